@@ -0,0 +1,123 @@
+/*******************************************************************************
+   Filename: analysis.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Method definitions for the Analyst class. The snapshot buffer
+             has one writer at a time: the search thread while a search runs,
+             and the analyst's own thread between searches (after waiting for
+             the previous search to finish).
+*******************************************************************************/
+
+#include "analysis.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "notation.h"
+
+using namespace std;
+
+namespace {
+
+string FormatScore(int score) {
+  char text[32];
+  if (score >= VALUE_MATE_IN_MAX_PLY) {
+    snprintf(text, sizeof(text), "#%d", (VALUE_MATE - score + 1) / 2);
+  } else if (score <= -VALUE_MATE_IN_MAX_PLY) {
+    snprintf(text, sizeof(text), "#-%d", (VALUE_MATE + score) / 2);
+  } else {
+    snprintf(text, sizeof(text), "%+.2f", score / 100.0);
+  }
+  return text;
+}
+
+void CopyText(const string &text, char *buffer) {
+  snprintf(buffer, ANALYSIS_TEXT_SIZE, "%s", text.c_str());
+}
+
+}  // namespace
+
+Analyst::Analyst() : quit_(false) {}
+
+Analyst::~Analyst() {
+  quit_ = true;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void Analyst::start() {
+  if (thread_.joinable()) {
+    return;
+  }
+  if (network_.load(NNUE_FILE)) {
+    search_.setNetwork(&network_);
+  }
+  search_.setInfoCallback([this](const SearchInfo &info) { report(info); });
+  thread_ = thread(&Analyst::run, this);
+}
+
+void Analyst::setPosition(const Position &pos) {
+  snprintf(requests_.writeBuffer().fen, ANALYSIS_FEN_SIZE, "%s",
+           pos.fen().c_str());
+  requests_.publish();
+}
+
+//------------------------------------------------------------------------------
+// Restarts the search whenever a new position arrives. A search that reaches
+// ANALYSIS_MAX_DEPTH ends by itself and the thread goes back to waiting.
+//------------------------------------------------------------------------------
+void Analyst::run() {
+  while (!quit_.load(memory_order_relaxed)) {
+    if (requests_.update()) {
+      search_.stop();
+      search_.wait();
+      Position pos;
+      if (pos.setFen(requests_.readBuffer().fen)) {
+        root_ = pos;
+        AnalysisSnapshot &snapshot = snapshots_.writeBuffer();
+        snapshot.key = pos.key();
+        snapshot.depth = 0;
+        CopyText("analyzing...", snapshot.summary);
+        snapshot.pv[0] = '\0';
+        snapshots_.publish();
+
+        SearchLimits limits;
+        limits.depth = ANALYSIS_MAX_DEPTH;
+        search_.start(pos, limits);
+      }
+    }
+    this_thread::sleep_for(chrono::milliseconds(ANALYSIS_POLL_MS));
+  }
+  search_.stop();
+  search_.wait();
+}
+
+//------------------------------------------------------------------------------
+// Turns a progress report into text, with the score from white's side and
+// the principal variation in SAN.
+//------------------------------------------------------------------------------
+void Analyst::report(const SearchInfo &info) {
+  Position pos = root_;
+  int score = pos.sideToMove() == WHITE ? info.score : -info.score;
+  string pv;
+  for (size_t i = 0; i < info.pv.size() && i < ANALYSIS_PV_MOVES; ++i) {
+    if (pos.sideToMove() == WHITE || i == 0) {
+      pv += to_string(pos.fullmoveNumber()) +
+            (pos.sideToMove() == WHITE ? ". " : "... ");
+    }
+    pv += MoveToSan(pos, info.pv[i]) + " ";
+    pos.doMove(info.pv[i]);
+  }
+
+  AnalysisSnapshot &snapshot = snapshots_.writeBuffer();
+  snapshot.key = root_.key();
+  snapshot.depth = info.depth;
+  CopyText("depth " + to_string(info.depth) + "  " + FormatScore(score),
+           snapshot.summary);
+  CopyText(pv, snapshot.pv);
+  snapshots_.publish();
+}
@@ -0,0 +1,72 @@
+/*******************************************************************************
+   Filename: analysis.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the Analyst class, which keeps the engine
+             analyzing whatever position the viewer shows. Positions go from
+             the render thread to a background thread, and results come back,
+             through triple buffers, so the render thread never takes a lock
+             or waits for the search; starting and stopping searches happens
+             on the background thread.
+*******************************************************************************/
+
+#ifndef ANALYSIS_H_
+#define ANALYSIS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "nnue.h"
+#include "search.h"
+#include "triple_buffer.h"
+
+#define ANALYSIS_MAX_DEPTH 24   // Stop there rather than spin forever.
+#define ANALYSIS_POLL_MS   20   // How often the analyst looks for positions.
+#define ANALYSIS_PV_MOVES  10
+#define ANALYSIS_TEXT_SIZE 128
+#define ANALYSIS_FEN_SIZE  128
+
+// The latest search result, as text ready to be drawn.
+struct AnalysisSnapshot {
+  uint64_t key;    // The position analyzed; 0 before the first one.
+  int depth;       // 0 until the first iteration finishes.
+  char summary[ANALYSIS_TEXT_SIZE];  // e.g., "depth 12  +0.35"
+  char pv[ANALYSIS_TEXT_SIZE];       // e.g., "1. e4 e5 2. Nf3 Nc6"
+};
+
+class Analyst {
+ public:
+  Analyst();
+  ~Analyst();  // Stops the search and joins the thread.
+
+  void start();
+  bool isRunning() const { return thread_.joinable(); }
+
+  // Render thread only; neither call blocks.
+  void setPosition(const Position &pos);
+  bool hasUpdate() const { return snapshots_.hasUpdate(); }
+  bool update() { return snapshots_.update(); }  // True if readBuffer moved.
+  const AnalysisSnapshot &snapshot() const { return snapshots_.readBuffer(); }
+
+ private:
+  struct PositionRequest {
+    char fen[ANALYSIS_FEN_SIZE];
+  };
+
+  Analyst(const Analyst &);  // Not copyable.
+  Analyst &operator=(const Analyst &);
+
+  void run();
+  void report(const SearchInfo &info);  // On the search's thread.
+
+  Search search_;
+  Network network_;
+  Position root_;  // Written only while no search is running.
+  TripleBuffer<PositionRequest> requests_;
+  TripleBuffer<AnalysisSnapshot> snapshots_;
+  std::atomic<bool> quit_;
+  std::thread thread_;
+};
+
+#endif  // ANALYSIS_H_
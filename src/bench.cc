@@ -0,0 +1,110 @@
+/*******************************************************************************
+   Filename: bench.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: The search benchmark. The positions cover openings,
+             middlegames and endgames so that a profile collected from them
+             (see CMakeLists.txt) reflects real games. Changing the list
+             changes every signature.
+*******************************************************************************/
+
+#include "bench.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include "cpu.h"
+#include "search.h"
+
+using namespace std;
+
+namespace {
+
+const char *kPositions[] = {
+  START_FEN,
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+  "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+  "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+  "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+  "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+  "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+  "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+  "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+  "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+  "8/8/1p6/3b4/1P1k1p2/8/3KBP2/8 w - - 2 68",
+  "8/5p2/5k2/p4r2/P1R3p1/6P1/5PK1/8 b - - 21 51",
+  "6r1/5k2/1p1p1p2/pP1PpP2/P3P3/8/3K4/1R6 w - - 5 46",
+};
+
+const int kNumPositions = sizeof(kPositions) / sizeof(kPositions[0]);
+
+uint64_t HashNodes(uint64_t hash, uint64_t nodes) {
+  for (int i = 0; i < 8; ++i) {
+    hash = (hash ^ ((nodes >> (8 * i)) & 0xFF)) * 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+}  // namespace
+
+bool RunBench(int depth, int threads, int hash_mb, bool verbose,
+              BenchResult *result) {
+  Position::initTables();
+  Search search;
+  search.setThreads(threads);
+  search.setHashSize(hash_mb);
+  SearchLimits limits;
+  limits.depth = depth;
+  result->nodes = 0;
+  result->signature = 0xCBF29CE484222325ULL;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 0; i < kNumPositions; ++i) {
+    Position pos;
+    if (!pos.setFen(kPositions[i])) {
+      cerr << "Error: invalid FEN " << kPositions[i] << endl;
+      return false;
+    }
+    search.clearHash();
+    search.start(pos, limits);
+    search.wait();
+    uint64_t nodes = search.nodes();
+    if (verbose) {
+      printf("position %2d/%d: %10llu nodes, best move %s\n", i + 1,
+             kNumPositions, (unsigned long long) nodes,
+             MoveToString(search.bestMove()).c_str());
+    }
+    result->nodes += nodes;
+    result->signature = HashNodes(result->signature, nodes);
+  }
+  result->seconds = chrono::duration<double>(chrono::steady_clock::now() -
+                                             start).count();
+  return true;
+}
+
+int BenchMain(int argc, char **argv) {
+  int depth = argc > 1 ? atoi(argv[1]) : BENCH_DEPTH;
+  int threads = argc > 2 ? atoi(argv[2]) : BENCH_THREADS;
+  int hash_mb = argc > 3 ? atoi(argv[3]) : BENCH_HASH;
+  if (argc > 4 || depth < 1 || depth >= MAX_PLY || threads < 1 ||
+      hash_mb < 1) {
+    cerr << "Usage: " << argv[0] << " [depth] [threads] [hash megabytes]"
+         << endl;
+    return 2;
+  }
+  BenchResult result;
+  if (!RunBench(depth, threads, hash_mb, true, &result)) {
+    return 1;
+  }
+  double seconds = result.seconds > 1e-9 ? result.seconds : 1e-9;
+  printf("depth %d, %d thread%s, %d MB hash, %s code\n", depth, threads,
+         threads == 1 ? "" : "s", hash_mb, CpuDispatchLevel());
+  printf("total nodes: %llu\n", (unsigned long long) result.nodes);
+  printf("time: %.0f ms\n", result.seconds * 1000);
+  printf("nodes/s: %.0f\n", result.nodes / seconds);
+  printf("signature: %016llx%s\n", (unsigned long long) result.signature,
+         threads == 1 ? "" : " (varies from run to run with more threads)");
+  return 0;
+}
@@ -0,0 +1,40 @@
+/*******************************************************************************
+   Filename: bench.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the search benchmark, run by "chess bench" and
+             by the standalone "bench" tool. A fixed, embedded set of
+             positions is searched to a fixed depth with a cleared hash table
+             before each one. With one thread the node counts depend only on
+             the code's behavior, never on timing, so their signature shows
+             whether an optimization meant to change nothing but speed really
+             changed nothing; the nodes per second track the speed itself.
+*******************************************************************************/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <cstdint>
+
+#define BENCH_DEPTH   9
+#define BENCH_THREADS 1
+#define BENCH_HASH    16  // Megabytes.
+
+struct BenchResult {
+  uint64_t nodes;
+  double seconds;
+  uint64_t signature;  // FNV-1a hash of every position's node count.
+};
+
+// Searches every position, printing a line for each when "verbose". Returns
+// false if a position is rejected.
+bool RunBench(int depth, int threads, int hash_mb, bool verbose,
+              BenchResult *result);
+
+// Parses "[depth] [threads] [hash megabytes]" (after the program or command
+// name in argv[0]), runs the benchmark and prints a summary. Returns the exit
+// status.
+int BenchMain(int argc, char **argv);
+
+#endif  // BENCH_H_
@@ -0,0 +1,186 @@
+/*******************************************************************************
+   Filename: bitboard.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Builds the attack tables declared in bitboard.h, including the
+             magic-bitboard (or PEXT) tables for sliding pieces.
+*******************************************************************************/
+
+#include "bitboard.h"
+
+Bitboard g_pawn_attacks[2][NUM_SQUARES];
+Bitboard g_knight_attacks[NUM_SQUARES];
+Bitboard g_king_attacks[NUM_SQUARES];
+Bitboard g_between[NUM_SQUARES][NUM_SQUARES];
+Bitboard g_line[NUM_SQUARES][NUM_SQUARES];
+Magic g_rook_magics[NUM_SQUARES];
+Magic g_bishop_magics[NUM_SQUARES];
+
+namespace {
+
+Bitboard rook_table[0x19000];
+Bitboard bishop_table[0x1480];
+
+const int kRookDirections[4][2]   = { { 1, 0 }, { -1, 0 }, { 0, 1 },
+                                      { 0, -1 } };
+const int kBishopDirections[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 },
+                                      { -1, -1 } };
+
+bool OnBoard(int row, int col) {
+  return row >= 0 && row < 8 && col >= 0 && col < 8;
+}
+
+// Returns the squares reached from "square" by stepping once by each of the
+// given (row, col) offsets.
+Bitboard StepAttacks(int square, const int steps[][2], int num_steps) {
+  Bitboard result = 0;
+  for (int i = 0; i < num_steps; ++i) {
+    int row = RowOf(square) + steps[i][0];
+    int col = ColOf(square) + steps[i][1];
+    if (OnBoard(row, col)) {
+      result |= SquareBB(SquareAt(row, col));
+    }
+  }
+  return result;
+}
+
+// Slow ray-walking attack generation, used only to fill the lookup tables.
+Bitboard SlidingAttacks(int square, Bitboard occupied,
+                        const int directions[4][2]) {
+  Bitboard result = 0;
+  for (int i = 0; i < 4; ++i) {
+    int row = RowOf(square) + directions[i][0];
+    int col = ColOf(square) + directions[i][1];
+    while (OnBoard(row, col)) {
+      Bitboard b = SquareBB(SquareAt(row, col));
+      result |= b;
+      if (occupied & b) {
+        break;
+      }
+      row += directions[i][0];
+      col += directions[i][1];
+    }
+  }
+  return result;
+}
+
+// Xorshift64* generator; a fixed seed keeps the magic search deterministic.
+struct Random {
+  uint64_t state;
+  uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+  }
+  uint64_t sparse() { return next() & next() & next(); }
+};
+
+void InitMagics(Magic magics[], Bitboard table[], const int directions[4][2]) {
+  // Seeds known to find magics for every rank quickly.
+  const uint64_t kSeeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645,
+                               255 };
+  Bitboard occupancy[4096], reference[4096];
+  int epoch[4096] = { 0 };
+  int current = 0;
+  Bitboard *next_table = table;
+
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    // Edge squares never affect the attack set, so leave them out of the mask:
+    Bitboard edges =
+        ((RANK_1_BB | RANK_8_BB) & ~(RANK_1_BB << (8 * RowOf(square)))) |
+        ((FILE_A_BB | FILE_H_BB) & ~(FILE_A_BB << ColOf(square)));
+    Magic &m = magics[square];
+    m.mask = SlidingAttacks(square, 0, directions) & ~edges;
+    m.shift = 64 - PopCount(m.mask);
+    m.attacks = next_table;
+
+    // Enumerate every subset of the mask (Carry-Rippler trick):
+    int size = 0;
+    Bitboard b = 0;
+    do {
+      occupancy[size] = b;
+      reference[size] = SlidingAttacks(square, b, directions);
+#ifdef __BMI2__
+      m.attacks[_pext_u64(b, m.mask)] = reference[size];
+#endif
+      ++size;
+      b = (b - m.mask) & m.mask;
+    } while (b);
+    next_table += size;
+
+#ifndef __BMI2__
+    Random rng = { kSeeds[RowOf(square)] };
+    for (int i = 0; i < size; ) {
+      for (m.magic = 0; PopCount((m.magic * m.mask) >> 56) < 6; ) {
+        m.magic = rng.sparse();
+      }
+      // A magic is good if every occupancy maps to a slot that is either
+      // unused in this attempt or already holds the same attack set:
+      ++current;
+      for (i = 0; i < size; ++i) {
+        unsigned index = m.index(occupancy[i]);
+        if (epoch[index] < current) {
+          epoch[index] = current;
+          m.attacks[index] = reference[i];
+        } else if (m.attacks[index] != reference[i]) {
+          break;
+        }
+      }
+    }
+#else
+    (void) kSeeds;
+    (void) occupancy;
+    (void) epoch;
+    (void) current;
+#endif
+  }
+}
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+// Fills in all attack tables. Must be called once before any move generation
+// (Position::initTables() does this).
+//------------------------------------------------------------------------------
+void InitBitboards() {
+  const int kKnightSteps[8][2] = { { 2, 1 }, { 2, -1 }, { -2, 1 }, { -2, -1 },
+                                   { 1, 2 }, { 1, -2 }, { -1, 2 }, { -1, -2 } };
+  const int kKingSteps[8][2] = { { 1, 1 }, { 1, 0 }, { 1, -1 }, { 0, 1 },
+                                 { 0, -1 }, { -1, 1 }, { -1, 0 }, { -1, -1 } };
+  const int kWhitePawnSteps[2][2] = { { 1, 1 }, { 1, -1 } };
+  const int kBlackPawnSteps[2][2] = { { -1, 1 }, { -1, -1 } };
+
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    g_knight_attacks[square] = StepAttacks(square, kKnightSteps, 8);
+    g_king_attacks[square] = StepAttacks(square, kKingSteps, 8);
+    g_pawn_attacks[0][square] = StepAttacks(square, kWhitePawnSteps, 2);
+    g_pawn_attacks[1][square] = StepAttacks(square, kBlackPawnSteps, 2);
+  }
+
+  InitMagics(g_rook_magics, rook_table, kRookDirections);
+  InitMagics(g_bishop_magics, bishop_table, kBishopDirections);
+
+  for (int a = 0; a < NUM_SQUARES; ++a) {
+    for (int b = 0; b < NUM_SQUARES; ++b) {
+      g_between[a][b] = g_line[a][b] = 0;
+      if (a == b) {
+        continue;
+      }
+      if (SlidingAttacks(a, 0, kRookDirections) & SquareBB(b)) {
+        g_line[a][b] = (SlidingAttacks(a, 0, kRookDirections) &
+                        SlidingAttacks(b, 0, kRookDirections)) |
+                       SquareBB(a) | SquareBB(b);
+        g_between[a][b] = RookAttacks(a, SquareBB(b)) &
+                          RookAttacks(b, SquareBB(a));
+      } else if (SlidingAttacks(a, 0, kBishopDirections) & SquareBB(b)) {
+        g_line[a][b] = (SlidingAttacks(a, 0, kBishopDirections) &
+                        SlidingAttacks(b, 0, kBishopDirections)) |
+                       SquareBB(a) | SquareBB(b);
+        g_between[a][b] = BishopAttacks(a, SquareBB(b)) &
+                          BishopAttacks(b, SquareBB(a));
+      }
+    }
+  }
+}
@@ -0,0 +1,106 @@
+/*******************************************************************************
+   Filename: bitboard.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: 64-bit board sets ("bitboards") and the precomputed attack tables
+             used by the move generator. Square 0 is a1, square 63 is h8; a
+             square's row is its rank and its column is its file.
+*******************************************************************************/
+
+#ifndef BITBOARD_H_
+#define BITBOARD_H_
+
+#include <cstdint>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+typedef uint64_t Bitboard;
+
+#define NUM_SQUARES 64
+#define NO_SQUARE   -1
+
+#define FILE_A_BB 0x0101010101010101ULL
+#define FILE_H_BB 0x8080808080808080ULL
+#define RANK_1_BB 0x00000000000000FFULL
+#define RANK_2_BB 0x000000000000FF00ULL
+#define RANK_4_BB 0x00000000FF000000ULL
+#define RANK_5_BB 0x000000FF00000000ULL
+#define RANK_7_BB 0x00FF000000000000ULL
+#define RANK_8_BB 0xFF00000000000000ULL
+
+constexpr int SquareAt(int row, int col) { return row * 8 + col; }
+constexpr int RowOf(int square) { return square >> 3; }
+constexpr int ColOf(int square) { return square & 7; }
+constexpr Bitboard SquareBB(int square) { return 1ULL << square; }
+constexpr Bitboard FileBB(int col) { return FILE_A_BB << col; }
+constexpr Bitboard RankBB(int row) { return RANK_1_BB << (row * 8); }
+
+inline int PopCount(Bitboard b) { return __builtin_popcountll(b); }
+inline int LowestSquare(Bitboard b) { return __builtin_ctzll(b); }
+inline bool MoreThanOne(Bitboard b) { return b & (b - 1); }
+
+// Removes the lowest set square from "b" and returns it.
+inline int PopLowestSquare(Bitboard &b) {
+  int square = LowestSquare(b);
+  b &= b - 1;
+  return square;
+}
+
+// Sliding-piece lookup data for one square. With BMI2 the table index is a
+// PEXT of the relevant occupancy; otherwise it comes from a magic multiply.
+struct Magic {
+  Bitboard mask;
+  Bitboard magic;
+  Bitboard *attacks;
+  unsigned shift;
+
+  unsigned index(Bitboard occupied) const {
+#ifdef __BMI2__
+    return (unsigned) _pext_u64(occupied, mask);
+#else
+    return (unsigned) (((occupied & mask) * magic) >> shift);
+#endif
+  }
+};
+
+extern Bitboard g_pawn_attacks[2][NUM_SQUARES];
+extern Bitboard g_knight_attacks[NUM_SQUARES];
+extern Bitboard g_king_attacks[NUM_SQUARES];
+extern Bitboard g_between[NUM_SQUARES][NUM_SQUARES];
+extern Bitboard g_line[NUM_SQUARES][NUM_SQUARES];
+extern Magic g_rook_magics[NUM_SQUARES];
+extern Magic g_bishop_magics[NUM_SQUARES];
+
+void InitBitboards();
+
+inline Bitboard PawnAttacks(int color, int square) {
+  return g_pawn_attacks[color][square];
+}
+
+inline Bitboard KnightAttacks(int square) { return g_knight_attacks[square]; }
+
+inline Bitboard KingAttacks(int square) { return g_king_attacks[square]; }
+
+inline Bitboard RookAttacks(int square, Bitboard occupied) {
+  const Magic &m = g_rook_magics[square];
+  return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard BishopAttacks(int square, Bitboard occupied) {
+  const Magic &m = g_bishop_magics[square];
+  return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard QueenAttacks(int square, Bitboard occupied) {
+  return RookAttacks(square, occupied) | BishopAttacks(square, occupied);
+}
+
+// Squares strictly between two aligned squares (empty if not aligned).
+inline Bitboard Between(int a, int b) { return g_between[a][b]; }
+
+// The full rank, file, or diagonal through two aligned squares.
+inline Bitboard Line(int a, int b) { return g_line[a][b]; }
+
+#endif  // BITBOARD_H_
@@ -0,0 +1,92 @@
+/*******************************************************************************
+   Filename: book.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for Polyglot opening books: a sorted array of
+             16-byte big-endian entries (position key, move, weight, learn)
+             that is searched in place through a memory mapping, so opening a
+             book costs nothing however large it is. Positions are keyed with
+             Polyglot's own hashing (PolyglotKey()), so books from other
+             tools can be read and books built here can be used elsewhere.
+*******************************************************************************/
+
+#ifndef BOOK_H_
+#define BOOK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "pgn.h"
+#include "position.h"
+
+#define BOOK_FILE         "books/opening.bin"  // Used if present.
+#define BOOK_ENTRY_SIZE   16
+#define BOOK_DEFAULT_PLIES 20
+
+struct BookMove {
+  Move move;
+  int weight;
+};
+
+// The Polyglot key of "pos", which differs from Position::key().
+uint64_t PolyglotKey(const Position &pos);
+
+// Polyglot move encoding: to file and rank, from file and rank (3 bits each)
+// and the promotion piece (1 = knight ... 4 = queen). Castling is written as
+// the king capturing its own rook.
+uint16_t EncodeBookMove(Move m);
+
+class OpeningBook {
+ public:
+  bool open(const char *filename);
+  void close() { file_.close(); }
+  bool isOpen() const { return file_.isOpen(); }
+
+  // Appends the legal book moves for "pos", heaviest first.
+  void probe(const Position &pos, std::vector<BookMove> *moves) const;
+
+  // Picks a book move with probability proportional to its weight, using
+  // "random" (any 32-bit value) as the source of chance. Returns NO_MOVE if
+  // the position is not in the book.
+  Move pick(const Position &pos, uint32_t random) const;
+
+ private:
+  MappedFile file_;
+};
+
+// Counts book moves in a batch of games. Each parsing thread fills its own
+// builder; WriteBook() merges them.
+class BookBuilder {
+ public:
+  BookBuilder() : plies_(BOOK_DEFAULT_PLIES) {}
+  void setPlies(int plies) { plies_ = plies; }  // Per game.
+
+  // Returns false, adding nothing, if a move cannot be read.
+  bool addGame(const PgnGame &game);
+  void sortEntries();  // Sorts by key and move and merges duplicates.
+
+ private:
+  friend bool WriteBook(const char *filename,
+                        const std::vector<BookBuilder> &parts,
+                        int min_games, size_t *entry_count);
+
+  struct Entry {
+    uint64_t key;
+    uint16_t move;  // Encoded.
+    uint32_t games;
+    uint32_t score;  // 2 per win and 1 per draw for the side to move.
+  };
+
+  int plies_;
+  Position pos_;
+  std::vector<Entry> entries_;
+};
+
+// Merges the parts and writes the moves played in at least "min_games" games
+// (and scoring at least once), with weights scaled to fit in 16 bits.
+bool WriteBook(const char *filename, const std::vector<BookBuilder> &parts,
+               int min_games, size_t *entry_count);
+
+#endif  // BOOK_H_
@@ -12,6 +12,79 @@ Description: Displays a chess board, chess pieces, and animations for a few
 
 using namespace std;
 
+// Global material-related variables:
+GLfloat redMaterial[] = { 0.7, 0.1, 0.2, 1.0 };
+GLfloat greenMaterial[] = { 0.1, 0.7, 0.4, 1.0 };
+GLfloat brightGreenMaterial[] = { 0.1, 0.9, 0.1, 1.0 };
+GLfloat blueMaterial[] = { 0.1, 0.2, 0.7, 1.0 };
+GLfloat whiteMaterial[] = { 1.0, 1.0, 1.0, 1.0 };
+GLfloat blackMaterial[] = { 0.0, 0.0, 0.0, 0.0 };
+
+// Global screen-related variables:
+double screen_x = 900;
+double screen_y = 600;
+
+// Global camera-related variables:
+double eye[3] = { DEFAULT_EYE_X, DEFAULT_EYE_Y, DEFAULT_EYE_Z };
+double at[3]  = { DEFAULT_AT_X, DEFAULT_AT_Y, DEFAULT_AT_Z };
+
+// Packed piece models (see mesh.h):
+MappedMeshFile g_mesh_file;
+
+// Rendering-related variables (see renderer.h):
+Renderer g_renderer;
+bool g_allow_shaders = true;
+int g_board_models[NUM_BOARD_PARTS];
+int g_piece_models[NUM_PIECE_MODELS];
+std::vector<RenderInstance> g_instances;
+
+// Frame timing (see frame_scheduler.h):
+FrameScheduler g_frame_scheduler;
+bool g_frame_pending = false;
+
+// Piece and camera animations (see timeline.h):
+Timeline g_timeline;
+
+// Opening book whose lines replace the scripted opening (see book.h):
+OpeningBook g_book;
+uint32_t g_book_seed = 0;
+
+// Background analysis of the position on the board (see analysis.h):
+std::unique_ptr<Analyst> g_analyst;
+
+// The board as last seen at rest:
+BoardWatch g_board_watch;
+
+// Input (see keys.h):
+double g_input_time = 0;
+int64_t g_camera_steps = 0;
+
+// Input recording and replay (see input_log.h):
+InputRecorder g_recorder;
+InputPlayer g_player;
+FrameTimeLog g_replay_frames;
+
+// Frame phase names, for the profiler:
+const char *kFramePhaseNames[NUM_FRAME_PHASES] = {
+  "input", "board", "pieces", "overlay", "swap"
+};
+static_assert(NUM_FRAME_PHASES <= PROFILER_PHASES, "Too many frame phases");
+
+// Profiling (see profiler.h):
+Profiler g_profiler;
+bool g_show_profiler = false;
+std::string g_trace_file;
+
+// Piece picking and dragging (see picking.h):
+PickBox g_piece_boxes[NUM_PIECE_MODELS];
+int g_highlight_model;
+Drag g_drag = { NO_PICK };
+
+// Global mouse-related variables:
+bool leftMouseDown = false;
+bool rightMouseDown = false;
+bool middleMouseDown = false;
+
 //------------------------------------------------------------------------------
 // Outputs a string of text at the specified location.
 //------------------------------------------------------------------------------
@@ -30,440 +103,791 @@ void text_output(double x, double y, char *string) {
 }
 
 //------------------------------------------------------------------------------
-// Given three triangle points, finds the normal vector n[0], n[1], n[2].
+// Loads the mesh for a given piece type, preferably straight from the
+// memory-mapped packed mesh file, otherwise by parsing its .POL model.
 //------------------------------------------------------------------------------
-void FindTriangleNormal(double x[], double y[], double z[], double n[]) {
-  // Convert the 3 input points to 2 vectors, v1 and v2:
-  double v1[3], v2[3];
-  v1[0] = x[1] - x[0];
-  v1[1] = y[1] - y[0];
-  v1[2] = z[1] - z[0];
-  v2[0] = x[2] - x[0];
-  v2[1] = y[2] - y[0];
-  v2[2] = z[2] - z[0];
-
-  // Get cross product of v1 and v2 to find the vector perpendicular to both:
-  n[0] = v1[1] * v2[2] - v1[2] * v2[1];
-  n[1] = -(v1[0] * v2[2] - v1[2] * v2[0]);
-  n[2] = v1[0] * v2[1] - v1[1] * v2[0];
-
-  double size = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
-  n[0] /= -size;
-  n[1] /= -size;
-  n[2] /= -size;
+void LoadPieceMesh(int type, Mesh *mesh) {
+  if (g_mesh_file.getMesh(type, mesh)) {
+    return;
+  }
+  char filename[64];
+  PolFileName(type, filename, sizeof(filename));
+  if (!LoadPolMesh(filename, mesh)) {
+    cerr << "Error: could not open " << filename << endl;
+    exit(1);
+  }
 }
 
 //------------------------------------------------------------------------------
-// Loads a given data file and draws it at its default position.
-// Call glTranslate before calling this to get it in the right place.
+// Appends a quad (given as four corners in order around its edge) to "mesh"
+// as two triangles, all facing the direction "normal".
 //------------------------------------------------------------------------------
-void DrawPiece(char filename[]) {
-  // Try to open the file:
-  char buffer[200];
-  ifstream in(filename);
-  if (!in) {
-    cerr << "Error: could not open " << filename << endl;
-    exit(1);
+void AddQuad(Mesh *mesh, const double corners[4][3], const float normal[3]) {
+  uint32_t first = (uint32_t) mesh->owned_vertices.size();
+  for (int i = 0; i < 4; ++i) {
+    MeshVertex v;
+    for (int j = 0; j < 3; ++j) {
+      v.normal[j] = normal[j];
+      v.position[j] = (float) corners[i][j];
+    }
+    mesh->owned_vertices.push_back(v);
+  }
+  const uint32_t kOrder[6] = { 0, 1, 2, 0, 2, 3 };
+  for (int i = 0; i < 6; ++i) {
+    mesh->owned_indices.push_back(first + kOrder[i]);
   }
+}
 
-  double x[100], y[100], z[100];  // To store one polygon, up to 100 vertices.
-  int done = false;
-  int verts = 0;  // Vertices in the current polygon.
-  int polygons = 0;  // Total polygons in this file.
-  do {
-    in.getline(buffer, 200);  // Get one line (point) from the file.
-    int count = sscanf(buffer, "%lf, %lf, %lf", &(x[verts]), &(y[verts]),
-                       &(z[verts]));
-    done = in.eof();
-    if (!done) {
-      if(count == 3) {  // If this line had an x,y,z point.
-        verts++;
-      } else {  // Line was empty: finish current polygon and start a new one.
-        if(verts >= 3) {
-          glBegin(GL_POLYGON);
-          double n[3];
-          FindTriangleNormal(x, y, z, n);
-          glNormal3dv(n);
-          for (int i = 0; i < verts; i++) {
-            glVertex3d(x[i], y[i], z[i]);
-          }
-          glEnd();  // End previous polygon.
-          polygons++;
-          verts = 0;
-        }
-      }
+//------------------------------------------------------------------------------
+// Builds the board's geometry, one mesh per material.
+//------------------------------------------------------------------------------
+void BuildBoardMeshes(Mesh parts[NUM_BOARD_PARTS]) {
+  const float kUp[3] = { 0, 1, 0 }, kDown[3] = { 0, -1, 0 };
+  const float kFront[3] = { 0, 0, -1 }, kBack[3] = { 0, 0, 1 };
+  const float kLeft[3] = { 1, 0, 0 }, kRight[3] = { -1, 0, 0 };
+
+  // Top (the dark area around and between the squares):
+  const double top[4][3] = {
+    { BOARD_TOP_RIGHT_EDGE + BOARD_BORDER, BOARD_TOP + Y_MODIFIER,
+      BOARD_TOP_FRONT_EDGE + BOARD_BORDER },
+    { BOARD_TOP_LEFT_EDGE - BOARD_BORDER, BOARD_TOP + Y_MODIFIER,
+      BOARD_TOP_FRONT_EDGE + BOARD_BORDER },
+    { BOARD_TOP_LEFT_EDGE - BOARD_BORDER, BOARD_TOP + Y_MODIFIER,
+      BOARD_TOP_BACK_EDGE - BOARD_BORDER },
+    { BOARD_TOP_RIGHT_EDGE + BOARD_BORDER, BOARD_TOP + Y_MODIFIER,
+      BOARD_TOP_BACK_EDGE - BOARD_BORDER }
+  };
+  AddQuad(&parts[BOARD_TOP_PART], top, kUp);
+
+  // Squares:
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 8; ++j) {
+      double x1 = BOARD_SQUARE_ORIGIN_X + i * BOARD_SQUARE_SIZE +
+                  BOARD_SQUARE_BORDER;
+      double x2 = x1 + BOARD_SQUARE_SIZE - 2 * BOARD_SQUARE_BORDER;
+      double z1 = BOARD_SQUARE_ORIGIN_Z + j * BOARD_SQUARE_SIZE +
+                  BOARD_SQUARE_BORDER;
+      double z2 = z1 + BOARD_SQUARE_SIZE - 2 * BOARD_SQUARE_BORDER;
+      double y = BOARD_TOP + Y_MODIFIER * 2;
+      const double square[4][3] = {
+        { x1, y, z1 }, { x1, y, z2 }, { x2, y, z2 }, { x2, y, z1 }
+      };
+      AddQuad(&parts[BOARD_SQUARES_PART], square, kUp);
     }
-  }while (!done);
-  if (verts > 0) {
-    cerr << "Error: extra vertices in file " << filename << endl;
-    exit(1);
+  }
+
+  // Main body:
+  const double main_top[4][3] = {
+    { BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE },
+    { BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE },
+    { BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE },
+    { BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE }
+  };
+  const double front[4][3] = {
+    { BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE },
+    { BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE },
+    { BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE },
+    { BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE }
+  };
+  const double left[4][3] = {
+    { BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE },
+    { BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE },
+    { BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE },
+    { BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE }
+  };
+  const double right[4][3] = {
+    { BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE },
+    { BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE },
+    { BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE },
+    { BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE }
+  };
+  const double back[4][3] = {
+    { BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE },
+    { BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE },
+    { BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE },
+    { BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE }
+  };
+  const double bottom[4][3] = {
+    { BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE },
+    { BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE },
+    { BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE },
+    { BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE }
+  };
+  AddQuad(&parts[BOARD_MAIN_PART], main_top, kUp);
+  AddQuad(&parts[BOARD_MAIN_PART], front, kFront);
+  AddQuad(&parts[BOARD_MAIN_PART], left, kLeft);
+  AddQuad(&parts[BOARD_MAIN_PART], right, kRight);
+  AddQuad(&parts[BOARD_MAIN_PART], back, kBack);
+  AddQuad(&parts[BOARD_MAIN_PART], bottom, kDown);
+  for (int i = 0; i < NUM_BOARD_PARTS; ++i) {
+    parts[i].adoptOwnedData();
   }
 }
 
 //------------------------------------------------------------------------------
-// GLUT callback functions
+// Builds the marker for squares a held piece may move to: a square centered
+// on the origin, just above the board's squares.
 //------------------------------------------------------------------------------
+void BuildHighlightMesh(Mesh *mesh) {
+  const float kUp[3] = { 0, 1, 0 };
+  double half = BOARD_SQUARE_SIZE / 2 - BOARD_SQUARE_BORDER;
+  double y = BOARD_TOP + Y_MODIFIER * 3;
+  const double square[4][3] = {
+    { -half, y, -half }, { -half, y, half }, { half, y, half },
+    { half, y, -half }
+  };
+  AddQuad(mesh, square, kUp);
+  mesh->adoptOwnedData();
+}
 
-void Interpolate(double t1, double t, double t2,
-                 double x1, double &x, double x2) {
-  if (t < t1) {
-    x = x1;
-  } else if (t > t2) {
-    x = x2;
-  } else {
-    double ratio = (t - t1) / (t2 - t1);
-    x = x1 + (x2 - x1) * ratio;
-  }
+//------------------------------------------------------------------------------
+// Queues one model to be drawn this frame.
+//------------------------------------------------------------------------------
+void AddInstance(int model, const GLfloat color[4], double x, double y,
+                 double z, double x_angle = 0, double y_angle = 0,
+                 double scale = 1) {
+  RenderInstance instance;
+  instance.model = model;
+  SetInstanceTransform(&instance, x, y, z, x_angle, y_angle, scale);
+  SetInstanceColor(&instance, color);
+  g_instances.push_back(instance);
+}
+
+void AddPiece(int type, const GLfloat color[4], double x, double y, double z,
+              double x_angle = 0, double y_angle = 0, double scale = 1) {
+  AddInstance(g_piece_models[type - PAWN], color, x, y, z, x_angle, y_angle,
+              scale);
 }
 
-void TurnCameraClockwise() {
+//------------------------------------------------------------------------------
+// GLUT callback functions
+//------------------------------------------------------------------------------
+
+void TurnCameraClockwise(double distance) {
   if (eye[2] > DEFAULT_AT_Z) {
-    eye[0] -= CAMERA_SPEED;
+    eye[0] -= distance;
   } else {
-    eye[0] += CAMERA_SPEED;
+    eye[0] += distance;
   }
   if (eye[0] > DEFAULT_AT_X) {
-    eye[2] += CAMERA_SPEED;
+    eye[2] += distance;
   } else {
-    eye[2] -= CAMERA_SPEED;
+    eye[2] -= distance;
   }
 }
 
-void TurnCameraCounterclockwise() {
+void TurnCameraCounterclockwise(double distance) {
   if (eye[2] > DEFAULT_AT_Z) {
-    eye[0] += CAMERA_SPEED;
+    eye[0] += distance;
   } else {
-    eye[0] -= CAMERA_SPEED;
+    eye[0] -= distance;
   }
   if (eye[0] > DEFAULT_AT_X) {
-    eye[2] -= CAMERA_SPEED;
+    eye[2] -= distance;
   } else {
-    eye[2] += CAMERA_SPEED;
+    eye[2] += distance;
   }
 }
 
-void display(void) {
-  double x, y, z, angle;  // For chess piece animations.
-
-  if (isKeyPressed(KEY_ESCAPE)) {
-    exit(0);
-  }
+//------------------------------------------------------------------------------
+// Returns true while any camera control is held down.
+//------------------------------------------------------------------------------
+bool IsCameraMoving() {
+  return leftMouseDown || rightMouseDown || middleMouseDown ||
+         isActionActive(TURN_LEFT_ACTION) ||
+         isActionActive(TURN_RIGHT_ACTION) ||
+         isActionActive(RAISE_CAMERA_ACTION) ||
+         isActionActive(LOWER_CAMERA_ACTION);
+}
 
-  // Track the current time for animations:
-  double currentTime = (double) clock() / CLOCKS_PER_SEC;
+void OnFrameTimer(int value) {
+  g_frame_pending = false;
+  glutPostRedisplay();
+}
 
-  // At launch, zoom toward the board from a distant vantage point:
-  if (currentTime <= INTRO_ZOOM_DURATION) {
-    Interpolate(0, currentTime, INTRO_ZOOM_DURATION, INITIAL_EYE_X, eye[0],
-                DEFAULT_EYE_X);
+//------------------------------------------------------------------------------
+// Requests another frame once the frame-rate cap allows it. When nothing is
+// moving, display() does not call this, so the viewer sleeps until an input
+// event posts a redisplay.
+//------------------------------------------------------------------------------
+void ScheduleNextFrame() {
+  if (g_frame_pending) {
+    return;
+  }
+  int delay = g_frame_scheduler.millisecondsUntilNextFrame();
+  if (delay > 0) {
+    g_frame_pending = true;
+    glutTimerFunc(delay, OnFrameTimer, 0);
   } else {
-    // After the initial zoom, adjust perspective according to user input:
-    if (leftMouseDown || isKeyPressed(KEY_LEFT) || isKeyPressed('a')) {
-      TurnCameraClockwise();
-    }
-    if (rightMouseDown || isKeyPressed(KEY_RIGHT) || isKeyPressed('d')) {
-      TurnCameraCounterclockwise();
+    glutPostRedisplay();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Moves the camera by up to "distance" units according to user input, unless
+// the camera is being animated at "time".
+//------------------------------------------------------------------------------
+void UpdateCamera(double distance, double time) {
+  if (g_timeline.isActorAnimating(CAMERA_ACTOR, time)) {
+    return;
+  }
+  if (leftMouseDown || isActionActive(TURN_LEFT_ACTION)) {
+    TurnCameraClockwise(distance);
+  }
+  if (rightMouseDown || isActionActive(TURN_RIGHT_ACTION)) {
+    TurnCameraCounterclockwise(distance);
+  }
+  if (middleMouseDown || isActionActive(RAISE_CAMERA_ACTION)) {
+    if (eye[1] < Y_MAX) {
+      eye[1] += distance;
     }
-    if (middleMouseDown || isKeyPressed(KEY_UP) || isKeyPressed('w')) {
-      if (eye[1] < Y_MAX) {
-        eye[1] += CAMERA_SPEED;
-      }
+  }
+  if (isActionActive(LOWER_CAMERA_ACTION)) {
+    if (eye[1] > Y_MIN) {
+      eye[1] -= distance;
     }
-    if (isKeyPressed(KEY_DOWN) || isKeyPressed('s')) {
-      if (eye[1] > Y_MIN) {
-        eye[1] -= CAMERA_SPEED;
-      }
+  }
+}
+
+void AddBoard() {
+  AddInstance(g_board_models[BOARD_TOP_PART], BOARD_TOP_COLOR, 0, 0, 0);
+  AddInstance(g_board_models[BOARD_SQUARES_PART], LIGHT_SQUARE_COLOR, 0, 0,
+              0);
+  AddInstance(g_board_models[BOARD_MAIN_PART], BOARD_MAIN_COLOR, 0, 0, 0);
+  if (g_drag.piece != NO_PICK) {
+    for (const Move *m = g_drag.moves.begin(); m != g_drag.moves.end(); ++m) {
+      AddInstance(g_highlight_model, HIGHLIGHT_COLOR,
+                  SquareCenterX(ColOf(ToSquare(*m))), 0,
+                  SquareCenterZ(RowOf(ToSquare(*m))));
     }
   }
+}
 
-  // Prepare to draw to the screen:
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glLoadIdentity();
-  gluLookAt(eye[0], eye[1], eye[2],
-            at[0], at[1], at[2],
-            0, 1, 0);  // Y is up!
+//------------------------------------------------------------------------------
+// Queues every piece in "position" on its square, for still diagrams.
+//------------------------------------------------------------------------------
+void AddPositionPieces(const Position &position) {
+  for (Bitboard b = position.pieces(); b; ) {
+    int square = PopLowestSquare(b);
+    int piece = position.pieceOn(square);
+    bool white = ColorOf(piece) == WHITE;
+    AddPiece(TypeOf(piece), white ? LIGHT_PIECE_COLOR : DARK_PIECE_COLOR,
+             SquareCenterX(ColOf(square)), 0,
+             SquareCenterZ(RowOf(square)), 0,
+             TypeOf(piece) == KNIGHT && !white ? 180 : 0);
+  }
+}
 
-  //
-  // Draw the board:
-  //
+//------------------------------------------------------------------------------
+// Queues every piece in the animation timeline as it currently stands.
+//------------------------------------------------------------------------------
+void AddTimelinePieces() {
+  for (int i = 0; i < g_timeline.pieceCount(); ++i) {
+    if (i == g_drag.piece) {
+      AddPiece(g_timeline.pieceType(i),
+               g_timeline.pieceColor(i) == WHITE ? LIGHT_PIECE_COLOR :
+                                                   DARK_PIECE_COLOR,
+               g_drag.x, DRAG_LIFT, g_drag.z, 0,
+               g_timeline.pieceValue(CHANNEL_Y_ANGLE, i),
+               g_timeline.pieceValue(CHANNEL_SCALE, i));
+      continue;
+    }
+    AddPiece(g_timeline.pieceType(i),
+             g_timeline.pieceColor(i) == WHITE ? LIGHT_PIECE_COLOR :
+                                                 DARK_PIECE_COLOR,
+             g_timeline.pieceValue(CHANNEL_X, i),
+             g_timeline.pieceValue(CHANNEL_Y, i),
+             g_timeline.pieceValue(CHANNEL_Z, i),
+             g_timeline.pieceValue(CHANNEL_X_ANGLE, i),
+             g_timeline.pieceValue(CHANNEL_Y_ANGLE, i),
+             g_timeline.pieceValue(CHANNEL_SCALE, i));
+  }
+}
 
-  // Top
-  glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, BOARD_TOP_COLOR);
-  glBegin(GL_QUADS);
-  glVertex3d(BOARD_TOP_RIGHT_EDGE + BOARD_BORDER,
-             BOARD_TOP + Y_MODIFIER,
-             BOARD_TOP_FRONT_EDGE + BOARD_BORDER);
-  glVertex3d(BOARD_TOP_LEFT_EDGE - BOARD_BORDER,
-             BOARD_TOP + Y_MODIFIER,
-             BOARD_TOP_FRONT_EDGE + BOARD_BORDER);
-  glVertex3d(BOARD_TOP_LEFT_EDGE - BOARD_BORDER,
-             BOARD_TOP + Y_MODIFIER,
-             BOARD_TOP_BACK_EDGE - BOARD_BORDER);
-  glVertex3d(BOARD_TOP_RIGHT_EDGE + BOARD_BORDER,
-             BOARD_TOP + Y_MODIFIER,
-             BOARD_TOP_BACK_EDGE - BOARD_BORDER);
-  glEnd();
-  glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, LIGHT_SQUARE_COLOR);
-  for (int i = 0; i < 8; ++i) {
-    for (int j = 0; j < 8; ++j) {
-      glBegin(GL_QUADS);
-      glVertex3d(BOARD_SQUARE_ORIGIN_X + i * BOARD_SQUARE_SIZE +
-                   BOARD_SQUARE_BORDER,
-                 BOARD_TOP + Y_MODIFIER * 2,
-                 BOARD_SQUARE_ORIGIN_Z + j * BOARD_SQUARE_SIZE +
-                   BOARD_SQUARE_BORDER);
-      glVertex3d(BOARD_SQUARE_ORIGIN_X + i * BOARD_SQUARE_SIZE +
-                   BOARD_SQUARE_BORDER,
-                 BOARD_TOP + Y_MODIFIER * 2,
-                 BOARD_SQUARE_ORIGIN_Z + j * BOARD_SQUARE_SIZE +
-                   BOARD_SQUARE_SIZE - BOARD_SQUARE_BORDER);
-      glVertex3d(BOARD_SQUARE_ORIGIN_X + i * BOARD_SQUARE_SIZE +
-                   BOARD_SQUARE_SIZE - BOARD_SQUARE_BORDER,
-                 BOARD_TOP + Y_MODIFIER * 2,
-                 BOARD_SQUARE_ORIGIN_Z + j * BOARD_SQUARE_SIZE +
-                   BOARD_SQUARE_SIZE - BOARD_SQUARE_BORDER);
-      glVertex3d(BOARD_SQUARE_ORIGIN_X + i * BOARD_SQUARE_SIZE +
-                   BOARD_SQUARE_SIZE - BOARD_SQUARE_BORDER,
-                 BOARD_TOP + Y_MODIFIER * 2,
-                 BOARD_SQUARE_ORIGIN_Z + j * BOARD_SQUARE_SIZE +
-                   BOARD_SQUARE_BORDER);
-      glEnd();
-    }
-  }
-  glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, BOARD_MAIN_COLOR);
-  glBegin(GL_QUADS);
-  glVertex3d(BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE);
-  glVertex3d(BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE);
-  glVertex3d(BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE);
-  glVertex3d(BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE);
-  glEnd();
-
-  // Front
-  glBegin(GL_QUADS);
-  glVertex3d(BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE);
-  glVertex3d(BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE);
-  glVertex3d(BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE);
-  glVertex3d(BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE);
-  glEnd();
-
-  // Left
-  glBegin(GL_QUADS);
-  glVertex3d(BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE);
-  glVertex3d(BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE);
-  glVertex3d(BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE);
-  glVertex3d(BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE);
-  glEnd();
-
-  // Right
-  glBegin(GL_QUADS);
-  glVertex3d(BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_FRONT_EDGE);
-  glVertex3d(BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE);
-  glVertex3d(BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE);
-  glVertex3d(BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE);
-  glEnd();
-
-  // Back
-  glBegin(GL_QUADS);
-  glVertex3d(BOARD_TOP_LEFT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE);
-  glVertex3d(BOARD_TOP_RIGHT_EDGE, BOARD_TOP, BOARD_TOP_BACK_EDGE);
-  glVertex3d(BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE);
-  glVertex3d(BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE);
-  glEnd();
-
-  // Bottom
-  glBegin(GL_QUADS);
-  glVertex3d(BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE);
-  glVertex3d(BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_FRONT_EDGE);
-  glVertex3d(BOARD_BOTTOM_LEFT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE);
-  glVertex3d(BOARD_BOTTOM_RIGHT_EDGE, BOARD_BOTTOM, BOARD_BOTTOM_BACK_EDGE);
-  glEnd();
+//------------------------------------------------------------------------------
+// Reads the board as the timeline currently shows it, and optionally which
+// timeline piece stands on each square. Returns false while a piece is between
+// squares or two share one (mid-capture). Toppled and sunken pieces count as
+// captured.
+//------------------------------------------------------------------------------
+bool ReadShownBoard(int board[NUM_SQUARES], int pieces[NUM_SQUARES] = NULL) {
+  const double kTolerance = 0.05;  // In squares.
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    board[square] = NO_PIECE;
+    if (pieces) {
+      pieces[square] = NO_PICK;
+    }
+  }
+  for (int i = 0; i < g_timeline.pieceCount(); ++i) {
+    if (g_timeline.pieceValue(CHANNEL_Y, i) < -Y_MODIFIER ||
+        fabs(g_timeline.pieceValue(CHANNEL_X_ANGLE, i)) > 1) {
+      continue;
+    }
+    double col = 8 - g_timeline.pieceValue(CHANNEL_X, i) / SQUARE_SPACING;
+    double row = g_timeline.pieceValue(CHANNEL_Z, i) / SQUARE_SPACING - 1;
+    int c = (int) lround(col), r = (int) lround(row);
+    if (fabs(col - c) > kTolerance || fabs(row - r) > kTolerance) {
+      return false;
+    }
+    if (c < 0 || c > 7 || r < 0 || r > 7) {
+      continue;
+    }
+    int square = SquareAt(r, c);
+    if (board[square] != NO_PIECE) {
+      return false;
+    }
+    board[square] = MakePiece(g_timeline.pieceColor(i),
+                              g_timeline.pieceType(i));
+    if (pieces) {
+      pieces[square] = i;
+    }
+  }
+  return true;
+}
 
-  //
-  // Draw the 16 white pieces:
-  //
+//------------------------------------------------------------------------------
+// Returns a FEN string for "board" with "side" to move. The viewer keeps no
+// game record, so en passant is never possible and castling is allowed
+// wherever the king and rook are still at home.
+//------------------------------------------------------------------------------
+string BoardFen(const int board[NUM_SQUARES], int side) {
+  string fen;
+  for (int row = 7; row >= 0; --row) {
+    int empty = 0;
+    for (int col = 0; col < 8; ++col) {
+      int piece = board[SquareAt(row, col)];
+      if (piece == NO_PIECE) {
+        ++empty;
+        continue;
+      }
+      if (empty) {
+        fen += (char) ('0' + empty);
+        empty = 0;
+      }
+      char c = "prbnqk"[TypeOf(piece) - PAWN];
+      fen += ColorOf(piece) == WHITE ? (char) toupper(c) : c;
+    }
+    if (empty) {
+      fen += (char) ('0' + empty);
+    }
+    fen += row > 0 ? "/" : "";
+  }
+  // Castling rights whose king or rook has left home are dropped by setFen():
+  return fen + (side == WHITE ? " w KQkq - 0 1" : " b KQkq - 0 1");
+}
 
-  //GLfloat mat_amb_diff1[] = { 0.8, 0.9, 0.5, 1.0 };
-  glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, LIGHT_PIECE_COLOR);
+//------------------------------------------------------------------------------
+// Hands the position on the board to the analyst once the pieces have come to
+// rest. The timeline does not know whose move it is, so the side to move is
+// the opponent of whoever moved last, starting with white.
+//------------------------------------------------------------------------------
+void WatchBoard(double time) {
+  BoardWatch &watch = g_board_watch;
+  int board[NUM_SQUARES];
+  if (!ReadShownBoard(board)) {
+    return;
+  }
+  if (memcmp(board, watch.resting, sizeof(board)) != 0) {
+    memcpy(watch.resting, board, sizeof(board));
+    watch.resting_since = time;
+  }
+  if ((g_timeline.isAnimating() &&
+       time - watch.resting_since < ANALYSIS_SETTLE_SECONDS) ||
+      (watch.side_to_move >= 0 &&
+       memcmp(board, watch.analyzed, sizeof(board)) == 0)) {
+    return;
+  }
+  int side = watch.side_to_move < 0 ? WHITE : watch.side_to_move;
+  for (int square = 0; square < NUM_SQUARES && watch.side_to_move >= 0;
+       ++square) {
+    if (board[square] != NO_PIECE && board[square] != watch.analyzed[square]) {
+      side = ColorOf(board[square]) ^ 1;
+    }
+  }
+  memcpy(watch.analyzed, board, sizeof(board));
+  watch.side_to_move = side;
 
-  // King
-  glPushMatrix();
-  glTranslatef(4000, 0, 1000);
-  glCallList(KING);
-  glPopMatrix();
+  Position position;
+  if (position.setFen(BoardFen(board, side))) {
+    g_analyst->setPosition(position);
+  }
+}
 
-  // Queen
+//------------------------------------------------------------------------------
+// Sets up for drawing text in window coordinates, with (0, 0) at the bottom
+// left; EndOverlay() restores the 3D state.
+//------------------------------------------------------------------------------
+void BeginOverlay() {
+  glMatrixMode(GL_PROJECTION);
   glPushMatrix();
-  glTranslatef(5000, 0, 1000);
-  glCallList(QUEEN);
-  glPopMatrix();
-
-  // Bishop 1
-  //double yScale = 1.0;
-  //Interpolate(INTRO_ZOOM_DURATION + 5, currentTime, INTRO_ZOOM_DURATION + 7,
-  //            1, yScale, 0);
+  glLoadIdentity();
+  glOrtho(0, screen_x, 0, screen_y, -1, 1);
+  glMatrixMode(GL_MODELVIEW);
   glPushMatrix();
-  glTranslatef(3000, 0, 1000);
-  //glScaled(1, yScale, 1);
-  glCallList(BISHOP);
-  glPopMatrix();
+  glLoadIdentity();
+  glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+  glDisable(GL_LIGHTING);
+  glDisable(GL_DEPTH_TEST);
+  glColor3f(0, 0, 0);
+}
 
-  // Bishop 2
-  glPushMatrix();
-  glTranslatef(6000, 0, 1000);
-  glCallList(BISHOP);
+void EndOverlay() {
+  glPopAttrib();
   glPopMatrix();
-
-  // Knight 1
-  glPushMatrix();
-  glTranslatef(2000, 0, 1000);
-  glCallList(KNIGHT);
+  glMatrixMode(GL_PROJECTION);
   glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+}
 
-  // Knight 2
-  glPushMatrix();
-  glTranslatef(7000, 0, 1000);
-  glCallList(KNIGHT);
-  glPopMatrix();
+//------------------------------------------------------------------------------
+// Draws the latest analysis in the top left corner of the window.
+//------------------------------------------------------------------------------
+void DrawAnalysis() {
+  const AnalysisSnapshot &snapshot = g_analyst->snapshot();
+  if (snapshot.key == 0) {
+    return;
+  }
+  char summary[ANALYSIS_TEXT_SIZE], pv[ANALYSIS_TEXT_SIZE];
+  strcpy(summary, snapshot.summary);
+  strcpy(pv, snapshot.pv);
+  BeginOverlay();
+  text_output(10, screen_y - 20, summary);
+  text_output(10, screen_y - 40, pv);
+  EndOverlay();
+}
 
-  // Rook 1
-  y = (currentTime > INTRO_ZOOM_DURATION + 7.5) ? -100 : 0;
-  Interpolate(INTRO_ZOOM_DURATION + 6.5, currentTime,
-              INTRO_ZOOM_DURATION + 7.5, 0, angle, -180);
-  Interpolate(INTRO_ZOOM_DURATION + 5, currentTime, INTRO_ZOOM_DURATION + 6,
-              1000, z, 7000);
-  glPushMatrix();
-  glTranslatef(1000, y, z);
-  glRotatef(angle, 1, 0, 0);
-  glCallList(ROOK);
-  glPopMatrix();
+//------------------------------------------------------------------------------
+// Draws frame-time statistics in the bottom left corner of the window. They
+// cover frames drawn, not wall-clock time: an idle viewer draws none.
+//------------------------------------------------------------------------------
+void DrawProfiler() {
+  FrameStats stats = g_profiler.frameStats();
+  char lines[3][128];
+  snprintf(lines[0], sizeof(lines[0]),
+           "frame ms: min %.2f  avg %.2f  p99 %.2f  (%d frames)",
+           stats.min_ms, stats.average_ms, stats.p99_ms, stats.frames);
+  snprintf(lines[1], sizeof(lines[1]), "%d draw calls, %ld vertices",
+           stats.draw_calls, stats.vertices);
+  int length = snprintf(lines[2], sizeof(lines[2]), "avg ms:");
+  for (int i = 0; i < NUM_FRAME_PHASES; ++i) {
+    length += snprintf(lines[2] + length, sizeof(lines[2]) - length,
+                       "  %s %.2f", kFramePhaseNames[i],
+                       g_profiler.phaseAverageMs(i));
+  }
+  BeginOverlay();
+  for (int i = 0; i < 3; ++i) {
+    text_output(10, 50 - 20 * i, lines[i]);
+  }
+  EndOverlay();
+}
 
-  // Rook 2
-  glPushMatrix();
-  glTranslatef(8000, 0, 1000);
-  glCallList(ROOK);
-  glPopMatrix();
+//------------------------------------------------------------------------------
+// Redraws when the analyst has published something new. Polling from the
+// GLUT thread keeps all drawing there without the analyst ever waiting on it.
+//------------------------------------------------------------------------------
+void OnAnalysisTimer(int value) {
+  if (g_analyst->hasUpdate()) {
+    glutPostRedisplay();
+  }
+  glutTimerFunc(ANALYSIS_REDRAW_MS, OnAnalysisTimer, 0);
+}
 
-  // Pawns
-  for(int i = 1; i <= 8; ++i) {
-    x = i * 1000;
-    z = 2000;
-    if (i == 1) {
-      if (currentTime <= INTRO_ZOOM_DURATION + 2) {
-        Interpolate(INTRO_ZOOM_DURATION + 1, currentTime,
-                    INTRO_ZOOM_DURATION + 2, 2000, z, 4000);
-      } else {
-        Interpolate(INTRO_ZOOM_DURATION + 3, currentTime,
-                    INTRO_ZOOM_DURATION + 4, 4000, z, 5000);
-      }
-      Interpolate(INTRO_ZOOM_DURATION + 3, currentTime,
-                  INTRO_ZOOM_DURATION + 4, i * 1000, x, i * 1000 + 1000);
+//------------------------------------------------------------------------------
+// Picks up the piece under window pixel (x, y), unless pieces are still being
+// animated. The viewer keeps no game record, so the side whose piece it is
+// moves next. Returns false if there is no piece there to pick up.
+//------------------------------------------------------------------------------
+bool PickUpPiece(int x, int y) {
+  ProfileScope scope(&g_profiler, "pick");
+  int board[NUM_SQUARES];
+  if (g_timeline.isAnimating() || !ReadShownBoard(board, g_drag.pieces)) {
+    return false;
+  }
+  PieceGrid grid;
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    int i = g_drag.pieces[square];
+    if (i != NO_PICK) {
+      grid.add(square, PlacePickBox(g_piece_boxes[g_timeline.pieceType(i) -
+                                                  PAWN],
+                                    g_timeline.pieceValue(CHANNEL_X, i),
+                                    g_timeline.pieceValue(CHANNEL_Y, i),
+                                    g_timeline.pieceValue(CHANNEL_Z, i),
+                                    g_timeline.pieceValue(CHANNEL_SCALE, i)));
     }
-    glPushMatrix();
-    glTranslatef(x, 0, z);
-    glCallList(PAWN);
-    glPopMatrix();
+  }
+  int from = grid.pick(ScreenRay(eye, at, FIELD_OF_VIEW, screen_x, screen_y,
+                                 x, y), NULL);
+  Position position;
+  if (from == NO_PICK ||
+      !position.setFen(BoardFen(board, ColorOf(board[from])))) {
+    return false;
   }
 
-  //
-  // Draw the 16 black pieces:
-  //
+  // Pawns are always promoted to queens:
+  MoveList legal;
+  GenerateLegalMoves(position, &legal);
+  g_drag.moves = MoveList();
+  for (const Move *m = legal.begin(); m != legal.end(); ++m) {
+    if (FromSquare(*m) == from &&
+        (!IsPromotion(*m) || PromotionType(*m) == QUEEN)) {
+      g_drag.moves.add(*m);
+    }
+  }
+  g_drag.piece = g_drag.pieces[from];
+  g_drag.from = from;
+  g_drag.x = g_timeline.pieceValue(CHANNEL_X, g_drag.piece);
+  g_drag.z = g_timeline.pieceValue(CHANNEL_Z, g_drag.piece);
+  return true;
+}
 
-  //GLfloat mat_amb_diff2[] = { 0.1, 0.5, 0.8, 1.0 };
-  glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, DARK_PIECE_COLOR);
+//------------------------------------------------------------------------------
+// Keeps the held piece under the mouse pointer.
+//------------------------------------------------------------------------------
+void DragPiece(int x, int y) {
+  if (g_drag.piece == NO_PICK) {
+    return;
+  }
+  double point[3];
+  if (IntersectPlaneY(ScreenRay(eye, at, FIELD_OF_VIEW, screen_x, screen_y,
+                                x, y), DRAG_LIFT, point)) {
+    g_drag.x = point[0];
+    g_drag.z = point[2];
+  }
+}
 
-  // King
-  glPushMatrix();
-  glTranslatef(4000, 0, 8000);
-  glCallList(KING);
-  glPopMatrix();
+//------------------------------------------------------------------------------
+// Animates timeline piece "i" from (x, y, z) onto "square", starting at
+// "time".
+//------------------------------------------------------------------------------
+void SlidePiece(int i, double x, double y, double z, int square,
+                double time) {
+  double end = time + DROP_SECONDS;
+  g_timeline.addPieceSegment(i, CHANNEL_X, time, end, x,
+                             SquareCenterX(ColOf(square)), EASE_OUT);
+  g_timeline.addPieceSegment(i, CHANNEL_Y, time, end, y, 0, EASE_OUT);
+  g_timeline.addPieceSegment(i, CHANNEL_Z, time, end, z,
+                             SquareCenterZ(RowOf(square)), EASE_OUT);
+}
 
-  // Queen
-  glPushMatrix();
-  glTranslatef(5000, 0, 8000);
-  glCallList(QUEEN);
-  glPopMatrix();
+//------------------------------------------------------------------------------
+// Puts the held piece down. Over a legal destination the move is played out
+// on the timeline, starting at "time", like the scripted ones; anywhere else
+// the piece goes back.
+//------------------------------------------------------------------------------
+void DropPiece(int x, int y, double time) {
+  DragPiece(x, y);
+  int i = g_drag.piece;
+  int to = SquareAtPoint(g_drag.x, g_drag.z);
+  g_drag.piece = NO_PICK;
+  Move move = NO_MOVE;
+  for (const Move *m = g_drag.moves.begin(); m != g_drag.moves.end(); ++m) {
+    if (ToSquare(*m) == to) {
+      move = *m;
+    }
+  }
+  if (move == NO_MOVE) {
+    SlidePiece(i, g_drag.x, DRAG_LIFT, g_drag.z, g_drag.from, time);
+    return;
+  }
 
-  // Bishop 1
-  glPushMatrix();
-  glTranslatef(3000, 0, 8000);
-  glCallList(BISHOP);
-  glPopMatrix();
+  int captured = FlagOf(move) == EN_PASSANT ? SquareAt(RowOf(g_drag.from),
+                                                       ColOf(to)) : to;
+  if (IsCapture(move) && g_drag.pieces[captured] != NO_PICK) {
+    int victim = g_drag.pieces[captured];
+    double end = time + CAPTURE_SECONDS;
+    g_timeline.addPieceSegment(victim, CHANNEL_X_ANGLE, time, end, 0, 180,
+                               EASE_IN);
+    g_timeline.addPieceSegment(victim, CHANNEL_Y, end, end, 0, CAPTURED_Y,
+                               EASE_STEP);
+  }
+  if (IsCastle(move)) {
+    bool kingside = FlagOf(move) == KING_CASTLE;
+    int rook_from = kingside ? to + 1 : to - 2;
+    int rook_to = kingside ? to - 1 : to + 1;
+    SlidePiece(g_drag.pieces[rook_from], SquareCenterX(ColOf(rook_from)), 0,
+               SquareCenterZ(RowOf(rook_from)), rook_to, time);
+  }
+  if (IsPromotion(move)) {
+    g_timeline.setPieceType(i, PromotionType(move));
+  }
+  SlidePiece(i, g_drag.x, DRAG_LIFT, g_drag.z, to, time);
+}
 
-  // Bishop 2
-  glPushMatrix();
-  glTranslatef(6000, 0, 8000);
-  glCallList(BISHOP);
-  glPopMatrix();
+//------------------------------------------------------------------------------
+// Applies one input event. The left button drags pieces, or turns the camera
+// when pressed off them.
+//------------------------------------------------------------------------------
+void HandleInputEvent(const InputEvent &event) {
+  if (event.type == BUTTON_DOWN_EVENT || event.type == BUTTON_UP_EVENT) {
+    bool down = event.type == BUTTON_DOWN_EVENT;
+    if (event.key == GLUT_LEFT_BUTTON) {
+      if (down && !PickUpPiece(event.x, event.y)) {
+        leftMouseDown = true;
+      } else if (!down) {
+        if (g_drag.piece != NO_PICK) {
+          DropPiece(event.x, event.y, event.time);
+        }
+        leftMouseDown = false;
+      }
+    } else if (event.key == GLUT_RIGHT_BUTTON) {
+      rightMouseDown = down;
+    } else if (event.key == GLUT_MIDDLE_BUTTON) {
+      middleMouseDown = down;
+    }
+  } else if (event.type == POINTER_MOVE_EVENT) {
+    DragPiece(event.x, event.y);
+  } else if (event.type == KEY_DOWN_EVENT && !event.repeat) {
+    if (event.action == QUIT_ACTION) {
+      exit(0);
+    } else if (event.action == TOGGLE_PROFILER_ACTION) {
+      g_show_profiler = !g_show_profiler;
+    }
+  }
+}
 
-  // Knight 1
-  glPushMatrix();
-  glTranslatef(2000, 0, 8000);
-  glRotatef(180, 0, 1, 0);
-  glCallList(KNIGHT);
-  glPopMatrix();
+//------------------------------------------------------------------------------
+// Applies held camera controls up to "time" in whole CAMERA_STEPs counted from
+// time 0. The turns change direction at the corners of their path, so taking
+// the same steps however the time is split into frames is what makes the
+// camera end up in the same place at any frame rate.
+//------------------------------------------------------------------------------
+void MoveCamera(double time) {
+  int64_t steps = (int64_t) floor(time / CAMERA_STEP);
+  if (!IsCameraMoving()) {
+    g_camera_steps = max(g_camera_steps, steps);
+    return;
+  }
+  while (g_camera_steps < steps) {
+    ++g_camera_steps;
+    UpdateCamera(CAMERA_SPEED * CAMERA_STEP, g_camera_steps * CAMERA_STEP);
+  }
+}
 
-  // Knight 2
-  Interpolate(INTRO_ZOOM_DURATION + 4.5, currentTime, INTRO_ZOOM_DURATION + 5,
-              7000, x, 6000);
-  Interpolate(INTRO_ZOOM_DURATION + 4, currentTime, INTRO_ZOOM_DURATION + 5,
-              8000, z, 6000);
-  glPushMatrix();
-  glTranslatef(x, 0, z);
-  glRotatef(180, 0, 1, 0);
-  glCallList(KNIGHT);
-  glPopMatrix();
+//------------------------------------------------------------------------------
+// Applies the input events that happened up to "time", in order, moving the
+// camera up to each one, so that motion starts and stops exactly when the
+// controls were pressed and released. The animation is brought up to each
+// event too, so what an event acts on does not depend on when frames happened
+// to be drawn. After a stall, camera motion older than MAX_FRAME_DELTA is
+// dropped rather than caught up; the dropped steps are logged as a
+// CAMERA_PAUSE_EVENT, so that a replay, which never stalls, drops them too.
+//------------------------------------------------------------------------------
+void ProcessInput(double time) {
+  int64_t resume = (int64_t) floor((time - MAX_FRAME_DELTA) / CAMERA_STEP);
+  while (!g_player.isOpen() && g_camera_steps < resume) {
+    InputEvent pause = {};
+    pause.time = g_camera_steps * CAMERA_STEP;
+    pause.type = CAMERA_PAUSE_EVENT;
+    pause.key = (int) min<int64_t>(resume - g_camera_steps, UINT16_MAX);
+    g_recorder.record(pause);
+    g_camera_steps += pause.key;
+  }
+  InputEvent event;
+  while (peekInputEvent(&event) && event.time <= time) {
+    double at_event = max(g_input_time, event.time);
+    MoveCamera(at_event);
+    g_timeline.advance(at_event);
+    nextInputEvent(time, &event);
+    if (event.action != QUIT_ACTION) {
+      g_recorder.record(event);  // Replays end with the log instead.
+    }
+    if (event.type == CAMERA_PAUSE_EVENT) {
+      g_camera_steps += event.key;
+    } else {
+      HandleInputEvent(event);
+    }
+  }
+  MoveCamera(time);
+  g_input_time = time;
+}
 
-  // Rook 1
-  Interpolate(INTRO_ZOOM_DURATION + 6, currentTime, INTRO_ZOOM_DURATION + 7,
-              8000, z, 7000);
-  glPushMatrix();
-  glTranslatef(1000, 0, z);
-  glCallList(ROOK);
-  glPopMatrix();
+double InputClock() {
+  return g_frame_scheduler.now();
+}
 
-  // Rook 2
-  glPushMatrix();
-  glTranslatef(8000, 0, 8000);
-  glCallList(ROOK);
-  glPopMatrix();
+void BindDefaultKeys() {
+  const int kBindings[][2] = {
+    { KEY_LEFT, TURN_LEFT_ACTION }, { 'a', TURN_LEFT_ACTION },
+    { KEY_RIGHT, TURN_RIGHT_ACTION }, { 'd', TURN_RIGHT_ACTION },
+    { KEY_UP, RAISE_CAMERA_ACTION }, { 'w', RAISE_CAMERA_ACTION },
+    { KEY_DOWN, LOWER_CAMERA_ACTION }, { 's', LOWER_CAMERA_ACTION },
+    { PROFILER_HUD_KEY, TOGGLE_PROFILER_ACTION }, { KEY_ESCAPE, QUIT_ACTION }
+  };
+  for (size_t i = 0; i < sizeof(kBindings) / sizeof(kBindings[0]); ++i) {
+    bindKey(kBindings[i][0], kBindings[i][1]);
+  }
+}
 
-  // Pawns
-  for(int i = 1; i <= 8; ++i) {
-    z = 7000;
-    y = 0;
-    angle = 0;
-    if (i == 1) {
-      Interpolate(INTRO_ZOOM_DURATION + 5.9, currentTime,
-                  INTRO_ZOOM_DURATION + 6.4, 0, angle, 180);
-      if (currentTime > INTRO_ZOOM_DURATION + 6.4) {
-        y = -100;
-      }
-    } else if (i == 2) {
-      Interpolate(INTRO_ZOOM_DURATION + 2, currentTime,
-                  INTRO_ZOOM_DURATION + 3, 7000, z, 5000);
-      Interpolate(INTRO_ZOOM_DURATION + 3.75, currentTime,
-                  INTRO_ZOOM_DURATION + 4.25, 0, angle, 180);
-      if (currentTime > INTRO_ZOOM_DURATION + 4.25) {
-        y = -100;
+void display(void) {
+  uint64_t frame_start = g_profiler.now();
+  uint64_t phase_ns[NUM_FRAME_PHASES] = {};
+  double currentTime;
+  {
+    ProfileScope scope(&g_profiler, kFramePhaseNames[INPUT_PHASE],
+                       &phase_ns[INPUT_PHASE]);
+    g_frame_scheduler.beginFrame();
+    currentTime = g_frame_scheduler.frameStart();
+    if (g_player.isOpen()) {
+      if (currentTime > g_player.endTime()) {
+        exit(0);  // ReportReplay() runs on exit.
       }
+      g_player.feed(currentTime);
     }
-    glPushMatrix();
-    glTranslatef(i * 1000, y, z);
-    glRotatef(angle, 1, 0, 0);
-    glCallList(PAWN);
-    glPopMatrix();
+    ProcessInput(currentTime);
+    g_timeline.advance(currentTime);
   }
 
-  glutSwapBuffers();
-  glutPostRedisplay();
+  // Prepare to draw to the screen:
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  g_renderer.setView(eye, at);  // Y is up!
+  int draw_calls = 0;
+  long vertices = 0;
+  for (int phase = BOARD_PHASE; phase <= PIECES_PHASE; ++phase) {
+    ProfileScope scope(&g_profiler, kFramePhaseNames[phase],
+                       &phase_ns[phase]);
+    g_instances.clear();
+    if (phase == BOARD_PHASE) {
+      AddBoard();
+    } else {
+      AddTimelinePieces();
+    }
+    g_renderer.draw(g_instances);
+    draw_calls += g_renderer.drawCalls();
+    vertices += g_renderer.verticesSubmitted();
+  }
+  {
+    ProfileScope scope(&g_profiler, kFramePhaseNames[OVERLAY_PHASE],
+                       &phase_ns[OVERLAY_PHASE]);
+    if (g_analyst) {
+      WatchBoard(currentTime);
+      g_analyst->update();
+      DrawAnalysis();
+    }
+    if (g_show_profiler) {
+      DrawProfiler();
+    }
+  }
+  {
+    ProfileScope scope(&g_profiler, kFramePhaseNames[SWAP_PHASE],
+                       &phase_ns[SWAP_PHASE]);
+    glutSwapBuffers();
+  }
+  uint64_t frame_end = g_profiler.now();
+  g_profiler.endFrame(frame_start, frame_end, draw_calls, vertices, phase_ns,
+                      NUM_FRAME_PHASES);
+  if (g_player.isOpen()) {
+    g_replay_frames.add(frame_end - frame_start);
+  }
+  if (g_timeline.isAnimating() || IsCameraMoving() || g_player.isOpen()) {
+    ScheduleNextFrame();
+  } else {
+    g_frame_scheduler.idle();
+  }
 }
 
 void SetPerspectiveView(int w, int h) {
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
   double aspectRatio = (GLdouble) w / (GLdouble) h;
-  gluPerspective(38.0, aspectRatio, 100.0, 1000000.0);
-  glMatrixMode(GL_MODELVIEW);
+  g_renderer.setPerspective(FIELD_OF_VIEW, aspectRatio, 100.0, 1000000.0);
 }
 
 void reshape(int w, int h) {
@@ -475,26 +899,150 @@ void reshape(int w, int h) {
   SetPerspectiveView(w, h);
 }
 
-void mouse(int mouse_button, int state, int x, int y) {
-  if (mouse_button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
-    leftMouseDown = true;
+void WriteTrace() {
+  if (!g_trace_file.empty() && g_profiler.writeChromeTrace(g_trace_file)) {
+    cerr << "Note: wrote " << g_trace_file << endl;
   }
-  if (mouse_button == GLUT_LEFT_BUTTON && state == GLUT_UP) {
-    leftMouseDown = false;
+}
+
+void CloseRecording() {
+  g_recorder.close(InputClock());
+}
+
+void ReportReplay() {
+  cerr << "Replay: " << g_replay_frames.summary() << endl;
+}
+
+//------------------------------------------------------------------------------
+// Opens a log from --replay and takes over the settings it recorded.
+// Returns false if it cannot be read.
+//------------------------------------------------------------------------------
+bool OpenReplay(const string &filename, int *width, int *height) {
+  if (!g_player.open(filename)) {
+    return false;
   }
-  if (mouse_button == GLUT_RIGHT_BUTTON && state == GLUT_DOWN) {
-    rightMouseDown = true;
+  *width = (int) g_player.header().width;
+  *height = (int) g_player.header().height;
+  g_book_seed = g_player.header().book_seed;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Turns vsync on or off where the GLX swap-control extensions are available.
+//------------------------------------------------------------------------------
+void SetSwapInterval(int interval) {
+  typedef int (*SwapIntervalFunc)(int);
+  const char *kNames[] = { "glXSwapIntervalMESA", "glXSwapIntervalSGI" };
+  for (int i = 0; i < 2; ++i) {
+    SwapIntervalFunc func = (SwapIntervalFunc) glXGetProcAddressARB(
+        (const GLubyte *) kNames[i]);
+    if (func && func(interval) == 0) {
+      return;
+    }
   }
-  if (mouse_button == GLUT_RIGHT_BUTTON && state == GLUT_UP) {
-    rightMouseDown = false;
+  cerr << "Note: unable to change the swap interval" << endl;
+}
+
+//------------------------------------------------------------------------------
+// Moves a piece actor between squares over one move's time.
+//------------------------------------------------------------------------------
+void AddSquareMove(const string &actor, int from, int to, double time) {
+  double end = time + BOOK_MOVE_SECONDS;
+  if (ColOf(from) != ColOf(to)) {
+    g_timeline.addSegment(actor, CHANNEL_X, time, end,
+                          SquareCenterX(ColOf(from)), SquareCenterX(ColOf(to)),
+                          EASE_IN_OUT);
   }
-  if (mouse_button == GLUT_MIDDLE_BUTTON && state == GLUT_DOWN) {
-    middleMouseDown = true;
+  if (RowOf(from) != RowOf(to)) {
+    g_timeline.addSegment(actor, CHANNEL_Z, time, end,
+                          SquareCenterZ(RowOf(from)), SquareCenterZ(RowOf(to)),
+                          EASE_IN_OUT);
   }
-  if (mouse_button == GLUT_MIDDLE_BUTTON && state == GLUT_UP) {
-    middleMouseDown = false;
+}
+
+//------------------------------------------------------------------------------
+// Adds the starting position and animates a line picked from the opening
+// book, one move per second, in place of the scripted opening moves. The line
+// ends early where the book does, or at a promotion (pieces cannot change
+// type in the timeline).
+//------------------------------------------------------------------------------
+void AddBookLine(const OpeningBook &book, uint32_t seed) {
+  Position position;
+  string actors[64];  // Name of the piece on each square.
+  for (Bitboard b = position.pieces(); b; ) {
+    int square = PopLowestSquare(b);
+    int piece = position.pieceOn(square);
+    actors[square] = "book_piece_" + to_string(square);
+    g_timeline.addPiece(actors[square], TypeOf(piece), ColorOf(piece),
+                        SquareCenterX(ColOf(square)),
+                        SquareCenterZ(RowOf(square)));
+  }
+
+  mt19937 random(seed);
+  double time = BOOK_LINE_START;
+  for (int ply = 0; ply < BOOK_LINE_PLIES; ++ply) {
+    Move m = book.pick(position, random());
+    if (m == NO_MOVE || IsPromotion(m)) {
+      break;
+    }
+    int from = FromSquare(m), to = ToSquare(m);
+    if (IsCapture(m)) {  // The captured piece topples and sinks.
+      int square = FlagOf(m) == EN_PASSANT ? RowOf(from) * 8 + ColOf(to) : to;
+      double topple = time + 0.75 * BOOK_MOVE_SECONDS;
+      double sink = time + 1.25 * BOOK_MOVE_SECONDS;
+      g_timeline.addSegment(actors[square], CHANNEL_X_ANGLE, topple, sink, 0,
+                            180, EASE_LINEAR);
+      g_timeline.addSegment(actors[square], CHANNEL_Y, sink, sink, 0, -100,
+                            EASE_STEP);
+      actors[square].clear();
+    }
+    AddSquareMove(actors[from], from, to, time);
+    actors[to] = actors[from];
+    actors[from].clear();
+    if (IsCastle(m)) {
+      int row = RowOf(from);
+      int rook_from = row * 8 + (FlagOf(m) == KING_CASTLE ? 7 : 0);
+      int rook_to = row * 8 + (FlagOf(m) == KING_CASTLE ? 5 : 3);
+      AddSquareMove(actors[rook_from], rook_from, rook_to, time);
+      actors[rook_to] = actors[rook_from];
+      actors[rook_from].clear();
+    }
+    position.doMove(m);
+    time += BOOK_MOVE_SECONDS;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Loads the opening animation: with an opening book, the intro (camera) track
+// and a line from the book; otherwise the scripted opening. If that fails,
+// shows the starting position without animating it.
+//------------------------------------------------------------------------------
+void LoadAnimation() {
+  double *camera[NUM_CHANNELS] = { &eye[0], &eye[1], &eye[2] };
+  g_timeline.clear();
+  g_timeline.addExternalActor(CAMERA_ACTOR, camera);
+  if (g_book.isOpen()) {
+    if (g_timeline.load(INTRO_ANIMATION_FILE)) {
+      AddBookLine(g_book, g_book_seed);
+      return;
+    }
+    cerr << "Note: could not load " << INTRO_ANIMATION_FILE << endl;
+    g_timeline.clear();
+    g_timeline.addExternalActor(CAMERA_ACTOR, camera);
+  }
+  if (g_timeline.load(OPENING_ANIMATION_FILE)) {
+    return;
+  }
+  cerr << "Note: could not load " << OPENING_ANIMATION_FILE << endl;
+  g_timeline.clear();
+  Position position;
+  for (Bitboard b = position.pieces(); b; ) {
+    int square = PopLowestSquare(b);
+    int piece = position.pieceOn(square);
+    g_timeline.addPiece("", TypeOf(piece), ColorOf(piece),
+                        SquareCenterX(ColOf(square)),
+                        SquareCenterZ(RowOf(square)));
   }
-  glutPostRedisplay();
 }
 
 void InitializeMyStuff() {
@@ -508,7 +1056,8 @@ void InitializeMyStuff() {
   // light with no origin point, 1 = point light):
   GLfloat main_light[] = { 1, 1, 1, 1 };
   GLfloat low_light[] = { 0.3, 0.3, 0.3, 1 };
-  GLfloat light_position[] = { -eye[0], -eye[1], -eye[2], 0 };
+  GLfloat light_position[] = { (GLfloat) -eye[0], (GLfloat) -eye[1],
+                               (GLfloat) -eye[2], 0 };
   glLightfv(GL_LIGHT0, GL_POSITION, light_position);
   glLightfv(GL_LIGHT0, GL_DIFFUSE, main_light);
   glLightfv(GL_LIGHT0, GL_SPECULAR, low_light);
@@ -516,40 +1065,297 @@ void InitializeMyStuff() {
   glEnable(GL_DEPTH_TEST);  // Turn on depth buffering.
   glEnable(GL_LIGHTING);  // Enable lighting.
   glEnable(GL_LIGHT0);  // Enable a specific light source (GL_LIGHT0).
+  glEnable(GL_NORMALIZE);  // Pieces may be scaled.
 
   //
-  // Initialize chess piece drawing lists:
+  // Upload the board and chess piece models:
   //
 
-  glNewList(PAWN, GL_COMPILE);
-  DrawPiece("models/PAWN.POL");
-  glEndList();
-
-  glNewList(KING, GL_COMPILE);
-  DrawPiece("models/KING.POL");
-  glEndList();
+  {
+    ProfileScope scope(&g_profiler, "renderer init");
+    g_renderer.init(g_allow_shaders);
+  }
+  {
+    ProfileScope scope(&g_profiler, "board models");
+    Mesh board_parts[NUM_BOARD_PARTS];
+    BuildBoardMeshes(board_parts);
+    for (int i = 0; i < NUM_BOARD_PARTS; ++i) {
+      g_board_models[i] = g_renderer.addModel(board_parts[i]);
+    }
+    Mesh highlight;
+    BuildHighlightMesh(&highlight);
+    g_highlight_model = g_renderer.addModel(highlight);
+  }
+  {
+    ProfileScope scope(&g_profiler, "piece models");
+    if (!IsMeshFileCurrent(PACKED_MESH_FILE) &&
+        BuildMeshFile(PACKED_MESH_FILE)) {
+      cerr << "Note: rebuilt " << PACKED_MESH_FILE << endl;
+    }
+    if (!g_mesh_file.open(PACKED_MESH_FILE)) {
+      cerr << "Note: " << PACKED_MESH_FILE
+           << " not found; loading .POL models" << endl;
+    }
+    for (int type = PAWN; type < NUM_CHESS_PIECE_TYPES; ++type) {
+      Mesh mesh;
+      LoadPieceMesh(type, &mesh);
+      g_piece_boxes[type - PAWN] = ModelPickBox(mesh);
+      g_piece_models[type - PAWN] = g_renderer.addModel(mesh);
+    }
+  }
+  ProfileScope scope(&g_profiler, "animation");
+  LoadAnimation();
+}
 
-  glNewList(QUEEN, GL_COMPILE);
-  DrawPiece("models/QUEEN.POL");
-  glEndList();
+//------------------------------------------------------------------------------
+// Opens the opening book given with --book, or if none was given, the default
+// book if there is one.
+//------------------------------------------------------------------------------
+bool OpenBook(const string &filename) {
+  if (filename.empty()) {
+    g_book.open(BOOK_FILE);
+    return true;
+  }
+  if (!g_book.open(filename.c_str())) {
+    cerr << "Error: could not open opening book " << filename << endl;
+    return false;
+  }
+  return true;
+}
 
-  glNewList(ROOK, GL_COMPILE);
-  DrawPiece("models/ROOK.POL");
-  glEndList();
+//------------------------------------------------------------------------------
+// Appends the FEN of every position in game "number" (counting from 1) of a
+// game database, from the start position to the final one.
+//------------------------------------------------------------------------------
+bool AddGamePositions(const string &filename, long number,
+                      vector<string> *fens) {
+  GameDatabase database;
+  if (!database.open(filename.c_str())) {
+    cerr << "Error: could not open game database " << filename << endl;
+    return false;
+  }
+  if (number < 1 || (uint64_t) number > database.gameCount()) {
+    cerr << "Error: --game must be from 1 to " << database.gameCount()
+         << endl;
+    return false;
+  }
+  Position position;
+  if (!database.startPosition(number - 1, &position)) {
+    cerr << "Error: game " << number << " in " << filename
+         << " has an invalid start position" << endl;
+    return false;
+  }
+  fens->push_back(position.fen());
+  const Move *moves = database.moves(number - 1);
+  for (int i = 0; i < database.moveCount(number - 1); ++i) {
+    position.doMove(moves[i]);
+    fens->push_back(position.fen());
+  }
+  return true;
+}
 
-  glNewList(BISHOP, GL_COMPILE);
-  DrawPiece("models/BISHOP.POL");
-  glEndList();
+//------------------------------------------------------------------------------
+// Renders without a window and writes the frames to disk: either the
+// scripted animation at a fixed timestep, or one still diagram per FEN.
+// With --replay, a recorded session is played back at the fixed timestep,
+// at the recorded window size, and its frame times are reported; frames are
+// written only if --output is given.
+// Usage: chess --headless [--output PATH] [--size WxH] [--fps N]
+//                         [--duration SECONDS] [--fen FEN] [--fen-file FILE]
+//                         [--db FILE --game N] [--book FILE]
+//                         [--replay FILE] [--legacy-renderer]
+// See FrameWriter::open() for the output formats.
+//------------------------------------------------------------------------------
+int RunHeadless(int argc, char **argv) {
+  string output = HEADLESS_OUTPUT;
+  bool output_given = false;
+  int width = (int) screen_x, height = (int) screen_y;
+  double fps = HEADLESS_FPS, duration = -1;  // Default: the whole timeline.
+  vector<string> fens;
+  string database, book, replay;
+  long game = 0;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--output" && has_value) {
+      output = argv[++i];
+      output_given = true;
+    } else if (arg == "--replay" && has_value) {
+      replay = argv[++i];
+    } else if (arg == "--size" && has_value) {
+      if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 ||
+          height <= 0) {
+        cerr << "Error: bad --size (expected WxH)" << endl;
+        return 1;
+      }
+    } else if (arg == "--fps" && has_value) {
+      fps = atof(argv[++i]);
+    } else if (arg == "--duration" && has_value) {
+      duration = atof(argv[++i]);
+    } else if (arg == "--fen" && has_value) {
+      fens.push_back(argv[++i]);
+    } else if (arg == "--fen-file" && has_value) {
+      ifstream file(argv[++i]);
+      if (!file) {
+        cerr << "Error: could not open " << argv[i] << endl;
+        return 1;
+      }
+      string line;
+      while (getline(file, line)) {
+        if (line.find_first_not_of(" \t\r") != string::npos) {
+          fens.push_back(line);
+        }
+      }
+    } else if (arg == "--db" && has_value) {
+      database = argv[++i];
+    } else if (arg == "--game" && has_value) {
+      game = atol(argv[++i]);
+    } else if (arg == "--book" && has_value) {
+      book = argv[++i];
+    } else if (arg == "--legacy-renderer") {
+      g_allow_shaders = false;
+    } else if (arg != "--headless") {
+      cerr << "Error: unknown option " << arg << endl;
+      return 1;
+    }
+  }
+  if (fps <= 0) {
+    cerr << "Error: --fps must be positive" << endl;
+    return 1;
+  }
+  if (!database.empty() && !AddGamePositions(database, game, &fens)) {
+    return 1;
+  }
+  if (!OpenBook(book)) {
+    return 1;
+  }
+  if (!replay.empty()) {
+    if (!fens.empty()) {
+      cerr << "Error: --replay cannot be combined with positions" << endl;
+      return 1;
+    }
+    if (!OpenReplay(replay, &width, &height)) {
+      return 1;
+    }
+    BindDefaultKeys();
+  }
+  bool write_frames = replay.empty() || output_given;
 
-  glNewList(KNIGHT, GL_COMPILE);
-  DrawPiece("models/KNIGHT.POL");
-  glEndList();
+  OffscreenContext context;
+  FrameWriter writer;
+  if (!context.create(width, height) ||
+      (write_frames && !writer.open(output, width, height))) {
+    return 1;
+  }
+  glClearColor(1, 1, 1, 1);
+  InitializeMyStuff();
+  reshape(width, height);
+  if (duration < 0) {
+    duration = g_player.isOpen() ? g_player.endTime() :
+                                   g_timeline.endTime() + 0.5;
+  }
+  int frames = fens.empty() ? (int) (duration * fps) + 1 : (int) fens.size();
+  Position position;
+  for (int frame = 0; frame < frames && !writer.failed(); ++frame) {
+    uint64_t frame_start = g_profiler.now();
+    g_instances.clear();
+    if (fens.empty()) {
+      if (g_player.isOpen()) {
+        g_player.feed(frame / fps);
+        ProcessInput(frame / fps);
+      }
+      g_timeline.advance(frame / fps);
+      AddBoard();
+      AddTimelinePieces();
+    } else if (position.setFen(fens[frame])) {
+      AddBoard();
+      AddPositionPieces(position);
+    } else {
+      cerr << "Warning: bad FEN on frame " << frame << ": " << fens[frame]
+           << endl;
+      AddBoard();
+    }
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    g_renderer.setView(eye, at);
+    g_renderer.draw(g_instances);
+    if (write_frames) {
+      context.readPixels(writer.beginFrame());
+      writer.endFrame();
+    } else {
+      glFinish();
+    }
+    if (g_player.isOpen()) {
+      g_replay_frames.add(g_profiler.now() - frame_start);
+    }
+  }
+  if (g_player.isOpen()) {
+    ReportReplay();
+  }
+  if (!write_frames) {
+    return 0;
+  }
+  bool ok = writer.close();
+  cerr << writer.framesWritten() << " of " << frames << " frames written"
+       << endl;
+  return ok ? 0 : 1;
 }
 
 int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+    return BenchMain(argc - 1, argv + 1);  // Usage: chess bench [see bench.h]
+  }
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--headless") == 0) {
+      return RunHeadless(argc, argv);
+    } else if (strcmp(argv[i], "--uci") == 0) {
+      return RunUci();
+    }
+  }
+
   bool fullscreen = false;
 
   glutInit(&argc, argv);
+  int vsync = -1;  // Leave the driver's setting alone.
+  bool analysis = true;
+  string book, record, replay;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--legacy-renderer") == 0) {
+      g_allow_shaders = false;
+    } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+      g_frame_scheduler.setMaxFps(atof(argv[++i]));
+    } else if (strcmp(argv[i], "--vsync") == 0) {
+      vsync = 1;
+    } else if (strcmp(argv[i], "--no-vsync") == 0) {
+      vsync = 0;
+    } else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc) {
+      book = argv[++i];
+    } else if (strcmp(argv[i], "--no-analysis") == 0) {
+      analysis = false;
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      g_trace_file = argv[++i];
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay = argv[++i];
+    }
+  }
+  if (!OpenBook(book)) {
+    return 1;
+  }
+  g_book_seed = (uint32_t) time(NULL);  // A different line every launch.
+  if (!replay.empty()) {
+    // Live input and the analysis (whose timing varies from run to run) are
+    // left out, and frames are drawn back to back on a simulated clock:
+    int width, height;
+    if (!OpenReplay(replay, &width, &height)) {
+      return 1;
+    }
+    screen_x = width;
+    screen_y = height;
+    analysis = false;
+    double fps = g_frame_scheduler.maxFps();
+    g_frame_scheduler.setFixedStep(1 / (fps > 0 ? fps : DEFAULT_MAX_FPS));
+  }
   glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
   glutInitWindowSize(screen_x, screen_y);
   glutInitWindowPosition(100, 50);
@@ -561,10 +1367,33 @@ int main(int argc, char **argv) {
   }
   glutDisplayFunc(display);
   glutReshapeFunc(reshape);
-  glutMouseFunc(mouse);
-  initKeyboard();
+  setInputClock(InputClock);
+  BindDefaultKeys();
+  if (g_player.isOpen()) {
+    atexit(ReportReplay);
+  } else {
+    initKeyboard();
+    initMouse();
+  }
+  if (!record.empty()) {
+    if (!g_recorder.open(record, (int) screen_x, (int) screen_y,
+                         g_book_seed)) {
+      return 1;
+    }
+    atexit(CloseRecording);
+  }
+  if (vsync >= 0) {
+    SetSwapInterval(vsync);
+  }
   glClearColor(1, 1, 1, 1);
+  atexit(WriteTrace);
   InitializeMyStuff();
+  if (analysis) {
+    g_board_watch.side_to_move = -1;
+    g_analyst.reset(new Analyst());
+    g_analyst->start();
+    glutTimerFunc(ANALYSIS_REDRAW_MS, OnAnalysisTimer, 0);
+  }
   glutMainLoop();
 
   return 0;
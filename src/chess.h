@@ -3,7 +3,8 @@
 
      Author: David C. Drake (https://davidcdrake.com)
 
-Description: Header file for chess.cc
+Description: Header file for chess.cc. The globals declared here are
+             defined at the top of chess.cc.
 *******************************************************************************/
 
 #ifndef CHESS_H_
@@ -17,16 +18,34 @@ Description: Header file for chess.cc
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "renderer.h"  // Before GL/glut.h, which includes GL/gl.h.
 #include <GL/glut.h>
+#include <GL/glx.h>
+#include "analysis.h"
+#include "bench.h"
+#include "frame_scheduler.h"
+#include "frame_writer.h"
+#include "game_db.h"
+#include "input_log.h"
 #include "keys.h"
+#include "book.h"
 #include "chess_piece.h"
+#include "mesh.h"
+#include "offscreen.h"
+#include "picking.h"
+#include "position.h"
+#include "profiler.h"
+#include "timeline.h"
+#include "uci.h"
 
 void text_output(double x, double y, char *string);
 
 // Camera-related constants:
-#define CAMERA_SPEED        75
-#define INTRO_ZOOM_DURATION 4  // seconds
-#define INITIAL_EYE_X       -300000
+#define CAMERA_SPEED        4500  // units per second
+#define CAMERA_STEP         (1.0 / 240)  // Seconds; the camera moves in steps.
 #define DEFAULT_EYE_X       4500
 #define DEFAULT_EYE_Y       8000
 #define DEFAULT_EYE_Z       -12000
@@ -36,6 +55,33 @@ void text_output(double x, double y, char *string);
 #define DEFAULT_AT_Y        0
 #define DEFAULT_AT_Z        4000
 
+// Animation-related constants:
+#define OPENING_ANIMATION_FILE "animations/opening.anim"
+#define INTRO_ANIMATION_FILE   "animations/intro.anim"  // Before book lines.
+#define BOOK_LINE_START        5   // Seconds.
+#define BOOK_LINE_PLIES        16
+#define BOOK_MOVE_SECONDS      1
+#define CAMERA_ACTOR           "camera"  // Timeline actor bound to eye[].
+
+// Piece dragging constants:
+#define FIELD_OF_VIEW   38.0  // Vertical, in degrees.
+#define DRAG_LIFT       400   // How high a held piece floats.
+#define DROP_SECONDS    0.15  // For a dropped piece to land.
+#define CAPTURE_SECONDS 0.5   // For a captured piece to topple.
+#define CAPTURED_Y      -100  // Where captured pieces are hidden.
+#define HIGHLIGHT_COLOR brightGreenMaterial
+
+// Analysis overlay constants:
+#define ANALYSIS_SETTLE_SECONDS 0.2  // Rest needed between animated moves.
+#define ANALYSIS_REDRAW_MS      100  // How often to look for new results.
+
+// Profiler constants:
+#define PROFILER_HUD_KEY KEY_F3  // Shows and hides the frame statistics.
+
+// Headless rendering defaults:
+#define HEADLESS_OUTPUT "frame%05d.png"
+#define HEADLESS_FPS    30
+
 // Board-related constants:
 #define BOARD_TOP               -10
 #define BOARD_TOP_FRONT_EDGE    -1000
@@ -55,6 +101,14 @@ void text_output(double x, double y, char *string);
 #define BOARD_BORDER            500
 #define Y_MODIFIER              5
 
+// The board is drawn as one model per material:
+enum BoardPart {
+  BOARD_MAIN_PART,     // BOARD_MAIN_COLOR
+  BOARD_TOP_PART,      // BOARD_TOP_COLOR
+  BOARD_SQUARES_PART,  // LIGHT_SQUARE_COLOR
+  NUM_BOARD_PARTS
+};
+
 // Color-related constants:
 #define BOARD_MAIN_COLOR   redMaterial
 #define BOARD_TOP_COLOR    blackMaterial
@@ -64,24 +118,103 @@ void text_output(double x, double y, char *string);
 #define DARK_PIECE_COLOR   greenMaterial
 
 // Global material-related variables:
-GLfloat redMaterial[]         = { 0.7, 0.1, 0.2, 1.0 };
-GLfloat greenMaterial[]       = { 0.1, 0.7, 0.4, 1.0 };
-GLfloat brightGreenMaterial[] = { 0.1, 0.9, 0.1, 1.0 };
-GLfloat blueMaterial[]        = { 0.1, 0.2, 0.7, 1.0 };
-GLfloat whiteMaterial[]       = { 1.0, 1.0, 1.0, 1.0 };
-GLfloat blackMaterial[]       = { 0.0, 0.0, 0.0, 0.0 };
+extern GLfloat redMaterial[];
+extern GLfloat greenMaterial[];
+extern GLfloat brightGreenMaterial[];
+extern GLfloat blueMaterial[];
+extern GLfloat whiteMaterial[];
+extern GLfloat blackMaterial[];
 
 // Global screen-related variables:
-double screen_x = 900;
-double screen_y = 600;
+extern double screen_x;
+extern double screen_y;
 
 // Global camera-related variables:
-double eye[3] = { DEFAULT_EYE_X, DEFAULT_EYE_Y, DEFAULT_EYE_Z };
-double at[3]  = { DEFAULT_AT_X, DEFAULT_AT_Y, DEFAULT_AT_Z    };
+extern double eye[3];
+extern double at[3];
+
+// Packed piece models (see mesh.h):
+extern MappedMeshFile g_mesh_file;
+
+// Rendering-related variables (see renderer.h):
+extern Renderer g_renderer;
+extern bool g_allow_shaders;  // False with --legacy-renderer.
+extern int g_board_models[NUM_BOARD_PARTS];
+extern int g_piece_models[NUM_PIECE_MODELS];
+extern std::vector<RenderInstance> g_instances;  // Rebuilt every frame.
+
+// Frame timing (see frame_scheduler.h):
+extern FrameScheduler g_frame_scheduler;
+extern bool g_frame_pending;  // A glutTimerFunc() redisplay is waiting.
+
+// Piece and camera animations (see timeline.h):
+extern Timeline g_timeline;
+
+// Opening book whose lines replace the scripted opening (see book.h):
+extern OpeningBook g_book;
+extern uint32_t g_book_seed;  // Picks the line; fixed when rendering headless.
+
+// Background analysis of the position on the board (see analysis.h):
+extern std::unique_ptr<Analyst> g_analyst;  // NULL with --no-analysis.
+
+// The board as last seen at rest, for finding positions to analyze:
+struct BoardWatch {
+  int resting[NUM_SQUARES];   // Latest placement with every piece on a square.
+  double resting_since;
+  int analyzed[NUM_SQUARES];  // Placement last sent to the analyst.
+  int side_to_move;           // In it; -1 before the first one.
+};
+extern BoardWatch g_board_watch;
+
+// What keys can be bound to (see keys.h):
+enum Action {
+  TURN_LEFT_ACTION,
+  TURN_RIGHT_ACTION,
+  RAISE_CAMERA_ACTION,
+  LOWER_CAMERA_ACTION,
+  TOGGLE_PROFILER_ACTION,
+  QUIT_ACTION,
+  NUM_ACTIONS
+};
+extern double g_input_time;  // Input has been applied up to here (seconds).
+extern int64_t g_camera_steps;  // Camera motion has been applied this far.
+
+// Input recording and replay (see input_log.h):
+extern InputRecorder g_recorder;      // Open with --record.
+extern InputPlayer g_player;          // Open with --replay.
+extern FrameTimeLog g_replay_frames;  // Reported when the replay ends.
+
+// The phases of a frame that are timed separately:
+enum FramePhase {
+  INPUT_PHASE,    // Input events, camera motion, and animation.
+  BOARD_PHASE,
+  PIECES_PHASE,
+  OVERLAY_PHASE,  // Analysis text and the profiler HUD.
+  SWAP_PHASE,
+  NUM_FRAME_PHASES
+};
+extern const char *kFramePhaseNames[NUM_FRAME_PHASES];
+
+// Profiling (see profiler.h):
+extern Profiler g_profiler;
+extern bool g_show_profiler;      // Toggled with PROFILER_HUD_KEY.
+extern std::string g_trace_file;  // From --trace; written on exit.
+
+// Piece picking and dragging (see picking.h):
+extern PickBox g_piece_boxes[NUM_PIECE_MODELS];  // Model space.
+extern int g_highlight_model;
+struct Drag {
+  int piece;                 // Timeline piece held, or NO_PICK.
+  int from;
+  double x, z;               // Where it is held.
+  int pieces[NUM_SQUARES];   // Timeline piece on each square, or NO_PICK.
+  MoveList moves;            // The held piece's legal moves.
+};
+extern Drag g_drag;
 
 // Global mouse-related variables:
-bool leftMouseDown   = false;
-bool rightMouseDown  = false;
-bool middleMouseDown = false;
+extern bool leftMouseDown;
+extern bool rightMouseDown;
+extern bool middleMouseDown;
 
 #endif  // CHESS_H_
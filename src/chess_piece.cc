@@ -7,16 +7,32 @@ Description: Method definitions for the ChessPiece class.
 *******************************************************************************/
 
 #include "chess_piece.h"
+#include "position.h"
 
-ChessPiece::ChessPiece(int type, int color, int row, int col) {
+ChessPiece::ChessPiece(int type, int color, int row, int col,
+                       Position *position) {
   type_ = type;
   color_ = color;
   row_ = row;
   col_ = col;
+  x_ = y_ = z_ = 0;
+  alive_ = true;
+  position_ = position;
 }
 
 ChessPiece::~ChessPiece() {}
 
-void ChessPiece::moveTo(int row, int col) {}
+void ChessPiece::moveTo(int row, int col) {
+  if (position_ && alive_) {
+    position_->relocatePiece(SquareAt(row_, col_), SquareAt(row, col));
+  }
+  row_ = row;
+  col_ = col;
+}
 
-void ChessPiece::die() {}
+void ChessPiece::die() {
+  if (position_ && alive_) {
+    position_->clearSquare(SquareAt(row_, col_));
+  }
+  alive_ = false;
+}
@@ -9,6 +9,8 @@ Description: Header file for the ChessPiece class.
 #ifndef CHESS_PIECE_H_
 #define CHESS_PIECE_H_
 
+#include <cstddef>
+
 enum ChessPieceType {
   PAWN = 100,
   ROOK,
@@ -25,9 +27,21 @@ enum ChessPieceColor {
   NUM_CHESS_PIECE_COLORS
 };
 
+// Pieces stand at the centers of their squares. In world coordinates, files
+// run from a (x = 8000) to h (x = 1000) and ranks from 1 (z = 1000) to 8
+// (z = 8000).
+#define SQUARE_SPACING 1000
+
+inline double SquareCenterX(int col) { return (8 - col) * SQUARE_SPACING; }
+inline double SquareCenterZ(int row) { return (row + 1) * SQUARE_SPACING; }
+
+class Position;
+
+// A single piece. When attached to a Position, moving or killing the piece
+// updates that position's bitboards as well.
 class ChessPiece {
  public:
-  ChessPiece(int type, int color, int row, int col);
+  ChessPiece(int type, int color, int row, int col, Position *position = NULL);
   ~ChessPiece();
   int getType() const { return type_; }
   int getColor() const { return color_; }
@@ -36,11 +50,14 @@ class ChessPiece {
   double getX() const { return x_; }
   double getY() const { return y_; }
   double getZ() const { return z_; }
+  bool isAlive() const { return alive_; }
   void moveTo(int row, int col);
   void die();
  private:
   int type_, color_, row_, col_;
   double x_, y_, z_;
+  bool alive_;
+  Position *position_;
 };
 
 #endif  // CHESS_PIECE_H_
@@ -0,0 +1,25 @@
+/*******************************************************************************
+   Filename: cpu.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Reports which version of the CPU_DISPATCH functions is in use.
+*******************************************************************************/
+
+#include "cpu.h"
+
+// The loader picks versions by the same tests, so this matches what runs.
+const char *CpuDispatchLevel() {
+#ifdef CPU_DISPATCH_ENABLED
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("x86-64-v3")) {
+    return "x86-64-v3";
+  }
+  if (__builtin_cpu_supports("x86-64-v2")) {
+    return "x86-64-v2";
+  }
+  return "baseline";
+#else
+  return "compile-time";
+#endif
+}
@@ -0,0 +1,41 @@
+/*******************************************************************************
+   Filename: cpu.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Runtime selection of instruction-set extensions, so that one
+             binary built for plain x86-64 still runs the functions marked
+             CPU_DISPATCH (the evaluation) with POPCNT and SSE4.2, or AVX2,
+             on processors that have them. Such a function is compiled once
+             per level below (GCC's function multiversioning) and the loader
+             binds the best version the processor supports; inline helpers
+             such as PopCount() are compiled into each version. Only marked
+             functions are dispatched: the sliding-piece lookups use PEXT
+             only in builds that target BMI2 (see bitboard.h). Builds that
+             already target AVX2 and BMI2 (e.g., -march=native) have nothing
+             to dispatch to, and -DCHESS_NO_CPU_DISPATCH turns it off.
+*******************************************************************************/
+
+#ifndef CPU_H_
+#define CPU_H_
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && \
+    !(defined(__AVX2__) && defined(__BMI2__)) && \
+    !defined(CHESS_NO_CPU_DISPATCH)
+#define CPU_DISPATCH_ENABLED
+#endif
+
+#ifdef CPU_DISPATCH_ENABLED
+#define CPU_DISPATCH \
+    __attribute__((target_clones("arch=x86-64-v3", "arch=x86-64-v2", \
+                                 "default")))
+#else
+#define CPU_DISPATCH
+#endif
+
+// Names the version CPU_DISPATCH functions run: "x86-64-v3" (AVX2, BMI2),
+// "x86-64-v2" (SSE4.2, POPCNT), "baseline", or "compile-time" when the build
+// does not dispatch.
+const char *CpuDispatchLevel();
+
+#endif  // CPU_H_
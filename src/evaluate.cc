@@ -0,0 +1,267 @@
+/*******************************************************************************
+   Filename: evaluate.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Static evaluation of chess positions: material and piece-square
+             values, mobility, king safety, and pawn structure, each scored
+             separately for the midgame and the endgame and blended by the
+             material left on the board. The piece-square tables and the pawn
+             masks are built by constexpr functions at compile time.
+*******************************************************************************/
+
+#include "evaluate.h"
+
+#include <algorithm>
+#include "cpu.h"
+
+using namespace std;
+
+//                                       P    R    B    N    Q  K
+const int kPieceValues[NUM_PIECE_TYPES] = { 100, 500, 330, 320, 900, 0 };
+
+#define TEMPO_BONUS      10
+#define MAX_PHASE        24  // Phase with all minor and major pieces on.
+#define MAX_KING_ATTACK  500
+#define PAWN_SHIELD_MG   12  // Per pawn in front of the king.
+
+namespace {
+
+// Tables with NUM_PIECE_TYPES entries are indexed by (type - PAWN); scores
+// are from the owner's side.
+constexpr Score kMaterial[NUM_PIECE_TYPES] = {
+  Score(90, 110), Score(470, 540), Score(340, 320),  // P, R, B
+  Score(320, 290), Score(950, 1000), Score(0, 0)     // N, Q, K
+};
+const int kPhase[NUM_PIECE_TYPES] = { 0, 2, 1, 1, 4, 0 };
+
+// Mobility counts the squares a piece attacks that are neither occupied by
+// its own side nor covered by enemy pawns; "base" squares score zero.
+const Score kMobility[NUM_PIECE_TYPES] = { Score(), Score(2, 4), Score(5, 5),
+                                           Score(4, 4), Score(1, 2), Score() };
+const int kMobilityBase[NUM_PIECE_TYPES] = { 0, 7, 6, 4, 13, 0 };
+
+// Weight of each square a piece attacks next to the enemy king.
+const int kAttackUnits[NUM_PIECE_TYPES] = { 0, 3, 2, 2, 5, 0 };
+
+const Score kBishopPair(30, 50);
+const Score kDoubledPawn(10, 25);
+const Score kIsolatedPawn(10, 15);
+const Score kPassedPawn[8] = {  // By rank, from the owner's side.
+  Score(0, 0), Score(5, 10), Score(10, 15), Score(15, 25),
+  Score(30, 45), Score(50, 75), Score(80, 120), Score(0, 0)
+};
+
+constexpr Score kPawnAdvance[8] = {
+  Score(0, 0), Score(-5, -5), Score(-2, -3), Score(2, 0),
+  Score(8, 8), Score(15, 20), Score(25, 40), Score(0, 0)
+};
+constexpr int kKingRankMg[8] = { 0, -20, -40, -60, -70, -80, -80, -80 };
+constexpr int kKingFileMg[8] = { 20, 30, 10, -5, -5, 10, 30, 20 };
+
+// 0 on the edge of the board, 3 in the middle.
+constexpr int FileCentrality(int square) {
+  return min(ColOf(square), 7 - ColOf(square));
+}
+constexpr int RankCentrality(int square) {
+  return min(RowOf(square), 7 - RowOf(square));
+}
+
+//------------------------------------------------------------------------------
+// Returns the positional value of "type" on "square" for white, without its
+// material. Minor pieces and the queen want the center; rooks want the
+// seventh rank; the king hides in a corner until the endgame, when it too
+// heads for the center.
+//------------------------------------------------------------------------------
+constexpr Score PieceSquareBonus(int type, int square) {
+  int row = RowOf(square);
+  int center = FileCentrality(square) + RankCentrality(square);
+  switch (type) {
+    case PAWN:
+      return kPawnAdvance[row] +
+             Score(row >= 2 && row <= 4 ? FileCentrality(square) * 5 : 0, 0);
+    case ROOK:
+      return row == 6 ? Score(20, 15) :
+             Score(FileCentrality(square) >= 2 ? 4 : 0, 0);
+    case BISHOP:
+      return Score(4 * center - 12, 3 * center - 9);
+    case KNIGHT:
+      return Score(8 * center - 24, 6 * center - 18);
+    case QUEEN:
+      return Score(2 * center - 6, 5 * center - 15);
+    case KING:
+      return Score(kKingRankMg[row] + kKingFileMg[ColOf(square)],
+                   10 * center - 30);
+  }
+  return Score();
+}
+
+struct PieceSquareTables {
+  Score values[NUM_PIECES][NUM_SQUARES];  // Material included.
+};
+
+constexpr PieceSquareTables BuildPieceSquareTables() {
+  PieceSquareTables tables{};
+  for (int type = PAWN; type <= KING; ++type) {
+    for (int square = 0; square < NUM_SQUARES; ++square) {
+      Score value = kMaterial[type - PAWN] + PieceSquareBonus(type, square);
+      tables.values[MakePiece(WHITE, type)][square] = value;
+      tables.values[MakePiece(BLACK, type)][square ^ 56] = value;
+    }
+  }
+  return tables;
+}
+
+// Squares ahead of a pawn (or king) of each color on each square: on its own
+// file, where enemy pawns could stop it, and where pawns shelter a king.
+struct PawnMasks {
+  Bitboard adjacent_files[8];
+  Bitboard forward_file[NUM_CHESS_PIECE_COLORS][NUM_SQUARES];
+  Bitboard passed[NUM_CHESS_PIECE_COLORS][NUM_SQUARES];
+  Bitboard shield[NUM_CHESS_PIECE_COLORS][NUM_SQUARES];
+};
+
+constexpr PawnMasks BuildPawnMasks() {
+  PawnMasks masks{};
+  for (int col = 0; col < 8; ++col) {
+    masks.adjacent_files[col] = (col > 0 ? FileBB(col - 1) : 0) |
+                                (col < 7 ? FileBB(col + 1) : 0);
+  }
+  for (int color = WHITE; color <= BLACK; ++color) {
+    int step = color == WHITE ? 1 : -1;
+    for (int square = 0; square < NUM_SQUARES; ++square) {
+      int col = ColOf(square);
+      Bitboard files = FileBB(col) | masks.adjacent_files[col];
+      for (int row = RowOf(square) + step; row >= 0 && row < 8;
+           row += step) {
+        masks.forward_file[color][square] |= SquareBB(SquareAt(row, col));
+        masks.passed[color][square] |= RankBB(row) & files;
+        if (row == RowOf(square) + step || row == RowOf(square) + 2 * step) {
+          masks.shield[color][square] |= RankBB(row) & files;
+        }
+      }
+    }
+  }
+  return masks;
+}
+
+constexpr PieceSquareTables kPieceSquare = BuildPieceSquareTables();
+constexpr PawnMasks kPawnMasks = BuildPawnMasks();
+
+Bitboard PawnAttacksOf(int color, Bitboard pawns) {
+  return color == WHITE ?
+         ((pawns & ~FILE_A_BB) << 7) | ((pawns & ~FILE_H_BB) << 9) :
+         ((pawns & ~FILE_A_BB) >> 9) | ((pawns & ~FILE_H_BB) >> 7);
+}
+
+//------------------------------------------------------------------------------
+// Scores the pawn structure: doubled, isolated, and passed pawns. Only the
+// frontmost of doubled pawns can be passed.
+//------------------------------------------------------------------------------
+void EvaluatePawns(const Position &pos, PawnEntry *entry) {
+  entry->key = pos.pawnKey();
+  entry->score = Score();
+  for (int color = WHITE; color <= BLACK; ++color) {
+    Bitboard ours = pos.pieces(color, PAWN);
+    Bitboard theirs = pos.pieces(color ^ 1, PAWN);
+    entry->attacks[color] = PawnAttacksOf(color, ours);
+    Score side;
+    Bitboard b = ours;
+    while (b) {
+      int square = PopLowestSquare(b);
+      bool doubled = ours & kPawnMasks.forward_file[color][square];
+      if (!(ours & kPawnMasks.adjacent_files[ColOf(square)])) {
+        side -= kIsolatedPawn;
+      }
+      if (doubled) {
+        side -= kDoubledPawn;
+      } else if (!(theirs & kPawnMasks.passed[color][square])) {
+        side += kPassedPawn[color == WHITE ? RowOf(square) :
+                                             7 - RowOf(square)];
+      }
+    }
+    entry->score += color == WHITE ? side : Score() - side;
+  }
+}
+
+// Mobility and king attacks are counted with PopCount(), which compiles to a
+// single instruction only where POPCNT is enabled (see cpu.h).
+CPU_DISPATCH
+int EvaluateWith(const Position &pos, const PawnEntry &pawns) {
+  Score score = pawns.score;
+  int phase = 0;
+  Bitboard occupied = pos.pieces();
+  for (int color = WHITE; color <= BLACK; ++color) {
+    int them = color ^ 1;
+    int enemy_king = pos.kingSquare(them);
+    Bitboard enemy_zone = KingAttacks(enemy_king) | SquareBB(enemy_king);
+    Bitboard mobility_area = ~pos.pieces(color) & ~pawns.attacks[them];
+    int attackers = 0, attack_units = 0;
+    Score side;
+
+    Bitboard b = pos.pieces(color);
+    while (b) {
+      int square = PopLowestSquare(b);
+      int piece = pos.pieceOn(square);
+      int type = TypeOf(piece);
+      side += kPieceSquare.values[piece][square];
+      phase += kPhase[type - PAWN];
+
+      Bitboard attacks;
+      if (type == KNIGHT) {
+        attacks = KnightAttacks(square);
+      } else if (type == BISHOP) {
+        attacks = BishopAttacks(square, occupied);
+      } else if (type == ROOK) {
+        attacks = RookAttacks(square, occupied);
+      } else if (type == QUEEN) {
+        attacks = QueenAttacks(square, occupied);
+      } else {
+        continue;
+      }
+      side += kMobility[type - PAWN] *
+              (PopCount(attacks & mobility_area) - kMobilityBase[type - PAWN]);
+      if (attacks & enemy_zone) {
+        ++attackers;
+        attack_units += kAttackUnits[type - PAWN] *
+                        PopCount(attacks & enemy_zone);
+      }
+    }
+
+    if (MoreThanOne(pos.pieces(color, BISHOP))) {
+      side += kBishopPair;
+    }
+    // A lone attacker is easily repelled; several grow dangerous fast:
+    if (attackers >= 2) {
+      side.mg += min(attack_units * attack_units / 4, MAX_KING_ATTACK);
+    }
+    side.mg += PAWN_SHIELD_MG *
+               PopCount(kPawnMasks.shield[color][pos.kingSquare(color)] &
+                        pos.pieces(color, PAWN));
+    score += color == WHITE ? side : Score() - side;
+  }
+
+  phase = min(phase, MAX_PHASE);
+  int value = (score.mg * phase + score.eg * (MAX_PHASE - phase)) / MAX_PHASE;
+  return (pos.sideToMove() == WHITE ? value : -value) + TEMPO_BONUS;
+}
+
+}  // namespace
+
+const PawnEntry &PawnTable::probe(const Position &pos) {
+  PawnEntry &entry = entries_[pos.pawnKey() & (PAWN_TABLE_SIZE - 1)];
+  if (entry.key != pos.pawnKey()) {
+    EvaluatePawns(pos, &entry);
+  }
+  return entry;
+}
+
+int Evaluate(const Position &pos, PawnTable *pawns) {
+  return EvaluateWith(pos, pawns->probe(pos));
+}
+
+int Evaluate(const Position &pos) {
+  PawnEntry entry;
+  EvaluatePawns(pos, &entry);
+  return EvaluateWith(pos, entry);
+}
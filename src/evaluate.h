@@ -0,0 +1,73 @@
+/*******************************************************************************
+   Filename: evaluate.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Static evaluation of chess positions, in centipawns from the
+             point of view of the side to move. Every term has a midgame and
+             an endgame value, blended by how much material is left. Pawn
+             structure depends on the pawns alone, so its terms are cached
+             in a PawnTable keyed by the position's pawn key.
+*******************************************************************************/
+
+#ifndef EVALUATE_H_
+#define EVALUATE_H_
+
+#include <vector>
+#include "position.h"
+
+#define PAWN_TABLE_SIZE 16384  // Entries; a power of two.
+
+// Nominal piece values, indexed by (type - PAWN).
+extern const int kPieceValues[NUM_PIECE_TYPES];
+
+inline int PieceValue(int type) { return kPieceValues[type - PAWN]; }
+
+// A term's midgame and endgame values.
+struct Score {
+  int mg;
+  int eg;
+
+  constexpr Score() : mg(0), eg(0) {}
+  constexpr Score(int midgame, int endgame) : mg(midgame), eg(endgame) {}
+  constexpr Score operator+(const Score &s) const {
+    return Score(mg + s.mg, eg + s.eg);
+  }
+  constexpr Score operator-(const Score &s) const {
+    return Score(mg - s.mg, eg - s.eg);
+  }
+  constexpr Score operator*(int n) const { return Score(mg * n, eg * n); }
+  constexpr Score &operator+=(const Score &s) {
+    mg += s.mg;
+    eg += s.eg;
+    return *this;
+  }
+  constexpr Score &operator-=(const Score &s) {
+    mg -= s.mg;
+    eg -= s.eg;
+    return *this;
+  }
+};
+
+// Pawn structure terms for one arrangement of pawns.
+struct PawnEntry {
+  uint64_t key;
+  Score score;  // White's point of view.
+  Bitboard attacks[NUM_CHESS_PIECE_COLORS];
+};
+
+// Per-thread cache of pawn structure terms. A new table holds zeroed entries,
+// which are correct for the pawn key of a board without pawns.
+class PawnTable {
+ public:
+  PawnTable() : entries_(PAWN_TABLE_SIZE) {}
+  const PawnEntry &probe(const Position &pos);
+
+ private:
+  std::vector<PawnEntry> entries_;
+};
+
+int Evaluate(const Position &pos, PawnTable *pawns);
+int Evaluate(const Position &pos);  // Without a cache.
+
+#endif  // EVALUATE_H_
@@ -0,0 +1,57 @@
+/*******************************************************************************
+   Filename: frame_scheduler.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Frame timing for the viewer.
+*******************************************************************************/
+
+#include "frame_scheduler.h"
+
+#include <cmath>
+
+using namespace std;
+
+FrameScheduler::FrameScheduler()
+    : start_(Clock::now()),
+      frame_start_(start_),
+      first_frame_(true),
+      max_fps_(DEFAULT_MAX_FPS),
+      fixed_step_(0),
+      fixed_frames_(-1) {}
+
+void FrameScheduler::setMaxFps(double fps) {
+  max_fps_ = fps > 0 ? fps : 0;
+}
+
+void FrameScheduler::setFixedStep(double seconds) {
+  fixed_step_ = seconds > 0 ? seconds : 0;
+  fixed_frames_ = -1;
+}
+
+double FrameScheduler::beginFrame() {
+  if (fixed_step_ > 0) {
+    return ++fixed_frames_ > 0 ? fixed_step_ : 0;
+  }
+  Clock::time_point now = Clock::now();
+  double delta = chrono::duration<double>(now - frame_start_).count();
+  frame_start_ = now;
+  if (first_frame_) {
+    first_frame_ = false;
+    return 0;
+  }
+  return delta < MAX_FRAME_DELTA ? delta : MAX_FRAME_DELTA;
+}
+
+double FrameScheduler::now() const {
+  return fixed_step_ > 0 ? frameStart() : seconds(Clock::now());
+}
+
+int FrameScheduler::millisecondsUntilNextFrame() const {
+  if (max_fps_ <= 0 || fixed_step_ > 0) {
+    return 0;
+  }
+  double due = seconds(frame_start_) + 1 / max_fps_;
+  double wait = due - now();
+  return wait > 0 ? (int) lround(wait * 1000) : 0;
+}
@@ -0,0 +1,63 @@
+/*******************************************************************************
+   Filename: frame_scheduler.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the FrameScheduler class, which measures frame
+             times on a monotonic clock and works out when the next frame is
+             due under an optional frame-rate cap.
+*******************************************************************************/
+
+#ifndef FRAME_SCHEDULER_H_
+#define FRAME_SCHEDULER_H_
+
+#include <chrono>
+
+#define DEFAULT_MAX_FPS 60
+#define MAX_FRAME_DELTA 0.25  // Seconds; longer stalls are not caught up.
+
+class FrameScheduler {
+ public:
+  FrameScheduler();
+
+  void setMaxFps(double fps);  // Zero means uncapped.
+  double maxFps() const { return max_fps_; }
+
+  // Replaces the clock with a simulated one that advances "seconds" per
+  // frame, with no waiting between frames. Zero restores real time.
+  void setFixedStep(double seconds);
+
+  // Call at the start of each frame. Returns the seconds elapsed since the
+  // previous frame started, clamped to MAX_FRAME_DELTA.
+  double beginFrame();
+
+  // Call when frames stop being requested, so the first frame after the
+  // pause reports a zero delta instead of the whole idle period.
+  void idle() { first_frame_ = true; }
+  double now() const;  // Seconds since the scheduler was created.
+  double frameStart() const {
+    return fixed_step_ > 0 ? fixed_frames_ * fixed_step_ :
+                             seconds(frame_start_);
+  }
+
+  // How long to wait before starting the next frame. Time spent blocked in a
+  // vsynced buffer swap counts toward the wait, so a cap at or above the
+  // refresh rate adds no extra delay.
+  int millisecondsUntilNextFrame() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  double seconds(Clock::time_point t) const {
+    return std::chrono::duration<double>(t - start_).count();
+  }
+
+  Clock::time_point start_;
+  Clock::time_point frame_start_;
+  bool first_frame_;
+  double max_fps_;
+  double fixed_step_;
+  long fixed_frames_;  // Frames begun on the simulated clock, less one.
+};
+
+#endif  // FRAME_SCHEDULER_H_
@@ -0,0 +1,188 @@
+/*******************************************************************************
+   Filename: frame_writer.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Background PNG and raw video output for rendered frames.
+*******************************************************************************/
+
+#include "frame_writer.h"
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <png.h>
+
+using namespace std;
+
+namespace {
+
+// Replaces the first "%d" (optionally with a zero-padded width, as in
+// "%05d") in "pattern" with "number". Other text is copied unchanged.
+string FrameFileName(const string &pattern, int number) {
+  size_t start = pattern.find('%');
+  if (start == string::npos) {
+    return pattern;
+  }
+  size_t end = start + 1;
+  while (end < pattern.size() && isdigit((unsigned char) pattern[end])) {
+    ++end;
+  }
+  if (end == pattern.size() || pattern[end] != 'd') {
+    return pattern;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), ("%" + pattern.substr(start + 1,
+                                                         end - start)).c_str(),
+           number);
+  return pattern.substr(0, start) + buffer + pattern.substr(end + 1);
+}
+
+}  // namespace
+
+FrameWriter::FrameWriter()
+    : head_(0),
+      count_(0),
+      closing_(false),
+      failed_(false),
+      png_(false),
+      raw_(NULL),
+      width_(0),
+      height_(0),
+      frames_written_(0) {}
+
+FrameWriter::~FrameWriter() {
+  close();
+}
+
+bool FrameWriter::open(const string &output, int width, int height) {
+  close();
+  output_ = output;
+  width_ = width;
+  height_ = height;
+  png_ = output.size() > 4 &&
+         output.compare(output.size() - 4, 4, ".png") == 0;
+  if (!png_) {
+    raw_ = output == "-" ? stdout : fopen(output.c_str(), "wb");
+    if (raw_ == NULL) {
+      cerr << "Error: could not open " << output << endl;
+      return false;
+    }
+  }
+  ring_.assign(FRAME_RING_SIZE, vector<unsigned char>(width * height * 3));
+  head_ = count_ = frames_written_ = 0;
+  closing_ = failed_ = false;
+  thread_ = thread(&FrameWriter::writerThread, this);
+  return true;
+}
+
+bool FrameWriter::close() {
+  if (!thread_.joinable()) {
+    return true;
+  }
+  {
+    lock_guard<mutex> lock(mutex_);
+    closing_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+  if (raw_ && raw_ != stdout) {
+    failed_ = fclose(raw_) != 0 || failed_;
+  } else if (raw_) {
+    failed_ = fflush(raw_) != 0 || failed_;
+  }
+  raw_ = NULL;
+  ring_.clear();
+  return !failed_;
+}
+
+unsigned char *FrameWriter::beginFrame() {
+  unique_lock<mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return count_ < FRAME_RING_SIZE; });
+  return &ring_[head_][0];
+}
+
+void FrameWriter::endFrame() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    head_ = (head_ + 1) % FRAME_RING_SIZE;
+    ++count_;
+  }
+  changed_.notify_all();
+}
+
+bool FrameWriter::failed() {
+  lock_guard<mutex> lock(mutex_);
+  return failed_;
+}
+
+//------------------------------------------------------------------------------
+// Writes queued frames in order until close() is called and the ring is
+// empty. A slot is only released after its frame is on disk.
+//------------------------------------------------------------------------------
+void FrameWriter::writerThread() {
+  int number = 0;
+  for (;;) {
+    int slot;
+    {
+      unique_lock<mutex> lock(mutex_);
+      changed_.wait(lock, [this] { return count_ > 0 || closing_; });
+      if (count_ == 0) {
+        return;
+      }
+      slot = (head_ - count_ + FRAME_RING_SIZE) % FRAME_RING_SIZE;
+    }
+    bool ok = writeFrame(&ring_[slot][0], number++);
+    {
+      lock_guard<mutex> lock(mutex_);
+      --count_;
+      failed_ = failed_ || !ok;
+      frames_written_ += ok;
+    }
+    changed_.notify_all();
+  }
+}
+
+bool FrameWriter::writeFrame(const unsigned char *pixels, int number) {
+  if (png_) {
+    return writePng(FrameFileName(output_, number).c_str(), pixels);
+  }
+  size_t row_size = width_ * 3;
+  for (int row = height_ - 1; row >= 0; --row) {
+    if (fwrite(pixels + row * row_size, 1, row_size, raw_) != row_size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FrameWriter::writePng(const char *filename,
+                           const unsigned char *pixels) const {
+  FILE *file = fopen(filename, "wb");
+  if (file == NULL) {
+    cerr << "Error: could not open " << filename << endl;
+    return false;
+  }
+  vector<png_const_bytep> rows(height_);
+  for (int i = 0; i < height_; ++i) {
+    rows[i] = pixels + (height_ - 1 - i) * width_ * 3;  // Flip vertically.
+  }
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL,
+                                            NULL);
+  png_infop info = png ? png_create_info_struct(png) : NULL;
+  if (info == NULL || setjmp(png_jmpbuf(png))) {  // libpng reports errors here.
+    png_destroy_write_struct(&png, &info);
+    fclose(file);
+    return false;
+  }
+  png_init_io(png, file);
+  png_set_compression_level(png, 3);  // Fast; diagrams compress well anyway.
+  png_set_IHDR(png, info, width_, height_, 8, PNG_COLOR_TYPE_RGB,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+               PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+  png_write_image(png, (png_bytepp) &rows[0]);
+  png_write_end(png, NULL);
+  png_destroy_write_struct(&png, &info);
+  return fclose(file) == 0;
+}
@@ -0,0 +1,64 @@
+/*******************************************************************************
+   Filename: frame_writer.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the FrameWriter class, which saves rendered
+             frames on a background thread. Frames pass through a fixed ring
+             of preallocated buffers, so rendering only waits on disk I/O when
+             every buffer is still queued.
+*******************************************************************************/
+
+#ifndef FRAME_WRITER_H_
+#define FRAME_WRITER_H_
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define FRAME_RING_SIZE 8
+
+class FrameWriter {
+ public:
+  FrameWriter();
+  ~FrameWriter();
+
+  // "output" selects the format: a name ending in ".png" writes PNG images
+  // (with any printf-style "%d" replaced by the frame number, e.g.
+  // "frames/%05d.png"); anything else receives raw RGB24 video, top row
+  // first, with "-" meaning standard output.
+  bool open(const std::string &output, int width, int height);
+  bool close();  // Waits for queued frames. Returns false if any write failed.
+
+  // Returns a buffer of width * height * 3 bytes to render into, waiting if
+  // the ring is full. Rows are bottom first, as glReadPixels() writes them.
+  unsigned char *beginFrame();
+  void endFrame();  // Queues the buffer from beginFrame() for writing.
+  bool failed();  // True once any write has failed.
+  int framesWritten() const { return frames_written_; }
+
+ private:
+  void writerThread();
+  bool writeFrame(const unsigned char *pixels, int number);
+  bool writePng(const char *filename, const unsigned char *pixels) const;
+
+  std::vector<std::vector<unsigned char> > ring_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  int head_;   // Next slot to fill.
+  int count_;  // Slots queued or being written.
+  bool closing_;
+  bool failed_;
+  std::thread thread_;
+  std::string output_;
+  bool png_;
+  FILE *raw_;
+  int width_;
+  int height_;
+  int frames_written_;
+};
+
+#endif  // FRAME_WRITER_H_
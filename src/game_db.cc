@@ -0,0 +1,528 @@
+/*******************************************************************************
+   Filename: game_db.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Binary game database: building, spilling to run files, merging
+             and reading.
+*******************************************************************************/
+
+#include "game_db.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include "notation.h"
+
+using namespace std;
+
+namespace {
+
+#define RUN_BUFFER_BYTES (1 << 22)
+#define INDEX_READER_ENTRIES 4096  // 64 KB per run during the merge.
+
+inline uint64_t Align8(uint64_t n) { return (n + 7) & ~(uint64_t) 7; }
+
+inline bool IndexLess(const GameDbIndexEntry &a, const GameDbIndexEntry &b) {
+  if (a.key != b.key) {
+    return a.key < b.key;
+  }
+  return a.game != b.game ? a.game < b.game : a.ply < b.ply;
+}
+
+// Tests whether "count" aligned items of type T starting at "offset" lie
+// within a file of "size" bytes. The header is untrusted, so the test is
+// arranged to never overflow.
+template <typename T>
+bool SectionFits(uint64_t offset, uint64_t count, uint64_t size) {
+  return offset <= size && offset % alignof(T) == 0 &&
+         count <= (size - offset) / sizeof(T);
+}
+
+int ParseResult(string_view result) {
+  if (result == "1-0") {
+    return RESULT_WHITE_WINS;
+  } else if (result == "0-1") {
+    return RESULT_BLACK_WINS;
+  } else if (result == "1/2-1/2") {
+    return RESULT_DRAW;
+  }
+  return RESULT_UNKNOWN;
+}
+
+bool WriteBytes(FILE *file, const void *data, size_t size) {
+  return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+bool WritePadding(FILE *file, uint64_t size) {
+  static const char kZeros[8] = { 0 };
+  return WriteBytes(file, kZeros, Align8(size) - size);
+}
+
+// A run file opened for reading at the given offset.
+class RunFile {
+ public:
+  RunFile(const string &filename, uint64_t offset) : file_(NULL) {
+    open(filename, offset);
+  }
+  ~RunFile() {
+    if (file_ != NULL) {
+      fclose(file_);
+    }
+  }
+
+  bool open(const string &filename, uint64_t offset) {
+    file_ = fopen(filename.c_str(), "rb");
+    if (file_ != NULL && fseeko(file_, (off_t) offset, SEEK_SET) != 0) {
+      fclose(file_);
+      file_ = NULL;
+    }
+    return file_ != NULL;
+  }
+
+  bool read(void *data, size_t size) {
+    return file_ != NULL && (size == 0 || fread(data, 1, size, file_) == size);
+  }
+
+  // Copies the next "size" bytes to "out".
+  bool copyTo(FILE *out, uint64_t size, vector<char> *buffer) {
+    while (size > 0) {
+      size_t n = (size_t) min<uint64_t>(size, buffer->size());
+      if (!read(buffer->data(), n) || !WriteBytes(out, buffer->data(), n)) {
+        return false;
+      }
+      size -= n;
+    }
+    return true;
+  }
+
+ private:
+  FILE *file_;
+
+  RunFile(const RunFile &);
+  RunFile &operator=(const RunFile &);
+};
+
+// Streams one run's sorted index for the merge, a block at a time. The file
+// is opened only to read each block, so any number of runs can be merged
+// without running out of file descriptors.
+class IndexReader {
+ public:
+  IndexReader() : offset_(0), left_(0), game_base_(0), next_(0),
+                  failed_(false) {}
+
+  template <typename Run>
+  void open(const Run &run, uint32_t game_base) {
+    filename_ = run.filename;
+    offset_ = run.game_count * sizeof(GameDbEntry) +
+              run.move_count * sizeof(Move) + run.strings_size;
+    left_ = run.index_count;
+    game_base_ = game_base;
+  }
+
+  // Returns false at the end of the run or on a read error (see failed()).
+  bool next(GameDbIndexEntry *entry) {
+    if (next_ == buffer_.size()) {
+      if (left_ == 0) {
+        return false;
+      }
+      size_t n = (size_t) min<uint64_t>(left_, INDEX_READER_ENTRIES);
+      buffer_.resize(n);
+      next_ = 0;
+      RunFile file(filename_, offset_);
+      if (!file.read(buffer_.data(), n * sizeof(GameDbIndexEntry))) {
+        failed_ = true;
+        return false;
+      }
+      offset_ += n * sizeof(GameDbIndexEntry);
+      left_ -= n;
+    }
+    *entry = buffer_[next_++];
+    entry->game += game_base_;
+    return true;
+  }
+
+  bool failed() const { return failed_; }
+
+ private:
+  string filename_;
+  uint64_t offset_;
+  uint64_t left_;  // Entries not yet read from the file.
+  uint32_t game_base_;
+  vector<GameDbIndexEntry> buffer_;
+  size_t next_;
+  bool failed_;
+
+  IndexReader(const IndexReader &);
+  IndexReader &operator=(const IndexReader &);
+};
+
+}  // namespace
+
+bool GameDbBuilder::addGame(const PgnGame &game) {
+  string_view fen = game.tag("FEN");
+  if (!pos_.setFen(fen.empty() ? string(START_FEN) : UnescapeTagValue(fen))) {
+    return false;
+  }
+  size_t first_move = moves_.size(), first_index = index_.size();
+  uint32_t number = (uint32_t) games_.size();
+  GameDbIndexEntry entry = { pos_.key(), number, 0 };
+  index_.push_back(entry);
+  for (size_t i = 0; i < game.moves.size(); ++i) {
+    Move m = SanToMove(pos_, game.moves[i]);
+    if (m == NO_MOVE) {
+      moves_.resize(first_move);
+      index_.resize(first_index);
+      return false;
+    }
+    pos_.doMove(m);
+    moves_.push_back(m);
+    if (index_plies_ == 0 || (int) i < index_plies_) {
+      entry.key = pos_.key();
+      entry.ply = (uint32_t) i + 1;
+      index_.push_back(entry);
+    }
+  }
+
+  GameDbEntry record;
+  memset(&record, 0, sizeof(record));
+  record.first_move = first_move;
+  record.move_count = (uint32_t) game.moves.size();
+  record.tags = strings_.size();
+  for (size_t i = 0; i < game.tags.size(); ++i) {
+    strings_.append(game.tags[i].name);
+    strings_ += '\0';
+    strings_ += UnescapeTagValue(game.tags[i].value);
+    strings_ += '\0';
+  }
+  record.tags_size = (uint32_t) (strings_.size() - record.tags);
+  record.result = ParseResult(game.result);
+  games_.push_back(record);
+  return true;
+}
+
+GameDbBuilder::~GameDbBuilder() {
+  removeRuns();
+}
+
+void GameDbBuilder::removeRuns() {
+  for (size_t i = 0; i < runs_.size(); ++i) {
+    remove(runs_[i].filename.c_str());
+  }
+  runs_.clear();
+}
+
+// Counts capacity rather than size, since that is what is allocated.
+size_t GameDbBuilder::memoryUsed() const {
+  return games_.capacity() * sizeof(GameDbEntry) +
+         moves_.capacity() * sizeof(Move) + strings_.capacity() +
+         (index_.capacity() + index_.size()) * sizeof(GameDbIndexEntry);
+}
+
+size_t GameDbBuilder::gameCount() const {
+  size_t count = games_.size();
+  for (size_t i = 0; i < runs_.size(); ++i) {
+    count += runs_[i].game_count;
+  }
+  return count;
+}
+
+size_t GameDbBuilder::moveCount() const {
+  size_t count = moves_.size();
+  for (size_t i = 0; i < runs_.size(); ++i) {
+    count += runs_[i].move_count;
+  }
+  return count;
+}
+
+size_t GameDbBuilder::indexCount() const {
+  size_t count = index_.size();
+  for (size_t i = 0; i < runs_.size(); ++i) {
+    count += runs_[i].index_count;
+  }
+  return count;
+}
+
+//------------------------------------------------------------------------------
+// Sorts the index and drops repeat visits to a position within a game,
+// keeping the first. Entries are added in game and ply order, so a stable
+// sort on the key alone is enough; a radix sort does it in four passes.
+//------------------------------------------------------------------------------
+void GameDbBuilder::sortIndex() {
+  const int kDigitBits = 16;
+  vector<GameDbIndexEntry> buffer(index_.size());
+  vector<size_t> counts(1 << kDigitBits);
+  for (int shift = 0; shift < 64; shift += kDigitBits) {
+    fill(counts.begin(), counts.end(), 0);
+    for (size_t i = 0; i < index_.size(); ++i) {
+      ++counts[(index_[i].key >> shift) & 0xFFFF];
+    }
+    size_t total = 0;
+    for (size_t d = 0; d < counts.size(); ++d) {
+      size_t count = counts[d];
+      counts[d] = total;
+      total += count;
+    }
+    for (size_t i = 0; i < index_.size(); ++i) {
+      buffer[counts[(index_[i].key >> shift) & 0xFFFF]++] = index_[i];
+    }
+    index_.swap(buffer);
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < index_.size(); ++i) {
+    if (kept == 0 || index_[i].key != index_[kept - 1].key ||
+        index_[i].game != index_[kept - 1].game) {
+      index_[kept++] = index_[i];
+    }
+  }
+  index_.resize(kept);
+}
+
+bool GameDbBuilder::spill() {
+  if (games_.empty()) {
+    return true;
+  }
+  if (temp_prefix_.empty()) {
+    return false;
+  }
+  sortIndex();
+  Run run;
+  run.filename = temp_prefix_ + "." + to_string(runs_.size());
+  run.game_count = games_.size();
+  run.move_count = moves_.size();
+  run.strings_size = strings_.size();
+  run.index_count = index_.size();
+  FILE *file = fopen(run.filename.c_str(), "wb");
+  if (file == NULL) {
+    return false;
+  }
+  setvbuf(file, NULL, _IOFBF, RUN_BUFFER_BYTES);
+  bool ok = WriteBytes(file, games_.data(),
+                       games_.size() * sizeof(GameDbEntry)) &&
+            WriteBytes(file, moves_.data(), moves_.size() * sizeof(Move)) &&
+            WriteBytes(file, strings_.data(), strings_.size()) &&
+            WriteBytes(file, index_.data(),
+                       index_.size() * sizeof(GameDbIndexEntry));
+  ok = fclose(file) == 0 && ok;
+  if (!ok) {
+    remove(run.filename.c_str());
+    return false;
+  }
+  runs_.push_back(run);
+
+  // Swap rather than clear, so the memory itself is released:
+  vector<GameDbEntry>().swap(games_);
+  vector<Move>().swap(moves_);
+  string().swap(strings_);
+  vector<GameDbIndexEntry>().swap(index_);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Writes the database in one pass over the runs per section. Only the file
+// buffers and one buffered reader per run for the index merge are held in
+// memory, however large the database.
+//------------------------------------------------------------------------------
+bool WriteGameDatabase(const char *filename, vector<GameDbBuilder> &parts) {
+  vector<const GameDbBuilder::Run *> runs;
+  bool ok = true;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    if (parts[i].temp_prefix_.empty()) {
+      parts[i].setTempPrefix(string(filename) + ".part" + to_string(i));
+    }
+    ok = parts[i].spill() && ok;
+    for (size_t j = 0; j < parts[i].runs_.size(); ++j) {
+      runs.push_back(&parts[i].runs_[j]);
+    }
+  }
+
+  GameDbHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = GAME_DB_MAGIC;
+  header.version = GAME_DB_VERSION;
+  header.key_version = POSITION_KEY_VERSION;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    header.game_count += runs[i]->game_count;
+    header.move_count += runs[i]->move_count;
+    header.strings_size += runs[i]->strings_size;
+    header.index_count += runs[i]->index_count;
+  }
+  header.games_offset = Align8(sizeof(header));
+  header.moves_offset = header.games_offset +
+                        header.game_count * sizeof(GameDbEntry);
+  header.strings_offset = Align8(header.moves_offset +
+                                 header.move_count * sizeof(Move));
+  header.index_offset = Align8(header.strings_offset + header.strings_size);
+  header.file_size = header.index_offset +
+                     header.index_count * sizeof(GameDbIndexEntry);
+
+  // Write to a temporary file first so a reader never maps a partial file:
+  string temp = string(filename) + ".tmp";
+  FILE *file = ok ? fopen(temp.c_str(), "wb") : NULL;
+  if (file == NULL) {
+    for (size_t i = 0; i < parts.size(); ++i) {
+      parts[i].removeRuns();
+    }
+    return false;
+  }
+  setvbuf(file, NULL, _IOFBF, RUN_BUFFER_BYTES);
+  ok = WriteBytes(file, &header, sizeof(header)) &&
+       WritePadding(file, sizeof(header));
+
+  // Games, with their move and tag offsets rebased:
+  uint64_t move_base = 0, string_base = 0;
+  vector<GameDbEntry> records(RUN_BUFFER_BYTES / sizeof(GameDbEntry));
+  for (size_t i = 0; ok && i < runs.size(); ++i) {
+    RunFile run(runs[i]->filename, 0);
+    uint64_t left = runs[i]->game_count;
+    while (ok && left > 0) {
+      size_t n = (size_t) min<uint64_t>(left, records.size());
+      ok = run.read(records.data(), n * sizeof(GameDbEntry));
+      for (size_t j = 0; j < n; ++j) {
+        records[j].first_move += move_base;
+        records[j].tags += string_base;
+      }
+      ok = ok && WriteBytes(file, records.data(), n * sizeof(GameDbEntry));
+      left -= n;
+    }
+    move_base += runs[i]->move_count;
+    string_base += runs[i]->strings_size;
+  }
+  vector<GameDbEntry>().swap(records);
+
+  vector<char> buffer(RUN_BUFFER_BYTES);
+  for (size_t i = 0; ok && i < runs.size(); ++i) {
+    RunFile run(runs[i]->filename, runs[i]->game_count * sizeof(GameDbEntry));
+    ok = run.copyTo(file, runs[i]->move_count * sizeof(Move), &buffer);
+  }
+  ok = ok && WritePadding(file, header.move_count * sizeof(Move));
+  for (size_t i = 0; ok && i < runs.size(); ++i) {
+    RunFile run(runs[i]->filename,
+                runs[i]->game_count * sizeof(GameDbEntry) +
+                runs[i]->move_count * sizeof(Move));
+    ok = run.copyTo(file, runs[i]->strings_size, &buffer);
+  }
+  ok = ok && WritePadding(file, header.strings_size);
+  vector<char>().swap(buffer);
+
+  // Merge the sorted indexes. Game numbers grow from run to run, so rebasing
+  // them keeps each run sorted:
+  vector<IndexReader> readers(runs.size());
+  uint32_t game_base = 0;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    readers[i].open(*runs[i], game_base);
+    game_base += (uint32_t) runs[i]->game_count;
+  }
+  typedef pair<GameDbIndexEntry, size_t> Head;  // Entry, run.
+  auto later = [](const Head &a, const Head &b) {
+    return IndexLess(b.first, a.first);
+  };
+  priority_queue<Head, vector<Head>, decltype(later)> heads(later);
+  GameDbIndexEntry entry;
+  for (size_t i = 0; ok && i < readers.size(); ++i) {
+    if (readers[i].next(&entry)) {
+      heads.push(Head(entry, i));
+    }
+    ok = !readers[i].failed();
+  }
+  while (ok && !heads.empty()) {
+    Head head = heads.top();
+    heads.pop();
+    ok = WriteBytes(file, &head.first, sizeof(head.first));
+    IndexReader &reader = readers[head.second];
+    if (reader.next(&entry)) {
+      heads.push(Head(entry, head.second));
+    }
+    ok = ok && !reader.failed();
+  }
+  readers.clear();
+
+  ok = fclose(file) == 0 && ok;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    parts[i].removeRuns();
+  }
+  if (!ok || rename(temp.c_str(), filename) != 0) {
+    remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+GameDatabase::GameDatabase()
+    : header_(NULL), games_(NULL), moves_(NULL), strings_(NULL),
+      index_(NULL) {}
+
+//------------------------------------------------------------------------------
+// Maps a database file and checks that its sections fit inside it and that its
+// keys match this build's Position::key().
+//------------------------------------------------------------------------------
+bool GameDatabase::open(const char *filename) {
+  close();
+  if (!file_.open(filename) || file_.size() < sizeof(GameDbHeader)) {
+    file_.close();
+    return false;
+  }
+  const unsigned char *data = file_.data();
+  const GameDbHeader *header = (const GameDbHeader *) data;
+  uint64_t size = file_.size();
+  bool ok = header->magic == GAME_DB_MAGIC &&
+            header->version == GAME_DB_VERSION &&
+            header->key_version == POSITION_KEY_VERSION &&
+            header->file_size == size &&
+            SectionFits<GameDbEntry>(header->games_offset,
+                                     header->game_count, size) &&
+            SectionFits<Move>(header->moves_offset, header->move_count,
+                              size) &&
+            SectionFits<char>(header->strings_offset, header->strings_size,
+                              size) &&
+            SectionFits<GameDbIndexEntry>(header->index_offset,
+                                          header->index_count, size);
+  if (!ok) {
+    file_.close();
+    return false;
+  }
+  header_ = header;
+  games_ = (const GameDbEntry *) (data + header->games_offset);
+  moves_ = (const Move *) (data + header->moves_offset);
+  strings_ = (const char *) (data + header->strings_offset);
+  index_ = (const GameDbIndexEntry *) (data + header->index_offset);
+  return true;
+}
+
+void GameDatabase::close() {
+  file_.close();
+  header_ = NULL;
+  games_ = NULL;
+  moves_ = NULL;
+  strings_ = NULL;
+  index_ = NULL;
+}
+
+string GameDatabase::tag(uint64_t game, const char *name) const {
+  const char *p = strings_ + games_[game].tags;
+  const char *end = p + games_[game].tags_size;
+  while (p < end) {
+    const char *value = p + strlen(p) + 1;
+    if (strcmp(p, name) == 0) {
+      return value;
+    }
+    p = value + strlen(value) + 1;
+  }
+  return "";
+}
+
+bool GameDatabase::startPosition(uint64_t game, Position *pos) const {
+  string fen = tag(game, "FEN");
+  return pos->setFen(fen.empty() ? string(START_FEN) : fen);
+}
+
+void GameDatabase::findPosition(uint64_t key,
+                                vector<GameDbIndexEntry> *matches) const {
+  const GameDbIndexEntry *end = index_ + header_->index_count;
+  GameDbIndexEntry probe = { key, 0, 0 };
+  const GameDbIndexEntry *first = lower_bound(index_, end, probe, IndexLess);
+  for (const GameDbIndexEntry *p = first; p < end && p->key == key; ++p) {
+    matches->push_back(*p);
+  }
+}
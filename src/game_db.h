@@ -0,0 +1,170 @@
+/*******************************************************************************
+   Filename: game_db.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the binary game database: a compact file of
+             games (tags plus 16-bit moves) with an index of every position's
+             Zobrist key, sorted so that all games reaching a position can be
+             found with a binary search. GameDbBuilder turns parsed PGN games
+             into database parts (one per parsing thread) and moves them to
+             temporary run files whenever they outgrow their memory budget;
+             WriteGameDatabase() merges the runs from disk into a file, so a
+             database of any size is built in bounded memory. GameDatabase
+             reads the file through a memory mapping.
+*******************************************************************************/
+
+#ifndef GAME_DB_H_
+#define GAME_DB_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "pgn.h"
+#include "position.h"
+
+#define GAME_DB_MAGIC   0x42444D47  // "GMDB" when read as little-endian.
+#define GAME_DB_VERSION 2
+
+enum GameDbResult {
+  RESULT_UNKNOWN,
+  RESULT_WHITE_WINS,
+  RESULT_BLACK_WINS,
+  RESULT_DRAW
+};
+
+// File layout: the header, then each section at the offset it records (all
+// 8-byte aligned).
+struct GameDbHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t file_size;
+  uint64_t game_count;
+  uint64_t games_offset;    // GameDbEntry[game_count]
+  uint64_t move_count;
+  uint64_t moves_offset;    // Move[move_count]
+  uint64_t strings_size;
+  uint64_t strings_offset;  // Tags: "name\0value\0" pairs, game after game.
+  uint64_t index_count;
+  uint64_t index_offset;    // GameDbIndexEntry[index_count]
+  uint32_t key_version;     // POSITION_KEY_VERSION of the indexed keys.
+  uint32_t reserved;
+};
+
+struct GameDbEntry {
+  uint64_t first_move;  // Into the move array.
+  uint64_t tags;        // Byte offset into the strings.
+  uint32_t move_count;
+  uint32_t tags_size;
+  uint32_t result;      // GameDbResult.
+  uint32_t reserved;
+};
+
+// Sorted by key, then game. Each position is listed once per game, with the
+// ply at which it first occurs.
+struct GameDbIndexEntry {
+  uint64_t key;
+  uint32_t game;
+  uint32_t ply;
+};
+
+class GameDbBuilder {
+ public:
+  GameDbBuilder() : index_plies_(0) {}
+  GameDbBuilder(GameDbBuilder &&other) = default;
+  ~GameDbBuilder();  // Removes the run files.
+
+  // Positions after more than "plies" half-moves are not indexed (0 means
+  // index every position).
+  void setIndexPlies(int plies) { index_plies_ = plies; }
+
+  // Run files are named "prefix.N"; spill() fails without a prefix.
+  void setTempPrefix(const std::string &prefix) { temp_prefix_ = prefix; }
+
+  // Converts the game's moves with the legal move generator. Returns false,
+  // adding nothing, if a move cannot be read or the start position is bad.
+  bool addGame(const PgnGame &game);
+
+  // Bytes held for the games not yet spilled, counting what sorting their
+  // index will take.
+  size_t memoryUsed() const;
+
+  // Sorts the games held in memory and moves them to a new run file,
+  // releasing their memory. Returns false if the file cannot be written.
+  bool spill();
+
+  // Totals over the runs and the games still in memory (whose index is not
+  // yet sorted and stripped of repeated positions).
+  size_t gameCount() const;
+  size_t moveCount() const;
+  size_t indexCount() const;
+
+ private:
+  friend bool WriteGameDatabase(const char *filename,
+                                std::vector<GameDbBuilder> &parts);
+
+  // A spilled stretch of games: the file holds their GameDbEntry records,
+  // moves, tag strings and sorted index, in that order. Game numbers, move
+  // offsets and tag offsets start from 0 in every run.
+  struct Run {
+    std::string filename;
+    uint64_t game_count;
+    uint64_t move_count;
+    uint64_t strings_size;
+    uint64_t index_count;
+  };
+
+  GameDbBuilder(const GameDbBuilder &);  // Not copyable.
+  GameDbBuilder &operator=(const GameDbBuilder &);
+
+  void sortIndex();
+  void removeRuns();
+
+  int index_plies_;
+  std::string temp_prefix_;
+  Position pos_;
+  std::vector<GameDbEntry> games_;
+  std::vector<Move> moves_;
+  std::string strings_;
+  std::vector<GameDbIndexEntry> index_;
+  std::vector<Run> runs_;
+};
+
+// Spills whatever the parts still hold, then writes their games in order
+// (game numbers follow on from one run to the next) while merging the runs'
+// sorted indexes, reading every run from disk. The run files are removed
+// afterwards.
+bool WriteGameDatabase(const char *filename,
+                       std::vector<GameDbBuilder> &parts);
+
+class GameDatabase {
+ public:
+  GameDatabase();
+  bool open(const char *filename);
+  void close();
+  bool isOpen() const { return header_ != NULL; }
+
+  uint64_t gameCount() const { return header_->game_count; }
+  int moveCount(uint64_t game) const { return games_[game].move_count; }
+  const Move *moves(uint64_t game) const {
+    return moves_ + games_[game].first_move;
+  }
+  int result(uint64_t game) const { return games_[game].result; }
+  std::string tag(uint64_t game, const char *name) const;  // "" if absent.
+  bool startPosition(uint64_t game, Position *pos) const;
+
+  // Appends every game that reaches the position with "key".
+  void findPosition(uint64_t key,
+                    std::vector<GameDbIndexEntry> *matches) const;
+
+ private:
+  MappedFile file_;
+  const GameDbHeader *header_;
+  const GameDbEntry *games_;
+  const Move *moves_;
+  const char *strings_;
+  const GameDbIndexEntry *index_;
+};
+
+#endif  // GAME_DB_H_
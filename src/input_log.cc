@@ -0,0 +1,130 @@
+/*******************************************************************************
+   Filename: input_log.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Method definitions for the InputRecorder and InputPlayer
+             classes.
+*******************************************************************************/
+
+#include "input_log.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+int16_t ClampCoordinate(int value) {
+  return (int16_t) max(-32768, min(32767, value));
+}
+
+}  // namespace
+
+bool InputRecorder::open(const string &filename, int width, int height,
+                         uint32_t book_seed) {
+  close(0);
+  file_ = fopen(filename.c_str(), "wb");
+  if (!file_) {
+    cerr << "Error: cannot write " << filename << endl;
+    return false;
+  }
+  filename_ = filename;
+  header_ = InputLogHeader();
+  header_.magic = INPUT_LOG_MAGIC;
+  header_.version = INPUT_LOG_VERSION;
+  header_.width = (uint32_t) width;
+  header_.height = (uint32_t) height;
+  header_.book_seed = book_seed;
+  failed_ = fwrite(&header_, sizeof(header_), 1, file_) != 1;
+  return true;
+}
+
+void InputRecorder::record(const InputEvent &event) {
+  if (!file_) {
+    return;
+  }
+  InputLogEvent entry;
+  entry.time = event.time;
+  entry.type = (uint16_t) event.type;
+  entry.key = (uint16_t) event.key;
+  entry.x = ClampCoordinate(event.x);
+  entry.y = ClampCoordinate(event.y);
+  if (fwrite(&entry, sizeof(entry), 1, file_) != 1) {
+    failed_ = true;
+  }
+  ++header_.event_count;
+  header_.end_time = max(header_.end_time, event.time);
+}
+
+//------------------------------------------------------------------------------
+// The header goes in last, so a log cut short by a crash reads as empty
+// rather than as a shorter session. "end_time" is raised to the last event's
+// time if it is earlier.
+//------------------------------------------------------------------------------
+bool InputRecorder::close(double end_time) {
+  if (!file_) {
+    return true;
+  }
+  header_.end_time = max(header_.end_time, end_time);
+  if (fseek(file_, 0, SEEK_SET) != 0 ||
+      fwrite(&header_, sizeof(header_), 1, file_) != 1) {
+    failed_ = true;
+  }
+  if (fclose(file_) != 0) {
+    failed_ = true;
+  }
+  file_ = NULL;
+  if (failed_) {
+    cerr << "Error: cannot write " << filename_ << endl;
+  }
+  return !failed_;
+}
+
+bool InputPlayer::open(const string &filename) {
+  header_ = InputLogHeader();
+  events_.clear();
+  next_ = 0;
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    cerr << "Error: could not open " << filename << endl;
+    return false;
+  }
+  InputLogHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic == INPUT_LOG_MAGIC &&
+            header.version == INPUT_LOG_VERSION;
+  if (ok) {
+    events_.resize(header.event_count);
+    ok = events_.empty() ||
+         fread(&events_[0], sizeof(InputLogEvent), events_.size(), file) ==
+             events_.size();
+  }
+  fclose(file);
+  if (!ok) {
+    events_.clear();
+    cerr << "Error: " << filename << " is not a complete input log" << endl;
+    return false;
+  }
+  header_ = header;
+  return true;
+}
+
+void InputPlayer::feed(double time) {
+  while (next_ < events_.size() && events_[next_].time <= time) {
+    const InputLogEvent &entry = events_[next_];
+    InputEvent event;
+    event.time = entry.time;
+    event.type = entry.type;
+    event.key = entry.key;
+    event.x = entry.x;
+    event.y = entry.y;
+    event.action = NO_ACTION;
+    event.repeat = false;
+    if (!pushInputEvent(event)) {
+      return;
+    }
+    ++next_;
+  }
+}
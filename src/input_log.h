@@ -0,0 +1,91 @@
+/*******************************************************************************
+   Filename: input_log.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for recording and replaying viewer input. An input
+             log is a small header followed by one fixed-size record per
+             input event, stamped on the clock that drives the animation, so
+             a session can be played back frame for frame: InputRecorder
+             writes the records as the viewer applies them, and InputPlayer
+             hands them back to the input queue (see keys.h) as a simulated
+             clock reaches them. Besides device input, the log holds the
+             camera motion the viewer dropped after a stall, which a replay
+             at a steady frame rate would otherwise catch up.
+*******************************************************************************/
+
+#ifndef INPUT_LOG_H_
+#define INPUT_LOG_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "keys.h"
+
+#define INPUT_LOG_MAGIC   0x474C4E49  // "INLG" when read as little-endian.
+#define INPUT_LOG_VERSION 2
+
+struct InputLogHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;        // Window size when recording began.
+  uint32_t height;
+  uint32_t book_seed;    // The opening line shown.
+  uint32_t event_count;  // Zero until the recording is closed.
+  double end_time;       // Seconds; when the recording was closed.
+};
+
+struct InputLogEvent {
+  double time;  // Seconds, on the input clock.
+  uint16_t type;
+  uint16_t key;
+  int16_t x, y;
+};
+
+class InputRecorder {
+ public:
+  InputRecorder() : file_(NULL), header_(), failed_(false) {}
+  ~InputRecorder() { close(0); }
+
+  // Returns false (with a message) if the file cannot be written.
+  bool open(const std::string &filename, int width, int height,
+            uint32_t book_seed);
+  bool isOpen() const { return file_ != NULL; }
+  void record(const InputEvent &event);
+
+  // Fills in the header. Returns false if anything failed to be written.
+  bool close(double end_time);
+
+ private:
+  InputRecorder(const InputRecorder &);
+  InputRecorder &operator=(const InputRecorder &);
+
+  FILE *file_;
+  std::string filename_;
+  InputLogHeader header_;
+  bool failed_;
+};
+
+class InputPlayer {
+ public:
+  InputPlayer() : header_(), next_(0) {}
+
+  // Reads a whole log. Returns false (with a message) if it is missing,
+  // truncated, or not an input log.
+  bool open(const std::string &filename);
+  bool isOpen() const { return header_.magic == INPUT_LOG_MAGIC; }
+  const InputLogHeader &header() const { return header_; }
+  double endTime() const { return header_.end_time; }
+
+  // Queues every event stamped at or before "time" that has not been queued
+  // yet. Events that do not fit in a full queue wait for the next call.
+  void feed(double time);
+
+ private:
+  InputLogHeader header_;
+  std::vector<InputLogEvent> events_;
+  size_t next_;
+};
+
+#endif  // INPUT_LOG_H_
@@ -3,65 +3,175 @@
 
      Author: Rob Bateman, modified by David C. Drake (https://davidcdrake.com)
 
-Description: Improves on GLUT's handling of keyboard input.
+Description: Improves on GLUT's handling of keyboard and mouse input.
 *******************************************************************************/
 
 #include "keys.h"
 
-// state of all keys, to know if multiple keys are pressed at any given time
-bool g_keystates[512] = { false };
+#include <atomic>
+#include <chrono>
 
-// callback functions
-key_func g_upfunc = 0;
-key_func g_downfunc = 0;
+// state of all keys, as of the last event dequeued
+bool g_keystates[NUM_KEYS] = { false };
 
-void setKeyboardFunc(key_func func) {
-  g_downfunc = func;
+// key bindings, and how many bound keys are down for each action
+int g_bindings[NUM_KEYS];
+int g_action_keys[MAX_INPUT_ACTIONS] = { 0 };
+bool g_bindings_ready = false;
+
+// single-producer, single-consumer event queue; the indices only grow
+InputEvent g_queue[INPUT_QUEUE_SIZE];
+std::atomic<unsigned> g_queue_head(0);  // next event to remove
+std::atomic<unsigned> g_queue_tail(0);  // next free slot
+
+input_clock_func g_clock = 0;
+
+double defaultClock() {
+  static const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start).count();
+}
+
+void prepareBindings() {
+  if (!g_bindings_ready) {
+    for (int i = 0; i < NUM_KEYS; ++i) {
+      g_bindings[i] = NO_ACTION;
+    }
+    g_bindings_ready = true;
+  }
+}
+
+void setInputClock(input_clock_func clock) {
+  g_clock = clock;
 }
 
-void setKeyboardUpFunc(key_func func) {
-  g_upfunc = func;
+void bindKey(int key, int action) {
+  prepareBindings();
+  if (key < 0 || key >= NUM_KEYS || action >= MAX_INPUT_ACTIONS) {
+    return;
+  }
+  if (g_keystates[key] && g_bindings[key] != NO_ACTION) {
+    --g_action_keys[g_bindings[key]];
+  }
+  g_bindings[key] = action;
+  if (g_keystates[key] && action != NO_ACTION) {
+    ++g_action_keys[action];
+  }
 }
 
 bool isKeyPressed(int key) {
-  if (key >= 0 && key < 512) {
+  if (key >= 0 && key < NUM_KEYS) {
     return g_keystates[key];
   }
 
   return false;
 }
 
-void keyUpFunc(unsigned char key,int x,int y) {
-  g_keystates[key] = false;
-  if (g_upfunc) {
-    g_upfunc(key, x, y);
+bool isActionActive(int action) {
+  if (action >= 0 && action < MAX_INPUT_ACTIONS) {
+    return g_action_keys[action] > 0;
   }
+
+  return false;
 }
 
-void keyDownFunc(unsigned char key, int x, int y) {
-  g_keystates[key] = true;
-  if (g_downfunc) {
-    g_downfunc(key, x, y);
+bool pushInputEvent(const InputEvent &event) {
+  unsigned tail = g_queue_tail.load(std::memory_order_relaxed);
+  if (tail - g_queue_head.load(std::memory_order_acquire) >=
+      INPUT_QUEUE_SIZE) {
+    return false;
   }
+  g_queue[tail & (INPUT_QUEUE_SIZE - 1)] = event;
+  g_queue_tail.store(tail + 1, std::memory_order_release);
+  return true;
 }
 
-void specialKeyUpFunc(int key, int x, int y) {
-  g_keystates[key + 256] = false;
-  if (g_upfunc) {
-    g_upfunc(key + 256, x, y);
+bool peekInputEvent(InputEvent *event) {
+  unsigned head = g_queue_head.load(std::memory_order_relaxed);
+  if (head == g_queue_tail.load(std::memory_order_acquire)) {
+    return false;
   }
+  *event = g_queue[head & (INPUT_QUEUE_SIZE - 1)];
+  return true;
 }
 
-void specialKeyDownFunc(int key, int x, int y) {
-  g_keystates[key + 256] = true;
-  if (g_downfunc) {
-    g_downfunc(key + 256, x, y);
+bool nextInputEvent(double time, InputEvent *event) {
+  if (!peekInputEvent(event) || event->time > time) {
+    return false;  // Leave it for a later frame.
+  }
+  g_queue_head.fetch_add(1, std::memory_order_release);
+
+  prepareBindings();
+  event->action = NO_ACTION;
+  event->repeat = false;
+  if (event->type != KEY_DOWN_EVENT && event->type != KEY_UP_EVENT) {
+    return true;
+  }
+  int key = event->key;
+  if (key < 0 || key >= NUM_KEYS) {
+    return true;
+  }
+  bool down = event->type == KEY_DOWN_EVENT;
+  event->action = g_bindings[key];
+  event->repeat = down && g_keystates[key];
+  if (g_keystates[key] != down && event->action != NO_ACTION) {
+    g_action_keys[event->action] += down ? 1 : -1;
   }
+  g_keystates[key] = down;
+  return true;
+}
+
+// queues an event from a GLUT callback, stamped with the current time
+void queueEvent(int type, int key, int x, int y) {
+  InputEvent event;
+  event.time = g_clock ? g_clock() : defaultClock();
+  event.type = type;
+  event.key = key;
+  event.x = x;
+  event.y = y;
+  event.action = NO_ACTION;
+  event.repeat = false;
+  pushInputEvent(event);
+  glutPostRedisplay();
+}
+
+void keyUpFunc(unsigned char key, int x, int y) {
+  queueEvent(KEY_UP_EVENT, key, x, y);
+}
+
+void keyDownFunc(unsigned char key, int x, int y) {
+  queueEvent(KEY_DOWN_EVENT, key, x, y);
+}
+
+void specialKeyUpFunc(int key, int x, int y) {
+  queueEvent(KEY_UP_EVENT, key + 256, x, y);
+}
+
+void specialKeyDownFunc(int key, int x, int y) {
+  queueEvent(KEY_DOWN_EVENT, key + 256, x, y);
+}
+
+void mouseFunc(int button, int state, int x, int y) {
+  queueEvent(state == GLUT_DOWN ? BUTTON_DOWN_EVENT : BUTTON_UP_EVENT, button,
+             x, y);
+}
+
+void motionFunc(int x, int y) {
+  queueEvent(POINTER_MOVE_EVENT, 0, x, y);
 }
 
 void initKeyboard() {
+  // Held keys are tracked from their down and up events, so the system's key
+  // repeat would only add noise (repeats that slip through are flagged):
+  glutIgnoreKeyRepeat(1);
   glutKeyboardFunc(keyDownFunc);
   glutKeyboardUpFunc(keyUpFunc);
   glutSpecialFunc(specialKeyDownFunc);
   glutSpecialUpFunc(specialKeyUpFunc);
 }
+
+void initMouse() {
+  glutMouseFunc(mouseFunc);
+  glutMotionFunc(motionFunc);
+}
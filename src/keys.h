@@ -3,7 +3,11 @@
 
      Author: Rob Bateman, modified by David C. Drake (https://davidcdrake.com)
 
-Description: Improves on GLUT's handling of keyboard input.
+Description: Improves on GLUT's handling of keyboard and mouse input. The GLUT
+             callbacks only timestamp each event and append it to a lock-free
+             queue; the program drains the queue once per frame, in order, so
+             it can apply every event at the time it happened. Keys can be
+             bound to program-defined actions.
 *******************************************************************************/
 
 #ifndef KEYS_H_
@@ -41,11 +45,56 @@ Description: Improves on GLUT's handling of keyboard input.
 #define KEY_ENTER 13
 #define KEY_ESCAPE 27
 
-typedef void (*key_func) (int, int, int);
+#define NUM_KEYS          512
+#define INPUT_QUEUE_SIZE  1024  // Events; a power of two.
+#define MAX_INPUT_ACTIONS 32
+#define NO_ACTION         -1
+
+enum InputEventType {
+  KEY_DOWN_EVENT,
+  KEY_UP_EVENT,
+  BUTTON_DOWN_EVENT,
+  BUTTON_UP_EVENT,
+  POINTER_MOVE_EVENT,  // With a button held.
+  CAMERA_PAUSE_EVENT   // From an input log: "key" camera steps were dropped.
+};
+
+struct InputEvent {
+  double time;  // Seconds, from the input clock.
+  int type;
+  int key;      // KEY_* or ASCII for key events; GLUT_*_BUTTON for buttons.
+  int x, y;     // Pointer position in window coordinates (y down).
+
+  // Filled in as the event is dequeued:
+  int action;   // Bound to the key, or NO_ACTION.
+  bool repeat;  // The key was already down.
+};
+
+typedef double (*input_clock_func)();
 
-bool isKeyPressed(int key);
 void initKeyboard();
-void setKeyboardFunc(key_func);
-void setKeyboardUpFunc(key_func);
+void initMouse();
+
+// Timestamps come from "clock" (by default, seconds on a steady clock since
+// the first event), so they can be compared with the program's frame times.
+void setInputClock(input_clock_func clock);
+
+void bindKey(int key, int action);  // NO_ACTION unbinds the key.
+
+// Appends an event, as the GLUT callbacks do. Only one thread may push at a
+// time; events must be pushed in time order. Returns false if the queue is
+// full, in which case the event is dropped.
+bool pushInputEvent(const InputEvent &event);
+
+// Copies the oldest queued event without removing it. Returns false if the
+// queue is empty.
+bool peekInputEvent(InputEvent *event);
+
+// Removes the oldest queued event if it happened at or before "time". Key
+// and action state below follows the events as they are removed.
+bool nextInputEvent(double time, InputEvent *event);
+
+bool isKeyPressed(int key);
+bool isActionActive(int action);  // Any key bound to it is down.
 
 #endif  // KEYS_H_
@@ -0,0 +1,55 @@
+/*******************************************************************************
+   Filename: mapped_file.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Read-only file mappings.
+*******************************************************************************/
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : data_(NULL), size_(0) {}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+//------------------------------------------------------------------------------
+// Maps all of "filename". Empty files cannot be mapped and are reported as
+// failures.
+//------------------------------------------------------------------------------
+bool MappedFile::open(const char *filename, Access access) {
+  close();
+  int fd = ::open(filename, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  madvise(map, info.st_size,
+          access == ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+  data_ = (const unsigned char *) map;
+  size_ = info.st_size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_) {
+    munmap((void *) data_, size_);
+    data_ = NULL;
+    size_ = 0;
+  }
+}
@@ -0,0 +1,39 @@
+/*******************************************************************************
+   Filename: mapped_file.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the MappedFile class, a read-only memory mapping
+             of a whole file. Large inputs are read through the page cache
+             without being copied.
+*******************************************************************************/
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+
+class MappedFile {
+ public:
+  enum Access {
+    ACCESS_RANDOM,
+    ACCESS_SEQUENTIAL  // Read ahead aggressively and drop pages behind.
+  };
+
+  MappedFile();
+  ~MappedFile();
+  bool open(const char *filename, Access access = ACCESS_RANDOM);
+  void close();
+  bool isOpen() const { return data_ != NULL; }
+  const unsigned char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile(const MappedFile &);  // Not copyable.
+  MappedFile &operator=(const MappedFile &);
+
+  const unsigned char *data_;
+  size_t size_;
+};
+
+#endif  // MAPPED_FILE_H_
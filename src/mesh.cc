@@ -0,0 +1,521 @@
+/*******************************************************************************
+   Filename: mesh.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Loading and saving of chess piece meshes.
+*******************************************************************************/
+
+#include "mesh.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Appends one convex polygon to "mesh" as a triangle fan. Normals are left for
+// SmoothMesh() to fill in.
+void AddPolygon(const vector<double> &x, const vector<double> &y,
+                const vector<double> &z, Mesh *mesh) {
+  uint32_t first = (uint32_t) mesh->owned_vertices.size();
+  for (size_t i = 0; i < x.size(); ++i) {
+    MeshVertex v;
+    memset(v.normal, 0, sizeof(v.normal));
+    v.position[0] = (float) x[i];
+    v.position[1] = (float) y[i];
+    v.position[2] = (float) z[i];
+    mesh->owned_vertices.push_back(v);
+  }
+  for (uint32_t i = 2; i < x.size(); ++i) {
+    mesh->owned_indices.push_back(first);
+    mesh->owned_indices.push_back(first + i - 1);
+    mesh->owned_indices.push_back(first + i);
+  }
+}
+
+// Triangle data in structure-of-arrays form, for the SIMD loops.
+struct TriangleArrays {
+  vector<float> ax, ay, az, bx, by, bz, cx, cy, cz;  // Corners.
+  vector<float> nx, ny, nz;  // Area-weighted normals (twice the area long).
+  vector<float> ux, uy, uz;  // Unit normals.
+
+  void resize(size_t n) {
+    vector<float> *arrays[] = { &ax, &ay, &az, &bx, &by, &bz, &cx, &cy, &cz,
+                                &nx, &ny, &nz, &ux, &uy, &uz };
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i) {
+      arrays[i]->assign(n, 0.0f);
+    }
+  }
+};
+
+// Computes the area-weighted normals of triangles [begin, end). The models
+// wind their polygons clockwise, so the normal is (c - a) x (b - a).
+void FaceNormalsScalar(TriangleArrays *t, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    float e1x = t->bx[i] - t->ax[i], e1y = t->by[i] - t->ay[i],
+          e1z = t->bz[i] - t->az[i];
+    float e2x = t->cx[i] - t->ax[i], e2y = t->cy[i] - t->ay[i],
+          e2z = t->cz[i] - t->az[i];
+    t->nx[i] = e2y * e1z - e2z * e1y;
+    t->ny[i] = e2z * e1x - e2x * e1z;
+    t->nz[i] = e2x * e1y - e2y * e1x;
+  }
+}
+
+// Sets (ux, uy, uz) to (x, y, z) scaled to unit length, or to zero for a zero
+// vector, for elements [begin, end).
+void NormalizeScalar(const float *x, const float *y, const float *z,
+                     float *ux, float *uy, float *uz, size_t begin,
+                     size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+    float length = sqrtf(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+    float scale = length > 0 ? 1 / length : 0;
+    ux[i] = x[i] * scale;
+    uy[i] = y[i] * scale;
+    uz[i] = z[i] * scale;
+  }
+}
+
+#ifdef __SSE2__
+// SSE versions of the above, four triangles at a time. Return the number of
+// elements processed; the caller finishes any remainder with the scalar code.
+size_t FaceNormalsSse(TriangleArrays *t, size_t count) {
+  size_t n = count & ~(size_t) 3;
+  for (size_t i = 0; i < n; i += 4) {
+    __m128 ax = _mm_loadu_ps(&t->ax[i]), ay = _mm_loadu_ps(&t->ay[i]),
+           az = _mm_loadu_ps(&t->az[i]);
+    __m128 e1x = _mm_sub_ps(_mm_loadu_ps(&t->bx[i]), ax);
+    __m128 e1y = _mm_sub_ps(_mm_loadu_ps(&t->by[i]), ay);
+    __m128 e1z = _mm_sub_ps(_mm_loadu_ps(&t->bz[i]), az);
+    __m128 e2x = _mm_sub_ps(_mm_loadu_ps(&t->cx[i]), ax);
+    __m128 e2y = _mm_sub_ps(_mm_loadu_ps(&t->cy[i]), ay);
+    __m128 e2z = _mm_sub_ps(_mm_loadu_ps(&t->cz[i]), az);
+    _mm_storeu_ps(&t->nx[i], _mm_sub_ps(_mm_mul_ps(e2y, e1z),
+                                        _mm_mul_ps(e2z, e1y)));
+    _mm_storeu_ps(&t->ny[i], _mm_sub_ps(_mm_mul_ps(e2z, e1x),
+                                        _mm_mul_ps(e2x, e1z)));
+    _mm_storeu_ps(&t->nz[i], _mm_sub_ps(_mm_mul_ps(e2x, e1y),
+                                        _mm_mul_ps(e2y, e1x)));
+  }
+  return n;
+}
+
+size_t NormalizeSse(const float *x, const float *y, const float *z,
+                    float *ux, float *uy, float *uz, size_t count) {
+  size_t n = count & ~(size_t) 3;
+  const __m128 kZero = _mm_setzero_ps(), kOne = _mm_set1_ps(1.0f);
+  for (size_t i = 0; i < n; i += 4) {
+    __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i),
+           vz = _mm_loadu_ps(z + i);
+    __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx),
+                                                      _mm_mul_ps(vy, vy)),
+                                           _mm_mul_ps(vz, vz)));
+    __m128 scale = _mm_and_ps(_mm_div_ps(kOne, length),
+                              _mm_cmpgt_ps(length, kZero));
+    _mm_storeu_ps(ux + i, _mm_mul_ps(vx, scale));
+    _mm_storeu_ps(uy + i, _mm_mul_ps(vy, scale));
+    _mm_storeu_ps(uz + i, _mm_mul_ps(vz, scale));
+  }
+  return n;
+}
+#endif  // __SSE2__
+
+void FaceNormals(TriangleArrays *t, size_t count) {
+  size_t done = 0;
+#ifdef __SSE2__
+  done = FaceNormalsSse(t, count);
+#endif
+  FaceNormalsScalar(t, done, count);
+}
+
+void Normalize(const float *x, const float *y, const float *z, float *ux,
+               float *uy, float *uz, size_t count) {
+  size_t done = 0;
+#ifdef __SSE2__
+  done = NormalizeSse(x, y, z, ux, uy, uz, count);
+#endif
+  NormalizeScalar(x, y, z, ux, uy, uz, done, count);
+}
+
+// Key for welding: positions are snapped to a grid MESH_WELD_TOLERANCE wide.
+struct WeldKey {
+  int64_t x, y, z;
+  bool operator==(const WeldKey &other) const {
+    return x == other.x && y == other.y && z == other.z;
+  }
+};
+
+struct WeldKeyHash {
+  size_t operator()(const WeldKey &k) const {
+    return (size_t) ((k.x * 73856093) ^ (k.y * 19349663) ^ (k.z * 83492791));
+  }
+};
+
+WeldKey MakeWeldKey(const float p[3]) {
+  WeldKey key = { llround(p[0] / MESH_WELD_TOLERANCE),
+                  llround(p[1] / MESH_WELD_TOLERANCE),
+                  llround(p[2] / MESH_WELD_TOLERANCE) };
+  return key;
+}
+
+inline size_t Align4(size_t n) { return (n + 3) & ~(size_t) 3; }
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+// Points the public arrays at the owned vectors (after filling them).
+//------------------------------------------------------------------------------
+void Mesh::adoptOwnedData() {
+  vertices = owned_vertices.empty() ? NULL : &owned_vertices[0];
+  indices = owned_indices.empty() ? NULL : &owned_indices[0];
+  vertex_count = (uint32_t) owned_vertices.size();
+  index_count = (uint32_t) owned_indices.size();
+}
+
+const char *PieceModelName(int type) {
+  static const char *kNames[NUM_PIECE_MODELS] = {
+    "PAWN", "ROOK", "BISHOP", "KNIGHT", "QUEEN", "KING"
+  };
+  return kNames[type - PAWN];
+}
+
+void PolFileName(int type, char *buffer, size_t size) {
+  snprintf(buffer, size, "%s/%s.POL", MODEL_DIRECTORY, PieceModelName(type));
+}
+
+//------------------------------------------------------------------------------
+// Welds vertices that share a position and gives each vertex the area-weighted
+// average normal of the triangles around it, leaving out triangles that meet
+// it at more than "crease_angle" degrees so that sharp edges stay sharp.
+// Vertices on either side of a crease keep separate copies.
+//------------------------------------------------------------------------------
+void SmoothMesh(Mesh *mesh, double crease_angle) {
+  const vector<MeshVertex> &in_vertices = mesh->owned_vertices;
+  const vector<uint32_t> &in_indices = mesh->owned_indices;
+  size_t triangle_count = in_indices.size() / 3;
+
+  // Weld positions:
+  unordered_map<WeldKey, uint32_t, WeldKeyHash> welded;
+  vector<uint32_t> corner_position(in_indices.size());
+  vector<const float *> positions;
+  for (size_t i = 0; i < in_indices.size(); ++i) {
+    const float *p = in_vertices[in_indices[i]].position;
+    auto inserted = welded.insert(make_pair(MakeWeldKey(p),
+                                            (uint32_t) positions.size()));
+    if (inserted.second) {
+      positions.push_back(p);
+    }
+    corner_position[i] = inserted.first->second;
+  }
+
+  // Face normals, in one vectorized pass:
+  TriangleArrays t;
+  t.resize(triangle_count);
+  for (size_t i = 0; i < triangle_count; ++i) {
+    const float *a = positions[corner_position[i * 3]];
+    const float *b = positions[corner_position[i * 3 + 1]];
+    const float *c = positions[corner_position[i * 3 + 2]];
+    t.ax[i] = a[0]; t.ay[i] = a[1]; t.az[i] = a[2];
+    t.bx[i] = b[0]; t.by[i] = b[1]; t.bz[i] = b[2];
+    t.cx[i] = c[0]; t.cy[i] = c[1]; t.cz[i] = c[2];
+  }
+  FaceNormals(&t, triangle_count);
+  Normalize(t.nx.data(), t.ny.data(), t.nz.data(), t.ux.data(), t.uy.data(),
+            t.uz.data(), triangle_count);
+
+  // The triangles around each welded position (compressed row storage):
+  vector<uint32_t> first(positions.size() + 1, 0);
+  for (size_t i = 0; i < corner_position.size(); ++i) {
+    ++first[corner_position[i] + 1];
+  }
+  for (size_t i = 1; i < first.size(); ++i) {
+    first[i] += first[i - 1];
+  }
+  vector<uint32_t> around(corner_position.size());
+  vector<uint32_t> fill(first.begin(), first.end() - 1);
+  for (size_t i = 0; i < corner_position.size(); ++i) {
+    around[fill[corner_position[i]]++] = (uint32_t) (i / 3);
+  }
+
+  // Sum the normals at each corner:
+  float min_cosine = (float) cos(crease_angle * M_PI / 180);
+  size_t corners = corner_position.size();
+  vector<float> sx(corners), sy(corners), sz(corners);
+  for (size_t i = 0; i < corners; ++i) {
+    size_t tri = i / 3;
+    uint32_t p = corner_position[i];
+    float x = 0, y = 0, z = 0;
+    for (uint32_t k = first[p]; k < first[p + 1]; ++k) {
+      uint32_t other = around[k];
+      if (t.ux[tri] * t.ux[other] + t.uy[tri] * t.uy[other] +
+          t.uz[tri] * t.uz[other] >= min_cosine) {
+        x += t.nx[other];
+        y += t.ny[other];
+        z += t.nz[other];
+      }
+    }
+    sx[i] = x;
+    sy[i] = y;
+    sz[i] = z;
+  }
+  Normalize(sx.data(), sy.data(), sz.data(), sx.data(), sy.data(), sz.data(),
+            corners);
+
+  // Emit one vertex per distinct (position, normal) pair:
+  vector<MeshVertex> vertices;
+  vector<uint32_t> indices(corners);
+  vector<vector<uint32_t> > emitted(positions.size());
+  for (size_t i = 0; i < corners; ++i) {
+    MeshVertex v;
+    memcpy(v.position, positions[corner_position[i]], sizeof(v.position));
+    v.normal[0] = sx[i];
+    v.normal[1] = sy[i];
+    v.normal[2] = sz[i];
+    vector<uint32_t> &candidates = emitted[corner_position[i]];
+    uint32_t index = UINT32_MAX;
+    for (size_t k = 0; k < candidates.size(); ++k) {
+      if (memcmp(vertices[candidates[k]].normal, v.normal,
+                 sizeof(v.normal)) == 0) {
+        index = candidates[k];
+        break;
+      }
+    }
+    if (index == UINT32_MAX) {
+      index = (uint32_t) vertices.size();
+      vertices.push_back(v);
+      candidates.push_back(index);
+    }
+    indices[i] = index;
+  }
+  mesh->owned_vertices.swap(vertices);
+  mesh->owned_indices.swap(indices);
+  mesh->adoptOwnedData();
+}
+
+//------------------------------------------------------------------------------
+// Parses an ASCII .POL model: one "x, y, z" point per line, with polygons
+// separated by empty lines. The result is welded and smooth-shaded (see
+// SmoothMesh()). Returns false if the file cannot be read, is malformed (e.g.,
+// a polygon with fewer than three points) or holds no polygons.
+//------------------------------------------------------------------------------
+bool LoadPolMesh(const char *filename, Mesh *mesh) {
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL) {
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  vector<char> text(size + 1);
+  size_t read = fread(&text[0], 1, size, file);
+  fclose(file);
+  text[read] = '\0';
+
+  mesh->owned_vertices.clear();
+  mesh->owned_indices.clear();
+  vector<double> x, y, z;  // The current polygon.
+  char *p = &text[0];
+  while (*p) {
+    char *line_end = strchr(p, '\n');
+    if (line_end == NULL) {
+      line_end = p + strlen(p);
+    }
+    char *end;
+    double px = strtod(p, &end);
+    bool ok = p != line_end && end != p && *end == ',';
+    double py = ok ? strtod(end + 1, &end) : 0;
+    ok = ok && *end == ',';
+    double pz = ok ? strtod(end + 1, &end) : 0;
+    ok = ok && end <= line_end;
+    if (ok) {
+      x.push_back(px);
+      y.push_back(py);
+      z.push_back(pz);
+    } else if (!x.empty()) {  // Empty line: finish the current polygon.
+      if (x.size() < 3) {
+        break;
+      }
+      AddPolygon(x, y, z, mesh);
+      x.clear();
+      y.clear();
+      z.clear();
+    }
+    p = *line_end ? line_end + 1 : line_end;
+  }
+  if (x.size() >= 3) {
+    AddPolygon(x, y, z, mesh);
+  } else if (!x.empty()) {
+    fprintf(stderr, "Error: polygon with fewer than 3 vertices in file %s\n",
+            filename);
+    return false;
+  }
+  if (mesh->owned_indices.empty()) {
+    fprintf(stderr, "Error: no polygons in file %s\n", filename);
+    return false;
+  }
+  SmoothMesh(mesh, MESH_CREASE_ANGLE);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Packs all piece meshes into a single file that MappedMeshFile can use
+// directly.
+//------------------------------------------------------------------------------
+bool WriteMeshFile(const char *filename,
+                   const Mesh meshes[NUM_PIECE_MODELS]) {
+  MeshFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MESH_FILE_MAGIC;
+  header.version = MESH_FILE_VERSION;
+  header.model_count = NUM_PIECE_MODELS;
+  size_t offset = Align4(sizeof(header));
+  for (int i = 0; i < NUM_PIECE_MODELS; ++i) {
+    MeshFileEntry &entry = header.models[i];
+    entry.vertex_offset = (uint32_t) offset;
+    entry.vertex_count = meshes[i].vertex_count;
+    offset += Align4(meshes[i].vertex_count * sizeof(MeshVertex));
+    entry.index_offset = (uint32_t) offset;
+    entry.index_count = meshes[i].index_count;
+    offset += Align4(meshes[i].index_count * sizeof(uint32_t));
+  }
+  header.file_size = (uint32_t) offset;
+
+  vector<unsigned char> data(offset, 0);
+  memcpy(&data[0], &header, sizeof(header));
+  for (int i = 0; i < NUM_PIECE_MODELS; ++i) {
+    const MeshFileEntry &entry = header.models[i];
+    if (entry.vertex_count) {
+      memcpy(&data[entry.vertex_offset], meshes[i].vertices,
+             entry.vertex_count * sizeof(MeshVertex));
+    }
+    if (entry.index_count) {
+      memcpy(&data[entry.index_offset], meshes[i].indices,
+             entry.index_count * sizeof(uint32_t));
+    }
+  }
+
+  // Write to a temporary file first so a reader never maps a partial file:
+  string temp = string(filename) + ".tmp";
+  FILE *file = fopen(temp.c_str(), "wb");
+  if (file == NULL) {
+    return false;
+  }
+  bool ok = fwrite(&data[0], 1, data.size(), file) == data.size();
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(temp.c_str(), filename) != 0) {
+    remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Loads and processes all six .POL models and writes them to a packed mesh
+// file.
+//------------------------------------------------------------------------------
+bool BuildMeshFile(const char *filename) {
+  Mesh meshes[NUM_PIECE_MODELS];
+  for (int type = PAWN; type < NUM_CHESS_PIECE_TYPES; ++type) {
+    char pol_file[64];
+    PolFileName(type, pol_file, sizeof(pol_file));
+    if (!LoadPolMesh(pol_file, &meshes[type - PAWN])) {
+      fprintf(stderr, "Error: could not load %s\n", pol_file);
+      return false;
+    }
+  }
+  return WriteMeshFile(filename, meshes);
+}
+
+//------------------------------------------------------------------------------
+// Returns true if "filename" exists and is newer than every .POL model.
+//------------------------------------------------------------------------------
+bool IsMeshFileCurrent(const char *filename) {
+  struct stat cache;
+  if (stat(filename, &cache) != 0) {
+    return false;
+  }
+  for (int type = PAWN; type < NUM_CHESS_PIECE_TYPES; ++type) {
+    char pol_file[64];
+    struct stat model;
+    PolFileName(type, pol_file, sizeof(pol_file));
+    if (stat(pol_file, &model) == 0 && model.st_mtime > cache.st_mtime) {
+      return false;
+    }
+  }
+  return true;
+}
+
+MappedMeshFile::MappedMeshFile() : data_(NULL), size_(0) {}
+
+MappedMeshFile::~MappedMeshFile() {
+  close();
+}
+
+//------------------------------------------------------------------------------
+// Maps a packed mesh file into memory and validates its header and offsets.
+//------------------------------------------------------------------------------
+bool MappedMeshFile::open(const char *filename) {
+  close();
+  if (!file_.open(filename) || file_.size() < sizeof(MeshFileHeader)) {
+    file_.close();
+    return false;
+  }
+  data_ = file_.data();
+  size_ = file_.size();
+
+  const MeshFileHeader *header = (const MeshFileHeader *) data_;
+  bool ok = header->magic == MESH_FILE_MAGIC &&
+            header->version == MESH_FILE_VERSION &&
+            header->file_size == size_ &&
+            header->model_count == NUM_PIECE_MODELS;
+  for (int i = 0; ok && i < NUM_PIECE_MODELS; ++i) {
+    const MeshFileEntry &entry = header->models[i];
+    ok = entry.vertex_offset % 4 == 0 && entry.index_offset % 4 == 0 &&
+         entry.vertex_offset + (uint64_t) entry.vertex_count *
+             sizeof(MeshVertex) <= size_ &&
+         entry.index_offset + (uint64_t) entry.index_count *
+             sizeof(uint32_t) <= size_;
+    const uint32_t *indices = (const uint32_t *) (data_ + entry.index_offset);
+    for (uint32_t j = 0; ok && j < entry.index_count; ++j) {
+      ok = indices[j] < entry.vertex_count;
+    }
+  }
+  if (!ok) {
+    close();
+  }
+  return ok;
+}
+
+void MappedMeshFile::close() {
+  file_.close();
+  data_ = NULL;
+  size_ = 0;
+}
+
+//------------------------------------------------------------------------------
+// Points "mesh" at the mapped data for one piece type (no copying).
+//------------------------------------------------------------------------------
+bool MappedMeshFile::getMesh(int type, Mesh *mesh) const {
+  if (!data_) {
+    return false;
+  }
+  const MeshFileEntry &entry =
+      ((const MeshFileHeader *) data_)->models[type - PAWN];
+  mesh->owned_vertices.clear();
+  mesh->owned_indices.clear();
+  mesh->vertices = (const MeshVertex *) (data_ + entry.vertex_offset);
+  mesh->indices = (const uint32_t *) (data_ + entry.index_offset);
+  mesh->vertex_count = entry.vertex_count;
+  mesh->index_count = entry.index_count;
+  return true;
+}
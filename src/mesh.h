@@ -0,0 +1,93 @@
+/*******************************************************************************
+   Filename: mesh.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Chess piece meshes: the ASCII .POL model parser (which welds
+             the polygons into smooth-shaded indexed meshes), and a packed
+             binary format (all six processed models in one file) that is
+             memory-mapped at startup and used in place, with no parsing.
+*******************************************************************************/
+
+#ifndef MESH_H_
+#define MESH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "chess_piece.h"
+#include "mapped_file.h"
+
+#define NUM_PIECE_MODELS    (NUM_CHESS_PIECE_TYPES - PAWN)
+#define MODEL_DIRECTORY     "models"
+#ifndef PACKED_MESH_FILE  // The CMake build keeps it in the build directory.
+#define PACKED_MESH_FILE    "models/pieces.mesh"
+#endif
+#define MESH_FILE_MAGIC     0x4853454D  // "MESH" when read as little-endian.
+#define MESH_FILE_VERSION   2
+#define MESH_CREASE_ANGLE   60    // Degrees; sharper edges are not smoothed.
+#define MESH_WELD_TOLERANCE 0.01  // Points this close are merged.
+
+// Matches OpenGL's GL_N3F_V3F interleaved layout.
+struct MeshVertex {
+  float normal[3];
+  float position[3];
+};
+
+// One model's geometry as indexed triangles. The arrays either point into a
+// mapped mesh file or at the owned_* vectors.
+struct Mesh {
+  const MeshVertex *vertices;
+  const uint32_t *indices;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  std::vector<MeshVertex> owned_vertices;
+  std::vector<uint32_t> owned_indices;
+
+  Mesh() : vertices(NULL), indices(NULL), vertex_count(0), index_count(0) {}
+  void adoptOwnedData();
+};
+
+// On-disk layout: a MeshFileHeader, then each model's vertex and index
+// arrays. Offsets are in bytes from the start of the file and are 4-byte
+// aligned.
+struct MeshFileEntry {
+  uint32_t vertex_offset;
+  uint32_t vertex_count;
+  uint32_t index_offset;
+  uint32_t index_count;
+};
+
+struct MeshFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t file_size;
+  uint32_t model_count;
+  MeshFileEntry models[NUM_PIECE_MODELS];  // Indexed by (type - PAWN).
+};
+
+// Read-only memory mapping of a packed mesh file.
+class MappedMeshFile {
+ public:
+  MappedMeshFile();
+  ~MappedMeshFile();
+  bool open(const char *filename);
+  void close();
+  bool isOpen() const { return data_ != NULL; }
+  bool getMesh(int type, Mesh *mesh) const;
+
+ private:
+  MappedFile file_;
+  const unsigned char *data_;  // file_'s contents once validated.
+  size_t size_;
+};
+
+const char *PieceModelName(int type);
+void PolFileName(int type, char *buffer, size_t size);
+bool LoadPolMesh(const char *filename, Mesh *mesh);
+void SmoothMesh(Mesh *mesh, double crease_angle);
+bool WriteMeshFile(const char *filename, const Mesh meshes[NUM_PIECE_MODELS]);
+bool BuildMeshFile(const char *filename);
+bool IsMeshFileCurrent(const char *filename);
+
+#endif  // MESH_H_
@@ -0,0 +1,252 @@
+/*******************************************************************************
+   Filename: movepick.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Method definitions for the MovePicker class, plus the static
+             exchange evaluator.
+*******************************************************************************/
+
+#include "movepick.h"
+
+#include <algorithm>
+#include "evaluate.h"
+
+using namespace std;
+
+namespace {
+
+enum Stage {
+  TT_MOVE,
+  GENERATE_CAPTURES,
+  GOOD_CAPTURES,
+  REFUTATIONS,
+  GENERATE_QUIETS,
+  QUIETS,
+  BAD_CAPTURES,
+  DONE
+};
+
+// Least valuable first, the order in which exchanges recapture:
+const int kAttackerOrder[] = { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+// Plays out the exchange on the target square as a swap list, keeping only the
+// running balance: after each capture, the side to recapture checks whether
+// doing so could still leave it ahead of the threshold, and stops if not.
+//------------------------------------------------------------------------------
+bool See(const Position &pos, Move m, int threshold) {
+  int flag = FlagOf(m);
+  if (flag != QUIET_MOVE && flag != DOUBLE_PAWN_PUSH && flag != CAPTURE) {
+    return threshold <= 0;
+  }
+  int from = FromSquare(m), to = ToSquare(m);
+  int victim = pos.pieceOn(to);
+  int balance = (victim == NO_PIECE ? 0 : PieceValue(TypeOf(victim))) -
+                threshold;
+  if (balance < 0) {
+    return false;  // Even a free capture falls short.
+  }
+  balance = PieceValue(TypeOf(pos.pieceOn(from))) - balance;
+  if (balance <= 0) {
+    return true;  // Still ahead after losing the capturing piece.
+  }
+
+  Bitboard occupied = pos.pieces() ^ SquareBB(from);
+  Bitboard attackers = pos.attackersTo(to, occupied);
+  Bitboard diagonal = pos.piecesOfType(BISHOP) | pos.piecesOfType(QUEEN);
+  Bitboard straight = pos.piecesOfType(ROOK) | pos.piecesOfType(QUEEN);
+  int side = pos.sideToMove();
+  int result = 1;
+  while (true) {
+    side ^= 1;
+    attackers &= occupied;
+    Bitboard ours = attackers & pos.pieces(side);
+    if (!ours) {
+      break;
+    }
+    result ^= 1;
+
+    int type = KING;
+    Bitboard candidates = 0;
+    for (int i = 0; i < 5; ++i) {
+      candidates = ours & pos.piecesOfType(kAttackerOrder[i]);
+      if (candidates) {
+        type = kAttackerOrder[i];
+        break;
+      }
+    }
+    if (type == KING) {
+      // The king may only take last, when nothing can take it back:
+      return (attackers & ~pos.pieces(side)) ? result ^ 1 : result;
+    }
+    balance = PieceValue(type) - balance;
+    if (balance < result) {
+      break;
+    }
+    occupied ^= SquareBB(LowestSquare(candidates));
+    // Removing the piece may uncover a slider behind it:
+    if (type == PAWN || type == BISHOP || type == QUEEN) {
+      attackers |= BishopAttacks(to, occupied) & diagonal;
+    }
+    if (type == ROOK || type == QUEEN) {
+      attackers |= RookAttacks(to, occupied) & straight;
+    }
+  }
+  return result;
+}
+
+MovePicker::MovePicker(const Position &pos, Move tt_move,
+                       const Move killers[2], Move countermove,
+                       const ButterflyHistory &history)
+    : pos_(pos), history_(history),
+      tt_move_(pos.isPseudoLegal(tt_move) ? tt_move : NO_MOVE),
+      stage_(TT_MOVE), current_(0), end_(0), bad_captures_(0),
+      skip_quiets_(false) {
+  refutations_[0] = killers[0];
+  refutations_[1] = killers[1];
+  refutations_[2] = countermove == killers[0] || countermove == killers[1] ?
+                    NO_MOVE : countermove;
+}
+
+MovePicker::MovePicker(const Position &pos, const ButterflyHistory &history)
+    : pos_(pos), history_(history), tt_move_(NO_MOVE),
+      stage_(GENERATE_CAPTURES), current_(0), end_(0), bad_captures_(0),
+      skip_quiets_(!pos.inCheck()) {
+  refutations_[0] = refutations_[1] = refutations_[2] = NO_MOVE;
+}
+
+//------------------------------------------------------------------------------
+// Advances through the stages described in movepick.h. Generated moves share
+// one buffer: losing captures are moved to its front as they turn up, and the
+// quiet moves are generated behind them.
+//------------------------------------------------------------------------------
+Move MovePicker::next() {
+  while (true) {
+    switch (stage_) {
+      case TT_MOVE:
+        stage_ = GENERATE_CAPTURES;
+        if (tt_move_ != NO_MOVE) {
+          return tt_move_;
+        }
+        break;
+
+      case GENERATE_CAPTURES:
+        GenerateMoves(pos_, GEN_CAPTURES, &moves_);
+        current_ = 0;
+        end_ = moves_.size;
+        scoreCaptures();
+        stage_ = GOOD_CAPTURES;
+        break;
+
+      case GOOD_CAPTURES:
+        while (current_ < end_) {
+          Move m = nextBest();
+          if (m == tt_move_) {
+            continue;
+          }
+          if (See(pos_, m, 0)) {
+            return m;
+          }
+          moves_.moves[bad_captures_++] = m;
+        }
+        current_ = 0;
+        // The quiescence search has no use for losing captures:
+        stage_ = skip_quiets_ ? DONE : REFUTATIONS;
+        break;
+
+      case REFUTATIONS:
+        // Killers and countermoves are quiet moves from other positions:
+        while (current_ < 3) {
+          Move m = refutations_[current_++];
+          if (m != NO_MOVE && m != tt_move_ && !IsCapture(m) &&
+              pos_.isPseudoLegal(m)) {
+            return m;
+          }
+        }
+        stage_ = GENERATE_QUIETS;
+        break;
+
+      case GENERATE_QUIETS:
+        moves_.size = bad_captures_;
+        GenerateMoves(pos_, GEN_QUIETS, &moves_);
+        current_ = bad_captures_;
+        end_ = moves_.size;
+        scoreQuiets();
+        stage_ = QUIETS;
+        break;
+
+      case QUIETS:
+        while (current_ < end_) {
+          Move m = moves_.moves[current_++];
+          if (m != tt_move_ && !isRefutation(m)) {
+            return m;
+          }
+        }
+        current_ = 0;
+        end_ = bad_captures_;
+        stage_ = BAD_CAPTURES;
+        break;
+
+      case BAD_CAPTURES:
+        if (current_ < end_) {
+          return moves_.moves[current_++];
+        }
+        stage_ = DONE;
+        break;
+
+      default:
+        return NO_MOVE;
+    }
+  }
+}
+
+// Selects the best-scored move left in the current range. Captures are few
+// and usually only the first is needed, so sorting them all would be wasted.
+Move MovePicker::nextBest() {
+  int best = current_;
+  for (int i = current_ + 1; i < end_; ++i) {
+    if (scores_[i] > scores_[best]) {
+      best = i;
+    }
+  }
+  swap(moves_.moves[current_], moves_.moves[best]);
+  swap(scores_[current_], scores_[best]);
+  return moves_.moves[current_++];
+}
+
+// Most valuable victim, then least valuable attacker; promotions add the
+// value of the new piece.
+void MovePicker::scoreCaptures() {
+  for (int i = current_; i < end_; ++i) {
+    Move m = moves_.moves[i];
+    int victim = FlagOf(m) == EN_PASSANT || !IsCapture(m) ? PAWN :
+                 TypeOf(pos_.pieceOn(ToSquare(m)));
+    int attacker = TypeOf(pos_.pieceOn(FromSquare(m)));
+    scores_[i] = PieceValue(victim) * 8 - PieceValue(attacker) / 8 +
+                 (IsPromotion(m) ? PieceValue(PromotionType(m)) : 0);
+  }
+}
+
+// Sorts the quiet moves by history once, with an insertion sort that keeps
+// the generation order among equal scores.
+void MovePicker::scoreQuiets() {
+  for (int i = current_; i < end_; ++i) {
+    Move m = moves_.moves[i];
+    int score = history_[FromSquare(m)][ToSquare(m)];
+    int j = i;
+    for (; j > current_ && scores_[j - 1] < score; --j) {
+      moves_.moves[j] = moves_.moves[j - 1];
+      scores_[j] = scores_[j - 1];
+    }
+    moves_.moves[j] = m;
+    scores_[j] = score;
+  }
+}
+
+bool MovePicker::isRefutation(Move m) const {
+  return m == refutations_[0] || m == refutations_[1] ||
+         m == refutations_[2];
+}
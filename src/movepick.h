@@ -0,0 +1,73 @@
+/*******************************************************************************
+   Filename: movepick.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the MovePicker class, which hands the search one
+             move at a time, best first, generating each kind of move only
+             when the previous ones have failed to cause a cutoff: the hash
+             move (no generation at all), then captures that win or break
+             even by static exchange, then the killers and the countermove,
+             then quiet moves sorted by history, and last the losing
+             captures. Most cutoffs come from the first move or two, so most
+             nodes never generate quiet moves. Also declares the static
+             exchange evaluator used to split the captures.
+*******************************************************************************/
+
+#ifndef MOVEPICK_H_
+#define MOVEPICK_H_
+
+#include <cstdint>
+#include "position.h"
+
+// Success rates of quiet moves, [from][to] for one color. Entries stay within
+// +/-16384 (see UpdateHistory() in search.cc), so 16 bits suffice and both
+// colors' tables take 16 KB, small enough to stay in the L1 cache.
+typedef int16_t ButterflyHistory[NUM_SQUARES][NUM_SQUARES];
+
+// The quiet move that last refuted each move, indexed by the piece that
+// moved and its destination.
+typedef Move CountermoveTable[NUM_PIECES][NUM_SQUARES];
+
+// Tests whether the exchange that "m" starts on its target square gains at
+// least "threshold" centipawns for the mover when both sides recapture with
+// their least valuable piece and may stop whenever they like. Pins are not
+// considered. Castling, en passant and promotions count as even exchanges.
+bool See(const Position &pos, Move m, int threshold);
+
+class MovePicker {
+ public:
+  // For the main search. "killers" and "countermove" may hold moves that are
+  // not pseudo-legal here; they are checked before being returned.
+  MovePicker(const Position &pos, Move tt_move, const Move killers[2],
+             Move countermove, const ButterflyHistory &history);
+
+  // For the quiescence search: captures and queen promotions that do not
+  // lose material by static exchange, or every move when in check.
+  MovePicker(const Position &pos, const ButterflyHistory &history);
+
+  // Returns the next pseudo-legal move, or NO_MOVE when there are no more.
+  Move next();
+
+ private:
+  Move nextBest();
+  void scoreCaptures();
+  void scoreQuiets();
+  bool isRefutation(Move m) const;
+
+  const Position &pos_;
+  const ButterflyHistory &history_;
+  Move tt_move_;
+  Move refutations_[3];  // The two killers and the countermove.
+  int stage_;
+  int current_, end_;
+  int bad_captures_;  // Losing captures kept at the front of "moves_".
+  bool skip_quiets_;
+  MoveList moves_;
+  int scores_[MAX_MOVES];
+
+  MovePicker(const MovePicker &);
+  MovePicker &operator=(const MovePicker &);
+};
+
+#endif  // MOVEPICK_H_
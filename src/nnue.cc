@@ -0,0 +1,422 @@
+/*******************************************************************************
+   Filename: nnue.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Method definitions for the Network class, and the vector kernels
+             it runs on: plain C++ versions that work anywhere, plus AVX2 and
+             SSE4.1 versions compiled with function target attributes (so the
+             build needs no special flags) and picked once at startup from
+             what the CPU supports.
+*******************************************************************************/
+
+#include "nnue.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NNUE_X86 1
+#endif
+
+using namespace std;
+
+namespace {
+
+// out = in + the "added" rows - the "removed" rows, over NNUE_HALF_DIMS
+// values. "out" may be "in". Sums wrap like the vector instructions do; a
+// well-trained network never gets near the limits.
+typedef void (*UpdateKernel)(int16_t *out, const int16_t *in,
+                             const int16_t *const *added, int num_added,
+                             const int16_t *const *removed, int num_removed);
+
+// Clips NNUE_HALF_DIMS sums to 0..127.
+typedef void (*ClipKernel)(const int16_t *in, uint8_t *out);
+
+// Dot product of "size" (a multiple of 32) activations and weights.
+typedef int32_t (*DotKernel)(const uint8_t *in, const int8_t *weights,
+                             int size);
+
+struct Kernels {
+  const char *name;
+  UpdateKernel update;
+  ClipKernel clip;
+  DotKernel dot;
+};
+
+void UpdateScalar(int16_t *out, const int16_t *in,
+                  const int16_t *const *added, int num_added,
+                  const int16_t *const *removed, int num_removed) {
+  if (out != in) {
+    memcpy(out, in, NNUE_HALF_DIMS * sizeof(int16_t));
+  }
+  for (int j = 0; j < num_added; ++j) {
+    for (int i = 0; i < NNUE_HALF_DIMS; ++i) {
+      out[i] = (int16_t) (out[i] + added[j][i]);
+    }
+  }
+  for (int j = 0; j < num_removed; ++j) {
+    for (int i = 0; i < NNUE_HALF_DIMS; ++i) {
+      out[i] = (int16_t) (out[i] - removed[j][i]);
+    }
+  }
+}
+
+void ClipScalar(const int16_t *in, uint8_t *out) {
+  for (int i = 0; i < NNUE_HALF_DIMS; ++i) {
+    out[i] = (uint8_t) min(max((int) in[i], 0), 127);
+  }
+}
+
+int32_t DotScalar(const uint8_t *in, const int8_t *weights, int size) {
+  int32_t sum = 0;
+  for (int i = 0; i < size; ++i) {
+    sum += in[i] * weights[i];
+  }
+  return sum;
+}
+
+const Kernels kScalarKernels = {
+  "scalar", UpdateScalar, ClipScalar, DotScalar
+};
+
+#ifdef NNUE_X86
+
+__attribute__((target("avx2")))
+void UpdateAvx2(int16_t *out, const int16_t *in,
+                const int16_t *const *added, int num_added,
+                const int16_t *const *removed, int num_removed) {
+  for (int i = 0; i < NNUE_HALF_DIMS; i += 16) {
+    __m256i sum = _mm256_loadu_si256((const __m256i *) (in + i));
+    for (int j = 0; j < num_added; ++j) {
+      sum = _mm256_add_epi16(
+          sum, _mm256_loadu_si256((const __m256i *) (added[j] + i)));
+    }
+    for (int j = 0; j < num_removed; ++j) {
+      sum = _mm256_sub_epi16(
+          sum, _mm256_loadu_si256((const __m256i *) (removed[j] + i)));
+    }
+    _mm256_storeu_si256((__m256i *) (out + i), sum);
+  }
+}
+
+__attribute__((target("avx2")))
+void ClipAvx2(const int16_t *in, uint8_t *out) {
+  const __m256i kMax = _mm256_set1_epi8(127);
+  for (int i = 0; i < NNUE_HALF_DIMS; i += 32) {
+    __m256i low = _mm256_loadu_si256((const __m256i *) (in + i));
+    __m256i high = _mm256_loadu_si256((const __m256i *) (in + i + 16));
+    // Packing works within 128-bit lanes; the permute restores the order.
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high),
+                                              0xD8);
+    _mm256_storeu_si256((__m256i *) (out + i), _mm256_min_epu8(packed, kMax));
+  }
+}
+
+__attribute__((target("avx2")))
+int32_t DotAvx2(const uint8_t *in, const int8_t *weights, int size) {
+  // Pairs of products cannot saturate: 2 * 127 * 128 < 32768.
+  const __m256i kOnes = _mm256_set1_epi16(1);
+  __m256i sum = _mm256_setzero_si256();
+  for (int i = 0; i < size; i += 32) {
+    __m256i products = _mm256_maddubs_epi16(
+        _mm256_loadu_si256((const __m256i *) (in + i)),
+        _mm256_loadu_si256((const __m256i *) (weights + i)));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, kOnes));
+  }
+  __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                _mm256_extracti128_si256(sum, 1));
+  total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4E));
+  total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xB1));
+  return _mm_cvtsi128_si32(total);
+}
+
+const Kernels kAvx2Kernels = { "avx2", UpdateAvx2, ClipAvx2, DotAvx2 };
+
+__attribute__((target("sse4.1")))
+void UpdateSse41(int16_t *out, const int16_t *in,
+                 const int16_t *const *added, int num_added,
+                 const int16_t *const *removed, int num_removed) {
+  for (int i = 0; i < NNUE_HALF_DIMS; i += 8) {
+    __m128i sum = _mm_loadu_si128((const __m128i *) (in + i));
+    for (int j = 0; j < num_added; ++j) {
+      sum = _mm_add_epi16(sum,
+                          _mm_loadu_si128((const __m128i *) (added[j] + i)));
+    }
+    for (int j = 0; j < num_removed; ++j) {
+      sum = _mm_sub_epi16(sum,
+                          _mm_loadu_si128((const __m128i *) (removed[j] + i)));
+    }
+    _mm_storeu_si128((__m128i *) (out + i), sum);
+  }
+}
+
+__attribute__((target("sse4.1")))
+void ClipSse41(const int16_t *in, uint8_t *out) {
+  const __m128i kMax = _mm_set1_epi8(127);
+  for (int i = 0; i < NNUE_HALF_DIMS; i += 16) {
+    __m128i packed = _mm_packus_epi16(
+        _mm_loadu_si128((const __m128i *) (in + i)),
+        _mm_loadu_si128((const __m128i *) (in + i + 8)));
+    _mm_storeu_si128((__m128i *) (out + i), _mm_min_epu8(packed, kMax));
+  }
+}
+
+__attribute__((target("sse4.1")))
+int32_t DotSse41(const uint8_t *in, const int8_t *weights, int size) {
+  const __m128i kOnes = _mm_set1_epi16(1);
+  __m128i sum = _mm_setzero_si128();
+  for (int i = 0; i < size; i += 16) {
+    __m128i products = _mm_maddubs_epi16(
+        _mm_loadu_si128((const __m128i *) (in + i)),
+        _mm_loadu_si128((const __m128i *) (weights + i)));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(products, kOnes));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+}
+
+const Kernels kSse41Kernels = { "sse4.1", UpdateSse41, ClipSse41, DotSse41 };
+
+#endif  // NNUE_X86
+
+const Kernels &SelectKernels() {
+#ifdef NNUE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return kAvx2Kernels;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return kSse41Kernels;
+  }
+#endif
+  return kScalarKernels;
+}
+
+const Kernels &kernels = SelectKernels();
+
+struct FileHeader {
+  char magic[4];  // "NNUE"
+  uint32_t version;
+  uint32_t features;
+  uint32_t half_dims;
+  uint32_t hidden1;
+  uint32_t hidden2;
+  char description[40];  // Padded with NULs.
+};
+
+// Returns where a section of "bytes" bytes starts and moves "offset" past it.
+size_t Section(size_t *offset, size_t bytes) {
+  size_t start = (*offset + 63) & ~(size_t) 63;
+  *offset = start + bytes;
+  return start;
+}
+
+// Runs a hidden layer: a clipped, rescaled affine transform of "in".
+void Propagate(const uint8_t *in, int in_size, const int8_t *weights,
+               const int32_t *biases, int out_size, uint8_t *out) {
+  for (int i = 0; i < out_size; ++i) {
+    int32_t sum = biases[i] + kernels.dot(in, weights + i * in_size, in_size);
+    out[i] = (uint8_t) min(max(sum >> NNUE_WEIGHT_SHIFT, 0), 127);
+  }
+}
+
+inline int Orient(int perspective, int square) {
+  return perspective == WHITE ? square : square ^ 56;  // Flip the ranks.
+}
+
+}  // namespace
+
+void AccumulatorStack::clear() {
+  for (int i = 0; i < NNUE_MAX_PLY; ++i) {
+    entries_[i].key = 0;
+  }
+}
+
+Network::Network()
+    : feature_biases_(NULL), feature_weights_(NULL), hidden1_biases_(NULL),
+      hidden1_weights_(NULL), hidden2_biases_(NULL), hidden2_weights_(NULL),
+      output_bias_(NULL), output_weights_(NULL) {}
+
+const char *Network::simdName() {
+  return kernels.name;
+}
+
+//------------------------------------------------------------------------------
+// Maps a network file. The weights are used where they lie in the mapping,
+// so the file must match the layout in nnue.h exactly.
+//------------------------------------------------------------------------------
+bool Network::load(const char *filename) {
+  unload();
+  if (!file_.open(filename)) {
+    return false;
+  }
+  FileHeader header;
+  if (file_.size() < sizeof(header)) {
+    unload();
+    return false;
+  }
+  memcpy(&header, file_.data(), sizeof(header));
+  if (memcmp(header.magic, "NNUE", 4) != 0 ||
+      header.version != NNUE_VERSION || header.features != NNUE_FEATURES ||
+      header.half_dims != NNUE_HALF_DIMS || header.hidden1 != NNUE_HIDDEN1 ||
+      header.hidden2 != NNUE_HIDDEN2) {
+    unload();
+    return false;
+  }
+
+  size_t offset = sizeof(header);
+  size_t feature_biases = Section(&offset, NNUE_HALF_DIMS * sizeof(int16_t));
+  size_t feature_weights = Section(
+      &offset, (size_t) NNUE_FEATURES * NNUE_HALF_DIMS * sizeof(int16_t));
+  size_t hidden1_biases = Section(&offset, NNUE_HIDDEN1 * sizeof(int32_t));
+  size_t hidden1_weights = Section(&offset,
+                                   NNUE_HIDDEN1 * 2 * NNUE_HALF_DIMS);
+  size_t hidden2_biases = Section(&offset, NNUE_HIDDEN2 * sizeof(int32_t));
+  size_t hidden2_weights = Section(&offset, NNUE_HIDDEN2 * NNUE_HIDDEN1);
+  size_t output_bias = Section(&offset, sizeof(int32_t));
+  size_t output_weights = Section(&offset, NNUE_HIDDEN2);
+  if (offset != file_.size()) {
+    unload();
+    return false;
+  }
+
+  const unsigned char *data = file_.data();
+  feature_biases_ = (const int16_t *) (data + feature_biases);
+  feature_weights_ = (const int16_t *) (data + feature_weights);
+  hidden1_biases_ = (const int32_t *) (data + hidden1_biases);
+  hidden1_weights_ = (const int8_t *) (data + hidden1_weights);
+  hidden2_biases_ = (const int32_t *) (data + hidden2_biases);
+  hidden2_weights_ = (const int8_t *) (data + hidden2_weights);
+  output_bias_ = (const int32_t *) (data + output_bias);
+  output_weights_ = (const int8_t *) (data + output_weights);
+  description_.assign(header.description,
+                      strnlen(header.description, sizeof(header.description)));
+  return true;
+}
+
+void Network::unload() {
+  file_.close();
+  description_.clear();
+}
+
+//------------------------------------------------------------------------------
+// Returns the weights of the feature for "piece" on "square", as seen by
+// "perspective" with its king on "king". Black sees the board flipped, so
+// both sides share the same weights.
+//------------------------------------------------------------------------------
+const int16_t *Network::featureWeights(int perspective, int king, int piece,
+                                       int square) const {
+  int kind = (piece & 7) * 2 + (ColorOf(piece) != perspective);
+  size_t index = ((size_t) Orient(perspective, king) * NNUE_PIECE_KINDS +
+                  kind) * NUM_SQUARES + Orient(perspective, square);
+  return feature_weights_ + index * NNUE_HALF_DIMS;
+}
+
+void Network::refresh(const Position &pos, int perspective,
+                      int16_t *values) const {
+  const int16_t *rows[NUM_SQUARES];
+  int count = 0;
+  int king = pos.kingSquare(perspective);
+  Bitboard b = pos.pieces() & ~pos.piecesOfType(KING);
+  while (b) {
+    int square = PopLowestSquare(b);
+    rows[count++] = featureWeights(perspective, king, pos.pieceOn(square),
+                                   square);
+  }
+  kernels.update(values, feature_biases_, rows, count, NULL, 0);
+}
+
+//------------------------------------------------------------------------------
+// Brings the accumulator at "ply" up to date. Starting from the nearest
+// earlier ply whose entry still matches the line being searched, it replays
+// the pieces each move changed, which is usually a single step of two or
+// three rows. A side whose king moved must start over from the board, since
+// all of its features depend on where its king stands.
+//------------------------------------------------------------------------------
+const Accumulator &Network::update(const Position &pos,
+                                   AccumulatorStack *stack, int ply) const {
+  Accumulator *entries = stack->entries_;
+  Accumulator &target = entries[ply];
+  if (target.key == pos.key()) {
+    return target;
+  }
+  int base = ply - 1;
+  while (base >= 0 && entries[base].key != pos.keyAt(ply - base)) {
+    --base;
+  }
+
+  bool rebuild[NUM_CHESS_PIECE_COLORS] = { base < 0, base < 0 };
+  for (int i = base + 1; base >= 0 && i <= ply; ++i) {
+    const PieceChanges &changes = pos.changesAt(ply - i);
+    if (changes.count > MAX_PIECE_CHANGES) {
+      rebuild[WHITE] = rebuild[BLACK] = true;
+      break;
+    }
+    for (int j = 0; j < changes.count; ++j) {
+      if (TypeOf(changes.list[j].piece) == KING) {
+        rebuild[ColorOf(changes.list[j].piece)] = true;
+      }
+    }
+  }
+
+  for (int perspective = WHITE; perspective <= BLACK; ++perspective) {
+    if (rebuild[perspective]) {
+      refresh(pos, perspective, target.values[perspective]);
+      continue;
+    }
+    int king = pos.kingSquare(perspective);
+    for (int i = base + 1; i <= ply; ++i) {
+      const PieceChanges &changes = pos.changesAt(ply - i);
+      const int16_t *added[MAX_PIECE_CHANGES];
+      const int16_t *removed[MAX_PIECE_CHANGES];
+      int num_added = 0, num_removed = 0;
+      for (int j = 0; j < changes.count; ++j) {
+        const PieceChange &change = changes.list[j];
+        if (TypeOf(change.piece) == KING) {
+          continue;  // The other king; kings are not features.
+        }
+        if (change.from != NO_SQUARE) {
+          removed[num_removed++] = featureWeights(perspective, king,
+                                                  change.piece, change.from);
+        }
+        if (change.to != NO_SQUARE) {
+          added[num_added++] = featureWeights(perspective, king, change.piece,
+                                              change.to);
+        }
+      }
+      kernels.update(entries[i].values[perspective],
+                     entries[i - 1].values[perspective], added, num_added,
+                     removed, num_removed);
+    }
+  }
+
+  // Entries passed on the way are complete unless a side was rebuilt:
+  bool complete = !rebuild[WHITE] && !rebuild[BLACK];
+  for (int i = base + 1; i < ply; ++i) {
+    entries[i].key = complete ? pos.keyAt(ply - i) : 0;
+  }
+  target.key = pos.key();
+  return target;
+}
+
+int Network::evaluate(const Position &pos, AccumulatorStack *stack,
+                      int ply) const {
+  const Accumulator &accumulator = update(pos, stack, ply);
+  int us = pos.sideToMove();
+  alignas(64) uint8_t input[2 * NNUE_HALF_DIMS];
+  kernels.clip(accumulator.values[us], input);
+  kernels.clip(accumulator.values[us ^ 1], input + NNUE_HALF_DIMS);
+
+  alignas(64) uint8_t hidden1[NNUE_HIDDEN1];
+  alignas(64) uint8_t hidden2[NNUE_HIDDEN2];
+  Propagate(input, 2 * NNUE_HALF_DIMS, hidden1_weights_, hidden1_biases_,
+            NNUE_HIDDEN1, hidden1);
+  Propagate(hidden1, NNUE_HIDDEN1, hidden2_weights_, hidden2_biases_,
+            NNUE_HIDDEN2, hidden2);
+  int32_t output = *output_bias_ +
+                   kernels.dot(hidden2, output_weights_, NNUE_HIDDEN2);
+  return output / NNUE_OUTPUT_SCALE;
+}
@@ -0,0 +1,111 @@
+/*******************************************************************************
+   Filename: nnue.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the Network class, an efficiently updatable
+             neural network evaluator (NNUE) with HalfKP input features: each
+             side sees every non-king piece relative to its own king. The
+             first layer's sums ("accumulators") are kept per search ply and
+             updated from the pieces each move changed, so only the small
+             layers above them are computed from scratch. Inference uses
+             quantized integer weights, read in place from a memory-mapped
+             network file, with AVX2 or SSE4.1 kernels chosen at run time and
+             plain C++ ones everywhere else.
+
+             Network file layout (all little-endian; every section starts on
+             a 64-byte boundary):
+               header   magic "NNUE", version, the four layer sizes below
+                        (uint32 each), then a 40-byte description
+               int16    feature biases[NNUE_HALF_DIMS]
+               int16    feature weights[NNUE_FEATURES][NNUE_HALF_DIMS]
+               int32    hidden 1 biases[NNUE_HIDDEN1]
+               int8     hidden 1 weights[NNUE_HIDDEN1][2 * NNUE_HALF_DIMS]
+               int32    hidden 2 biases[NNUE_HIDDEN2]
+               int8     hidden 2 weights[NNUE_HIDDEN2][NNUE_HIDDEN1]
+               int32    output bias
+               int8     output weights[NNUE_HIDDEN2]
+             Activations are clipped to 0..127, which stands for 0..1; hidden
+             layer sums are divided by 64 (NNUE_WEIGHT_SHIFT) before clipping
+             and the output by NNUE_OUTPUT_SCALE to give centipawns.
+*******************************************************************************/
+
+#ifndef NNUE_H_
+#define NNUE_H_
+
+#include <cstdint>
+#include <string>
+#include "mapped_file.h"
+#include "position.h"
+
+#define NNUE_FILE          "nets/default.nnue"  // Used if present.
+#define NNUE_VERSION       1
+#define NNUE_PIECE_KINDS   10  // Pawn to queen, ours and theirs.
+#define NNUE_FEATURES      (NUM_SQUARES * NNUE_PIECE_KINDS * NUM_SQUARES)
+#define NNUE_HALF_DIMS     256
+#define NNUE_HIDDEN1       32
+#define NNUE_HIDDEN2       32
+#define NNUE_WEIGHT_SHIFT  6
+#define NNUE_OUTPUT_SCALE  16
+#define NNUE_MAX_PLY       128  // Deepest ply evaluated; at least MAX_PLY.
+
+// First layer sums for both perspectives, and the key of the position they
+// belong to (0 for none).
+struct alignas(64) Accumulator {
+  int16_t values[NUM_CHESS_PIECE_COLORS][NNUE_HALF_DIMS];
+  uint64_t key;
+};
+
+// One accumulator per ply of a search, owned by the thread running it. An
+// entry stays valid until a different position reaches its ply, so going back
+// up the tree costs nothing.
+class AccumulatorStack {
+ public:
+  AccumulatorStack() { clear(); }
+  void clear();  // Call before searching a new root or with a new network.
+
+ private:
+  friend class Network;
+  Accumulator entries_[NNUE_MAX_PLY];
+};
+
+class Network {
+ public:
+  Network();
+
+  // Maps "filename" and checks its layout. On failure the network is left
+  // unloaded.
+  bool load(const char *filename);
+  void unload();
+  bool isLoaded() const { return file_.isOpen(); }
+  const std::string &description() const { return description_; }
+  static const char *simdName();  // The kernels in use, e.g., "avx2".
+
+  // Evaluates "pos", reached "ply" moves after the search root, in
+  // centipawns for the side to move. "stack" must hold the root's position
+  // or be clear. Safe to call from several threads with their own stacks.
+  int evaluate(const Position &pos, AccumulatorStack *stack, int ply) const;
+
+ private:
+  Network(const Network &);  // Not copyable.
+  Network &operator=(const Network &);
+
+  const Accumulator &update(const Position &pos, AccumulatorStack *stack,
+                            int ply) const;
+  void refresh(const Position &pos, int perspective, int16_t *values) const;
+  const int16_t *featureWeights(int perspective, int king, int piece,
+                                int square) const;
+
+  MappedFile file_;
+  std::string description_;
+  const int16_t *feature_biases_;
+  const int16_t *feature_weights_;
+  const int32_t *hidden1_biases_;
+  const int8_t *hidden1_weights_;
+  const int32_t *hidden2_biases_;
+  const int8_t *hidden2_weights_;
+  const int32_t *output_bias_;
+  const int8_t *output_weights_;
+};
+
+#endif  // NNUE_H_
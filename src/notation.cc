@@ -0,0 +1,222 @@
+/*******************************************************************************
+   Filename: notation.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Standard algebraic notation.
+*******************************************************************************/
+
+#include "notation.h"
+
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const char kPieceLetters[] = "PRBNQK";  // Indexed by type - PAWN.
+
+int PieceTypeOf(char letter) {
+  switch (letter) {
+    case 'N': return KNIGHT;
+    case 'B': return BISHOP;
+    case 'R': return ROOK;
+    case 'Q': return QUEEN;
+    case 'K': return KING;
+    default: return 0;
+  }
+}
+
+string SquareName(int square) {
+  string s;
+  s += (char) ('a' + ColOf(square));
+  s += (char) ('1' + RowOf(square));
+  return s;
+}
+
+}  // namespace
+
+string MoveToSan(Position &pos, Move m) {
+  int from = FromSquare(m), to = ToSquare(m);
+  int type = TypeOf(pos.pieceOn(from));
+  string san;
+  if (IsCastle(m)) {
+    san = FlagOf(m) == KING_CASTLE ? "O-O" : "O-O-O";
+  } else if (type == PAWN) {
+    if (IsCapture(m)) {
+      san += (char) ('a' + ColOf(from));
+      san += 'x';
+    }
+    san += SquareName(to);
+    if (IsPromotion(m)) {
+      san += '=';
+      san += kPieceLetters[PromotionType(m) - PAWN];
+    }
+  } else {
+    san += kPieceLetters[type - PAWN];
+
+    // Name the file, the rank or both if another piece of the same type can
+    // also reach the target square:
+    MoveList list;
+    GenerateLegalMoves(pos, &list);
+    bool ambiguous = false, same_file = false, same_row = false;
+    for (int i = 0; i < list.size; ++i) {
+      int other = FromSquare(list.moves[i]);
+      if (other != from && ToSquare(list.moves[i]) == to &&
+          TypeOf(pos.pieceOn(other)) == type) {
+        ambiguous = true;
+        same_file |= ColOf(other) == ColOf(from);
+        same_row |= RowOf(other) == RowOf(from);
+      }
+    }
+    if (ambiguous) {
+      if (!same_file) {
+        san += (char) ('a' + ColOf(from));
+      } else if (!same_row) {
+        san += (char) ('1' + RowOf(from));
+      } else {
+        san += SquareName(from);
+      }
+    }
+    if (IsCapture(m)) {
+      san += 'x';
+    }
+    san += SquareName(to);
+  }
+
+  pos.doMove(m);
+  if (pos.inCheck()) {
+    MoveList replies;
+    GenerateLegalMoves(pos, &replies);
+    san += replies.size ? '+' : '#';
+  }
+  pos.undoMove();
+  return san;
+}
+
+Move SanToMove(const Position &pos, string_view san) {
+  while (!san.empty() && strchr("+#!?", san.back())) {
+    san.remove_suffix(1);
+  }
+  if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+    int flag = san.size() == 3 ? KING_CASTLE : QUEEN_CASTLE;
+    MoveList list;
+    GenerateMoves(pos, GEN_QUIETS, &list);
+    for (int i = 0; i < list.size; ++i) {
+      if (FlagOf(list.moves[i]) == flag && pos.isLegal(list.moves[i])) {
+        return list.moves[i];
+      }
+    }
+    return NO_MOVE;
+  }
+
+  // [piece] [from file] [from rank] [x] to-square [[=]promotion]
+  int type = PAWN, promotion = 0;
+  if (!san.empty() && PieceTypeOf(san[0])) {
+    type = PieceTypeOf(san[0]);
+    san.remove_prefix(1);
+  }
+  if (type == PAWN && !san.empty() && PieceTypeOf(san.back())) {
+    promotion = PieceTypeOf(san.back());
+    san.remove_suffix(1);
+    if (!san.empty() && san.back() == '=') {
+      san.remove_suffix(1);
+    }
+  }
+  if (san.size() < 2 || san[san.size() - 2] < 'a' ||
+      san[san.size() - 2] > 'h' || san.back() < '1' || san.back() > '8') {
+    return NO_MOVE;
+  }
+  int to = SquareAt(san.back() - '1', san[san.size() - 2] - 'a');
+  san.remove_suffix(2);
+  Bitboard from_mask = ~0ULL;
+  for (size_t i = 0; i < san.size(); ++i) {
+    if (san[i] >= 'a' && san[i] <= 'h') {
+      from_mask &= FileBB(san[i] - 'a');
+    } else if (san[i] >= '1' && san[i] <= '8') {
+      from_mask &= RankBB(san[i] - '1');
+    } else if (san[i] != 'x' && san[i] != '-' && san[i] != ':') {
+      return NO_MOVE;
+    }
+  }
+
+  Move found = NO_MOVE;
+  int us = pos.sideToMove();
+  if (type != PAWN) {
+    // Pieces move as they attack, so only the pieces attacking the target
+    // square need to be considered. The same goes for pawns below; no move
+    // list is generated.
+    if (pos.pieces(us) & SquareBB(to)) {
+      return NO_MOVE;
+    }
+    Bitboard occupied = pos.pieces(), attackers;
+    switch (type) {
+      case KNIGHT: attackers = KnightAttacks(to); break;
+      case BISHOP: attackers = BishopAttacks(to, occupied); break;
+      case ROOK: attackers = RookAttacks(to, occupied); break;
+      case QUEEN: attackers = QueenAttacks(to, occupied); break;
+      default: attackers = KingAttacks(to); break;
+    }
+    attackers &= pos.pieces(us, type) & from_mask;
+    int flag = pos.pieceOn(to) == NO_PIECE ? QUIET_MOVE : CAPTURE;
+    while (attackers) {
+      Move m = MakeMove(PopLowestSquare(attackers), to, flag);
+      if (pos.isLegal(m)) {
+        if (found != NO_MOVE) {
+          return NO_MOVE;  // Ambiguous.
+        }
+        found = m;
+      }
+    }
+    return found;
+  }
+
+  // Pawns: a file before the target square means a capture.
+  int them = !us;
+  int forward = us == WHITE ? 8 : -8;
+  int last_row = us == WHITE ? 7 : 0;
+  if ((RowOf(to) == last_row) != (promotion != 0) || promotion == KING ||
+      RowOf(to) == 7 - last_row) {
+    return NO_MOVE;
+  }
+  int flag;
+  Bitboard candidates;
+  if (from_mask != ~0ULL) {
+    candidates = PawnAttacks(them, to) & pos.pieces(us, PAWN) & from_mask;
+    if (to == pos.epSquare()) {
+      flag = EN_PASSANT;
+    } else if (pos.pieces(them) & SquareBB(to)) {
+      flag = CAPTURE;
+    } else {
+      return NO_MOVE;
+    }
+  } else {
+    if (pos.pieceOn(to) != NO_PIECE) {
+      return NO_MOVE;
+    }
+    int from = to - forward;
+    flag = QUIET_MOVE;
+    if (pos.pieceOn(from) == NO_PIECE &&
+        RowOf(to) == (us == WHITE ? 3 : 4)) {
+      from -= forward;
+      flag = DOUBLE_PAWN_PUSH;
+    }
+    candidates = pos.pieces(us, PAWN) & SquareBB(from);
+  }
+  if (promotion) {
+    static const int kPromotionFlags[] = {
+      ROOK_PROMOTION, BISHOP_PROMOTION, KNIGHT_PROMOTION, QUEEN_PROMOTION
+    };  // Indexed by type - ROOK.
+    flag = kPromotionFlags[promotion - ROOK] | (flag & CAPTURE);
+  }
+  while (candidates) {
+    Move m = MakeMove(PopLowestSquare(candidates), to, flag);
+    if (pos.isLegal(m)) {
+      if (found != NO_MOVE) {
+        return NO_MOVE;
+      }
+      found = m;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,26 @@
+/*******************************************************************************
+   Filename: notation.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for converting moves to and from standard algebraic
+             notation (SAN), as used in PGN files.
+*******************************************************************************/
+
+#ifndef NOTATION_H_
+#define NOTATION_H_
+
+#include <string>
+#include <string_view>
+#include "position.h"
+
+// Returns "m", a legal move in "pos", in SAN (e.g., "Nbd7", "exd5", "e8=Q+",
+// "O-O#"). The position is used to test for check and is restored.
+std::string MoveToSan(Position &pos, Move m);
+
+// Returns the legal move in "pos" that "san" names, or NO_MOVE if there is
+// none or the text is ambiguous. Accepts check marks and annotations ("+",
+// "#", "!", "?"), "0-0" for "O-O" and promotions with or without "=".
+Move SanToMove(const Position &pos, std::string_view san);
+
+#endif  // NOTATION_H_
@@ -0,0 +1,146 @@
+/*******************************************************************************
+   Filename: offscreen.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Windowless OpenGL rendering through EGL.
+*******************************************************************************/
+
+#include "offscreen.h"
+
+#include <cstring>
+#include <iostream>
+#include <EGL/eglext.h>
+
+using namespace std;
+
+namespace {
+
+// Prefers Mesa's surfaceless platform, which needs no display server or GPU
+// device, and falls back to the default display.
+EGLDisplay OpenDisplay() {
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (get_platform_display && extensions &&
+      strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+    EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                              EGL_DEFAULT_DISPLAY, NULL);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+      return display;
+    }
+  }
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+    return display;
+  }
+  return EGL_NO_DISPLAY;
+}
+
+}  // namespace
+
+OffscreenContext::OffscreenContext()
+    : display_(EGL_NO_DISPLAY),
+      surface_(EGL_NO_SURFACE),
+      context_(EGL_NO_CONTEXT),
+      framebuffer_(0),
+      width_(0),
+      height_(0) {
+  renderbuffers_[0] = renderbuffers_[1] = 0;
+}
+
+OffscreenContext::~OffscreenContext() {
+  destroy();
+}
+
+bool OffscreenContext::create(int width, int height) {
+  destroy();
+  display_ = OpenDisplay();
+  if (display_ == EGL_NO_DISPLAY || !eglBindAPI(EGL_OPENGL_API)) {
+    cerr << "Error: no EGL display available" << endl;
+    destroy();
+    return false;
+  }
+
+  // Everything is drawn into a framebuffer object, so the context needs no
+  // surface of its own. Without EGL_KHR_surfaceless_context, a 1x1 pbuffer
+  // stands in for one.
+  const EGLint kConfigAttributes[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint count = 0;
+  if (!eglChooseConfig(display_, kConfigAttributes, &config, 1, &count) ||
+      count == 0) {
+    cerr << "Error: no suitable EGL configuration" << endl;
+    destroy();
+    return false;
+  }
+  context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, NULL);
+  const char *extensions = eglQueryString(display_, EGL_EXTENSIONS);
+  if (context_ != EGL_NO_CONTEXT &&
+      !(extensions && strstr(extensions, "EGL_KHR_surfaceless_context"))) {
+    const EGLint kPbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1,
+                                          EGL_NONE };
+    surface_ = eglCreatePbufferSurface(display_, config, kPbufferAttributes);
+  }
+  if (context_ == EGL_NO_CONTEXT ||
+      !eglMakeCurrent(display_, surface_, surface_, context_)) {
+    cerr << "Error: unable to create an EGL context" << endl;
+    destroy();
+    return false;
+  }
+
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glGenRenderbuffers(2, renderbuffers_);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers_[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, renderbuffers_[0]);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers_[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, renderbuffers_[1]);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    cerr << "Error: incomplete offscreen framebuffer" << endl;
+    destroy();
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  glViewport(0, 0, width, height);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  return true;
+}
+
+void OffscreenContext::destroy() {
+  if (context_ != EGL_NO_CONTEXT) {
+    if (framebuffer_) {
+      glDeleteFramebuffers(1, &framebuffer_);
+      glDeleteRenderbuffers(2, renderbuffers_);
+      framebuffer_ = 0;
+      renderbuffers_[0] = renderbuffers_[1] = 0;
+    }
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display_, context_);
+    context_ = EGL_NO_CONTEXT;
+  }
+  if (surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, surface_);
+    surface_ = EGL_NO_SURFACE;
+  }
+  if (display_ != EGL_NO_DISPLAY) {
+    eglTerminate(display_);
+    display_ = EGL_NO_DISPLAY;
+  }
+  width_ = height_ = 0;
+}
+
+void OffscreenContext::readPixels(unsigned char *pixels) const {
+  glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+}
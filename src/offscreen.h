@@ -0,0 +1,43 @@
+/*******************************************************************************
+   Filename: offscreen.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the OffscreenContext class: an OpenGL context
+             with no window (via EGL) that renders into a framebuffer object,
+             for exporting images on machines without a display.
+*******************************************************************************/
+
+#ifndef OFFSCREEN_H_
+#define OFFSCREEN_H_
+
+#include <EGL/egl.h>
+#include "renderer.h"
+
+class OffscreenContext {
+ public:
+  OffscreenContext();
+  ~OffscreenContext();
+
+  // Creates the context and a width x height RGB framebuffer with a depth
+  // buffer, and makes them current. Returns false on failure.
+  bool create(int width, int height);
+  void destroy();
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  // Copies the framebuffer into "pixels" (width * height * 3 bytes), bottom
+  // row first, as glReadPixels() returns it.
+  void readPixels(unsigned char *pixels) const;
+
+ private:
+  EGLDisplay display_;
+  EGLSurface surface_;
+  EGLContext context_;
+  GLuint framebuffer_;
+  GLuint renderbuffers_[2];  // Color and depth.
+  int width_;
+  int height_;
+};
+
+#endif  // OFFSCREEN_H_
@@ -0,0 +1,80 @@
+/*******************************************************************************
+   Filename: perft.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Leaf-node counting for move generator verification.
+*******************************************************************************/
+
+#include "perft.h"
+
+#include <cstring>
+
+namespace {
+
+bool HasLegalMove(const Position &pos) {
+  MoveList list;
+  GenerateMoves(pos, GEN_ALL, &list);
+  for (int i = 0; i < list.size; ++i) {
+    if (pos.isLegal(list.moves[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Count(Position &pos, int depth, PerftStats *stats) {
+  MoveList list;
+  GenerateLegalMoves(pos, &list);
+  for (int i = 0; i < list.size; ++i) {
+    Move m = list.moves[i];
+    pos.doMove(m);
+    if (depth > 1) {
+      Count(pos, depth - 1, stats);
+    } else {
+      ++stats->nodes;
+      stats->captures += IsCapture(m);
+      stats->en_passants += FlagOf(m) == EN_PASSANT;
+      stats->castles += IsCastle(m);
+      stats->promotions += IsPromotion(m);
+      if (pos.inCheck()) {
+        ++stats->checks;
+        stats->mates += !HasLegalMove(pos);
+      }
+    }
+    pos.undoMove();
+  }
+}
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+// Returns the number of legal move sequences of length "depth". The last ply
+// is counted straight from the move list, without making the moves.
+//------------------------------------------------------------------------------
+uint64_t Perft(Position &pos, int depth) {
+  MoveList list;
+  GenerateLegalMoves(pos, &list);
+  if (depth <= 1) {
+    return depth == 1 ? list.size : 1;
+  }
+  uint64_t nodes = 0;
+  for (int i = 0; i < list.size; ++i) {
+    pos.doMove(list.moves[i]);
+    nodes += Perft(pos, depth - 1);
+    pos.undoMove();
+  }
+  return nodes;
+}
+
+//------------------------------------------------------------------------------
+// Like Perft(), but also classifies every move made at the last ply.
+//------------------------------------------------------------------------------
+void PerftDetailed(Position &pos, int depth, PerftStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  if (depth <= 0) {
+    stats->nodes = 1;
+    return;
+  }
+  Count(pos, depth, stats);
+}
@@ -0,0 +1,30 @@
+/*******************************************************************************
+   Filename: perft.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Move generator verification: counts the leaf nodes of the legal
+             move tree to a fixed depth ("perft"), optionally broken down by
+             move type.
+*******************************************************************************/
+
+#ifndef PERFT_H_
+#define PERFT_H_
+
+#include <cstdint>
+#include "position.h"
+
+struct PerftStats {
+  uint64_t nodes;
+  uint64_t captures;
+  uint64_t en_passants;
+  uint64_t castles;
+  uint64_t promotions;
+  uint64_t checks;
+  uint64_t mates;
+};
+
+uint64_t Perft(Position &pos, int depth);
+void PerftDetailed(Position &pos, int depth, PerftStats *stats);
+
+#endif  // PERFT_H_
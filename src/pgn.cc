@@ -0,0 +1,252 @@
+/*******************************************************************************
+   Filename: pgn.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: PGN tokenizer.
+*******************************************************************************/
+
+#include "pgn.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+inline bool IsSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' ||
+         c == '\v';
+}
+
+inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Characters that end a movetext token.
+inline bool IsDelimiter(char c) {
+  return IsSpace(c) || c == '{' || c == '}' || c == '(' || c == ')' ||
+         c == ';' || c == '[' || c == '$';
+}
+
+bool IsResult(string_view token) {
+  return token == "1-0" || token == "0-1" || token == "1/2-1/2" ||
+         token == "*";
+}
+
+}  // namespace
+
+string_view PgnGame::tag(string_view name) const {
+  for (size_t i = 0; i < tags.size(); ++i) {
+    if (tags[i].name == name) {
+      return tags[i].value;
+    }
+  }
+  return string_view();
+}
+
+PgnReader::PgnReader(const char *data, size_t size)
+    : data_(data), pos_(data), end_(data + size) {}
+
+void PgnReader::skipSpace() {
+  while (pos_ < end_ && IsSpace(*pos_)) {
+    ++pos_;
+  }
+}
+
+void PgnReader::skipLine() {
+  const char *newline = (const char *) memchr(pos_, '\n', end_ - pos_);
+  pos_ = newline ? newline + 1 : end_;
+}
+
+void PgnReader::skipComment() {
+  const char *close = (const char *) memchr(pos_, '}', end_ - pos_);
+  pos_ = close ? close + 1 : end_;
+}
+
+// Skips a parenthesized variation, including nested ones and any comments
+// (which may contain parentheses) inside.
+void PgnReader::skipVariation() {
+  int depth = 0;
+  while (pos_ < end_) {
+    char c = *pos_;
+    if (c == '{') {
+      skipComment();
+      continue;
+    } else if (c == ';') {
+      skipLine();
+      continue;
+    }
+    ++pos_;
+    if (c == '(') {
+      ++depth;
+    } else if (c == ')' && --depth == 0) {
+      return;
+    }
+  }
+}
+
+// Reads [Name "Value"] starting at the '['. On malformed input, skips the
+// rest of the line and returns false.
+bool PgnReader::readTag(PgnTag *tag) {
+  const char *start = ++pos_;
+  while (pos_ < end_ && !IsSpace(*pos_) && *pos_ != '"' && *pos_ != ']') {
+    ++pos_;
+  }
+  tag->name = string_view(start, pos_ - start);
+  skipSpace();
+  if (pos_ >= end_ || *pos_ != '"' || tag->name.empty()) {
+    skipLine();
+    return false;
+  }
+  start = ++pos_;
+  while (pos_ < end_ && *pos_ != '"' && *pos_ != '\n') {
+    pos_ += *pos_ == '\\' && pos_ + 1 < end_ ? 2 : 1;
+  }
+  if (pos_ >= end_ || *pos_ != '"') {
+    skipLine();
+    return false;
+  }
+  tag->value = string_view(start, pos_ - start);
+  skipLine();  // The closing ']' and anything after it.
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Reads the tag pairs, then the movetext up to the game termination marker
+// (or the next game's tags, if the marker is missing).
+//------------------------------------------------------------------------------
+bool PgnReader::next(PgnGame *game) {
+  game->tags.clear();
+  game->moves.clear();
+  game->result = string_view();
+
+  // Tag pairs, plus any "%" escape lines before them:
+  for (;;) {
+    skipSpace();
+    if (pos_ >= end_) {
+      return false;
+    }
+    if (*pos_ == '%') {
+      skipLine();
+    } else {
+      break;
+    }
+  }
+  game->offset = pos_ - data_;
+  while (pos_ < end_ && *pos_ == '[') {
+    PgnTag tag;
+    if (readTag(&tag)) {
+      game->tags.push_back(tag);
+    }
+    skipSpace();
+  }
+
+  // Movetext:
+  while (pos_ < end_) {
+    skipSpace();
+    if (pos_ >= end_ || *pos_ == '[') {
+      break;  // Next game (this one had no result).
+    }
+    char c = *pos_;
+    if (c == '{') {
+      skipComment();
+    } else if (c == ';' || (c == '%' && (pos_ == data_ || pos_[-1] == '\n'))) {
+      skipLine();
+    } else if (c == '(') {
+      skipVariation();
+    } else if (c == ')' || c == '}') {
+      ++pos_;  // Unbalanced; ignore it.
+    } else if (c == '$') {
+      ++pos_;
+      while (pos_ < end_ && IsDigit(*pos_)) {
+        ++pos_;
+      }
+    } else {
+      const char *start = pos_;
+      if (IsDigit(c)) {
+        while (pos_ < end_ && IsDigit(*pos_)) {
+          ++pos_;
+        }
+        if (pos_ < end_ && *pos_ == '.') {  // A move number.
+          while (pos_ < end_ && *pos_ == '.') {
+            ++pos_;
+          }
+          continue;
+        }
+      }
+      while (pos_ < end_ && !IsDelimiter(*pos_)) {
+        ++pos_;
+      }
+      string_view token(start, pos_ - start);
+      if (IsResult(token)) {
+        game->result = token;
+        break;
+      }
+      // Move numbers written as "1..." are handled above, but "..." alone
+      // can follow a comment:
+      if (token.find_first_not_of('.') != string_view::npos) {
+        game->moves.push_back(token);
+      }
+    }
+  }
+  return true;
+}
+
+size_t NextGameBoundary(const char *data, size_t size, size_t offset) {
+  if (offset == 0) {
+    return 0;
+  }
+  // Start at the beginning of the next line:
+  const char *p = (const char *) memchr(data + offset - 1, '\n',
+                                        size - offset + 1);
+  const char *end = data + size;
+  bool previous_is_tag = true;  // Unknown; do not start mid-way through tags.
+  while (p != NULL && p < end) {
+    const char *line = p + 1;
+    if (line >= end) {
+      break;
+    }
+    bool is_tag = *line == '[';
+    if (is_tag && !previous_is_tag) {
+      return line - data;
+    }
+    bool blank = true;
+    for (const char *q = line; q < end && *q != '\n'; ++q) {
+      if (!IsSpace(*q)) {
+        blank = false;
+        break;
+      }
+    }
+    if (!blank) {
+      previous_is_tag = is_tag;
+    }
+    p = (const char *) memchr(line, '\n', end - line);
+  }
+  return size;
+}
+
+vector<size_t> SplitGames(const char *data, size_t size, int chunks) {
+  const size_t kMinChunkSize = 4096;
+  chunks = (int) min((size_t) max(1, chunks), size / kMinChunkSize + 1);
+  vector<size_t> bounds(1, 0);
+  for (int i = 1; i < chunks; ++i) {
+    size_t bound = NextGameBoundary(data, size, size / chunks * i);
+    if (bound > bounds.back() && bound < size) {
+      bounds.push_back(bound);
+    }
+  }
+  bounds.push_back(size);
+  return bounds;
+}
+
+string UnescapeTagValue(string_view value) {
+  string text;
+  text.reserve(value.size());
+  for (size_t i = 0; i < value.size(); ++i) {
+    if (value[i] == '\\' && i + 1 < value.size()) {
+      ++i;
+    }
+    text += value[i];
+  }
+  return text;
+}
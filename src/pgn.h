@@ -0,0 +1,70 @@
+/*******************************************************************************
+   Filename: pgn.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the PgnReader class, a zero-copy tokenizer for
+             PGN (Portable Game Notation) text. It walks a buffer (normally a
+             memory-mapped file) game by game, returning views into the
+             buffer rather than copies, so multi-gigabyte collections can be
+             split into chunks at game boundaries and read in parallel.
+*******************************************************************************/
+
+#ifndef PGN_H_
+#define PGN_H_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct PgnTag {
+  std::string_view name;
+  std::string_view value;  // As written: escapes (\" and \\) are kept.
+};
+
+// One game's tags and main line; comments, variations and NAGs are skipped.
+// The views point into the reader's buffer.
+struct PgnGame {
+  std::vector<PgnTag> tags;
+  std::vector<std::string_view> moves;  // SAN, possibly with "!?"-style marks.
+  std::string_view result;              // "1-0", "0-1", "1/2-1/2" or "*".
+  size_t offset;                        // Where the game starts.
+
+  std::string_view tag(std::string_view name) const;  // Empty if absent.
+};
+
+class PgnReader {
+ public:
+  PgnReader(const char *data, size_t size);
+
+  // Reads the next game. Returns false at the end of the buffer.
+  bool next(PgnGame *game);
+  size_t offset() const { return pos_ - data_; }
+
+ private:
+  void skipSpace();
+  void skipLine();
+  void skipComment();
+  void skipVariation();
+  bool readTag(PgnTag *tag);
+
+  const char *data_;
+  const char *pos_;
+  const char *end_;
+};
+
+// Returns the offset of the first game that starts at or after "offset" (or
+// "size" if there is none). A game starts at a tag line ("[") that does not
+// directly follow another tag line.
+size_t NextGameBoundary(const char *data, size_t size, size_t offset);
+
+// Splits a buffer into at most "chunks" runs of whole games for parallel
+// parsing. Returns the chunk boundaries, starting with 0 and ending with
+// "size".
+std::vector<size_t> SplitGames(const char *data, size_t size, int chunks);
+
+// Undoes the escapes in a tag value.
+std::string UnescapeTagValue(std::string_view value);
+
+#endif  // PGN_H_
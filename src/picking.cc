@@ -0,0 +1,230 @@
+/*******************************************************************************
+   Filename: picking.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Ray casting for mouse picking. The grid is walked with the
+             Amanatides-Woo traversal, in "square coordinates": u grows with
+             the column and v with the row, one unit per square.
+*******************************************************************************/
+
+#include "picking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+const double kInfinity = numeric_limits<double>::infinity();
+
+double ToU(double x) { return 8.5 - x / SQUARE_SPACING; }
+double ToV(double z) { return z / SQUARE_SPACING - 0.5; }
+
+//------------------------------------------------------------------------------
+// Finds the stretch [*t_near, *t_far] of the ray, ahead of its origin, that
+// lies inside "box" (the slab method). Returns false if there is none.
+//------------------------------------------------------------------------------
+bool ClipRay(const Ray &ray, const PickBox &box, double *t_near,
+             double *t_far) {
+  double near = 0, far = kInfinity;
+  for (int i = 0; i < 3; ++i) {
+    if (ray.direction[i] == 0) {
+      if (ray.origin[i] < box.min[i] || ray.origin[i] > box.max[i]) {
+        return false;
+      }
+      continue;
+    }
+    double t1 = (box.min[i] - ray.origin[i]) / ray.direction[i];
+    double t2 = (box.max[i] - ray.origin[i]) / ray.direction[i];
+    near = max(near, min(t1, t2));
+    far = min(far, max(t1, t2));
+    if (near > far) {
+      return false;
+    }
+  }
+  *t_near = near;
+  *t_far = far;
+  return true;
+}
+
+}  // namespace
+
+Ray ScreenRay(const double eye[3], const double at[3], double fovy,
+              double width, double height, int x, int y) {
+  double f[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+  double length = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+  for (int i = 0; i < 3; ++i) {
+    f[i] /= length;
+  }
+  double s[3] = { -f[2], 0, f[0] };  // f x (0, 1, 0), as in setView().
+  length = sqrt(s[0] * s[0] + s[2] * s[2]);
+  s[0] /= length;
+  s[2] /= length;
+  double u[3] = { s[1] * f[2] - s[2] * f[1],
+                  s[2] * f[0] - s[0] * f[2],
+                  s[0] * f[1] - s[1] * f[0] };
+
+  double tan_half = tan(fovy * M_PI / 360);
+  double right = (2 * (x + 0.5) / width - 1) * tan_half * width / height;
+  double up = (1 - 2 * (y + 0.5) / height) * tan_half;
+  Ray ray;
+  length = 0;
+  for (int i = 0; i < 3; ++i) {
+    ray.origin[i] = eye[i];
+    ray.direction[i] = f[i] + s[i] * right + u[i] * up;
+    length += ray.direction[i] * ray.direction[i];
+  }
+  length = sqrt(length);
+  for (int i = 0; i < 3; ++i) {
+    ray.direction[i] /= length;
+  }
+  return ray;
+}
+
+bool IntersectPlaneY(const Ray &ray, double y, double point[3]) {
+  if (fabs(ray.direction[1]) < 1e-12) {
+    return false;
+  }
+  double t = (y - ray.origin[1]) / ray.direction[1];
+  if (t < 0) {
+    return false;
+  }
+  for (int i = 0; i < 3; ++i) {
+    point[i] = ray.origin[i] + t * ray.direction[i];
+  }
+  return true;
+}
+
+int SquareAtPoint(double x, double z) {
+  double u = ToU(x), v = ToV(z);
+  if (u < 0 || u >= 8 || v < 0 || v >= 8) {
+    return NO_SQUARE;
+  }
+  return SquareAt((int) v, (int) u);
+}
+
+PickBox ModelPickBox(const Mesh &mesh) {
+  double radius = 0, bottom = kInfinity, top = -kInfinity;
+  for (uint32_t i = 0; i < mesh.vertex_count; ++i) {
+    const float *p = mesh.vertices[i].position;
+    radius = max(radius, sqrt((double) p[0] * p[0] + (double) p[2] * p[2]));
+    bottom = min(bottom, (double) p[1]);
+    top = max(top, (double) p[1]);
+  }
+  if (mesh.vertex_count == 0) {
+    bottom = top = 0;
+  }
+  PickBox box = { { -radius, bottom, -radius }, { radius, top, radius } };
+  return box;
+}
+
+PickBox PlacePickBox(const PickBox &model, double x, double y, double z,
+                     double scale) {
+  const double kOffset[3] = { x, y, z };
+  PickBox box;
+  for (int i = 0; i < 3; ++i) {
+    box.min[i] = kOffset[i] + model.min[i] * scale;
+    box.max[i] = kOffset[i] + model.max[i] * scale;
+  }
+  return box;
+}
+
+void PieceGrid::clear() {
+  entries_.clear();
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    cells_[square].clear();
+  }
+}
+
+void PieceGrid::add(int id, const PickBox &box) {
+  // x runs against u, so box.max[0] gives the smaller u:
+  int col_min = max(0, (int) floor(ToU(box.max[0])));
+  int col_max = min(7, (int) floor(ToU(box.min[0])));
+  int row_min = max(0, (int) floor(ToV(box.min[2])));
+  int row_max = min(7, (int) floor(ToV(box.max[2])));
+  if (col_min > col_max || row_min > row_max) {
+    return;
+  }
+  if (entries_.empty()) {
+    bottom_ = box.min[1];
+    top_ = box.max[1];
+  } else {
+    bottom_ = min(bottom_, box.min[1]);
+    top_ = max(top_, box.max[1]);
+  }
+  Entry entry = { id, box };
+  entries_.push_back(entry);
+  for (int row = row_min; row <= row_max; ++row) {
+    for (int col = col_min; col <= col_max; ++col) {
+      cells_[SquareAt(row, col)].push_back((int) entries_.size() - 1);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Clips the ray to the grid, then visits the cells it crosses in order.
+// Boxes can spill into neighboring cells, so the search ends only once the
+// nearest hit so far lies within the cell being left.
+//------------------------------------------------------------------------------
+int PieceGrid::pick(const Ray &ray, double *distance) const {
+  if (entries_.empty()) {
+    return NO_PICK;
+  }
+  const PickBox kGrid = {
+    { 0.5 * SQUARE_SPACING, bottom_, 0.5 * SQUARE_SPACING },
+    { 8.5 * SQUARE_SPACING, top_, 8.5 * SQUARE_SPACING }
+  };
+  double t_enter, t_exit;
+  if (!ClipRay(ray, kGrid, &t_enter, &t_exit)) {
+    return NO_PICK;
+  }
+
+  double u = ToU(ray.origin[0] + t_enter * ray.direction[0]);
+  double v = ToV(ray.origin[2] + t_enter * ray.direction[2]);
+  double du = -ray.direction[0] / SQUARE_SPACING;
+  double dv = ray.direction[2] / SQUARE_SPACING;
+  int col = min(7, max(0, (int) floor(u)));
+  int row = min(7, max(0, (int) floor(v)));
+  int step_col = du > 0 ? 1 : -1, step_row = dv > 0 ? 1 : -1;
+  double next_col = du != 0 ?
+      t_enter + ((du > 0 ? col + 1 : col) - u) / du : kInfinity;
+  double next_row = dv != 0 ?
+      t_enter + ((dv > 0 ? row + 1 : row) - v) / dv : kInfinity;
+  double delta_col = du != 0 ? fabs(1 / du) : kInfinity;
+  double delta_row = dv != 0 ? fabs(1 / dv) : kInfinity;
+
+  int best = NO_PICK;
+  double best_t = kInfinity;
+  while (true) {
+    const vector<int> &cell = cells_[SquareAt(row, col)];
+    for (size_t i = 0; i < cell.size(); ++i) {
+      const Entry &entry = entries_[cell[i]];
+      double t_near, t_far;
+      if (ClipRay(ray, entry.box, &t_near, &t_far) && t_near < best_t) {
+        best = entry.id;
+        best_t = t_near;
+      }
+    }
+    double cell_exit = min(min(next_col, next_row), t_exit);
+    if (best_t <= cell_exit || cell_exit >= t_exit) {
+      break;
+    }
+    if (next_col < next_row) {
+      col += step_col;
+      next_col += delta_col;
+    } else {
+      row += step_row;
+      next_row += delta_row;
+    }
+    if (col < 0 || col > 7 || row < 0 || row > 7) {
+      break;
+    }
+  }
+  if (distance && best != NO_PICK) {
+    *distance = best_t;
+  }
+  return best;
+}
@@ -0,0 +1,79 @@
+/*******************************************************************************
+   Filename: picking.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Mouse picking on the CPU. A click becomes a ray from the eye,
+             which is tested against the board plane and against bounding
+             boxes for the pieces. The boxes are filed in a grid with one
+             cell per square, and the ray visits only the cells it crosses,
+             nearest first, so a pick costs a few box tests and no drawing.
+*******************************************************************************/
+
+#ifndef PICKING_H_
+#define PICKING_H_
+
+#include <vector>
+#include "bitboard.h"
+#include "mesh.h"
+
+#define NO_PICK -1
+
+struct Ray {
+  double origin[3];
+  double direction[3];  // Unit length.
+};
+
+// An axis-aligned box, in world coordinates unless noted.
+struct PickBox {
+  double min[3];
+  double max[3];
+};
+
+// Returns the ray through window pixel (x, y), with y counted down from the
+// top as GLUT does, for a camera set up like gluPerspective(fovy, width /
+// height, ...) and gluLookAt(eye, at, Y up).
+Ray ScreenRay(const double eye[3], const double at[3], double fovy,
+              double width, double height, int x, int y);
+
+// Finds where "ray" meets the horizontal plane at height "y". Returns false
+// if it never does (ahead of the eye).
+bool IntersectPlaneY(const Ray &ray, double y, double point[3]);
+
+// Returns the square at world point (x, z), or NO_SQUARE off the board.
+int SquareAtPoint(double x, double z);
+
+// Returns the bounds of a piece model's vertices, widened into a box that
+// holds the model at any y_angle, with x and z centered on the origin.
+PickBox ModelPickBox(const Mesh &mesh);
+
+// "model" (from ModelPickBox()) placed and scaled as a piece on the board.
+PickBox PlacePickBox(const PickBox &model, double x, double y, double z,
+                     double scale);
+
+class PieceGrid {
+ public:
+  PieceGrid() : bottom_(0), top_(0) {}
+  void clear();
+
+  // Files a box under every square it overlaps. Boxes wholly off the board
+  // are not pickable.
+  void add(int id, const PickBox &box);
+
+  // Returns the id of the nearest box the ray hits, or NO_PICK. "distance",
+  // if not NULL, receives the distance along the ray.
+  int pick(const Ray &ray, double *distance) const;
+
+ private:
+  struct Entry {
+    int id;
+    PickBox box;
+  };
+
+  std::vector<Entry> entries_;
+  std::vector<int> cells_[NUM_SQUARES];  // Indices into entries_.
+  double bottom_;  // Vertical extent of all boxes filed.
+  double top_;
+};
+
+#endif  // PICKING_H_
@@ -0,0 +1,921 @@
+/*******************************************************************************
+   Filename: position.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Method definitions for the Position class, plus the pseudo-legal
+             and legal move generators.
+*******************************************************************************/
+
+#include "position.h"
+
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+const char kPieceChars[] = "PRBNQK  prbnqk";
+
+// Castling rights that survive a move touching each square.
+int castling_mask[NUM_SQUARES];
+
+// Zobrist hashing keys:
+uint64_t piece_keys[NUM_PIECES][NUM_SQUARES];
+uint64_t castling_keys[ALL_CASTLING + 1];
+uint64_t ep_keys[8];
+uint64_t side_key;
+
+inline Bitboard PawnPush(Bitboard b, int color) {
+  return color == WHITE ? b << 8 : b >> 8;
+}
+
+// Rook squares (from, to) for a castling move whose king lands on "king_to".
+inline void CastlingRookSquares(int flag, int king_to, int *from, int *to) {
+  if (flag == KING_CASTLE) {
+    *from = king_to + 1;
+    *to = king_to - 1;
+  } else {
+    *from = king_to - 2;
+    *to = king_to + 1;
+  }
+}
+
+// Xorshift64* pseudorandom number generator.
+uint64_t NextRandom(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+bool BuildTables() {
+  InitBitboards();
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    castling_mask[square] = ALL_CASTLING;
+  }
+  castling_mask[SquareAt(0, 4)] &= ~(WHITE_OO | WHITE_OOO);
+  castling_mask[SquareAt(0, 7)] &= ~WHITE_OO;
+  castling_mask[SquareAt(0, 0)] &= ~WHITE_OOO;
+  castling_mask[SquareAt(7, 4)] &= ~(BLACK_OO | BLACK_OOO);
+  castling_mask[SquareAt(7, 7)] &= ~BLACK_OO;
+  castling_mask[SquareAt(7, 0)] &= ~BLACK_OOO;
+
+  // A fixed seed gives the same keys on every run:
+  uint64_t seed = 1070372;
+  for (int piece = 0; piece < NUM_PIECES; ++piece) {
+    for (int square = 0; square < NUM_SQUARES; ++square) {
+      piece_keys[piece][square] = NextRandom(&seed);
+    }
+  }
+  for (int rights = 0; rights <= ALL_CASTLING; ++rights) {
+    castling_keys[rights] = NextRandom(&seed);
+  }
+  for (int col = 0; col < 8; ++col) {
+    ep_keys[col] = NextRandom(&seed);
+  }
+  side_key = NextRandom(&seed);
+  return true;
+}
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+// Builds all lookup tables the Position class and move generator rely on.
+// Safe to call more than once, and from several threads.
+//------------------------------------------------------------------------------
+void Position::initTables() {
+  static bool initialized = BuildTables();
+  (void) initialized;
+}
+
+Position::Position() {
+  initTables();
+  setFen(START_FEN);
+}
+
+void Position::clear() {
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    board_[square] = NO_PIECE;
+  }
+  memset(types_, 0, sizeof(types_));
+  memset(colors_, 0, sizeof(colors_));
+  occupied_ = 0;
+  king_square_[WHITE] = king_square_[BLACK] = NO_SQUARE;
+  side_to_move_ = WHITE;
+  fullmove_number_ = 1;
+  ply_ = 0;
+  memset(&history_[0], 0, sizeof(State));
+  history_[0].captured = NO_PIECE;
+  history_[0].ep_square = NO_SQUARE;
+  forgetChanges();
+}
+
+//------------------------------------------------------------------------------
+// Sets up the position described by a FEN string. Returns false (leaving the
+// position unchanged) if the string cannot be parsed or describes an illegal
+// position.
+//------------------------------------------------------------------------------
+bool Position::setFen(const string &fen) {
+  istringstream in(fen);
+  string placement, side, castling, ep;
+  int halfmove = 0, fullmove = 1;
+  if (!(in >> placement >> side)) {
+    return false;
+  }
+  if (!(in >> castling)) {
+    castling = "-";
+  }
+  if (!(in >> ep)) {
+    ep = "-";
+  }
+  in >> halfmove >> fullmove;
+
+  // Validate the piece placement before touching any member:
+  int placed[NUM_SQUARES];
+  int kings[NUM_CHESS_PIECE_COLORS] = { 0, 0 };
+  int row = 7, col = 0;
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    placed[square] = NO_PIECE;
+  }
+  for (size_t i = 0; i < placement.size(); ++i) {
+    char c = placement[i];
+    if (c == '/') {
+      if (col != 8 || row == 0) {
+        return false;
+      }
+      --row;
+      col = 0;
+    } else if (c >= '1' && c <= '8') {
+      col += c - '0';
+    } else {
+      const char *p = strchr(kPieceChars, c);
+      if (p == NULL || *p == ' ' || col > 7) {
+        return false;
+      }
+      int piece = (int) (p - kPieceChars);
+      if (TypeOf(piece) == KING) {
+        ++kings[ColorOf(piece)];
+      }
+      placed[SquareAt(row, col++)] = piece;
+    }
+    if (col > 8) {
+      return false;
+    }
+  }
+  if (row != 0 || col != 8 || kings[WHITE] != 1 || kings[BLACK] != 1 ||
+      (side != "w" && side != "b")) {
+    return false;
+  }
+
+  // No pawn may stand on the first or last rank, and the side that just moved
+  // cannot have left its king in check:
+  int us = side == "w" ? WHITE : BLACK;
+  int their_king = NO_SQUARE;
+  Bitboard occupied = 0, pawns = 0;
+  Bitboard ours[NUM_PIECE_TYPES] = { 0 };
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    int piece = placed[square];
+    if (piece == NO_PIECE) {
+      continue;
+    }
+    occupied |= SquareBB(square);
+    if (TypeOf(piece) == PAWN) {
+      pawns |= SquareBB(square);
+    }
+    if (ColorOf(piece) == us) {
+      ours[TypeOf(piece) - PAWN] |= SquareBB(square);
+    } else if (TypeOf(piece) == KING) {
+      their_king = square;
+    }
+  }
+  Bitboard diagonal = ours[BISHOP - PAWN] | ours[QUEEN - PAWN];
+  Bitboard straight = ours[ROOK - PAWN] | ours[QUEEN - PAWN];
+  if ((pawns & (RankBB(0) | RankBB(7))) ||
+      (PawnAttacks(us ^ 1, their_king) & ours[PAWN - PAWN]) ||
+      (KnightAttacks(their_king) & ours[KNIGHT - PAWN]) ||
+      (KingAttacks(their_king) & ours[KING - PAWN]) ||
+      (BishopAttacks(their_king, occupied) & diagonal) ||
+      (RookAttacks(their_king, occupied) & straight)) {
+    return false;
+  }
+
+  clear();
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    if (placed[square] != NO_PIECE) {
+      putPiece(placed[square], square);
+    }
+  }
+  side_to_move_ = us;
+
+  State &st = state();
+  for (size_t i = 0; i < castling.size(); ++i) {
+    switch (castling[i]) {
+      case 'K': st.castling |= WHITE_OO; break;
+      case 'Q': st.castling |= WHITE_OOO; break;
+      case 'k': st.castling |= BLACK_OO; break;
+      case 'q': st.castling |= BLACK_OOO; break;
+    }
+  }
+  // Drop any right whose king or rook is not on its home square:
+  for (int square = 0; square < NUM_SQUARES; ++square) {
+    int home = placed[square];
+    bool needed = (square == SquareAt(0, 4) || square == SquareAt(7, 4)) ?
+                  home != NO_PIECE && TypeOf(home) == KING :
+                  home != NO_PIECE && TypeOf(home) == ROOK;
+    if (!needed || ColorOf(home) != (RowOf(square) == 0 ? WHITE : BLACK)) {
+      st.castling &= castling_mask[square];
+    }
+  }
+  // Only record en passant squares that can actually be captured on: behind
+  // an enemy pawn that has just made a double push (so both squares it
+  // crossed are empty) and attacked by one of ours. Anything else would make
+  // the move generator emit an en passant capture of a missing pawn.
+  if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' &&
+      ep[1] == (us == WHITE ? '6' : '3')) {
+    int square = SquareAt(ep[1] - '1', ep[0] - 'a');
+    int forward = us == WHITE ? 8 : -8;
+    if (pieceOn(square - forward) == MakePiece(us ^ 1, PAWN) &&
+        pieceOn(square) == NO_PIECE &&
+        pieceOn(square + forward) == NO_PIECE &&
+        (PawnAttacks(us ^ 1, square) & pieces(us, PAWN))) {
+      st.ep_square = square;
+    }
+  }
+  st.halfmove_clock = halfmove;
+  fullmove_number_ = fullmove > 0 ? fullmove : 1;
+  st.key = computeKey();
+  updateCheckInfo();
+  return true;
+}
+
+string Position::fen() const {
+  ostringstream out;
+  for (int row = 7; row >= 0; --row) {
+    int empty = 0;
+    for (int col = 0; col < 8; ++col) {
+      int piece = board_[SquareAt(row, col)];
+      if (piece == NO_PIECE) {
+        ++empty;
+        continue;
+      }
+      if (empty) {
+        out << empty;
+        empty = 0;
+      }
+      out << kPieceChars[piece];
+    }
+    if (empty) {
+      out << empty;
+    }
+    if (row > 0) {
+      out << '/';
+    }
+  }
+  out << (side_to_move_ == WHITE ? " w " : " b ");
+  int castling = castlingRights();
+  if (castling & WHITE_OO) out << 'K';
+  if (castling & WHITE_OOO) out << 'Q';
+  if (castling & BLACK_OO) out << 'k';
+  if (castling & BLACK_OOO) out << 'q';
+  if (!castling) out << '-';
+  if (epSquare() == NO_SQUARE) {
+    out << " -";
+  } else {
+    out << ' ' << (char) ('a' + ColOf(epSquare()))
+        << (char) ('1' + RowOf(epSquare()));
+  }
+  out << ' ' << halfmoveClock() << ' ' << fullmove_number_;
+  return out.str();
+}
+
+//------------------------------------------------------------------------------
+// Returns the Zobrist hash of the position, computed from scratch. Normally
+// the key is updated incrementally instead; see putPiece() and friends.
+//------------------------------------------------------------------------------
+uint64_t Position::computeKey() const {
+  uint64_t key = castling_keys[castlingRights()];
+  Bitboard b = occupied_;
+  while (b) {
+    int square = PopLowestSquare(b);
+    key ^= piece_keys[board_[square]][square];
+  }
+  if (epSquare() != NO_SQUARE) {
+    key ^= ep_keys[ColOf(epSquare())];
+  }
+  if (side_to_move_ == BLACK) {
+    key ^= side_key;
+  }
+  return key;
+}
+
+void Position::putPiece(int piece, int square) {
+  Bitboard b = SquareBB(square);
+  recordChange(piece, NO_SQUARE, square);
+  state().key ^= piece_keys[piece][square];
+  if (TypeOf(piece) == PAWN) {
+    state().pawn_key ^= piece_keys[piece][square];
+  }
+  board_[square] = piece;
+  types_[piece & 7] |= b;
+  colors_[ColorOf(piece)] |= b;
+  occupied_ |= b;
+  if (TypeOf(piece) == KING) {
+    king_square_[ColorOf(piece)] = square;
+  }
+}
+
+void Position::removePiece(int square) {
+  int piece = board_[square];
+  Bitboard b = SquareBB(square);
+  recordChange(piece, square, NO_SQUARE);
+  state().key ^= piece_keys[piece][square];
+  if (TypeOf(piece) == PAWN) {
+    state().pawn_key ^= piece_keys[piece][square];
+  }
+  board_[square] = NO_PIECE;
+  types_[piece & 7] ^= b;
+  colors_[ColorOf(piece)] ^= b;
+  occupied_ ^= b;
+}
+
+void Position::movePiece(int from, int to) {
+  int piece = board_[from];
+  Bitboard b = SquareBB(from) | SquareBB(to);
+  recordChange(piece, from, to);
+  state().key ^= piece_keys[piece][from] ^ piece_keys[piece][to];
+  if (TypeOf(piece) == PAWN) {
+    state().pawn_key ^= piece_keys[piece][from] ^ piece_keys[piece][to];
+  }
+  board_[from] = NO_PIECE;
+  board_[to] = piece;
+  types_[piece & 7] ^= b;
+  colors_[ColorOf(piece)] ^= b;
+  occupied_ ^= b;
+  if (TypeOf(piece) == KING) {
+    king_square_[ColorOf(piece)] = to;
+  }
+}
+
+void Position::recordChange(int piece, int from, int to) {
+  PieceChanges &changes = state().changes;
+  if (changes.count < MAX_PIECE_CHANGES) {
+    PieceChange &change = changes.list[changes.count++];
+    change.piece = piece;
+    change.from = from;
+    change.to = to;
+  } else {
+    forgetChanges();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Marks the current position's changes as unknown, so that consumers rebuild
+// whatever they derive from the board. Used by edits, which are not moves.
+//------------------------------------------------------------------------------
+void Position::forgetChanges() {
+  state().changes.count = MAX_PIECE_CHANGES + 1;
+}
+
+void Position::setCastling(int rights) {
+  State &st = state();
+  st.key ^= castling_keys[st.castling] ^ castling_keys[rights];
+  st.castling = rights;
+}
+
+void Position::setEpSquare(int square) {
+  State &st = state();
+  if (st.ep_square != NO_SQUARE) {
+    st.key ^= ep_keys[ColOf(st.ep_square)];
+  }
+  if (square != NO_SQUARE) {
+    st.key ^= ep_keys[ColOf(square)];
+  }
+  st.ep_square = square;
+}
+
+//------------------------------------------------------------------------------
+// Starts a new undo record, copying what carries over from the previous one.
+// When the stack fills up (only in very long games) the oldest records are
+// dropped; they are too old to matter for repetitions or the fifty-move rule.
+//------------------------------------------------------------------------------
+Position::State *Position::pushState() {
+  if (ply_ + 1 >= MAX_GAME_PLY) {
+    const int kKeep = 256;
+    memmove(&history_[0], &history_[ply_ + 1 - kKeep], kKeep * sizeof(State));
+    ply_ = kKeep - 1;
+  }
+  const State &prev = history_[ply_];
+  State *st = &history_[++ply_];
+  st->captured = NO_PIECE;
+  st->castling = prev.castling;
+  st->ep_square = prev.ep_square;
+  st->halfmove_clock = prev.halfmove_clock + 1;
+  st->plies_from_null = prev.plies_from_null + 1;
+  st->key = prev.key ^ side_key;
+  st->pawn_key = prev.pawn_key;
+  st->changes.count = 0;
+  return st;
+}
+
+//------------------------------------------------------------------------------
+// Returns true if the position is drawn by the fifty-move rule or by
+// repetition. Inside the search tree ("ply" moves from the root) a single
+// repetition counts; positions from before the root must occur three times.
+//------------------------------------------------------------------------------
+bool Position::isDraw(int ply) const {
+  const State &st = state();
+  if (st.halfmove_clock >= 100) {
+    return true;
+  }
+  int end = st.halfmove_clock < st.plies_from_null ? st.halfmove_clock :
+                                                     st.plies_from_null;
+  int count = 0;
+  for (int i = 4; i <= end && i <= ply_; i += 2) {
+    if (history_[ply_ - i].key == st.key) {
+      if (i <= ply || ++count == 2) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Returns how many times the current position occurred before (so 2 means it
+// has now appeared three times).
+//------------------------------------------------------------------------------
+int Position::repetitions() const {
+  const State &st = state();
+  int end = st.halfmove_clock < st.plies_from_null ? st.halfmove_clock :
+                                                     st.plies_from_null;
+  int count = 0;
+  for (int i = 4; i <= end && i <= ply_; i += 2) {
+    count += history_[ply_ - i].key == st.key;
+  }
+  return count;
+}
+
+//------------------------------------------------------------------------------
+// Returns all pieces (of both colors) attacking "square", treating "occupied"
+// as the set of occupied squares.
+//------------------------------------------------------------------------------
+Bitboard Position::attackersTo(int square, Bitboard occupied) const {
+  return (PawnAttacks(BLACK, square) & pieces(WHITE, PAWN)) |
+         (PawnAttacks(WHITE, square) & pieces(BLACK, PAWN)) |
+         (KnightAttacks(square) & piecesOfType(KNIGHT)) |
+         (KingAttacks(square) & piecesOfType(KING)) |
+         (RookAttacks(square, occupied) &
+          (piecesOfType(ROOK) | piecesOfType(QUEEN))) |
+         (BishopAttacks(square, occupied) &
+          (piecesOfType(BISHOP) | piecesOfType(QUEEN)));
+}
+
+//------------------------------------------------------------------------------
+// Returns the pieces of "color" that are the only thing standing between the
+// king on "square" and an enemy slider, i.e., that are pinned.
+//------------------------------------------------------------------------------
+Bitboard Position::sliderBlockers(int square, int color) const {
+  int them = color ^ 1;
+  Bitboard blockers = 0;
+  Bitboard snipers =
+      ((RookAttacks(square, 0) & (pieces(them, ROOK) | pieces(them, QUEEN))) |
+       (BishopAttacks(square, 0) &
+        (pieces(them, BISHOP) | pieces(them, QUEEN))));
+  while (snipers) {
+    Bitboard b = Between(square, PopLowestSquare(snipers)) & occupied_;
+    if (b && !MoreThanOne(b)) {
+      blockers |= b;
+    }
+  }
+  return blockers & colors_[color];
+}
+
+void Position::updateCheckInfo() {
+  State &st = state();
+  int king = king_square_[side_to_move_];
+  if (king == NO_SQUARE) {
+    st.checkers = st.blockers = 0;
+    return;
+  }
+  st.checkers = attackersTo(king, occupied_) & colors_[side_to_move_ ^ 1];
+  st.blockers = sliderBlockers(king, side_to_move_);
+}
+
+//------------------------------------------------------------------------------
+// Tests whether a pseudo-legal move leaves the mover's king out of check.
+// Castling moves are fully checked during generation.
+//------------------------------------------------------------------------------
+bool Position::isLegal(Move m) const {
+  int us = side_to_move_, them = us ^ 1;
+  int from = FromSquare(m), to = ToSquare(m);
+  int king = king_square_[us];
+
+  if (FlagOf(m) == EN_PASSANT) {
+    int captured = to + (us == WHITE ? -8 : 8);
+    Bitboard occupied = (occupied_ ^ SquareBB(from) ^ SquareBB(captured)) |
+                        SquareBB(to);
+    return !(attackersTo(king, occupied) & colors_[them] &
+             ~SquareBB(captured));
+  }
+  if (from == king) {
+    return IsCastle(m) ||
+           !(attackersTo(to, occupied_ ^ SquareBB(from)) & colors_[them]);
+  }
+  Bitboard checkers = state().checkers;
+  if (checkers) {
+    if (MoreThanOne(checkers)) {
+      return false;
+    }
+    int checker = LowestSquare(checkers);
+    if (!((Between(king, checker) | checkers) & SquareBB(to))) {
+      return false;
+    }
+  }
+  return !(state().blockers & SquareBB(from)) ||
+         (Line(from, to) & SquareBB(king));
+}
+
+void Position::doMove(Move m) {
+  State &st = *pushState();
+  int us = side_to_move_, them = us ^ 1;
+  int from = FromSquare(m), to = ToSquare(m), flag = FlagOf(m);
+  int piece = board_[from];
+
+  st.move = m;
+  setEpSquare(NO_SQUARE);
+
+  if (flag == EN_PASSANT) {
+    int captured = to + (us == WHITE ? -8 : 8);
+    st.captured = board_[captured];
+    removePiece(captured);
+  } else if (flag & CAPTURE) {
+    st.captured = board_[to];
+    removePiece(to);
+  } else if (IsCastle(m)) {
+    int rook_from, rook_to;
+    CastlingRookSquares(flag, to, &rook_from, &rook_to);
+    movePiece(rook_from, rook_to);
+  }
+  movePiece(from, to);
+
+  if (TypeOf(piece) == PAWN) {
+    st.halfmove_clock = 0;
+    if (flag == DOUBLE_PAWN_PUSH) {
+      int ep = (from + to) / 2;
+      if (PawnAttacks(us, ep) & pieces(them, PAWN)) {
+        setEpSquare(ep);
+      }
+    } else if (IsPromotion(m)) {
+      removePiece(to);
+      putPiece(MakePiece(us, PromotionType(m)), to);
+    }
+  }
+  if (st.captured != NO_PIECE) {
+    st.halfmove_clock = 0;
+  }
+  if (st.castling) {
+    setCastling(st.castling & castling_mask[from] & castling_mask[to]);
+  }
+
+  side_to_move_ = them;
+  if (us == BLACK) {
+    ++fullmove_number_;
+  }
+  updateCheckInfo();
+}
+
+void Position::undoMove() {
+  forgetChanges();  // The record is dropped along with the state.
+  const State &st = state();
+  Move m = st.move;
+  int us = side_to_move_ ^ 1;
+  int from = FromSquare(m), to = ToSquare(m), flag = FlagOf(m);
+
+  side_to_move_ = us;
+  if (us == BLACK) {
+    --fullmove_number_;
+  }
+  if (IsPromotion(m)) {
+    removePiece(to);
+    putPiece(MakePiece(us, PAWN), to);
+  }
+  movePiece(to, from);
+  if (IsCastle(m)) {
+    int rook_from, rook_to;
+    CastlingRookSquares(flag, to, &rook_from, &rook_to);
+    movePiece(rook_to, rook_from);
+  } else if (st.captured != NO_PIECE) {
+    putPiece(st.captured,
+             flag == EN_PASSANT ? to + (us == WHITE ? -8 : 8) : to);
+  }
+  --ply_;
+}
+
+//------------------------------------------------------------------------------
+// Passes the turn to the opponent. Only legal when not in check; used by the
+// search for null-move pruning.
+//------------------------------------------------------------------------------
+void Position::doNullMove() {
+  State &st = *pushState();
+  st.move = NO_MOVE;
+  st.plies_from_null = 0;
+  setEpSquare(NO_SQUARE);
+  side_to_move_ ^= 1;
+  updateCheckInfo();
+}
+
+void Position::undoNullMove() {
+  side_to_move_ ^= 1;
+  --ply_;
+}
+
+//------------------------------------------------------------------------------
+// Moves whatever stands on "from" to "to", removing anything already on "to".
+// Unlike doMove(), this is an editing operation: it is not recorded and cannot
+// be undone.
+//------------------------------------------------------------------------------
+void Position::relocatePiece(int from, int to) {
+  if (from == to || board_[from] == NO_PIECE) {
+    return;
+  }
+  if (board_[to] != NO_PIECE) {
+    removePiece(to);
+  }
+  movePiece(from, to);
+  setCastling(castlingRights() & castling_mask[from] & castling_mask[to]);
+  setEpSquare(NO_SQUARE);
+  state().plies_from_null = 0;
+  forgetChanges();
+  updateCheckInfo();
+}
+
+void Position::clearSquare(int square) {
+  int piece = board_[square];
+  if (piece == NO_PIECE) {
+    return;
+  }
+  removePiece(square);
+  if (TypeOf(piece) == KING) {
+    king_square_[ColorOf(piece)] = NO_SQUARE;
+  }
+  setCastling(castlingRights() & castling_mask[square]);
+  setEpSquare(NO_SQUARE);
+  state().plies_from_null = 0;
+  forgetChanges();
+  updateCheckInfo();
+}
+
+namespace {
+
+// Adds a move for each target in "targets", labeling captures.
+inline void AddPieceMoves(const Position &pos, int from, Bitboard targets,
+                          MoveList *list) {
+  Bitboard them = pos.pieces(pos.sideToMove() ^ 1);
+  while (targets) {
+    int to = PopLowestSquare(targets);
+    list->add(MakeMove(from, to, (them & SquareBB(to)) ? CAPTURE : QUIET_MOVE));
+  }
+}
+
+inline void AddPromotions(int from, int to, bool capture, GenType type,
+                          MoveList *list) {
+  int base = capture ? KNIGHT_PROMOTION_CAPTURE : KNIGHT_PROMOTION;
+  if (type != GEN_QUIETS) {
+    list->add(MakeMove(from, to, base + 3));
+  }
+  // Underpromotions count as captures only when they capture:
+  if ((capture && type != GEN_QUIETS) || (!capture && type != GEN_CAPTURES)) {
+    for (int i = 0; i < 3; ++i) {
+      list->add(MakeMove(from, to, base + i));
+    }
+  }
+}
+
+void GeneratePawnMoves(const Position &pos, GenType type, MoveList *list) {
+  int us = pos.sideToMove(), them = us ^ 1;
+  int up = us == WHITE ? 8 : -8;
+  Bitboard empty = ~pos.pieces();
+  Bitboard enemies = pos.pieces(them);
+  Bitboard pawns = pos.pieces(us, PAWN);
+  Bitboard last_rank = us == WHITE ? RANK_7_BB : RANK_2_BB;
+  Bitboard double_rank = us == WHITE ? RANK_4_BB : RANK_5_BB;
+  Bitboard promoting = pawns & last_rank;
+  Bitboard others = pawns & ~last_rank;
+
+  if (type != GEN_CAPTURES) {
+    Bitboard single = PawnPush(others, us) & empty;
+    Bitboard twice = PawnPush(single, us) & empty & double_rank;
+    while (single) {
+      int to = PopLowestSquare(single);
+      list->add(MakeMove(to - up, to, QUIET_MOVE));
+    }
+    while (twice) {
+      int to = PopLowestSquare(twice);
+      list->add(MakeMove(to - 2 * up, to, DOUBLE_PAWN_PUSH));
+    }
+  }
+
+  Bitboard pushes = PawnPush(promoting, us) & empty;
+  while (pushes) {
+    int to = PopLowestSquare(pushes);
+    AddPromotions(to - up, to, false, type, list);
+  }
+
+  if (type == GEN_QUIETS) {
+    return;
+  }
+  while (promoting) {
+    int from = PopLowestSquare(promoting);
+    Bitboard targets = PawnAttacks(us, from) & enemies;
+    while (targets) {
+      AddPromotions(from, PopLowestSquare(targets), true, type, list);
+    }
+  }
+  Bitboard b = others;
+  while (b) {
+    int from = PopLowestSquare(b);
+    Bitboard targets = PawnAttacks(us, from) & enemies;
+    while (targets) {
+      list->add(MakeMove(from, PopLowestSquare(targets), CAPTURE));
+    }
+  }
+  int ep = pos.epSquare();
+  if (ep != NO_SQUARE) {
+    Bitboard attackers = others & PawnAttacks(them, ep);
+    while (attackers) {
+      list->add(MakeMove(PopLowestSquare(attackers), ep, EN_PASSANT));
+    }
+  }
+}
+
+void GenerateCastling(const Position &pos, MoveList *list) {
+  int us = pos.sideToMove(), them = us ^ 1;
+  int rights = pos.castlingRights() & (us == WHITE ? WHITE_OO | WHITE_OOO :
+                                                     BLACK_OO | BLACK_OOO);
+  if (!rights || pos.inCheck()) {
+    return;
+  }
+  int king = pos.kingSquare(us);
+  Bitboard occupied = pos.pieces();
+  Bitboard enemies = pos.pieces(them);
+  if ((rights & (WHITE_OO | BLACK_OO)) &&
+      !(Between(king, king + 3) & occupied) &&
+      !(pos.attackersTo(king + 1, occupied) & enemies) &&
+      !(pos.attackersTo(king + 2, occupied) & enemies)) {
+    list->add(MakeMove(king, king + 2, KING_CASTLE));
+  }
+  if ((rights & (WHITE_OOO | BLACK_OOO)) &&
+      !(Between(king, king - 4) & occupied) &&
+      !(pos.attackersTo(king - 1, occupied) & enemies) &&
+      !(pos.attackersTo(king - 2, occupied) & enemies)) {
+    list->add(MakeMove(king, king - 2, QUEEN_CASTLE));
+  }
+}
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+// Appends pseudo-legal moves of the requested kind to "list". Moves may leave
+// the mover's king in check; filter them with Position::isLegal().
+//------------------------------------------------------------------------------
+void GenerateMoves(const Position &pos, GenType type, MoveList *list) {
+  int us = pos.sideToMove();
+  Bitboard occupied = pos.pieces();
+  Bitboard targets = type == GEN_CAPTURES ? pos.pieces(us ^ 1) :
+                     type == GEN_QUIETS   ? ~occupied :
+                                            ~pos.pieces(us);
+
+  GeneratePawnMoves(pos, type, list);
+
+  Bitboard b = pos.pieces(us, KNIGHT);
+  while (b) {
+    int from = PopLowestSquare(b);
+    AddPieceMoves(pos, from, KnightAttacks(from) & targets, list);
+  }
+  b = pos.pieces(us, BISHOP);
+  while (b) {
+    int from = PopLowestSquare(b);
+    AddPieceMoves(pos, from, BishopAttacks(from, occupied) & targets, list);
+  }
+  b = pos.pieces(us, ROOK);
+  while (b) {
+    int from = PopLowestSquare(b);
+    AddPieceMoves(pos, from, RookAttacks(from, occupied) & targets, list);
+  }
+  b = pos.pieces(us, QUEEN);
+  while (b) {
+    int from = PopLowestSquare(b);
+    AddPieceMoves(pos, from, QueenAttacks(from, occupied) & targets, list);
+  }
+  int king = pos.kingSquare(us);
+  AddPieceMoves(pos, king, KingAttacks(king) & targets, list);
+
+  if (type != GEN_CAPTURES) {
+    GenerateCastling(pos, list);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Tests whether GenerateMoves() would produce "m" in this position. Moves
+// remembered from other positions (the hash move, killers) must pass this
+// before they are tried, since isLegal() assumes a pseudo-legal move.
+//------------------------------------------------------------------------------
+bool Position::isPseudoLegal(Move m) const {
+  int us = side_to_move_, them = us ^ 1;
+  int from = FromSquare(m), to = ToSquare(m), flag = FlagOf(m);
+  int piece = board_[from];
+  if (m == NO_MOVE || piece == NO_PIECE || ColorOf(piece) != us ||
+      (colors_[us] & SquareBB(to))) {
+    return false;
+  }
+  if (IsCastle(m)) {
+    MoveList list;
+    GenerateCastling(*this, &list);
+    for (int i = 0; i < list.size; ++i) {
+      if (list.moves[i] == m) {
+        return true;
+      }
+    }
+    return false;
+  }
+  if (flag == EN_PASSANT) {
+    return TypeOf(piece) == PAWN && to == state().ep_square &&
+           (PawnAttacks(us, from) & SquareBB(to));
+  }
+  if (IsCapture(m) != ((colors_[them] & SquareBB(to)) != 0)) {
+    return false;
+  }
+  if (TypeOf(piece) == PAWN) {
+    int up = us == WHITE ? 8 : -8;
+    if (IsPromotion(m) != ((SquareBB(to) & (RANK_1_BB | RANK_8_BB)) != 0)) {
+      return false;
+    }
+    if (IsCapture(m)) {
+      return PawnAttacks(us, from) & SquareBB(to);
+    }
+    if (flag == DOUBLE_PAWN_PUSH) {
+      return to == from + 2 * up && board_[from + up] == NO_PIECE &&
+             (SquareBB(to) & (us == WHITE ? RANK_4_BB : RANK_5_BB));
+    }
+    return to == from + up;  // The target is empty, as checked above.
+  }
+  if (flag != QUIET_MOVE && flag != CAPTURE) {
+    return false;
+  }
+  Bitboard attacks;
+  switch (TypeOf(piece)) {
+    case KNIGHT: attacks = KnightAttacks(from); break;
+    case BISHOP: attacks = BishopAttacks(from, occupied_); break;
+    case ROOK:   attacks = RookAttacks(from, occupied_); break;
+    case QUEEN:  attacks = QueenAttacks(from, occupied_); break;
+    default:     attacks = KingAttacks(from); break;
+  }
+  return attacks & SquareBB(to);
+}
+
+void GenerateLegalMoves(const Position &pos, MoveList *list) {
+  MoveList pseudo;
+  GenerateMoves(pos, GEN_ALL, &pseudo);
+  list->size = 0;
+  for (int i = 0; i < pseudo.size; ++i) {
+    if (pos.isLegal(pseudo.moves[i])) {
+      list->add(pseudo.moves[i]);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Returns a move in UCI coordinate notation (e.g., "e2e4" or "e7e8q").
+//------------------------------------------------------------------------------
+string MoveToString(Move m) {
+  if (m == NO_MOVE) {
+    return "0000";
+  }
+  string s;
+  s += (char) ('a' + ColOf(FromSquare(m)));
+  s += (char) ('1' + RowOf(FromSquare(m)));
+  s += (char) ('a' + ColOf(ToSquare(m)));
+  s += (char) ('1' + RowOf(ToSquare(m)));
+  if (IsPromotion(m)) {
+    s += "nbrq"[FlagOf(m) & 3];
+  }
+  return s;
+}
+
+//------------------------------------------------------------------------------
+// Returns the legal move in "pos" written as "text" in UCI coordinate
+// notation, or NO_MOVE if there is none.
+//------------------------------------------------------------------------------
+Move ParseMove(const Position &pos, const string &text) {
+  MoveList list;
+  GenerateLegalMoves(pos, &list);
+  for (int i = 0; i < list.size; ++i) {
+    if (MoveToString(list.moves[i]) == text) {
+      return list.moves[i];
+    }
+  }
+  return NO_MOVE;
+}
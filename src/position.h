@@ -0,0 +1,220 @@
+/*******************************************************************************
+   Filename: position.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the Position class, a bitboard representation of
+             a chess position, and for the move generator that works on it.
+*******************************************************************************/
+
+#ifndef POSITION_H_
+#define POSITION_H_
+
+#include <cstdint>
+#include <string>
+#include "bitboard.h"
+#include "chess_piece.h"
+
+#define NUM_PIECE_TYPES (NUM_CHESS_PIECE_TYPES - PAWN)
+#define MAX_MOVES       256  // More than any legal chess position allows.
+#define MAX_GAME_PLY    1024
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Files that store Position::key() values (the game database index) record
+// this number; change it whenever the keys change.
+#define POSITION_KEY_VERSION 1
+
+// A piece on the board packs its color and zero-based type index into one
+// small integer: (color << 3) | (type - PAWN).
+#define NO_PIECE   -1
+#define NUM_PIECES 16
+
+constexpr int MakePiece(int color, int type) {
+  return (color << 3) | (type - PAWN);
+}
+constexpr int TypeOf(int piece) { return PAWN + (piece & 7); }
+constexpr int ColorOf(int piece) { return piece >> 3; }
+
+// Castling rights:
+#define WHITE_OO       1
+#define WHITE_OOO      2
+#define BLACK_OO       4
+#define BLACK_OOO      8
+#define ALL_CASTLING   15
+
+// A move is packed into 16 bits: from (6), to (6), and flags (4).
+typedef uint16_t Move;
+
+#define NO_MOVE 0
+
+enum MoveFlag {
+  QUIET_MOVE = 0,
+  DOUBLE_PAWN_PUSH,
+  KING_CASTLE,
+  QUEEN_CASTLE,
+  CAPTURE,
+  EN_PASSANT,
+  KNIGHT_PROMOTION = 8,
+  BISHOP_PROMOTION,
+  ROOK_PROMOTION,
+  QUEEN_PROMOTION,
+  KNIGHT_PROMOTION_CAPTURE,
+  BISHOP_PROMOTION_CAPTURE,
+  ROOK_PROMOTION_CAPTURE,
+  QUEEN_PROMOTION_CAPTURE
+};
+
+inline Move MakeMove(int from, int to, int flag) {
+  return (Move) (from | (to << 6) | (flag << 12));
+}
+inline int FromSquare(Move m) { return m & 63; }
+inline int ToSquare(Move m) { return (m >> 6) & 63; }
+inline int FlagOf(Move m) { return m >> 12; }
+inline bool IsCapture(Move m) { return FlagOf(m) & CAPTURE; }
+inline bool IsPromotion(Move m) { return FlagOf(m) & KNIGHT_PROMOTION; }
+inline bool IsCastle(Move m) {
+  return FlagOf(m) == KING_CASTLE || FlagOf(m) == QUEEN_CASTLE;
+}
+inline int PromotionType(Move m) {
+  static const int kTypes[4] = { KNIGHT, BISHOP, ROOK, QUEEN };
+  return kTypes[FlagOf(m) & 3];
+}
+
+// One piece added to, removed from, or moved across the board. A move's
+// changes let consumers such as the NNUE accumulators follow the board without
+// rescanning it.
+#define MAX_PIECE_CHANGES 4  // A capturing promotion changes the most.
+
+struct PieceChange {
+  int8_t piece;
+  int8_t from;  // NO_SQUARE for a piece put on the board.
+  int8_t to;    // NO_SQUARE for a piece taken off it.
+};
+
+struct PieceChanges {
+  int8_t count;  // Above MAX_PIECE_CHANGES if the changes were not recorded.
+  PieceChange list[MAX_PIECE_CHANGES];
+};
+
+// Fixed-size move buffer; lives on the stack so generation never allocates.
+struct MoveList {
+  Move moves[MAX_MOVES];
+  int size;
+
+  MoveList() : size(0) {}
+  void add(Move m) { moves[size++] = m; }
+  const Move *begin() const { return moves; }
+  const Move *end() const { return moves + size; }
+};
+
+enum GenType {
+  GEN_CAPTURES,  // Captures and queen promotions.
+  GEN_QUIETS,    // Everything else.
+  GEN_ALL
+};
+
+class Position {
+ public:
+  Position();
+  static void initTables();
+
+  bool setFen(const std::string &fen);
+  std::string fen() const;
+
+  int pieceOn(int square) const { return board_[square]; }
+  Bitboard pieces() const { return occupied_; }
+  Bitboard pieces(int color) const { return colors_[color]; }
+  Bitboard piecesOfType(int type) const { return types_[type - PAWN]; }
+  Bitboard pieces(int color, int type) const {
+    return colors_[color] & types_[type - PAWN];
+  }
+  int sideToMove() const { return side_to_move_; }
+  int castlingRights() const { return state().castling; }
+  int epSquare() const { return state().ep_square; }
+  int halfmoveClock() const { return state().halfmove_clock; }
+  int fullmoveNumber() const { return fullmove_number_; }
+  int kingSquare(int color) const { return king_square_[color]; }
+  Bitboard checkers() const { return state().checkers; }
+  bool inCheck() const { return state().checkers != 0; }
+  int capturedPiece() const { return state().captured; }
+  Move lastMove() const { return state().move; }  // NO_MOVE after a null.
+
+  uint64_t key() const { return state().key; }
+  uint64_t pawnKey() const { return state().pawn_key; }  // Pawns only.
+  // The key and board changes of the position "plies_ago" moves back (0 is
+  // the current one), which must not predate the moves made since setFen():
+  uint64_t keyAt(int plies_ago) const {
+    return history_[ply_ - plies_ago].key;
+  }
+  const PieceChanges &changesAt(int plies_ago) const {
+    return history_[ply_ - plies_ago].changes;
+  }
+  bool isDraw(int ply) const;
+  int repetitions() const;
+
+  Bitboard attackersTo(int square, Bitboard occupied) const;
+  bool isLegal(Move m) const;
+  bool isPseudoLegal(Move m) const;
+
+  void doMove(Move m);
+  void undoMove();
+  void doNullMove();
+  void undoNullMove();
+
+  // Board editing outside of normal play (used by ChessPiece):
+  void relocatePiece(int from, int to);
+  void clearSquare(int square);
+
+ private:
+  // Everything doMove() cannot recompute when the move is taken back.
+  struct State {
+    Move move;
+    int8_t captured;
+    int8_t castling;
+    int8_t ep_square;
+    int16_t halfmove_clock;
+    int16_t plies_from_null;  // Also reset by board edits.
+    uint64_t key;
+    uint64_t pawn_key;
+    Bitboard checkers;
+    Bitboard blockers;  // The mover's pieces pinned to its own king.
+    PieceChanges changes;  // What the move did to the board.
+  };
+
+  const State &state() const { return history_[ply_]; }
+  State &state() { return history_[ply_]; }
+
+  // All board changes funnel through these three, which also keep the
+  // Zobrist key current and record the changes:
+  void putPiece(int piece, int square);
+  void removePiece(int square);
+  void movePiece(int from, int to);
+  void recordChange(int piece, int from, int to);
+  void forgetChanges();
+  void setCastling(int rights);
+  void setEpSquare(int square);
+
+  State *pushState();
+  void clear();
+  uint64_t computeKey() const;
+  void updateCheckInfo();
+  Bitboard sliderBlockers(int square, int color) const;
+
+  int board_[NUM_SQUARES];
+  Bitboard types_[NUM_PIECE_TYPES];
+  Bitboard colors_[NUM_CHESS_PIECE_COLORS];
+  Bitboard occupied_;
+  int king_square_[NUM_CHESS_PIECE_COLORS];
+  int side_to_move_;
+  int fullmove_number_;
+  int ply_;
+  State history_[MAX_GAME_PLY];
+};
+
+void GenerateMoves(const Position &pos, GenType type, MoveList *list);
+void GenerateLegalMoves(const Position &pos, MoveList *list);
+
+std::string MoveToString(Move m);
+Move ParseMove(const Position &pos, const std::string &text);
+
+#endif  // POSITION_H_
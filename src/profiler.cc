@@ -0,0 +1,174 @@
+/*******************************************************************************
+   Filename: profiler.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Method definitions for the Profiler and FrameTimeLog classes.
+*******************************************************************************/
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+atomic<int> next_thread(1);
+
+int ThreadNumber() {
+  thread_local int number = next_thread.fetch_add(1, memory_order_relaxed);
+  return number;
+}
+
+}  // namespace
+
+Profiler::Profiler()
+    : start_(chrono::steady_clock::now()),
+      slots_(new Slot[PROFILER_EVENTS]),
+      head_(0),
+      frames_(),
+      phase_totals_(),
+      frame_count_(0),
+      draw_calls_(0),
+      vertices_(0) {
+  for (int i = 0; i < PROFILER_EVENTS; ++i) {
+    slots_[i].sequence.store(0, memory_order_relaxed);
+  }
+}
+
+uint64_t Profiler::now() const {
+  return chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now() - start_).count();
+}
+
+void Profiler::record(const char *name, uint64_t start, uint64_t end) {
+  uint64_t index = head_.fetch_add(1, memory_order_relaxed);
+  Slot &slot = slots_[index & (PROFILER_EVENTS - 1)];
+  slot.sequence.store(0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  slot.name.store(name, memory_order_relaxed);
+  slot.start.store(start, memory_order_relaxed);
+  slot.duration.store(end - start, memory_order_relaxed);
+  slot.thread.store(ThreadNumber(), memory_order_relaxed);
+  slot.sequence.store(index + 1, memory_order_release);
+}
+
+vector<ProfileEvent> Profiler::events() const {
+  vector<ProfileEvent> events;
+  uint64_t head = head_.load(memory_order_acquire);
+  uint64_t first = head > PROFILER_EVENTS ? head - PROFILER_EVENTS : 0;
+  events.reserve(head - first);
+  for (uint64_t index = first; index < head; ++index) {
+    const Slot &slot = slots_[index & (PROFILER_EVENTS - 1)];
+    if (slot.sequence.load(memory_order_acquire) != index + 1) {
+      continue;  // Still being written, or already overwritten.
+    }
+    ProfileEvent event;
+    event.name = slot.name.load(memory_order_relaxed);
+    event.start = slot.start.load(memory_order_relaxed);
+    event.duration = slot.duration.load(memory_order_relaxed);
+    event.thread = slot.thread.load(memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (slot.sequence.load(memory_order_relaxed) == index + 1) {
+      events.push_back(event);
+    }
+  }
+  sort(events.begin(), events.end(),
+       [](const ProfileEvent &a, const ProfileEvent &b) {
+         return a.start < b.start;
+       });
+  return events;
+}
+
+void Profiler::endFrame(uint64_t start, uint64_t end, int draw_calls,
+                        long vertices, const uint64_t phases[],
+                        int num_phases) {
+  FrameSample &sample = frames_[frame_count_ % PROFILER_FRAMES];
+  sample.start = start;
+  sample.duration = end - start;
+  for (int i = 0; i < PROFILER_PHASES; ++i) {
+    // The sample being replaced leaves the window:
+    phase_totals_[i] -= sample.phases[i];
+    sample.phases[i] = i < num_phases ? phases[i] : 0;
+    phase_totals_[i] += sample.phases[i];
+  }
+  ++frame_count_;
+  draw_calls_ = draw_calls;
+  vertices_ = vertices;
+}
+
+FrameStats Profiler::frameStats() const {
+  FrameStats stats = FrameStats();
+  stats.frames = (int) min(frame_count_, (long) PROFILER_FRAMES);
+  stats.draw_calls = draw_calls_;
+  stats.vertices = vertices_;
+  if (stats.frames == 0) {
+    return stats;
+  }
+  vector<uint64_t> durations(stats.frames);
+  uint64_t total = 0;
+  for (int i = 0; i < stats.frames; ++i) {
+    durations[i] = frames_[i].duration;
+    total += durations[i];
+  }
+  size_t p99 = (durations.size() * 99) / 100;
+  nth_element(durations.begin(), durations.begin() + p99, durations.end());
+  stats.p99_ms = durations[p99] / 1e6;
+  stats.min_ms = *min_element(durations.begin(), durations.end()) / 1e6;
+  stats.average_ms = total / 1e6 / stats.frames;
+  return stats;
+}
+
+double Profiler::phaseAverageMs(int phase) const {
+  long frames = min(frame_count_, (long) PROFILER_FRAMES);
+  return frames ? phase_totals_[phase] / 1e6 / frames : 0;
+}
+
+//------------------------------------------------------------------------------
+// Writes the recorded events as complete ("X") events in the Trace Event
+// Format, with times in microseconds. Returns false on error.
+//------------------------------------------------------------------------------
+bool Profiler::writeChromeTrace(const string &filename) const {
+  FILE *file = fopen(filename.c_str(), "w");
+  if (!file) {
+    cerr << "Error: cannot write " << filename << endl;
+    return false;
+  }
+  vector<ProfileEvent> all = events();
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (size_t i = 0; i < all.size(); ++i) {
+    fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%.3f,\"dur\":%.3f}%s\n", all[i].name, all[i].thread,
+            all[i].start / 1e3, all[i].duration / 1e3,
+            i + 1 < all.size() ? "," : "");
+  }
+  fprintf(file, "]}\n");
+  if (fclose(file) != 0) {
+    cerr << "Error: cannot write " << filename << endl;
+    return false;
+  }
+  return true;
+}
+
+string FrameTimeLog::summary() const {
+  if (durations_.empty()) {
+    return "0 frames";
+  }
+  vector<uint64_t> sorted(durations_);
+  sort(sorted.begin(), sorted.end());
+  uint64_t total = 0;
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    total += sorted[i];
+  }
+  double mean = total / 1e6 / sorted.size();
+  char line[160];
+  snprintf(line, sizeof(line), "%zu frames: min %.2f, mean %.2f, median "
+           "%.2f, p99 %.2f, max %.2f ms (%.0f fps)", sorted.size(),
+           sorted.front() / 1e6, mean, sorted[sorted.size() / 2] / 1e6,
+           sorted[(sorted.size() * 99) / 100] / 1e6, sorted.back() / 1e6,
+           mean > 0 ? 1000 / mean : 0);
+  return line;
+}
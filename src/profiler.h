@@ -0,0 +1,141 @@
+/*******************************************************************************
+   Filename: profiler.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the Profiler class, which records how long named
+             stretches of code take. Timings go into a fixed-size ring buffer
+             that any thread may write without locking; the oldest events are
+             overwritten once it is full. The viewer also hands it a summary
+             of every frame, from which it reports frame-time statistics, and
+             the recorded events can be saved in Chrome's trace format (open
+             the file at chrome://tracing or https://ui.perfetto.dev).
+             FrameTimeLog keeps the statistics for runs of any length.
+*******************************************************************************/
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define PROFILER_EVENTS 65536  // Ring buffer capacity; a power of two.
+#define PROFILER_FRAMES 240    // Frames kept for statistics.
+#define PROFILER_PHASES 8      // Phases of a frame averaged for the overlay.
+
+struct ProfileEvent {
+  const char *name;   // A string literal.
+  uint64_t start;     // Nanoseconds since the profiler was created.
+  uint64_t duration;  // Nanoseconds.
+  int thread;         // Numbered from 1 in order of first use.
+};
+
+// Statistics over the last PROFILER_FRAMES frames, in milliseconds.
+struct FrameStats {
+  int frames;  // 0 before the first frame.
+  double min_ms;
+  double average_ms;
+  double p99_ms;
+  int draw_calls;  // In the latest frame.
+  long vertices;   // In the latest frame.
+};
+
+class Profiler {
+ public:
+  Profiler();
+
+  uint64_t now() const;  // Nanoseconds since the profiler was created.
+  void record(const char *name, uint64_t start, uint64_t end);
+
+  // Returns the events still in the ring, oldest first. Safe to call while
+  // other threads are recording; events overwritten meanwhile are left out.
+  std::vector<ProfileEvent> events() const;
+
+  // Frame summaries, from the thread that draws only. "phases" holds the
+  // time spent in each of "num_phases" (at most PROFILER_PHASES) parts of the
+  // frame, whose averages are kept as running sums so that reading them
+  // costs nothing.
+  void endFrame(uint64_t start, uint64_t end, int draw_calls, long vertices,
+                const uint64_t phases[], int num_phases);
+  FrameStats frameStats() const;
+  double phaseAverageMs(int phase) const;  // Over the frames in frameStats().
+
+  bool writeChromeTrace(const std::string &filename) const;
+
+ private:
+  // An event plus a sequence number: 0 while being written, and otherwise
+  // one more than the event's position in the stream of all events. Readers
+  // keep an event only if the number is right both before and after reading
+  // it, as in a seqlock.
+  struct Slot {
+    std::atomic<uint64_t> sequence;
+    std::atomic<const char *> name;
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> duration;
+    std::atomic<int> thread;
+  };
+
+  struct FrameSample {
+    uint64_t start;
+    uint64_t duration;
+    uint64_t phases[PROFILER_PHASES];
+  };
+
+  Profiler(const Profiler &);  // Not copyable.
+  Profiler &operator=(const Profiler &);
+
+  std::chrono::steady_clock::time_point start_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<uint64_t> head_;  // Events ever recorded.
+  FrameSample frames_[PROFILER_FRAMES];
+  uint64_t phase_totals_[PROFILER_PHASES];  // Over the samples in "frames_".
+  long frame_count_;
+  int draw_calls_;
+  long vertices_;
+};
+
+// Records the time from its construction to the end of its scope, and adds
+// it to "*total" if that is given.
+class ProfileScope {
+ public:
+  ProfileScope(Profiler *profiler, const char *name, uint64_t *total = NULL)
+      : profiler_(profiler), name_(name), total_(total),
+        start_(profiler->now()) {}
+  ~ProfileScope() {
+    uint64_t end = profiler_->now();
+    profiler_->record(name_, start_, end);
+    if (total_) {
+      *total_ += end - start_;
+    }
+  }
+
+ private:
+  ProfileScope(const ProfileScope &);  // Not copyable.
+  ProfileScope &operator=(const ProfileScope &);
+
+  Profiler *profiler_;
+  const char *name_;
+  uint64_t *total_;
+  uint64_t start_;
+};
+
+// Every frame's duration over a whole run (a replay, say), for a report at
+// the end; the Profiler itself keeps only the latest frames.
+class FrameTimeLog {
+ public:
+  void add(uint64_t duration) { durations_.push_back(duration); }
+  size_t frames() const { return durations_.size(); }
+
+  // Returns a line such as "600 frames: min 1.20, mean 2.31, median 2.10,
+  // p99 5.33, max 9.80 ms (433 fps)".
+  std::string summary() const;
+
+ private:
+  std::vector<uint64_t> durations_;  // Nanoseconds.
+};
+
+#endif  // PROFILER_H_
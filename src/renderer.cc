@@ -0,0 +1,418 @@
+/*******************************************************************************
+   Filename: renderer.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Retained-mode renderer for the board and chess pieces.
+*******************************************************************************/
+
+#include "renderer.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+// Vertex attribute locations:
+#define ATTRIB_NORMAL    0
+#define ATTRIB_POSITION  1
+#define ATTRIB_TRANSFORM 2  // Four consecutive locations, one per column.
+#define ATTRIB_COLOR     6
+
+// The shaders reproduce OpenGL's fixed-function lighting for one directional
+// light (with a non-local viewer), evaluated per fragment.
+const char *kVertexShader =
+    "#version 330\n"
+    "layout(location = 0) in vec3 normal;\n"
+    "layout(location = 1) in vec3 position;\n"
+    "layout(location = 2) in mat4 transform;\n"
+    "layout(location = 6) in vec4 color;\n"
+    "uniform mat4 projection;\n"
+    "uniform mat4 view;\n"
+    "out vec3 eye_normal;\n"
+    "out vec4 material;\n"
+    "void main() {\n"
+    "  mat4 model_view = view * transform;\n"
+    "  eye_normal = mat3(model_view) * normal;\n"
+    "  material = color;\n"
+    "  gl_Position = projection * model_view * vec4(position, 1.0);\n"
+    "}\n";
+
+const char *kFragmentShader =
+    "#version 330\n"
+    "in vec3 eye_normal;\n"
+    "in vec4 material;\n"
+    "uniform vec3 light_direction;\n"
+    "uniform vec3 ambient;\n"
+    "uniform vec3 diffuse;\n"
+    "uniform vec3 specular;\n"
+    "uniform float shininess;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "  vec3 n = normalize(eye_normal);\n"
+    "  float lambert = max(dot(n, light_direction), 0.0);\n"
+    "  vec3 color = (ambient + lambert * diffuse) * material.rgb;\n"
+    "  if (lambert > 0.0) {\n"
+    "    vec3 h = normalize(light_direction + vec3(0.0, 0.0, 1.0));\n"
+    "    color += pow(max(dot(n, h), 0.0), shininess) * specular;\n"
+    "  }\n"
+    "  frag_color = vec4(min(color, vec3(1.0)), material.a);\n"
+    "}\n";
+
+void Identity(float m[16]) {
+  memset(m, 0, 16 * sizeof(float));
+  m[0] = m[5] = m[10] = m[15] = 1;
+}
+
+GLuint CompileShader(GLenum type, const char *source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, NULL);
+  glCompileShader(shader);
+  GLint ok;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    char log[1024];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    cerr << "Error: shader compilation failed: " << log << endl;
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+// Returns true if the current context provides at least OpenGL 3.3, which is
+// needed for instanced vertex attributes.
+bool HasInstancedArrays() {
+  const char *version = (const char *) glGetString(GL_VERSION);
+  int major = 0, minor = 0;
+  if (version == NULL || sscanf(version, "%d.%d", &major, &minor) != 2) {
+    return false;
+  }
+  return major > 3 || (major == 3 && minor >= 3);
+}
+
+}  // namespace
+
+//------------------------------------------------------------------------------
+// Places an instance at (x, y, z), turned "y_angle" degrees about the Y axis
+// and then "x_angle" degrees about the X axis, and scaled uniformly (the same
+// as glTranslate(), glRotate() and glScale() calls in that order).
+//------------------------------------------------------------------------------
+void SetInstanceTransform(RenderInstance *instance, double x, double y,
+                          double z, double x_angle, double y_angle,
+                          double scale) {
+  double a = x_angle * M_PI / 180, b = y_angle * M_PI / 180;
+  float sa = (float) sin(a), ca = (float) cos(a);
+  float sb = (float) sin(b), cb = (float) cos(b);
+  float k = (float) scale;
+  float *m = instance->transform;
+
+  // T * Ry * Rx * S, column by column:
+  m[0] = k * cb;       m[1] = 0;       m[2] = k * -sb;      m[3] = 0;
+  m[4] = k * sb * sa;  m[5] = k * ca;  m[6] = k * cb * sa;  m[7] = 0;
+  m[8] = k * sb * ca;  m[9] = k * -sa; m[10] = k * cb * ca; m[11] = 0;
+  m[12] = (float) x;
+  m[13] = (float) y;
+  m[14] = (float) z;
+  m[15] = 1;
+}
+
+void SetInstanceColor(RenderInstance *instance, const GLfloat color[4]) {
+  memcpy(instance->color, color, sizeof(instance->color));
+}
+
+Renderer::Renderer()
+    : uploaded_(false),
+      program_(0),
+      vao_(0),
+      vertex_buffer_(0),
+      index_buffer_(0),
+      instance_buffer_(0),
+      instance_capacity_(0),
+      projection_location_(-1),
+      view_location_(-1),
+      draw_calls_(0),
+      vertices_submitted_(0) {
+  Identity(projection_);
+  Identity(view_);
+}
+
+bool Renderer::init(bool allow_shaders) {
+  if (allow_shaders && HasInstancedArrays() && initShaders()) {
+    return true;
+  }
+  cerr << "Note: using the legacy (display list) renderer" << endl;
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Builds the shader program and copies the current fixed-function lighting
+// into its uniforms. Returns false (leaving the legacy path active) on error.
+//------------------------------------------------------------------------------
+bool Renderer::initShaders() {
+  GLuint vertex_shader = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+  GLuint fragment_shader = CompileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+  if (!vertex_shader || !fragment_shader) {
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    return false;
+  }
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  glLinkProgram(program);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+  GLint ok;
+  glGetProgramiv(program, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    char log[1024];
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    cerr << "Error: shader linking failed: " << log << endl;
+    glDeleteProgram(program);
+    return false;
+  }
+  program_ = program;
+  projection_location_ = glGetUniformLocation(program_, "projection");
+  view_location_ = glGetUniformLocation(program_, "view");
+
+  // GL_POSITION is returned in eye coordinates, which is what the shader
+  // wants; a directional light's position is its direction:
+  GLfloat position[4], light_diffuse[4], light_specular[4], light_ambient[4];
+  GLfloat model_ambient[4], material_specular[4], shininess;
+  glGetLightfv(GL_LIGHT0, GL_POSITION, position);
+  glGetLightfv(GL_LIGHT0, GL_DIFFUSE, light_diffuse);
+  glGetLightfv(GL_LIGHT0, GL_SPECULAR, light_specular);
+  glGetLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
+  glGetFloatv(GL_LIGHT_MODEL_AMBIENT, model_ambient);
+  glGetMaterialfv(GL_FRONT, GL_SPECULAR, material_specular);
+  glGetMaterialfv(GL_FRONT, GL_SHININESS, &shininess);
+  float length = (float) sqrt(position[0] * position[0] +
+                              position[1] * position[1] +
+                              position[2] * position[2]);
+  for (int i = 0; i < 3; ++i) {
+    position[i] = length > 0 ? position[i] / length : (i == 2);
+    light_ambient[i] += model_ambient[i];
+    light_specular[i] *= material_specular[i];
+  }
+  glUseProgram(program_);
+  glUniform3fv(glGetUniformLocation(program_, "light_direction"), 1, position);
+  glUniform3fv(glGetUniformLocation(program_, "ambient"), 1, light_ambient);
+  glUniform3fv(glGetUniformLocation(program_, "diffuse"), 1, light_diffuse);
+  glUniform3fv(glGetUniformLocation(program_, "specular"), 1,
+               light_specular);
+  glUniform1f(glGetUniformLocation(program_, "shininess"), shininess);
+  glUseProgram(0);
+
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+  glGenBuffers(1, &instance_buffer_);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Adds a model to draw. With shaders, its geometry is appended to the shared
+// vertex and index arrays, which are uploaded on the first draw(); otherwise
+// it is compiled into a display list.
+//------------------------------------------------------------------------------
+int Renderer::addModel(const Mesh &mesh) {
+  Model model;
+  model.list = 0;
+  model.index_count = mesh.index_count;
+  model.index_offset = indices_.size() * sizeof(uint32_t);
+  if (usingShaders()) {
+    uint32_t base = (uint32_t) vertices_.size();
+    vertices_.insert(vertices_.end(), mesh.vertices,
+                     mesh.vertices + mesh.vertex_count);
+    for (uint32_t i = 0; i < mesh.index_count; ++i) {
+      indices_.push_back(base + mesh.indices[i]);
+    }
+    uploaded_ = false;
+  } else {
+    model.list = glGenLists(1);
+    glNewList(model.list, GL_COMPILE);
+    glInterleavedArrays(GL_N3F_V3F, 0, mesh.vertices);
+    glDrawElements(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT,
+                   mesh.indices);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glEndList();
+  }
+  models_.push_back(model);
+  return (int) models_.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+// Copies all model geometry to the GPU and records the vertex layout in the
+// vertex array object. The CPU-side copies are then released.
+//------------------------------------------------------------------------------
+void Renderer::uploadModels() {
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(MeshVertex),
+               vertices_.empty() ? NULL : &vertices_[0], GL_STATIC_DRAW);
+  glEnableVertexAttribArray(ATTRIB_NORMAL);
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE,
+                        sizeof(MeshVertex),
+                        (const void *) offsetof(MeshVertex, normal));
+  glEnableVertexAttribArray(ATTRIB_POSITION);
+  glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE,
+                        sizeof(MeshVertex),
+                        (const void *) offsetof(MeshVertex, position));
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(uint32_t),
+               indices_.empty() ? NULL : &indices_[0], GL_STATIC_DRAW);
+  for (int i = 0; i < 4; ++i) {
+    glEnableVertexAttribArray(ATTRIB_TRANSFORM + i);
+    glVertexAttribDivisor(ATTRIB_TRANSFORM + i, 1);
+  }
+  glEnableVertexAttribArray(ATTRIB_COLOR);
+  glVertexAttribDivisor(ATTRIB_COLOR, 1);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  vector<MeshVertex>().swap(vertices_);
+  vector<uint32_t>().swap(indices_);
+  uploaded_ = true;
+}
+
+//------------------------------------------------------------------------------
+// Equivalent to gluPerspective().
+//------------------------------------------------------------------------------
+void Renderer::setPerspective(double fovy, double aspect, double z_near,
+                              double z_far) {
+  double f = 1 / tan(fovy * M_PI / 360);
+  Identity(projection_);
+  projection_[0] = (float) (f / aspect);
+  projection_[5] = (float) f;
+  projection_[10] = (float) ((z_far + z_near) / (z_near - z_far));
+  projection_[11] = -1;
+  projection_[14] = (float) (2 * z_far * z_near / (z_near - z_far));
+  projection_[15] = 0;
+  glMatrixMode(GL_PROJECTION);
+  glLoadMatrixf(projection_);
+  glMatrixMode(GL_MODELVIEW);
+}
+
+//------------------------------------------------------------------------------
+// Equivalent to gluLookAt() with Y as the up axis.
+//------------------------------------------------------------------------------
+void Renderer::setView(const double eye[3], const double at[3]) {
+  double f[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+  double length = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+  for (int i = 0; i < 3; ++i) {
+    f[i] /= length;
+  }
+  double s[3] = { -f[2], 0, f[0] };  // f x (0, 1, 0)
+  length = sqrt(s[0] * s[0] + s[2] * s[2]);
+  s[0] /= length;
+  s[2] /= length;
+  double u[3] = { s[1] * f[2] - s[2] * f[1],
+                  s[2] * f[0] - s[0] * f[2],
+                  s[0] * f[1] - s[1] * f[0] };
+  for (int i = 0; i < 3; ++i) {
+    view_[i * 4 + 0] = (float) s[i];
+    view_[i * 4 + 1] = (float) u[i];
+    view_[i * 4 + 2] = (float) -f[i];
+    view_[i * 4 + 3] = 0;
+  }
+  view_[12] = (float) -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+  view_[13] = (float) -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+  view_[14] = (float) (f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2]);
+  view_[15] = 1;
+  glMatrixMode(GL_MODELVIEW);
+  glLoadMatrixf(view_);
+}
+
+void Renderer::draw(const vector<RenderInstance> &instances) {
+  draw_calls_ = 0;
+  vertices_submitted_ = 0;
+  if (usingShaders()) {
+    drawInstanced(instances);
+  } else {
+    drawLegacy(instances);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Groups the instances by model (a counting sort), uploads them in one call,
+// and issues one instanced draw per model.
+//------------------------------------------------------------------------------
+void Renderer::drawInstanced(const vector<RenderInstance> &instances) {
+  if (!uploaded_) {
+    uploadModels();
+  }
+  model_starts_.assign(models_.size() + 1, 0);
+  for (size_t i = 0; i < instances.size(); ++i) {
+    ++model_starts_[instances[i].model + 1];
+  }
+  for (size_t i = 1; i < model_starts_.size(); ++i) {
+    model_starts_[i] += model_starts_[i - 1];
+  }
+  sorted_.resize(instances.size());
+  model_next_.assign(model_starts_.begin(), model_starts_.end() - 1);
+  for (size_t i = 0; i < instances.size(); ++i) {
+    sorted_[model_next_[instances[i].model]++] = instances[i];
+  }
+
+  // Orphan the old buffer contents so the driver need not wait for the GPU
+  // to finish reading them:
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  size_t bytes = sorted_.size() * sizeof(RenderInstance);
+  if (bytes > instance_capacity_) {
+    instance_capacity_ = bytes * 2;
+  }
+  glBufferData(GL_ARRAY_BUFFER, instance_capacity_, NULL, GL_STREAM_DRAW);
+  if (bytes) {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &sorted_[0]);
+  }
+
+  glUseProgram(program_);
+  glUniformMatrix4fv(projection_location_, 1, GL_FALSE, projection_);
+  glUniformMatrix4fv(view_location_, 1, GL_FALSE, view_);
+  glBindVertexArray(vao_);
+  for (size_t m = 0; m < models_.size(); ++m) {
+    int count = model_starts_[m + 1] - model_starts_[m];
+    if (count == 0 || models_[m].index_count == 0) {
+      continue;
+    }
+    size_t base = model_starts_[m] * sizeof(RenderInstance);
+    for (int i = 0; i < 4; ++i) {
+      glVertexAttribPointer(ATTRIB_TRANSFORM + i, 4, GL_FLOAT, GL_FALSE,
+                            sizeof(RenderInstance),
+                            (const void *) (base +
+                                offsetof(RenderInstance, transform) +
+                                i * 4 * sizeof(float)));
+    }
+    glVertexAttribPointer(ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(RenderInstance),
+                          (const void *) (base +
+                              offsetof(RenderInstance, color)));
+    glDrawElementsInstanced(GL_TRIANGLES, models_[m].index_count,
+                            GL_UNSIGNED_INT,
+                            (const void *) models_[m].index_offset, count);
+    ++draw_calls_;
+    vertices_submitted_ += (long) models_[m].index_count * count;
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glUseProgram(0);
+}
+
+void Renderer::drawLegacy(const vector<RenderInstance> &instances) {
+  for (size_t i = 0; i < instances.size(); ++i) {
+    const RenderInstance &instance = instances[i];
+    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, instance.color);
+    glPushMatrix();
+    glMultMatrixf(instance.transform);
+    glCallList(models_[instance.model].list);
+    glPopMatrix();
+    ++draw_calls_;
+    vertices_submitted_ += models_[instance.model].index_count;
+  }
+}
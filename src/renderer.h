@@ -0,0 +1,92 @@
+/*******************************************************************************
+   Filename: renderer.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the Renderer class. All geometry (the board and
+             the six piece models) is uploaded once into buffer objects, and
+             each frame is drawn from a list of instances: one instanced draw
+             call per model, with every instance's transform and color read
+             from a per-frame instance buffer. Where OpenGL 3.3 shaders are
+             unavailable it falls back to display lists.
+*******************************************************************************/
+
+#ifndef RENDERER_H_
+#define RENDERER_H_
+
+#include <vector>
+#include "mesh.h"
+
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// One copy of a model to draw this frame. The transform is a column-major
+// 4x4 matrix, as used by glLoadMatrixf().
+struct RenderInstance {
+  int model;  // Index returned by Renderer::addModel().
+  float transform[16];
+  float color[4];
+};
+
+void SetInstanceTransform(RenderInstance *instance, double x, double y,
+                          double z, double x_angle, double y_angle,
+                          double scale = 1);
+void SetInstanceColor(RenderInstance *instance, const GLfloat color[4]);
+
+class Renderer {
+ public:
+  Renderer();
+
+  // Call once a GL context exists and lighting has been set up (the shaders
+  // copy the fixed-function light and material state). Returns true if the
+  // shader path is in use.
+  bool init(bool allow_shaders);
+  int addModel(const Mesh &mesh);  // Call after init(). Returns the model id.
+  bool usingShaders() const { return program_ != 0; }
+
+  // These also load the fixed-function matrices so that legacy drawing (e.g.,
+  // text) still lines up with the scene:
+  void setPerspective(double fovy, double aspect, double z_near, double z_far);
+  void setView(const double eye[3], const double at[3]);
+
+  void draw(const std::vector<RenderInstance> &instances);
+  int drawCalls() const { return draw_calls_; }  // In the last draw().
+  long verticesSubmitted() const { return vertices_submitted_; }  // Ditto.
+
+ private:
+  struct Model {
+    GLuint list;          // Display list (legacy path only).
+    GLsizei index_count;
+    size_t index_offset;  // Bytes into the index buffer.
+  };
+
+  bool initShaders();
+  void uploadModels();
+  void drawInstanced(const std::vector<RenderInstance> &instances);
+  void drawLegacy(const std::vector<RenderInstance> &instances);
+
+  std::vector<Model> models_;
+  std::vector<MeshVertex> vertices_;  // Shader path: all models, until upload.
+  std::vector<uint32_t> indices_;
+  bool uploaded_;
+  GLuint program_;
+  GLuint vao_;
+  GLuint vertex_buffer_;
+  GLuint index_buffer_;
+  GLuint instance_buffer_;
+  size_t instance_capacity_;
+  GLint projection_location_;
+  GLint view_location_;
+  float projection_[16];
+  float view_[16];
+  std::vector<RenderInstance> sorted_;  // Instances grouped by model.
+  std::vector<int> model_starts_;
+  std::vector<int> model_next_;
+  int draw_calls_;
+  long vertices_submitted_;
+};
+
+#endif  // RENDERER_H_
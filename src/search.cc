@@ -0,0 +1,616 @@
+/*******************************************************************************
+   Filename: search.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Method definitions for the Search class: iterative deepening,
+             principal variation search with null-move pruning and late-move
+             reductions, and lazy SMP (every thread searches the same root,
+             sharing results through the transposition table).
+*******************************************************************************/
+
+#include "search.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include "evaluate.h"
+#include "movepick.h"
+
+using namespace std;
+
+#define MOVE_OVERHEAD 20  // Milliseconds reserved for communication.
+
+static_assert(NNUE_MAX_PLY >= MAX_PLY, "NNUE stack too small for MAX_PLY");
+
+struct Search::Worker {
+  int id;
+  Position pos;
+  atomic<uint64_t> nodes;
+  atomic<uint64_t> tb_hits;
+  int seldepth;
+  Move killers[MAX_PLY][2];
+  ButterflyHistory history[NUM_CHESS_PIECE_COLORS];
+  CountermoveTable countermoves;
+  Move pv[MAX_PLY + 1][MAX_PLY + 1];
+  int pv_length[MAX_PLY + 1];
+  AccumulatorStack accumulators;
+  PawnTable pawns;
+
+  // Results of the last completed iteration:
+  int completed_depth;
+  int best_score;
+  vector<Move> best_pv;
+
+  void countNode() {
+    nodes.store(nodes.load(memory_order_relaxed) + 1, memory_order_relaxed);
+  }
+};
+
+namespace {
+
+int reductions[64][64];  // [depth][move number]
+
+bool InitReductions() {
+  for (int depth = 1; depth < 64; ++depth) {
+    for (int count = 1; count < 64; ++count) {
+      reductions[depth][count] =
+          (int) (0.75 + log((double) depth) * log((double) count) / 2.25);
+    }
+  }
+  return true;
+}
+
+int64_t Now() {
+  return chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Mate scores are stored relative to the node, not the root.
+inline int ValueToTT(int value, int ply) {
+  return value >= VALUE_MATE_IN_MAX_PLY ? value + ply :
+         value <= -VALUE_MATE_IN_MAX_PLY ? value - ply : value;
+}
+
+inline int ValueFromTT(int value, int ply) {
+  return value >= VALUE_MATE_IN_MAX_PLY ? value - ply :
+         value <= -VALUE_MATE_IN_MAX_PLY ? value + ply : value;
+}
+
+inline bool HasNonPawnMaterial(const Position &pos) {
+  int us = pos.sideToMove();
+  return pos.pieces(us) & ~(pos.pieces(us, PAWN) | pos.pieces(us, KING));
+}
+
+inline void UpdateHistory(int16_t *entry, int bonus) {
+  // Gravity keeps entries within +/-16384 and lets stale values decay:
+  *entry = (int16_t) (*entry + bonus - *entry * abs(bonus) / 16384);
+}
+
+}  // namespace
+
+Search::Search()
+    : tablebases_(NULL), tb_pieces_(0), network_(NULL), stop_(false),
+      searching_(false), pondering_(false) {
+  static bool initialized = InitReductions();
+  (void) initialized;
+  start_time_ = optimum_time_ = maximum_time_ = 0;
+  best_move_ = ponder_move_ = NO_MOVE;
+  best_score_ = 0;
+  setThreads(1);
+}
+
+Search::~Search() {
+  stop();
+  wait();
+}
+
+void Search::setThreads(int count) {
+  count = max(1, count);
+  workers_.clear();
+  for (int i = 0; i < count; ++i) {
+    workers_.push_back(unique_ptr<Worker>(new Worker()));
+    workers_.back()->id = i;
+  }
+}
+
+void Search::setHashSize(int megabytes) {
+  tt_.resize(max(1, megabytes));
+}
+
+void Search::clearHash() {
+  tt_.clear();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    memset(workers_[i]->history, 0, sizeof(workers_[i]->history));
+    memset(workers_[i]->countermoves, 0, sizeof(workers_[i]->countermoves));
+  }
+}
+
+void Search::setTablebases(Tablebases *tablebases, int max_pieces) {
+  tablebases_ = tablebases;
+  tb_pieces_ = tablebases ? min(max_pieces, tablebases->maxPieces()) : 0;
+}
+
+uint64_t Search::tbhits() const {
+  uint64_t total = 0;
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    total += workers_[i]->tb_hits.load(memory_order_relaxed);
+  }
+  return total;
+}
+
+uint64_t Search::nodes() const {
+  uint64_t total = 0;
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    total += workers_[i]->nodes.load(memory_order_relaxed);
+  }
+  return total;
+}
+
+int64_t Search::elapsed() const {
+  return Now() - start_time_;
+}
+
+//------------------------------------------------------------------------------
+// Begins searching "pos" on background threads and returns immediately. The
+// done callback (if any) runs on the search thread when the search ends.
+//------------------------------------------------------------------------------
+void Search::start(const Position &pos, const SearchLimits &limits) {
+  stop();
+  wait();
+
+  start_time_ = Now();
+  limits_ = limits;
+  pondering_ = limits.ponder;
+  stop_ = false;
+  searching_ = true;
+  tt_.newSearch();
+
+  // Split the remaining clock time over the expected number of moves:
+  optimum_time_ = maximum_time_ = 0;
+  int us = pos.sideToMove();
+  if (limits.movetime) {
+    optimum_time_ = maximum_time_ = max((int64_t) 1, limits.movetime);
+  } else if (limits.time[us]) {
+    int64_t left = max((int64_t) 1, limits.time[us] - MOVE_OVERHEAD);
+    int moves = limits.movestogo ? min(limits.movestogo, 40) : 30;
+    optimum_time_ = min(left / moves + limits.increment[us] * 3 / 4,
+                        left / 2);
+    maximum_time_ = min(optimum_time_ * 4, left * 4 / 5);
+    optimum_time_ = max((int64_t) 1, optimum_time_);
+    maximum_time_ = max(optimum_time_, maximum_time_);
+  }
+
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker *worker = workers_[i].get();
+    worker->pos = pos;
+    worker->nodes = 0;
+    worker->tb_hits = 0;
+    worker->completed_depth = 0;
+    worker->best_score = 0;
+    worker->best_pv.clear();
+    memset(worker->killers, 0, sizeof(worker->killers));
+    worker->accumulators.clear();
+  }
+  main_thread_ = thread(&Search::mainThread, this);
+}
+
+//------------------------------------------------------------------------------
+// Switches a ponder search to a normal one. Time is measured from here on,
+// since until now the opponent's clock was running.
+//------------------------------------------------------------------------------
+void Search::ponderhit() {
+  start_time_ = Now();
+  pondering_ = false;
+}
+
+void Search::wait() {
+  if (main_thread_.joinable()) {
+    main_thread_.join();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Runs worker 0, which owns time management and reporting, alongside the
+// helper threads. When it finishes it stops the helpers and publishes the
+// result.
+//------------------------------------------------------------------------------
+void Search::mainThread() {
+  // With the root position in the tablebases there is nothing to search:
+  Worker *main = workers_[0].get();
+  Move tb_move = NO_MOVE;
+  int tb_score = 0;
+  if (tb_pieces_ && PopCount(main->pos.pieces()) <= tb_pieces_) {
+    tb_move = tablebases_->probeRoot(main->pos, &tb_score);
+  }
+  vector<thread> helpers;
+  if (tb_move != NO_MOVE) {
+    main->tb_hits = 1;
+    main->completed_depth = 1;
+    main->best_score = tb_score;
+    main->best_pv.assign(1, tb_move);
+    report(main, 1);
+  } else {
+    for (size_t i = 1; i < workers_.size(); ++i) {
+      helpers.push_back(thread(&Search::workerThread, this,
+                               workers_[i].get()));
+    }
+    iterate(main);
+  }
+
+  // UCI forbids returning early from an infinite or ponder search:
+  while (unbounded() && !stop_.load(memory_order_relaxed)) {
+    this_thread::sleep_for(chrono::microseconds(200));
+  }
+  stop_ = true;
+  for (size_t i = 0; i < helpers.size(); ++i) {
+    helpers[i].join();
+  }
+
+  best_move_ = main->best_pv.empty() ? NO_MOVE : main->best_pv[0];
+  ponder_move_ = main->best_pv.size() > 1 ? main->best_pv[1] : NO_MOVE;
+  best_score_ = main->best_score;
+  if (best_move_ == NO_MOVE) {
+    // Stopped before depth 1 finished; any legal move beats none.
+    MoveList list;
+    GenerateLegalMoves(main->pos, &list);
+    if (list.size) {
+      best_move_ = list.moves[0];
+    }
+  }
+  searching_ = false;
+  if (done_callback_) {
+    done_callback_(best_move_, ponder_move_);
+  }
+}
+
+void Search::workerThread(Worker *worker) {
+  iterate(worker);
+}
+
+//------------------------------------------------------------------------------
+// Iterative deepening. Helper threads start at staggered depths so they do
+// not all search the same tree in lockstep.
+//------------------------------------------------------------------------------
+void Search::iterate(Worker *worker) {
+  int max_depth = limits_.depth ? min(limits_.depth, MAX_PLY - 1) :
+                                  MAX_PLY - 1;
+  int score = 0;
+  for (int depth = 1 + (worker->id & 1); depth <= max_depth; ++depth) {
+    worker->seldepth = 0;
+
+    // Aspiration window around the previous score:
+    int delta = 25;
+    int alpha = -VALUE_INFINITE, beta = VALUE_INFINITE;
+    if (depth >= 5) {
+      alpha = max(score - delta, -VALUE_INFINITE);
+      beta = min(score + delta, (int) VALUE_INFINITE);
+    }
+    while (true) {
+      score = search(worker, alpha, beta, depth, 0, false);
+      if (stop_.load(memory_order_relaxed)) {
+        break;
+      }
+      if (score <= alpha) {
+        beta = (alpha + beta) / 2;
+        alpha = max(score - delta, -VALUE_INFINITE);
+      } else if (score >= beta) {
+        beta = min(score + delta, (int) VALUE_INFINITE);
+      } else {
+        break;
+      }
+      delta += delta / 2;
+    }
+    if (stop_.load(memory_order_relaxed)) {
+      break;  // The interrupted iteration's result is unreliable.
+    }
+
+    worker->completed_depth = depth;
+    worker->best_score = score;
+    worker->best_pv.assign(worker->pv[0], worker->pv[0] + worker->pv_length[0]);
+
+    if (worker->id == 0) {
+      report(worker, depth);
+      if (abs(score) >= VALUE_MATE_IN_MAX_PLY && !limits_.infinite &&
+          VALUE_MATE - abs(score) <= depth) {
+        break;  // Found the shortest mate.
+      }
+      if (optimum_time_ && !unbounded() &&
+          elapsed() > optimum_time_ * 6 / 10) {
+        break;  // The next iteration would most likely not finish.
+      }
+    }
+  }
+}
+
+void Search::report(const Worker *worker, int depth) {
+  if (!info_callback_) {
+    return;
+  }
+  SearchInfo info;
+  info.depth = depth;
+  info.seldepth = worker->seldepth;
+  info.score = worker->best_score;
+  info.nodes = nodes();
+  info.tbhits = tbhits();
+  info.time = elapsed();
+  info.hashfull = tt_.hashfull();
+  info.pv = worker->best_pv;
+  info_callback_(info);
+}
+
+void Search::checkLimits() {
+  if (maximum_time_ && !unbounded() && elapsed() >= maximum_time_) {
+    stop();
+  }
+  if (limits_.nodes && nodes() >= limits_.nodes) {
+    stop();
+  }
+}
+
+int Search::search(Worker *worker, int alpha, int beta, int depth, int ply,
+                   bool null_ok) {
+  Position &pos = worker->pos;
+  bool pv_node = beta - alpha > 1;
+  bool root = ply == 0;
+
+  if (depth <= 0) {
+    return quiesce(worker, alpha, beta, ply);
+  }
+  worker->pv_length[ply] = ply;
+  if (worker->id == 0 && (worker->nodes.load(memory_order_relaxed) & 1023) ==
+      0) {
+    checkLimits();
+  }
+  if (stop_.load(memory_order_relaxed)) {
+    return 0;
+  }
+  worker->countNode();
+
+  if (!root) {
+    if (pos.isDraw(ply)) {
+      return VALUE_DRAW;
+    }
+    if (ply >= MAX_PLY - 1) {
+      return pos.inCheck() ? VALUE_DRAW : evaluate(worker, ply);
+    }
+    // Mate distance pruning:
+    alpha = max(alpha, -VALUE_MATE + ply);
+    beta = min(beta, VALUE_MATE - ply - 1);
+    if (alpha >= beta) {
+      return alpha;
+    }
+  }
+
+  uint64_t key = pos.key();
+  TTEntryData tte;
+  bool tt_hit = tt_.probe(key, &tte);
+  Move tt_move = tt_hit ? tte.move : NO_MOVE;
+  if (tt_hit && !pv_node && tte.depth >= depth) {
+    int value = ValueFromTT(tte.score, ply);
+    if (tte.bound == BOUND_EXACT ||
+        (tte.bound == BOUND_LOWER && value >= beta) ||
+        (tte.bound == BOUND_UPPER && value <= alpha)) {
+      return value;
+    }
+  }
+
+  // Tablebase results are exact right after a capture or pawn move, when
+  // the fifty-move counter restarts:
+  if (!root && tb_pieces_ && pos.halfmoveClock() == 0 &&
+      PopCount(pos.pieces()) <= tb_pieces_) {
+    int wdl;
+    if (tablebases_->probeWdl(pos, &wdl)) {
+      worker->tb_hits.store(worker->tb_hits.load(memory_order_relaxed) + 1,
+                            memory_order_relaxed);
+      int value = wdl < WDL_BLESSED_LOSS ? -VALUE_TB_WIN + ply :
+                  wdl > WDL_CURSED_WIN ? VALUE_TB_WIN - ply : VALUE_DRAW + wdl;
+      int bound = wdl < WDL_BLESSED_LOSS ? BOUND_UPPER :
+                  wdl > WDL_CURSED_WIN ? BOUND_LOWER : BOUND_EXACT;
+      if (bound == BOUND_EXACT || (bound == BOUND_LOWER && value >= beta) ||
+          (bound == BOUND_UPPER && value <= alpha)) {
+        tt_.store(key, NO_MOVE, ValueToTT(value, ply),
+                  pos.inCheck() ? 0 : evaluate(worker, ply),
+                  min(depth + 6, MAX_PLY - 1), bound);
+        return value;
+      }
+    }
+  }
+
+  bool in_check = pos.inCheck();
+  int static_eval = in_check ? -VALUE_INFINITE :
+                    tt_hit ? tte.eval : evaluate(worker, ply);
+
+  // Null-move pruning: if passing still fails high, a real move surely will.
+  if (!pv_node && !in_check && null_ok && depth >= 3 && static_eval >= beta &&
+      HasNonPawnMaterial(pos)) {
+    int r = 3 + depth / 6;
+    pos.doNullMove();
+    int score = -search(worker, -beta, -beta + 1, depth - 1 - r, ply + 1,
+                        false);
+    pos.undoNullMove();
+    if (stop_.load(memory_order_relaxed)) {
+      return 0;
+    }
+    if (score >= beta) {
+      return score >= VALUE_MATE_IN_MAX_PLY ? beta : score;
+    }
+  }
+
+  // The countermove answers the opponent's last move, identified by the
+  // piece now standing on its target square:
+  Move prev = pos.lastMove();
+  int prev_piece = prev != NO_MOVE ? pos.pieceOn(ToSquare(prev)) : NO_PIECE;
+  Move countermove = prev_piece != NO_PIECE ?
+                     worker->countermoves[prev_piece][ToSquare(prev)] :
+                     NO_MOVE;
+  Move *killers = worker->killers[ply];
+  MovePicker picker(pos, tt_move, killers, countermove,
+                    worker->history[pos.sideToMove()]);
+
+  int best_score = -VALUE_INFINITE;
+  Move best_move = NO_MOVE;
+  int move_count = 0;
+  Move quiets_tried[MAX_MOVES];
+  int num_quiets = 0;
+  Move m;
+  while ((m = picker.next()) != NO_MOVE) {
+    if (!pos.isLegal(m)) {
+      continue;
+    }
+    ++move_count;
+    bool quiet = !IsCapture(m) && !IsPromotion(m);
+    bool killer = m == killers[0] || m == killers[1];
+
+    pos.doMove(m);
+    bool gives_check = pos.inCheck();
+    int new_depth = depth - 1 + (gives_check ? 1 : 0);
+    int score;
+    if (move_count == 1) {
+      score = -search(worker, -beta, -alpha, new_depth, ply + 1, true);
+    } else {
+      // Late-move reductions for quiet moves that ordering ranked low:
+      int r = 0;
+      if (depth >= 3 && move_count > 3 && quiet && !in_check &&
+          !gives_check) {
+        r = reductions[min(depth, 63)][min(move_count, 63)];
+        r -= pv_node + killer;
+        r = max(0, min(r, new_depth - 1));
+      }
+      score = -search(worker, -alpha - 1, -alpha, new_depth - r, ply + 1,
+                      true);
+      if (score > alpha && r > 0) {
+        score = -search(worker, -alpha - 1, -alpha, new_depth, ply + 1, true);
+      }
+      if (score > alpha && score < beta) {
+        score = -search(worker, -beta, -alpha, new_depth, ply + 1, true);
+      }
+    }
+    pos.undoMove();
+
+    if (stop_.load(memory_order_relaxed)) {
+      return 0;
+    }
+    if (score > best_score) {
+      best_score = score;
+      if (score > alpha) {
+        best_move = m;
+        worker->pv[ply][ply] = m;
+        for (int j = ply + 1; j < worker->pv_length[ply + 1]; ++j) {
+          worker->pv[ply][j] = worker->pv[ply + 1][j];
+        }
+        worker->pv_length[ply] = max(ply + 1, worker->pv_length[ply + 1]);
+        if (score >= beta) {
+          if (quiet) {
+            if (killers[0] != m) {
+              killers[1] = killers[0];
+              killers[0] = m;
+            }
+            if (prev_piece != NO_PIECE) {
+              worker->countermoves[prev_piece][ToSquare(prev)] = m;
+            }
+            ButterflyHistory &history = worker->history[pos.sideToMove()];
+            int bonus = min(depth * depth, 400);
+            UpdateHistory(&history[FromSquare(m)][ToSquare(m)], bonus);
+            for (int j = 0; j < num_quiets; ++j) {
+              Move q = quiets_tried[j];
+              UpdateHistory(&history[FromSquare(q)][ToSquare(q)], -bonus);
+            }
+          }
+          break;
+        }
+        alpha = score;
+      }
+    }
+    if (quiet) {
+      quiets_tried[num_quiets++] = m;
+    }
+  }
+
+  if (move_count == 0) {
+    return in_check ? -VALUE_MATE + ply : VALUE_DRAW;
+  }
+  int bound = best_score >= beta ? BOUND_LOWER :
+              best_move != NO_MOVE ? BOUND_EXACT : BOUND_UPPER;
+  tt_.store(key, best_move, ValueToTT(best_score, ply),
+            in_check ? 0 : static_eval, depth, bound);
+  return best_score;
+}
+
+//------------------------------------------------------------------------------
+// Searches captures (or all evasions when in check) until the position is
+// quiet, so that the static evaluation is only applied to stable positions.
+//------------------------------------------------------------------------------
+int Search::quiesce(Worker *worker, int alpha, int beta, int ply) {
+  Position &pos = worker->pos;
+  worker->pv_length[ply] = ply;
+  if (worker->id == 0 && (worker->nodes.load(memory_order_relaxed) & 1023) ==
+      0) {
+    checkLimits();
+  }
+  if (stop_.load(memory_order_relaxed)) {
+    return 0;
+  }
+  worker->countNode();
+  worker->seldepth = max(worker->seldepth, ply);
+
+  bool in_check = pos.inCheck();
+  if (ply >= MAX_PLY - 1) {
+    return in_check ? VALUE_DRAW : evaluate(worker, ply);
+  }
+  int best_score = -VALUE_INFINITE;
+  if (!in_check) {
+    best_score = evaluate(worker, ply);
+    if (best_score >= beta) {
+      return best_score;
+    }
+    alpha = max(alpha, best_score);
+  }
+
+  MovePicker picker(pos, worker->history[pos.sideToMove()]);
+  int move_count = 0;
+  Move m;
+  while ((m = picker.next()) != NO_MOVE) {
+    if (!pos.isLegal(m)) {
+      continue;
+    }
+    ++move_count;
+    pos.doMove(m);
+    int score = -quiesce(worker, -beta, -alpha, ply + 1);
+    pos.undoMove();
+    if (stop_.load(memory_order_relaxed)) {
+      return 0;
+    }
+    if (score > best_score) {
+      best_score = score;
+      if (score > alpha) {
+        worker->pv[ply][ply] = m;
+        for (int j = ply + 1; j < worker->pv_length[ply + 1]; ++j) {
+          worker->pv[ply][j] = worker->pv[ply + 1][j];
+        }
+        worker->pv_length[ply] = max(ply + 1, worker->pv_length[ply + 1]);
+        if (score >= beta) {
+          break;
+        }
+        alpha = score;
+      }
+    }
+  }
+  if (in_check && move_count == 0) {
+    return -VALUE_MATE + ply;
+  }
+  return best_score;
+}
+
+//------------------------------------------------------------------------------
+// Static evaluation of the worker's position, "ply" moves from the root. Kept
+// clear of the tablebase and mate scores, which a network could reach.
+//------------------------------------------------------------------------------
+int Search::evaluate(Worker *worker, int ply) {
+  if (!network_) {
+    return Evaluate(worker->pos, &worker->pawns);
+  }
+  int value = network_->evaluate(worker->pos, &worker->accumulators, ply);
+  return max(-VALUE_MAX_EVAL, min(value, (int) VALUE_MAX_EVAL));
+}
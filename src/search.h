@@ -0,0 +1,133 @@
+/*******************************************************************************
+   Filename: search.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the Search class, a multithreaded iterative-
+             deepening alpha-beta engine. Searches run on their own threads;
+             start() returns immediately, so callers such as the GLUT main loop
+             never block while the engine thinks.
+*******************************************************************************/
+
+#ifndef SEARCH_H_
+#define SEARCH_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "nnue.h"
+#include "position.h"
+#include "syzygy.h"
+#include "tt.h"
+
+#define MAX_PLY               128
+#define VALUE_DRAW            0
+#define VALUE_MATE            32000
+#define VALUE_INFINITE        32001
+#define VALUE_MATE_IN_MAX_PLY (VALUE_MATE - MAX_PLY)
+#define VALUE_TB_WIN          (VALUE_MATE_IN_MAX_PLY - 1)  // Minus the ply.
+#define VALUE_MAX_EVAL        (VALUE_TB_WIN - MAX_PLY - 1)  // Static scores.
+
+// What to search for; zero means "no limit" for every field.
+struct SearchLimits {
+  int depth;
+  int64_t movetime;                           // Milliseconds.
+  int64_t time[NUM_CHESS_PIECE_COLORS];       // Milliseconds left on clocks.
+  int64_t increment[NUM_CHESS_PIECE_COLORS];  // Milliseconds per move.
+  int movestogo;
+  uint64_t nodes;
+  bool infinite;  // Keep searching until stop() even if a limit is reached.
+  bool ponder;    // Like infinite until ponderhit(), then use the limits.
+
+  SearchLimits()
+      : depth(0), movetime(0), movestogo(0), nodes(0), infinite(false),
+        ponder(false) {
+    time[WHITE] = time[BLACK] = increment[WHITE] = increment[BLACK] = 0;
+  }
+};
+
+// Progress report, sent after each completed iteration.
+struct SearchInfo {
+  int depth;
+  int seldepth;
+  int score;         // Centipawns, or +/-(VALUE_MATE - plies) for mates.
+  uint64_t nodes;    // All threads combined.
+  uint64_t tbhits;   // Tablebase probes that returned a result.
+  int64_t time;      // Milliseconds since start().
+  int hashfull;      // Permille.
+  std::vector<Move> pv;
+};
+
+typedef std::function<void(const SearchInfo &)> InfoCallback;
+typedef std::function<void(Move best, Move ponder)> DoneCallback;
+
+class Search {
+ public:
+  Search();
+  ~Search();
+
+  // These may only be called while no search is running:
+  void setThreads(int count);
+  void setHashSize(int megabytes);
+  void clearHash();
+  void setInfoCallback(InfoCallback callback) { info_callback_ = callback; }
+  void setDoneCallback(DoneCallback callback) { done_callback_ = callback; }
+  // Probes positions with at most "max_pieces" pieces (NULL: no tables).
+  void setTablebases(Tablebases *tablebases, int max_pieces);
+  // Evaluates with "network" (NULL: the classical evaluation).
+  void setNetwork(const Network *network) { network_ = network; }
+
+  void start(const Position &pos, const SearchLimits &limits);
+  void stop() { stop_.store(true, std::memory_order_relaxed); }
+  void ponderhit();  // The expected move was played; the clock is running.
+  void wait();
+  bool isSearching() const { return searching_.load(); }
+
+  // Results of the last finished search:
+  Move bestMove() const { return best_move_; }
+  Move ponderMove() const { return ponder_move_; }
+  int bestScore() const { return best_score_; }
+  uint64_t nodes() const;
+  uint64_t tbhits() const;
+
+ private:
+  struct Worker;
+
+  void mainThread();
+  void workerThread(Worker *worker);
+  void iterate(Worker *worker);
+  int search(Worker *worker, int alpha, int beta, int depth, int ply,
+             bool null_ok);
+  int quiesce(Worker *worker, int alpha, int beta, int ply);
+  int evaluate(Worker *worker, int ply);
+  void checkLimits();
+  bool unbounded() const {
+    return limits_.infinite || pondering_.load(std::memory_order_relaxed);
+  }
+  int64_t elapsed() const;
+  void report(const Worker *worker, int depth);
+
+  std::vector<std::unique_ptr<Worker> > workers_;
+  std::thread main_thread_;
+  TranspositionTable tt_;
+  Tablebases *tablebases_;
+  int tb_pieces_;  // Largest piece count probed; 0 disables probing.
+  const Network *network_;
+  SearchLimits limits_;
+  std::atomic<bool> stop_;
+  std::atomic<bool> searching_;
+  std::atomic<bool> pondering_;
+  std::atomic<int64_t> start_time_;  // Reset by ponderhit().
+  int64_t optimum_time_;  // Soft limit: do not start another iteration.
+  int64_t maximum_time_;  // Hard limit: abort the current iteration.
+  InfoCallback info_callback_;
+  DoneCallback done_callback_;
+  Move best_move_;
+  Move ponder_move_;
+  int best_score_;
+};
+
+#endif  // SEARCH_H_
@@ -0,0 +1,1094 @@
+/*******************************************************************************
+   Filename: syzygy.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Syzygy tablebase probing. Each file holds one or more tables of
+             values compressed with recursive pairing and a canonical Huffman
+             code, in blocks that are located through a sparse index. A
+             position is turned into a table index by mirroring it into a
+             canonical form and enumerating its pieces group by group.
+*******************************************************************************/
+
+#include "syzygy.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+#include "evaluate.h"
+#include "mapped_file.h"
+#include "search.h"
+
+using namespace std;
+
+#define MAX_DTZ 262144  // Above any distance to zeroing in the tables.
+
+namespace {
+
+enum TableType { TABLE_WDL, TABLE_DTZ };
+
+// Per-table flags (all but the last apply to DTZ tables only):
+#define FLAG_STM          1    // Stores black-to-move positions.
+#define FLAG_MAPPED       2    // Values are translated through the DTZ map.
+#define FLAG_WIN_PLIES    4    // Wins are counted in plies, not moves.
+#define FLAG_LOSS_PLIES   8
+#define FLAG_WIDE         16   // The DTZ map has 16-bit entries.
+#define FLAG_SINGLE_VALUE 128  // Every position has the same value.
+
+const unsigned char kMagic[2][4] = { { 0x71, 0xE8, 0x23, 0x5D },    // .rtbw
+                                     { 0xD7, 0x66, 0x0C, 0xA5 } };  // .rtbz
+const char *kExtensions[2] = { ".rtbw", ".rtbz" };
+
+// File names list pieces as "KQRBNP"; tables number them 1 (pawn) to 6
+// (king), plus 8 for black. Both are indexed here by (type - PAWN).
+const char kPieceChars[] = "PRBNQK";
+const int kTableTypes[NUM_PIECE_TYPES] = { 1, 4, 3, 2, 5, 6 };
+const int kNameOrder[NUM_PIECE_TYPES] = { KING, QUEEN, ROOK, BISHOP, KNIGHT,
+                                          PAWN };
+const char kNameChars[] = "KQRBNP";
+
+// Whether one side's name ("KRB") lists pieces at least as strong as
+// another's of the same length.
+bool Stronger(const string &a, const string &b) {
+  for (size_t i = 0; i < a.size(); ++i) {
+    const char *x = strchr(kNameChars, a[i]), *y = strchr(kNameChars, b[i]);
+    if (x != y) {
+      return x < y;
+    }
+  }
+  return true;
+}
+
+// Index tables shared by every file:
+int map_pawns[NUM_SQUARES];        // a2-h7 to 0..47, edge files highest.
+int map_b1h1h7[NUM_SQUARES];       // Squares below the a1-h8 diagonal.
+int map_a1d1d4[NUM_SQUARES];       // The a1-d1-d4 triangle to 0..9.
+int map_kk[10][NUM_SQUARES];       // Legal king pairs to 0..461.
+int binomial[6][NUM_SQUARES];      // [k][n]: ways to choose k of n.
+int lead_pawn_idx[6][NUM_SQUARES]; // [lead pawns][square]
+int lead_pawns_size[6][4];         // [lead pawns][file a-d]
+
+inline int OffA1H8(int square) { return RowOf(square) - ColOf(square); }
+
+inline int ReadLE16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+inline uint32_t ReadLE32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+inline uint32_t ReadBE32(const uint8_t *p) {
+  return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+inline uint64_t ReadBE64(const uint8_t *p) {
+  return ((uint64_t) ReadBE32(p) << 32) | ReadBE32(p + 4);
+}
+
+// Each pairing-tree node is 3 bytes: two 12-bit child symbols.
+inline int LeftSymbol(const uint8_t *node) {
+  return ((node[1] & 0xF) << 8) | node[0];
+}
+inline int RightSymbol(const uint8_t *node) {
+  return (node[2] << 4) | (node[1] >> 4);
+}
+
+bool InitIndexTables() {
+  int code = 0;
+  for (int s = 0; s < NUM_SQUARES; ++s) {
+    if (OffA1H8(s) < 0) {
+      map_b1h1h7[s] = code++;
+    }
+  }
+
+  // Triangle squares below the diagonal come first, diagonal squares last:
+  static const int kTriangle[10] = { 0, 1, 2, 3, 9, 10, 11, 18, 19, 27 };
+  vector<int> diagonal;
+  code = 0;
+  for (int i = 0; i < 10; ++i) {
+    int s = kTriangle[i];
+    if (OffA1H8(s) < 0) {
+      map_a1d1d4[s] = code++;
+    } else if (OffA1H8(s) == 0) {
+      diagonal.push_back(s);
+    }
+  }
+  for (size_t i = 0; i < diagonal.size(); ++i) {
+    map_a1d1d4[diagonal[i]] = code++;
+  }
+
+  // King pairs with the first king in the triangle; pairs with both kings on
+  // the diagonal come last:
+  vector<pair<int, int> > both_on_diagonal;
+  code = 0;
+  for (int idx = 0; idx < 10; ++idx) {
+    for (int s1 = 0; s1 <= 27; ++s1) {
+      if (map_a1d1d4[s1] != idx || (idx == 0 && s1 != 1)) {
+        continue;  // Only b1 maps to 0 among the squares that are not a1.
+      }
+      for (int s2 = 0; s2 < NUM_SQUARES; ++s2) {
+        if ((KingAttacks(s1) | SquareBB(s1)) & SquareBB(s2)) {
+          continue;  // Kings touching.
+        } else if (OffA1H8(s1) == 0 && OffA1H8(s2) > 0) {
+          continue;  // Mirrors to a pair below the diagonal.
+        } else if (OffA1H8(s1) == 0 && OffA1H8(s2) == 0) {
+          both_on_diagonal.push_back(make_pair(idx, s2));
+        } else {
+          map_kk[idx][s2] = code++;
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < both_on_diagonal.size(); ++i) {
+    map_kk[both_on_diagonal[i].first][both_on_diagonal[i].second] = code++;
+  }
+
+  binomial[0][0] = 1;
+  for (int n = 1; n < NUM_SQUARES; ++n) {
+    for (int k = 0; k < 6 && k <= n; ++k) {
+      binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) +
+                       (k < n ? binomial[k][n - 1] : 0);
+    }
+  }
+
+  // The leading pawn is the one with the highest map_pawns[] value: nearest
+  // the edge, then lowest. Each file's table counts the pawn sets led from
+  // that file, rank by rank.
+  int available = 47;
+  for (int lead = 1; lead <= 5; ++lead) {
+    for (int col = 0; col < 4; ++col) {
+      int idx = 0;
+      for (int row = 1; row <= 6; ++row) {
+        int s = SquareAt(row, col);
+        if (lead == 1) {
+          map_pawns[s] = available--;
+          map_pawns[s ^ 7] = available--;
+        }
+        lead_pawn_idx[lead][s] = idx;
+        idx += binomial[lead - 1][map_pawns[s]];
+      }
+      lead_pawns_size[lead][col] = idx;
+    }
+  }
+  return true;
+}
+
+// Packs the piece counts into a key: one nibble per color and type.
+uint64_t MaterialKey(const int counts[2][NUM_PIECE_TYPES], bool swap_colors) {
+  uint64_t key = 0;
+  for (int color = WHITE; color <= BLACK; ++color) {
+    for (int t = 0; t < NUM_PIECE_TYPES; ++t) {
+      key |= (uint64_t) counts[color][t] <<
+             (4 * ((color ^ swap_colors) * NUM_PIECE_TYPES + t));
+    }
+  }
+  return key;
+}
+
+uint64_t MaterialKey(const Position &pos) {
+  int counts[2][NUM_PIECE_TYPES];
+  for (int color = WHITE; color <= BLACK; ++color) {
+    for (int t = 0; t < NUM_PIECE_TYPES; ++t) {
+      counts[color][t] = PopCount(pos.pieces(color, PAWN + t));
+    }
+  }
+  return MaterialKey(counts, false);
+}
+
+// Table piece code: 1 (pawn) to 6 (king), plus 8 for black.
+inline int TablePiece(int piece) {
+  return kTableTypes[TypeOf(piece) - PAWN] | (ColorOf(piece) << 3);
+}
+
+inline bool IsZeroing(const Position &pos, Move m) {
+  return IsCapture(m) || TypeOf(pos.pieceOn(FromSquare(m))) == PAWN;
+}
+
+// The distance to zeroing just before a zeroing move into a "wdl" position.
+int DtzBeforeZeroing(int wdl) {
+  return wdl == WDL_WIN ? 1 : wdl == WDL_CURSED_WIN ? 101 :
+         wdl == WDL_BLESSED_LOSS ? -101 : wdl == WDL_LOSS ? -1 : 0;
+}
+
+inline int Sign(int value) { return (value > 0) - (value < 0); }
+
+bool IsMate(const Position &pos) {
+  if (!pos.inCheck()) {
+    return false;
+  }
+  MoveList list;
+  GenerateLegalMoves(pos, &list);
+  return list.size == 0;
+}
+
+// Decoding data for one table of a file. Pawnless files hold one table per
+// side to move; files with pawns hold one for each file (a-d) of the leading
+// pawn. The pointers point into the mapping.
+struct PairsData {
+  int flags;
+  int max_sym_len;
+  int min_sym_len;           // The value itself for single-value tables.
+  uint32_t num_blocks;
+  uint64_t block_size;
+  uint64_t span;             // Values between sparse index entries.
+  const uint8_t *lowest_sym; // 16-bit lowest symbol of each code length.
+  const uint8_t *btree;      // Pairing tree, 3 bytes per symbol.
+  const uint8_t *block_length;  // 16-bit value count (minus 1) per block.
+  uint32_t block_length_size;
+  const uint8_t *sparse_index;  // 6 bytes per entry: block and offset.
+  uint64_t sparse_index_size;
+  const uint8_t *data;       // The compressed blocks.
+  vector<uint64_t> base64;   // Lowest code of each length, left-aligned.
+  vector<uint8_t> symlen;    // Values (minus 1) each symbol expands to.
+  int pieces[SYZYGY_MAX_PIECES];
+  uint64_t group_idx[SYZYGY_MAX_PIECES + 1];
+  int group_len[SYZYGY_MAX_PIECES + 1];
+  int map_idx[4];            // DTZ map offsets for each WDL result.
+
+  PairsData()
+      : flags(0), max_sym_len(0), min_sym_len(0), num_blocks(0),
+        block_size(0), span(0), lowest_sym(NULL), btree(NULL),
+        block_length(NULL), block_length_size(0), sparse_index(NULL),
+        sparse_index_size(0), data(NULL) {
+    memset(pieces, 0, sizeof(pieces));
+    memset(group_idx, 0, sizeof(group_idx));
+    memset(group_len, 0, sizeof(group_len));
+    memset(map_idx, 0, sizeof(map_idx));
+  }
+};
+
+//------------------------------------------------------------------------------
+// Returns the value stored at "idx": finds its block through the sparse
+// index, decodes Huffman symbols until reaching the one that covers "idx",
+// then descends the pairing tree to the value itself.
+//------------------------------------------------------------------------------
+int DecompressPairs(const PairsData &d, uint64_t idx) {
+  if (d.flags & FLAG_SINGLE_VALUE) {
+    return d.min_sym_len;
+  }
+
+  // Sparse entry k describes the value at k * span + span / 2:
+  uint64_t k = idx / d.span;
+  const uint8_t *entry = d.sparse_index + 6 * k;
+  uint32_t block = ReadLE32(entry);
+  int64_t offset = ReadLE16(entry + 4);
+  offset += (int64_t) (idx % d.span) - (int64_t) (d.span / 2);
+  while (offset < 0) {
+    offset += ReadLE16(d.block_length + 2 * --block) + 1;
+  }
+  while (offset > ReadLE16(d.block_length + 2 * block)) {
+    offset -= ReadLE16(d.block_length + 2 * block++) + 1;
+  }
+
+  const uint8_t *p = d.data + block * d.block_size;
+  uint64_t buffer = ReadBE64(p);
+  p += 8;
+  int buffer_bits = 64;
+  int sym;
+  while (true) {
+    int len = 0;  // Code length minus min_sym_len.
+    while (buffer < d.base64[len]) {
+      ++len;
+    }
+    sym = (int) ((buffer - d.base64[len]) >> (64 - len - d.min_sym_len));
+    sym += ReadLE16(d.lowest_sym + 2 * len);
+    if (offset < d.symlen[sym] + 1) {
+      break;
+    }
+    offset -= d.symlen[sym] + 1;
+    len += d.min_sym_len;
+    buffer <<= len;
+    buffer_bits -= len;
+    if (buffer_bits <= 32) {
+      buffer_bits += 32;
+      buffer |= (uint64_t) ReadBE32(p) << (64 - buffer_bits);
+      p += 4;
+    }
+  }
+
+  // Children of a pair are adjacent, so the value lies left or right:
+  while (d.symlen[sym]) {
+    const uint8_t *node = d.btree + 3 * sym;
+    int left = LeftSymbol(node);
+    if (offset < d.symlen[left] + 1) {
+      sym = left;
+    } else {
+      offset -= d.symlen[left] + 1;
+      sym = RightSymbol(node);
+    }
+  }
+  return LeftSymbol(d.btree + 3 * sym);
+}
+
+uint8_t SetSymlen(PairsData *d, int sym, vector<bool> *visited) {
+  (*visited)[sym] = true;
+  const uint8_t *node = d->btree + 3 * sym;
+  int right = RightSymbol(node);
+  if (right == 0xFFF) {
+    return 0;  // A leaf.
+  }
+  int left = LeftSymbol(node);
+  if (!(*visited)[left]) {
+    d->symlen[left] = SetSymlen(d, left, visited);
+  }
+  if (!(*visited)[right]) {
+    d->symlen[right] = SetSymlen(d, right, visited);
+  }
+  return d->symlen[left] + d->symlen[right] + 1;
+}
+
+//------------------------------------------------------------------------------
+// Reads a table's block and code descriptions. Returns the next byte, or NULL
+// if the description would run past "end".
+//------------------------------------------------------------------------------
+const uint8_t *SetSizes(PairsData *d, const uint8_t *data,
+                        const uint8_t *end) {
+  if (end - data < 2) {
+    return NULL;
+  }
+  d->flags = *data++;
+  if (d->flags & FLAG_SINGLE_VALUE) {
+    d->min_sym_len = *data++;
+    return data;
+  }
+  if (end - data < 9) {
+    return NULL;
+  }
+  int groups = 0;
+  while (d->group_len[groups]) {
+    ++groups;
+  }
+  uint64_t table_size = d->group_idx[groups];
+  d->block_size = 1ULL << *data++;
+  d->span = 1ULL << *data++;
+  d->sparse_index_size = (table_size + d->span - 1) / d->span;
+  int padding = *data++;
+  d->num_blocks = ReadLE32(data);
+  data += 4;
+  d->block_length_size = d->num_blocks + padding;
+  d->max_sym_len = *data++;
+  d->min_sym_len = *data++;
+  if (d->max_sym_len < d->min_sym_len || d->min_sym_len < 1 ||
+      d->max_sym_len > 32 ||
+      end - data < 2 * (d->max_sym_len - d->min_sym_len + 1) + 2) {
+    return NULL;
+  }
+  d->lowest_sym = data;
+
+  // Longer codes have lower values, so base64[] decreases with the length:
+  d->base64.assign(d->max_sym_len - d->min_sym_len + 1, 0);
+  for (int i = (int) d->base64.size() - 2; i >= 0; --i) {
+    d->base64[i] = (d->base64[i + 1] + ReadLE16(d->lowest_sym + 2 * i) -
+                    ReadLE16(d->lowest_sym + 2 * (i + 1))) / 2;
+  }
+  for (size_t i = 0; i < d->base64.size(); ++i) {
+    d->base64[i] <<= 64 - i - d->min_sym_len;
+  }
+  data += 2 * d->base64.size();
+
+  int symbols = ReadLE16(data);
+  data += 2;
+  if (end - data < 3 * symbols) {
+    return NULL;
+  }
+  d->symlen.assign(symbols, 0);
+  d->btree = data;
+  vector<bool> visited(symbols, false);
+  for (int sym = 0; sym < symbols; ++sym) {
+    if (!visited[sym]) {
+      d->symlen[sym] = SetSymlen(d, sym, &visited);
+    }
+  }
+  return data + 3 * symbols + (symbols & 1);
+}
+
+}  // namespace
+
+// Material combination, known from its file name at init().
+struct Tablebases::Table {
+  uint64_t key;   // The stronger side (the name's first half) as white.
+  uint64_t key2;  // Colors swapped.
+  int piece_count;
+  bool has_pawns;
+  bool has_unique_pieces;   // Some piece other than a king has no twin.
+  int pawn_count[2];        // Leading color first.
+  string path[2];           // [TABLE_WDL or TABLE_DTZ]; empty if missing.
+  shared_ptr<TableFile> file[2];  // Mapped on first use.
+  atomic<uint32_t> last_used[2];
+  atomic<bool> failed[2];   // The file could not be mapped or is corrupt.
+};
+
+// A mapped file and its decoding data.
+struct Tablebases::TableFile {
+  MappedFile file;
+  PairsData items[2][4];  // [side to move][leading pawn file or 0]
+  const uint8_t *dtz_map;
+
+  PairsData &get(int stm, int col, const Table &table, int type) {
+    return items[type == TABLE_WDL ? stm : 0][table.has_pawns ? col : 0];
+  }
+  bool load(const Table &table, int type);
+  void setGroups(const Table &table, PairsData *d, const int order[2],
+                 int col);
+};
+
+//------------------------------------------------------------------------------
+// Splits a table's pieces into the groups that are encoded together, and
+// computes each group's multiplier in the index. The leading group is three
+// unique pieces or the two kings when there are no pawns, and the leading
+// pawns otherwise; "order" gives the position of the leading group and of
+// the other side's pawns among the factors.
+//------------------------------------------------------------------------------
+void Tablebases::TableFile::setGroups(const Table &table, PairsData *d,
+                                      const int order[2], int col) {
+  int n = 0;
+  int first_len = table.has_pawns ? 0 : table.has_unique_pieces ? 3 : 2;
+  d->group_len[0] = 1;
+  for (int i = 1; i < table.piece_count; ++i) {
+    if (--first_len > 0 || d->pieces[i] == d->pieces[i - 1]) {
+      d->group_len[n]++;
+    } else {
+      d->group_len[++n] = 1;
+    }
+  }
+  d->group_len[++n] = 0;
+
+  bool both_pawns = table.has_pawns && table.pawn_count[1];
+  int next = both_pawns ? 2 : 1;
+  int free_squares = 64 - d->group_len[0] -
+                     (both_pawns ? d->group_len[1] : 0);
+  uint64_t idx = 1;
+  for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+    if (k == order[0]) {
+      d->group_idx[0] = idx;
+      idx *= table.has_pawns ? lead_pawns_size[d->group_len[0]][col] :
+             table.has_unique_pieces ? 31332 : 462;
+    } else if (k == order[1]) {
+      d->group_idx[1] = idx;
+      idx *= binomial[d->group_len[1]][48 - d->group_len[0]];
+    } else {
+      d->group_idx[next] = idx;
+      idx *= binomial[d->group_len[next]][free_squares];
+      free_squares -= d->group_len[next++];
+    }
+  }
+  d->group_idx[n] = idx;
+}
+
+//------------------------------------------------------------------------------
+// Maps "table"'s file and reads the layout of the tables inside it. Returns
+// false if the file is missing or corrupt.
+//------------------------------------------------------------------------------
+bool Tablebases::TableFile::load(const Table &table, int type) {
+  if (!file.open(table.path[type].c_str()) || file.size() < 5 ||
+      memcmp(file.data(), kMagic[type], 4) != 0) {
+    return false;
+  }
+  const uint8_t *data = file.data() + 4;
+  const uint8_t *end = file.data() + file.size();
+  const int kSplit = 1, kHasPawns = 2;
+  bool split = table.key != table.key2;
+  if (((*data & kHasPawns) != 0) != table.has_pawns ||
+      ((*data & kSplit) != 0) != split) {
+    return false;
+  }
+  ++data;
+
+  int sides = type == TABLE_WDL && split ? 2 : 1;
+  int max_col = table.has_pawns ? 3 : 0;
+  bool both_pawns = table.has_pawns && table.pawn_count[1];
+  for (int col = 0; col <= max_col; ++col) {
+    if (end - data < 1 + both_pawns + table.piece_count) {
+      return false;
+    }
+    int order[2][2] = {
+      { *data & 0xF, both_pawns ? data[1] & 0xF : 0xF },
+      { *data >> 4, both_pawns ? data[1] >> 4 : 0xF }
+    };
+    data += 1 + both_pawns;
+    for (int k = 0; k < table.piece_count; ++k, ++data) {
+      for (int i = 0; i < sides; ++i) {
+        items[i][col].pieces[k] = i ? *data >> 4 : *data & 0xF;
+      }
+    }
+    for (int i = 0; i < sides; ++i) {
+      setGroups(table, &items[i][col], order[i], col);
+    }
+  }
+  data += (uintptr_t) data & 1;  // Word alignment.
+
+  for (int col = 0; col <= max_col; ++col) {
+    for (int i = 0; i < sides; ++i) {
+      if ((data = SetSizes(&items[i][col], data, end)) == NULL) {
+        return false;
+      }
+    }
+  }
+
+  // DTZ values are stored as ranks by frequency; the map turns them back:
+  dtz_map = data;
+  if (type == TABLE_DTZ) {
+    for (int col = 0; col <= max_col; ++col) {
+      PairsData &d = items[0][col];
+      if (!(d.flags & FLAG_MAPPED)) {
+        continue;
+      }
+      if (d.flags & FLAG_WIDE) {
+        data += (uintptr_t) data & 1;
+        for (int i = 0; i < 4 && data + 2 <= end; ++i) {
+          d.map_idx[i] = (int) ((data - dtz_map) / 2 + 1);
+          data += 2 * ReadLE16(data) + 2;
+        }
+      } else {
+        for (int i = 0; i < 4 && data < end; ++i) {
+          d.map_idx[i] = (int) (data - dtz_map + 1);
+          data += *data + 1;
+        }
+      }
+    }
+    data += (uintptr_t) data & 1;
+  }
+
+  for (int col = 0; col <= max_col; ++col) {
+    for (int i = 0; i < sides; ++i) {
+      items[i][col].sparse_index = data;
+      data += 6 * items[i][col].sparse_index_size;
+    }
+  }
+  for (int col = 0; col <= max_col; ++col) {
+    for (int i = 0; i < sides; ++i) {
+      items[i][col].block_length = data;
+      data += 2 * (uint64_t) items[i][col].block_length_size;
+    }
+  }
+  for (int col = 0; col <= max_col; ++col) {
+    for (int i = 0; i < sides; ++i) {
+      data = (const uint8_t *) (((uintptr_t) data + 0x3F) & ~(uintptr_t) 0x3F);
+      items[i][col].data = data;
+      data += items[i][col].num_blocks * items[i][col].block_size;
+    }
+  }
+  return data <= end;
+}
+
+Tablebases::Tablebases() : max_pieces_(0), clock_(0), open_files_(0) {
+  static bool initialized = InitIndexTables();
+  (void) initialized;
+}
+
+Tablebases::~Tablebases() {}
+
+//------------------------------------------------------------------------------
+// Registers the material combination "white" v "black" (e.g., "KRP", "KR") if
+// its WDL file exists in one of the search paths.
+//------------------------------------------------------------------------------
+void Tablebases::addTable(const string &white, const string &black) {
+  unique_ptr<Table> table(new Table());
+  for (int type = TABLE_WDL; type <= TABLE_DTZ; ++type) {
+    for (size_t i = 0; i < paths_.size() && table->path[type].empty(); ++i) {
+      string path = paths_[i] + "/" + white + "v" + black + kExtensions[type];
+      if (access(path.c_str(), R_OK) == 0) {
+        table->path[type] = path;
+      }
+    }
+    table->last_used[type] = 0;
+    table->failed[type] = false;
+  }
+  if (table->path[TABLE_WDL].empty()) {
+    return;
+  }
+
+  int counts[2][NUM_PIECE_TYPES] = { { 0 } };
+  for (int side = 0; side < 2; ++side) {
+    const string &pieces = side == 0 ? white : black;
+    for (size_t i = 0; i < pieces.size(); ++i) {
+      ++counts[side][strchr(kPieceChars, pieces[i]) - kPieceChars];
+    }
+  }
+  table->key = MaterialKey(counts, false);
+  table->key2 = MaterialKey(counts, true);
+  table->piece_count = (int) (white.size() + black.size());
+  table->has_pawns = counts[WHITE][0] || counts[BLACK][0];
+  table->has_unique_pieces = false;
+  for (int side = 0; side < 2; ++side) {
+    for (int t = 0; t < NUM_PIECE_TYPES - 1; ++t) {  // All but kings.
+      table->has_unique_pieces |= counts[side][t] == 1;
+    }
+  }
+
+  // Pawns are encoded from the side with fewer pawns (but at least one):
+  bool white_leads = !counts[BLACK][0] ||
+                     (counts[WHITE][0] && counts[BLACK][0] >= counts[WHITE][0]);
+  table->pawn_count[0] = counts[white_leads ? WHITE : BLACK][0];
+  table->pawn_count[1] = counts[white_leads ? BLACK : WHITE][0];
+
+  by_material_[table->key] = table.get();
+  by_material_[table->key2] = table.get();
+  max_pieces_ = max(max_pieces_, table->piece_count);
+  tables_.push_back(move(table));
+}
+
+int Tablebases::init(const string &paths) {
+  lock_guard<mutex> lock(mutex_);
+  tables_.clear();
+  by_material_.clear();
+  paths_.clear();
+  max_pieces_ = 0;
+  open_files_ = 0;
+  size_t start = 0;
+  while (start <= paths.size()) {
+    size_t end = paths.find(':', start);
+    if (end == string::npos) {
+      end = paths.size();
+    }
+    if (end > start) {
+      paths_.push_back(paths.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+  if (paths_.empty()) {
+    return 0;
+  }
+
+  // Every split of 3 to 7 pieces into two sides, each with a king and its
+  // pieces in name order; the stronger side (more pieces) comes first.
+  vector<string> sides[SYZYGY_MAX_PIECES];  // By number of pieces.
+  sides[1].push_back("K");
+  for (int n = 2; n < SYZYGY_MAX_PIECES; ++n) {
+    for (size_t i = 0; i < sides[n - 1].size(); ++i) {
+      const string &prev = sides[n - 1][i];
+      char last = prev[prev.size() - 1];
+      for (int t = 1; t < NUM_PIECE_TYPES; ++t) {  // Queen to pawn.
+        char c = kPieceChars[kNameOrder[t] - PAWN];
+        if (strchr(kNameChars, c) >= strchr(kNameChars, last)) {
+          sides[n].push_back(prev + c);
+        }
+      }
+    }
+  }
+  for (int total = 3; total <= SYZYGY_MAX_PIECES; ++total) {
+    for (int w = total - 1; w >= (total + 1) / 2; --w) {
+      for (size_t i = 0; i < sides[w].size(); ++i) {
+        for (size_t j = 0; j < sides[total - w].size(); ++j) {
+          // Equal sides are listed once, stronger pieces first:
+          if (w == total - w && !Stronger(sides[w][i], sides[w][j])) {
+            continue;
+          }
+          addTable(sides[w][i], sides[total - w][j]);
+        }
+      }
+    }
+  }
+  return (int) tables_.size();
+}
+
+//------------------------------------------------------------------------------
+// Returns the mapped file of "type" for "table", mapping it if necessary and
+// unmapping the least recently used file when the cache is full. Files stay
+// mapped while any thread still holds them.
+//------------------------------------------------------------------------------
+shared_ptr<Tablebases::TableFile> Tablebases::acquire(Table *table,
+                                                      int type) {
+  uint32_t now = clock_.load(memory_order_relaxed);
+  if (table->last_used[type].load(memory_order_relaxed) != now) {
+    table->last_used[type].store(now, memory_order_relaxed);
+  }
+  shared_ptr<TableFile> file = atomic_load(&table->file[type]);
+  if (file || table->failed[type].load(memory_order_relaxed) ||
+      table->path[type].empty()) {
+    return file;
+  }
+
+  lock_guard<mutex> lock(mutex_);
+  file = atomic_load(&table->file[type]);
+  if (file || table->failed[type]) {
+    return file;
+  }
+  while (open_files_ >= SYZYGY_MAX_OPEN_FILES) {
+    Table *oldest = NULL;
+    int oldest_type = 0;
+    for (size_t i = 0; i < tables_.size(); ++i) {
+      for (int t = TABLE_WDL; t <= TABLE_DTZ; ++t) {
+        if (atomic_load(&tables_[i]->file[t]) &&
+            (!oldest || tables_[i]->last_used[t] <
+                        oldest->last_used[oldest_type])) {
+          oldest = tables_[i].get();
+          oldest_type = t;
+        }
+      }
+    }
+    if (!oldest) {
+      open_files_ = 0;
+      break;
+    }
+    atomic_store(&oldest->file[oldest_type], shared_ptr<TableFile>());
+    --open_files_;
+  }
+  file = make_shared<TableFile>();
+  if (!file->load(*table, type)) {
+    table->failed[type] = true;
+    return shared_ptr<TableFile>();
+  }
+  atomic_store(&table->file[type], file);
+  ++open_files_;
+  table->last_used[type] = clock_.fetch_add(1) + 1;
+  return file;
+}
+
+bool Tablebases::covers(const Position &pos) const {
+  return max_pieces_ && !pos.castlingRights() &&
+         PopCount(pos.pieces()) <= max_pieces_;
+}
+
+//------------------------------------------------------------------------------
+// Looks "pos" up in its WDL or DTZ table. A DTZ value is returned in plies
+// and needs the position's "wdl" to be decoded.
+//------------------------------------------------------------------------------
+int Tablebases::probeTable(Position &pos, int type, int wdl,
+                           ProbeState *state) {
+  if (PopCount(pos.pieces()) == 2) {
+    return WDL_DRAW;  // King against king.
+  }
+  unordered_map<uint64_t, Table *>::const_iterator it =
+      by_material_.find(MaterialKey(pos));
+  shared_ptr<TableFile> file;
+  if (it == by_material_.end() || !(file = acquire(it->second, type))) {
+    *state = PROBE_FAIL;
+    return 0;
+  }
+  const Table &table = *it->second;
+
+  // Tables are stored with the stronger side as white and, when both sides
+  // are equal, with white to move; otherwise flip colors and ranks.
+  uint64_t key = MaterialKey(pos);
+  bool symmetric_black = table.key == table.key2 && pos.sideToMove() == BLACK;
+  bool flip = symmetric_black || key != table.key;
+  int flip_color = flip ? 8 : 0, flip_squares = flip ? 56 : 0;
+  int stm = flip ^ pos.sideToMove();
+
+  int squares[SYZYGY_MAX_PIECES], pieces[SYZYGY_MAX_PIECES];
+  int size = 0, lead_pawns_count = 0, col = 0;
+  Bitboard lead_pawns = 0;
+  if (table.has_pawns) {
+    // The table's first piece is a pawn of the leading color:
+    int pc = file->get(0, 0, table, type).pieces[0] ^ flip_color;
+    int color = pc >> 3;
+    lead_pawns = pos.pieces(color, PAWN);
+    for (Bitboard b = lead_pawns; b; ) {
+      squares[size++] = PopLowestSquare(b) ^ flip_squares;
+    }
+    lead_pawns_count = size;
+    swap(squares[0], *max_element(squares, squares + lead_pawns_count,
+                                  [](int a, int b) {
+                                    return map_pawns[a] < map_pawns[b];
+                                  }));
+    col = min(ColOf(squares[0]), 7 - ColOf(squares[0]));
+  }
+
+  // DTZ files hold one side to move; the caller searches one ply instead:
+  if (type == TABLE_DTZ &&
+      (file->get(stm, col, table, type).flags & FLAG_STM) != stm &&
+      !(table.key == table.key2 && !table.has_pawns)) {
+    *state = PROBE_CHANGE_STM;
+    return 0;
+  }
+
+  for (Bitboard b = pos.pieces() ^ lead_pawns; b; ) {
+    int s = PopLowestSquare(b);
+    squares[size] = s ^ flip_squares;
+    pieces[size++] = TablePiece(pos.pieceOn(s)) ^ flip_color;
+  }
+  const PairsData &d = file->get(stm, col, table, type);
+
+  // Put the pieces in the table's order:
+  for (int i = lead_pawns_count; i < size - 1; ++i) {
+    for (int j = i + 1; j < size; ++j) {
+      if (d.pieces[i] == pieces[j]) {
+        swap(pieces[i], pieces[j]);
+        swap(squares[i], squares[j]);
+        break;
+      }
+    }
+  }
+
+  // Mirror the leading piece onto files a-d:
+  if (ColOf(squares[0]) > 3) {
+    for (int i = 0; i < size; ++i) {
+      squares[i] ^= 7;
+    }
+  }
+
+  uint64_t idx;
+  if (table.has_pawns) {
+    idx = lead_pawn_idx[lead_pawns_count][squares[0]];
+    stable_sort(squares + 1, squares + lead_pawns_count, [](int a, int b) {
+      return map_pawns[a] < map_pawns[b];
+    });
+    for (int i = 1; i < lead_pawns_count; ++i) {
+      idx += binomial[i][map_pawns[squares[i]]];
+    }
+  } else {
+    // Mirror the leading piece onto ranks 1-4, then below the a1-h8
+    // diagonal (taking the first leading piece off it):
+    if (RowOf(squares[0]) > 3) {
+      for (int i = 0; i < size; ++i) {
+        squares[i] ^= 56;
+      }
+    }
+    for (int i = 0; i < d.group_len[0]; ++i) {
+      if (!OffA1H8(squares[i])) {
+        continue;
+      }
+      if (OffA1H8(squares[i]) > 0) {
+        for (int j = i; j < size; ++j) {
+          squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+        }
+      }
+      break;
+    }
+
+    if (table.has_unique_pieces) {
+      // Three unique pieces: the first in the triangle, the other two on
+      // the 63 and 62 squares that remain, with the cases where leading
+      // pieces lie on the diagonal numbered after the others.
+      int adjust1 = squares[1] > squares[0];
+      int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+      if (OffA1H8(squares[0])) {
+        idx = (map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 +
+              squares[2] - adjust2;
+      } else if (OffA1H8(squares[1])) {
+        idx = (6 * 63 + RowOf(squares[0]) * 28 + map_b1h1h7[squares[1]]) *
+              62 + squares[2] - adjust2;
+      } else if (OffA1H8(squares[2])) {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + RowOf(squares[0]) * 7 * 28 +
+              (RowOf(squares[1]) - adjust1) * 28 + map_b1h1h7[squares[2]];
+      } else {
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 +
+              RowOf(squares[0]) * 7 * 6 + (RowOf(squares[1]) - adjust1) * 6 +
+              (RowOf(squares[2]) - adjust2);
+      }
+    } else {
+      idx = map_kk[map_a1d1d4[squares[0]]][squares[1]];
+    }
+  }
+
+  // The remaining groups, each as a combination of the squares left over:
+  idx *= d.group_idx[0];
+  int *group = squares + d.group_len[0];
+  bool remaining_pawns = table.has_pawns && table.pawn_count[1];
+  for (int next = 1; d.group_len[next]; ++next) {
+    stable_sort(group, group + d.group_len[next]);
+    uint64_t n = 0;
+    for (int i = 0; i < d.group_len[next]; ++i) {
+      int adjust = 0;
+      for (int *s = squares; s < group; ++s) {
+        adjust += group[i] > *s;
+      }
+      n += binomial[i + 1][group[i] - adjust - 8 * remaining_pawns];
+    }
+    remaining_pawns = false;
+    idx += n * d.group_idx[next];
+    group += d.group_len[next];
+  }
+
+  int value = DecompressPairs(d, idx);
+  if (type == TABLE_WDL) {
+    return value - 2;
+  }
+
+  static const int kWdlMap[] = { 1, 3, 0, 2, 0 };  // By wdl + 2.
+  const PairsData &d0 = file->get(0, col, table, type);
+  if (d0.flags & FLAG_MAPPED) {
+    int map_idx = d0.map_idx[kWdlMap[wdl + 2]];
+    value = d0.flags & FLAG_WIDE ?
+            ReadLE16(file->dtz_map + 2 * (map_idx + value)) :
+            file->dtz_map[map_idx + value];
+  }
+  if ((wdl == WDL_WIN && !(d0.flags & FLAG_WIN_PLIES)) ||
+      (wdl == WDL_LOSS && !(d0.flags & FLAG_LOSS_PLIES)) ||
+      wdl == WDL_CURSED_WIN || wdl == WDL_BLESSED_LOSS) {
+    value *= 2;  // Stored in moves.
+  }
+  return value + 1;
+}
+
+//------------------------------------------------------------------------------
+// Returns the WDL score of "pos", trying captures (and with "pawn_moves",
+// pawn moves) first: the tables may store any value where such a move wins,
+// and a stored loss may hide a drawing capture. Sets PROBE_ZEROING_MOVE when
+// a capture or pawn move is the best move.
+//------------------------------------------------------------------------------
+int Tablebases::searchZeroing(Position &pos, bool pawn_moves,
+                              ProbeState *state) {
+  MoveList list;
+  GenerateLegalMoves(pos, &list);
+  int best = WDL_LOSS, tried = 0;
+  for (int i = 0; i < list.size; ++i) {
+    Move m = list.moves[i];
+    if (!IsCapture(m) && (!pawn_moves || !IsZeroing(pos, m))) {
+      continue;
+    }
+    ++tried;
+    pos.doMove(m);
+    int value = -searchZeroing(pos, false, state);
+    pos.undoMove();
+    if (*state == PROBE_FAIL) {
+      return WDL_DRAW;
+    }
+    if (value > best) {
+      best = value;
+      if (value >= WDL_WIN) {
+        *state = PROBE_ZEROING_MOVE;
+        return value;
+      }
+    }
+  }
+
+  // With every legal move tried, the stored value is not needed (and would
+  // be wrong when en passant is possible):
+  bool all_tried = tried && tried == list.size;
+  int value = best;
+  if (!all_tried) {
+    value = probeTable(pos, TABLE_WDL, WDL_DRAW, state);
+    if (*state == PROBE_FAIL) {
+      return WDL_DRAW;
+    }
+  }
+  if (best >= value) {
+    *state = best > WDL_DRAW || all_tried ? PROBE_ZEROING_MOVE : PROBE_OK;
+    return best;
+  }
+  *state = PROBE_OK;
+  return value;
+}
+
+bool Tablebases::probeWdl(Position &pos, int *wdl) {
+  if (!covers(pos)) {
+    return false;
+  }
+  ProbeState state = PROBE_OK;
+  *wdl = searchZeroing(pos, false, &state);
+  return state != PROBE_FAIL;
+}
+
+//------------------------------------------------------------------------------
+// Returns the distance to zeroing in plies: positive when winning, negative
+// when losing, 0 for draws, plus 100 for results the fifty-move rule spoils.
+//------------------------------------------------------------------------------
+int Tablebases::probeDtzTable(Position &pos, ProbeState *state) {
+  *state = PROBE_OK;
+  int wdl = searchZeroing(pos, true, state);
+  if (*state == PROBE_FAIL || wdl == WDL_DRAW) {
+    return 0;
+  }
+  if (*state == PROBE_ZEROING_MOVE) {
+    return DtzBeforeZeroing(wdl);
+  }
+  int dtz = probeTable(pos, TABLE_DTZ, wdl, state);
+  if (*state == PROBE_FAIL) {
+    return 0;
+  }
+  if (*state != PROBE_CHANGE_STM) {
+    return (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) *
+           Sign(wdl);
+  }
+
+  // Only the other side to move is stored: take the best move's value.
+  MoveList list;
+  GenerateLegalMoves(pos, &list);
+  int min_dtz = 0xFFFF;
+  for (int i = 0; i < list.size; ++i) {
+    Move m = list.moves[i];
+    bool zeroing = IsZeroing(pos, m);
+    pos.doMove(m);
+    // After a zeroing move, count from the position before it:
+    dtz = zeroing ? -DtzBeforeZeroing(searchZeroing(pos, false, state)) :
+                    -probeDtzTable(pos, state);
+    if (dtz == 1 && IsMate(pos)) {
+      min_dtz = 1;
+    }
+    if (!zeroing) {
+      dtz += Sign(dtz);
+    }
+    if (dtz < min_dtz && Sign(dtz) == Sign(wdl)) {
+      min_dtz = dtz;
+    }
+    pos.undoMove();
+    if (*state == PROBE_FAIL) {
+      return 0;
+    }
+  }
+  return min_dtz == 0xFFFF ? -1 : min_dtz;  // No moves: mated.
+}
+
+bool Tablebases::probeDtz(Position &pos, int *dtz) {
+  if (!covers(pos)) {
+    return false;
+  }
+  ProbeState state;
+  *dtz = probeDtzTable(pos, &state);
+  return state != PROBE_FAIL;
+}
+
+Move Tablebases::probeRoot(Position &pos, int *score) {
+  if (!covers(pos)) {
+    return NO_MOVE;
+  }
+  MoveList list;
+  GenerateLegalMoves(pos, &list);
+  int halfmoves = pos.halfmoveClock();
+  Move best_move = NO_MOVE;
+  int best_rank = 0, best_dtz = 0;
+  for (int i = 0; i < list.size; ++i) {
+    Move m = list.moves[i];
+    ProbeState state = PROBE_OK;
+    pos.doMove(m);
+    int dtz;
+    if (pos.halfmoveClock() == 0) {
+      dtz = DtzBeforeZeroing(-searchZeroing(pos, false, &state));
+    } else {
+      dtz = -probeDtzTable(pos, &state);
+      dtz += Sign(dtz);
+    }
+    bool mate = IsMate(pos);
+    pos.undoMove();
+    if (state == PROBE_FAIL) {
+      return NO_MOVE;
+    }
+    if (mate) {
+      best_move = m;
+      best_rank = MAX_DTZ;
+      break;
+    }
+
+    // Wins that zero the counter in time rank equally, and so do losses the
+    // opponent can convert in time; the rest rank by how close the fifty-move
+    // rule is. Equal ranks prefer the fastest win or the slowest loss.
+    int rank = dtz > 0 ? (dtz + halfmoves <= 99 ? MAX_DTZ :
+                                                  MAX_DTZ - (dtz + halfmoves)) :
+               dtz < 0 ? (-dtz * 2 + halfmoves < 100 ? -MAX_DTZ :
+                                                       -MAX_DTZ - dtz +
+                                                       halfmoves) : 0;
+    if (best_move == NO_MOVE || rank > best_rank ||
+        (rank == best_rank && dtz > 0 && dtz < best_dtz) ||
+        (rank == best_rank && dtz < 0 && dtz < best_dtz)) {
+      best_move = m;
+      best_rank = rank;
+      best_dtz = dtz;
+    }
+  }
+  if (best_move == NO_MOVE) {
+    return NO_MOVE;
+  }
+
+  // Certain results score just inside the mate range; results near the
+  // fifty-move limit score a fraction of a pawn.
+  const int kBound = MAX_DTZ - 100;
+  int pawn = PieceValue(PAWN);
+  *score = best_rank >= kBound ? VALUE_TB_WIN :
+           best_rank > 0 ? max(3, best_rank - (MAX_DTZ - 200)) * pawn / 200 :
+           best_rank == 0 ? 0 :
+           best_rank > -kBound ?
+               min(-3, best_rank + (MAX_DTZ - 200)) * pawn / 200 :
+               -VALUE_TB_WIN;
+  return best_move;
+}
@@ -0,0 +1,99 @@
+/*******************************************************************************
+   Filename: syzygy.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the Tablebases class, which probes Syzygy
+             endgame tablebases (.rtbw win/draw/loss and .rtbz distance-to-
+             zeroing files). init() only checks which files exist; a file is
+             memory-mapped the first time a position needs it, and the
+             mappings are shared by every search thread through a cache that
+             keeps at most SYZYGY_MAX_OPEN_FILES of them, unmapping the least
+             recently used. The table format and indexing follow the public
+             Syzygy probing code by Ronald de Man.
+*******************************************************************************/
+
+#ifndef SYZYGY_H_
+#define SYZYGY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "position.h"
+
+#define SYZYGY_MAX_PIECES     7
+#define SYZYGY_MAX_OPEN_FILES 256  // Mapped files kept at once.
+// Probing stays off until "SyzygyProbeLimit" is raised: the decoder has not
+// yet passed tools/syzygy_check.cc against a real table set.
+#define SYZYGY_DEFAULT_PROBE_LIMIT 0
+
+// Game-theoretic results for the side to move. Cursed wins and blessed losses
+// are wins and losses that the fifty-move rule turns into draws.
+enum WdlScore {
+  WDL_LOSS = -2,
+  WDL_BLESSED_LOSS,
+  WDL_DRAW,
+  WDL_CURSED_WIN,
+  WDL_WIN
+};
+
+class Tablebases {
+ public:
+  Tablebases();
+  ~Tablebases();
+
+  // Looks for tables in "paths" (directories separated by ':') and returns
+  // how many material combinations were found. Not thread safe: call it while
+  // no search is running.
+  int init(const std::string &paths);
+  int maxPieces() const { return max_pieces_; }  // 0 without tables.
+
+  // The probes may run on any number of threads at once. They fail for
+  // positions with castling rights or with more pieces than the tables hold;
+  // "pos" is restored before they return.
+  bool probeWdl(Position &pos, int *wdl);
+  bool probeDtz(Position &pos, int *dtz);  // Plies; negative when losing.
+
+  // Picks the root move that keeps the best result the tables allow and,
+  // among equals, zeroes the fifty-move counter soonest when winning (or
+  // latest when losing). Returns NO_MOVE if the position is not covered;
+  // otherwise sets "score" to a search score for the result.
+  Move probeRoot(Position &pos, int *score);
+
+ private:
+  struct Table;
+  struct TableFile;
+
+  enum ProbeState {
+    PROBE_FAIL,
+    PROBE_OK,
+    PROBE_CHANGE_STM,      // A DTZ file holds only the other side to move.
+    PROBE_ZEROING_MOVE     // The best move is a capture or pawn move.
+  };
+
+  Tablebases(const Tablebases &);  // Not copyable.
+  Tablebases &operator=(const Tablebases &);
+
+  void addTable(const std::string &white, const std::string &black);
+  std::shared_ptr<TableFile> acquire(Table *table, int type);
+  int probeTable(Position &pos, int type, int wdl, ProbeState *state);
+  int searchZeroing(Position &pos, bool pawn_moves, ProbeState *state);
+  int probeDtzTable(Position &pos, ProbeState *state);
+  bool covers(const Position &pos) const;
+
+  std::vector<std::string> paths_;
+  std::vector<std::unique_ptr<Table> > tables_;
+  std::unordered_map<uint64_t, Table *> by_material_;
+  int max_pieces_;
+
+  // Cache of mapped files:
+  std::mutex mutex_;            // Guards mapping and unmapping.
+  std::atomic<uint32_t> clock_; // Advances with every file mapped.
+  int open_files_;
+};
+
+#endif  // SYZYGY_H_
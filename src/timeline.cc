@@ -0,0 +1,368 @@
+/*******************************************************************************
+   Filename: timeline.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Keyframed animation of pieces and the camera.
+*******************************************************************************/
+
+#include "timeline.h"
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "bitboard.h"
+#include "chess_piece.h"
+
+using namespace std;
+
+namespace {
+
+const int kNoActor = INT32_MIN;  // findActor() result for unknown names.
+
+const char *kChannelNames[NUM_CHANNELS] = {
+  "x", "y", "z", "x_angle", "y_angle", "scale"
+};
+const char *kEasingNames[] = {
+  "linear", "ease-in", "ease-out", "ease-in-out", "step"
+};
+const char *kTypeNames[] = {
+  "pawn", "rook", "bishop", "knight", "queen", "king"
+};
+const char *kColorNames[NUM_CHESS_PIECE_COLORS] = { "white", "black" };
+
+// Returns the index of "name" in "names", or -1.
+int Lookup(const string &name, const char *names[], int count) {
+  for (int i = 0; i < count; ++i) {
+    if (name == names[i]) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Maps u in [0, 1] through an easing curve.
+inline double Ease(int easing, double u) {
+  switch (easing) {
+    case EASE_IN:
+      return u * u;
+    case EASE_OUT:
+      return 1 - (1 - u) * (1 - u);
+    case EASE_IN_OUT:
+      return u * u * (3 - 2 * u);
+    case EASE_STEP:
+      return 0;
+    default:
+      return u;
+  }
+}
+
+// Parses a square name such as "e4". Returns -1 if it is not one.
+int ParseSquare(const string &name) {
+  if (name.size() != 2 || name[0] < 'a' || name[0] > 'h' || name[1] < '1' ||
+      name[1] > '8') {
+    return -1;
+  }
+  return SquareAt(name[1] - '1', name[0] - 'a');
+}
+
+}  // namespace
+
+Timeline::Timeline() : next_(0), time_(0), prepared_(false) {}
+
+void Timeline::clear() {
+  piece_names_.clear();
+  piece_types_.clear();
+  piece_colors_.clear();
+  for (int c = 0; c < NUM_CHANNELS; ++c) {
+    values_[c].clear();
+    initial_values_[c].clear();
+  }
+  external_names_.clear();
+  external_targets_.clear();
+  external_initial_values_.clear();
+  starts_.clear();
+  ends_.clear();
+  froms_.clear();
+  tos_.clear();
+  easings_.clear();
+  actors_.clear();
+  channels_.clear();
+  targets_.clear();
+  active_.clear();
+  next_ = 0;
+  time_ = 0;
+  prepared_ = false;
+}
+
+//------------------------------------------------------------------------------
+// Reads an animation file. Each non-blank line not starting with '#' is one
+// of:
+//   piece <name> <type> <color> <square>
+//   track <actor> <channel> [easing] <time> <value> <time> <value> ...
+// A track sets its first value at its first time (so a single key is a plain
+// assignment) and eases between consecutive keys. Times are in seconds.
+//------------------------------------------------------------------------------
+bool Timeline::load(const char *filename) {
+  ifstream file(filename);
+  if (!file) {
+    return false;
+  }
+  string line;
+  for (int line_number = 1; getline(file, line); ++line_number) {
+    istringstream in(line);
+    string command;
+    if (!(in >> command) || command[0] == '#') {
+      continue;
+    }
+    bool ok = false;
+    if (command == "piece") {
+      string name, type, color, square;
+      in >> name >> type >> color >> square;
+      int t = Lookup(type, kTypeNames, NUM_CHESS_PIECE_TYPES - PAWN);
+      int c = Lookup(color, kColorNames, NUM_CHESS_PIECE_COLORS);
+      int s = ParseSquare(square);
+      ok = !name.empty() && findActor(name) == kNoActor && t >= 0 &&
+           c >= 0 && s >= 0;
+      if (ok) {
+        addPiece(name, PAWN + t, c, SquareCenterX(ColOf(s)),
+                 SquareCenterZ(RowOf(s)));
+      }
+    } else if (command == "track") {
+      string actor, channel, word;
+      in >> actor >> channel;
+      int ch = Lookup(channel, kChannelNames, NUM_CHANNELS);
+      int easing = EASE_LINEAR;
+      vector<double> keys;
+      ok = ch >= 0 && findActor(actor) != kNoActor;
+      while (ok && in >> word) {
+        int e = Lookup(word, kEasingNames, EASE_STEP + 1);
+        if (e >= 0 && keys.empty()) {
+          easing = e;
+        } else {
+          istringstream number(word);
+          double value;
+          ok = (number >> value) && number.eof();
+          keys.push_back(value);
+        }
+      }
+      ok = ok && keys.size() >= 2 && keys.size() % 2 == 0;
+      if (ok) {
+        addSegment(actor, ch, keys[0], keys[0], keys[1], keys[1], easing);
+      }
+      for (size_t i = 2; ok && i < keys.size(); i += 2) {
+        ok = keys[i] >= keys[i - 2];
+        if (ok && keys[i + 1] != keys[i - 1]) {  // Holds need no segment.
+          addSegment(actor, ch, keys[i - 2], keys[i], keys[i - 1],
+                     keys[i + 1], easing);
+        }
+      }
+    }
+    if (!ok) {
+      cerr << "Error: " << filename << ":" << line_number << ": bad line: "
+           << line << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int Timeline::addPiece(const string &name, int type, int color, double x,
+                       double z) {
+  const double kInitial[NUM_CHANNELS] = {
+    x, 0, z, 0, type == KNIGHT && color == BLACK ? 180.0 : 0.0, 1
+  };
+  piece_names_.push_back(name);
+  piece_types_.push_back(type);
+  piece_colors_.push_back(color);
+  for (int c = 0; c < NUM_CHANNELS; ++c) {
+    values_[c].push_back(kInitial[c]);
+    initial_values_[c].push_back(kInitial[c]);
+  }
+  prepared_ = false;  // The value arrays may have moved.
+  return pieceCount() - 1;
+}
+
+void Timeline::addExternalActor(const string &name,
+                                double *targets[NUM_CHANNELS]) {
+  external_names_.push_back(name);
+  external_targets_.push_back(vector<double *>(targets,
+                                               targets + NUM_CHANNELS));
+  vector<double> initial(NUM_CHANNELS, 0.0);
+  for (int c = 0; c < NUM_CHANNELS; ++c) {
+    if (targets[c] != NULL) {
+      initial[c] = *targets[c];
+    }
+  }
+  external_initial_values_.push_back(initial);
+  prepared_ = false;
+}
+
+bool Timeline::addSegment(const string &actor, int channel, double start,
+                          double end, double from, double to, int easing) {
+  return addActorSegment(findActor(actor), channel, start, end, from, to,
+                         easing);
+}
+
+bool Timeline::addPieceSegment(int piece, int channel, double start,
+                               double end, double from, double to,
+                               int easing) {
+  if (piece < 0 || piece >= pieceCount()) {
+    return false;
+  }
+  return addActorSegment(piece, channel, start, end, from, to, easing);
+}
+
+bool Timeline::addActorSegment(int index, int channel, double start,
+                               double end, double from, double to,
+                               int easing) {
+  if (index == kNoActor || channel < 0 || channel >= NUM_CHANNELS ||
+      end < start) {
+    return false;
+  }
+  starts_.push_back(start);
+  ends_.push_back(end);
+  froms_.push_back(from);
+  tos_.push_back(to);
+  easings_.push_back((uint8_t) easing);
+  actors_.push_back(index);
+  channels_.push_back((uint8_t) channel);
+  prepared_ = false;
+  return true;
+}
+
+int Timeline::findActor(const string &name) const {
+  for (size_t i = 0; i < piece_names_.size(); ++i) {
+    if (piece_names_[i] == name) {
+      return (int) i;
+    }
+  }
+  for (size_t i = 0; i < external_names_.size(); ++i) {
+    if (external_names_[i] == name) {
+      return -1 - (int) i;
+    }
+  }
+  return kNoActor;
+}
+
+// Scans every segment rather than the active ones, so that "time" need not be
+// the time the timeline was last advanced to.
+bool Timeline::isActorAnimating(const string &actor, double time) const {
+  int index = findActor(actor);
+  for (size_t i = 0; i < count(); ++i) {
+    if (actors_[i] == index && starts_[i] <= time && time < ends_[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+double Timeline::endTime() const {
+  double end = 0;
+  for (size_t i = 0; i < ends_.size(); ++i) {
+    end = max(end, ends_[i]);
+  }
+  return end;
+}
+
+//------------------------------------------------------------------------------
+// Sorts the segments by start time (keeping the file order of ties) and
+// points each one at the value it drives. Segments for channels an external
+// actor lacks are dropped.
+//------------------------------------------------------------------------------
+void Timeline::prepare() {
+  vector<int> order(count());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = (int) i;
+  }
+  stable_sort(order.begin(), order.end(),
+              [this](int a, int b) { return starts_[a] < starts_[b]; });
+  vector<double> starts, ends, froms, tos;
+  vector<uint8_t> easings, channels;
+  vector<int> actors;
+  targets_.clear();
+  for (size_t k = 0; k < order.size(); ++k) {
+    int i = order[k];
+    double *target = actors_[i] >= 0 ?
+        &values_[channels_[i]][actors_[i]] :
+        external_targets_[-1 - actors_[i]][channels_[i]];
+    if (target == NULL) {
+      continue;
+    }
+    starts.push_back(starts_[i]);
+    ends.push_back(ends_[i]);
+    froms.push_back(froms_[i]);
+    tos.push_back(tos_[i]);
+    easings.push_back(easings_[i]);
+    channels.push_back(channels_[i]);
+    actors.push_back(actors_[i]);
+    targets_.push_back(target);
+  }
+  starts_.swap(starts);
+  ends_.swap(ends);
+  froms_.swap(froms);
+  tos_.swap(tos);
+  easings_.swap(easings);
+  channels_.swap(channels);
+  actors_.swap(actors);
+  prepared_ = true;
+  rewind(false);
+}
+
+//------------------------------------------------------------------------------
+// Restarts the tracks from the pieces' initial values, and if "external" is
+// set, the external actors' too. Re-preparing after segments are added only
+// replays the tracks, leaving variables such as the camera where the viewer
+// has since moved them.
+//------------------------------------------------------------------------------
+void Timeline::rewind(bool external) {
+  for (int c = 0; c < NUM_CHANNELS; ++c) {
+    values_[c] = initial_values_[c];
+  }
+  for (size_t i = 0; external && i < external_targets_.size(); ++i) {
+    for (int c = 0; c < NUM_CHANNELS; ++c) {
+      if (external_targets_[i][c] != NULL) {
+        *external_targets_[i][c] = external_initial_values_[i][c];
+      }
+    }
+  }
+  active_.clear();
+  next_ = 0;
+  time_ = 0;
+}
+
+void Timeline::advance(double time) {
+  if (!prepared_) {
+    prepare();
+  }
+  if (time < time_) {
+    rewind(true);
+  }
+  time_ = time;
+  if (active_.empty() && next_ == count()) {
+    return;  // Nothing left to animate.
+  }
+  while (next_ < count() && starts_[next_] <= time) {
+    active_.push_back((int) next_++);
+  }
+
+  // Finish segments that have ended (in start order, so the latest one on a
+  // channel wins), then evaluate the rest:
+  size_t kept = 0;
+  for (size_t k = 0; k < active_.size(); ++k) {
+    int i = active_[k];
+    if (time >= ends_[i]) {
+      *targets_[i] = tos_[i];
+    } else {
+      active_[kept++] = i;
+    }
+  }
+  active_.resize(kept);
+  for (size_t k = 0; k < active_.size(); ++k) {
+    int i = active_[k];
+    double u = (time - starts_[i]) / (ends_[i] - starts_[i]);
+    *targets_[i] = froms_[i] + (tos_[i] - froms_[i]) * Ease(easings_[i], u);
+  }
+}
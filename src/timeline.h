@@ -0,0 +1,118 @@
+/*******************************************************************************
+   Filename: timeline.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the Timeline class, which animates the pieces
+             (and camera) from keyframed tracks. Track segments are kept as
+             parallel arrays sorted by start time; each frame only the
+             segments in progress are evaluated, so once an animation is over
+             advancing the timeline costs nothing.
+*******************************************************************************/
+
+#ifndef TIMELINE_H_
+#define TIMELINE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum TimelineChannel {
+  CHANNEL_X,
+  CHANNEL_Y,
+  CHANNEL_Z,
+  CHANNEL_X_ANGLE,  // Degrees.
+  CHANNEL_Y_ANGLE,  // Degrees.
+  CHANNEL_SCALE,
+  NUM_CHANNELS
+};
+
+enum Easing {
+  EASE_LINEAR,
+  EASE_IN,
+  EASE_OUT,
+  EASE_IN_OUT,
+  EASE_STEP  // Holds the starting value, then jumps at the segment's end.
+};
+
+class Timeline {
+ public:
+  Timeline();
+  void clear();
+
+  // Appends the actors and tracks in an animation file (see
+  // animations/opening.anim for the format). Returns false, after printing
+  // the offending line, if the file cannot be read or is malformed.
+  bool load(const char *filename);
+
+  // Pieces are drawn every frame; their channel values live in the timeline.
+  int addPiece(const std::string &name, int type, int color, double x,
+               double z);
+
+  // Other actors (e.g., the camera) animate variables owned elsewhere. A
+  // NULL target means the actor has no such channel. The targets' current
+  // values are restored whenever time runs backward.
+  void addExternalActor(const std::string &name,
+                        double *targets[NUM_CHANNELS]);
+
+  // Adds one segment of a track. Segments of the same channel should not
+  // overlap; a segment with end == start sets the value at that time.
+  bool addSegment(const std::string &actor, int channel, double start,
+                  double end, double from, double to, int easing);
+  bool addPieceSegment(int piece, int channel, double start, double end,
+                       double from, double to, int easing);
+
+  // Promotes a piece. Unlike its channels, this is not undone by rewinding.
+  void setPieceType(int piece, int type) { piece_types_[piece] = type; }
+
+  // Updates every channel to its value at "time" (seconds). Moving backward
+  // replays the tracks from the start.
+  void advance(double time);
+  bool isAnimating() const { return !active_.empty() || next_ < count(); }
+  bool isActorAnimating(const std::string &actor, double time) const;
+  double endTime() const;  // When the last segment ends.
+
+  int pieceCount() const { return (int) piece_types_.size(); }
+  int pieceType(int i) const { return piece_types_[i]; }
+  int pieceColor(int i) const { return piece_colors_[i]; }
+  double pieceValue(int channel, int i) const { return values_[channel][i]; }
+
+ private:
+  // Actors are numbered from 0 for pieces and from -1 downward for external
+  // actors.
+  int findActor(const std::string &name) const;
+  bool addActorSegment(int index, int channel, double start, double end,
+                       double from, double to, int easing);
+  size_t count() const { return starts_.size(); }
+  void prepare();
+  void rewind(bool external);
+
+  // Pieces:
+  std::vector<std::string> piece_names_;
+  std::vector<int> piece_types_;
+  std::vector<int> piece_colors_;
+  std::vector<double> values_[NUM_CHANNELS];
+  std::vector<double> initial_values_[NUM_CHANNELS];
+
+  // External actors:
+  std::vector<std::string> external_names_;
+  std::vector<std::vector<double *> > external_targets_;
+  std::vector<std::vector<double> > external_initial_values_;
+
+  // Segments, sorted by start time once prepared:
+  std::vector<double> starts_;
+  std::vector<double> ends_;
+  std::vector<double> froms_;
+  std::vector<double> tos_;
+  std::vector<uint8_t> easings_;
+  std::vector<int> actors_;
+  std::vector<uint8_t> channels_;
+  std::vector<double *> targets_;  // Resolved by prepare().
+
+  std::vector<int> active_;  // In-progress segments, in start order.
+  size_t next_;              // First segment not yet started.
+  double time_;
+  bool prepared_;
+};
+
+#endif  // TIMELINE_H_
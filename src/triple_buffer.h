@@ -0,0 +1,62 @@
+/*******************************************************************************
+   Filename: triple_buffer.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: The TripleBuffer class template, a lock-free way for one thread
+             to keep handing its latest value of some state to one other
+             thread. The writer fills the back buffer and publishes it; the
+             reader picks up the newest published buffer whenever it likes.
+             Neither side ever waits: each owns one buffer outright and they
+             trade the third through a single atomic exchange. Values the
+             reader did not get to in time are simply overwritten.
+*******************************************************************************/
+
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : buffers_(), middle_(1), back_(2), front_(0) {}
+
+  // Writer side. Fill writeBuffer(), then publish() it; afterwards
+  // writeBuffer() is a different buffer, holding stale data.
+  T &writeBuffer() { return buffers_[back_]; }
+  void publish() {
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+            kIndexMask;
+  }
+
+  // Reader side. update() switches readBuffer() to the newest published
+  // value and returns true, or returns false if nothing new was published.
+  bool hasUpdate() const {
+    return middle_.load(std::memory_order_relaxed) & kFresh;
+  }
+  bool update() {
+    if (!hasUpdate()) {
+      return false;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+  const T &readBuffer() const { return buffers_[front_]; }
+
+ private:
+  static const int kIndexMask = 3;
+  static const int kFresh = 4;  // The middle buffer has not been read yet.
+
+  TripleBuffer(const TripleBuffer &);  // Not copyable.
+  TripleBuffer &operator=(const TripleBuffer &);
+
+  T buffers_[3];
+  // Index of the buffer in transit, plus kFresh; on its own cache line so
+  // that the two sides' private indices do not share it.
+  alignas(64) std::atomic<int> middle_;
+  alignas(64) int back_;   // Writer's buffer.
+  alignas(64) int front_;  // Reader's buffer.
+};
+
+#endif  // TRIPLE_BUFFER_H_
@@ -0,0 +1,139 @@
+/*******************************************************************************
+   Filename: tt.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Method definitions for the TranspositionTable class.
+*******************************************************************************/
+
+#include "tt.h"
+
+namespace {
+
+// Packed layout (low to high): move (16), score (16), eval (16), depth (8),
+// bound (2), generation (6).
+inline uint64_t Pack(Move move, int score, int eval, int depth, int bound,
+                     int generation) {
+  return (uint64_t) move |
+         ((uint64_t) (uint16_t) (int16_t) score << 16) |
+         ((uint64_t) (uint16_t) (int16_t) eval << 32) |
+         ((uint64_t) (uint8_t) (int8_t) depth << 48) |
+         ((uint64_t) bound << 56) |
+         ((uint64_t) generation << 58);
+}
+
+inline Move MoveOf(uint64_t data) { return (Move) data; }
+inline int ScoreOf(uint64_t data) { return (int16_t) (data >> 16); }
+inline int EvalOf(uint64_t data) { return (int16_t) (data >> 32); }
+inline int DepthOf(uint64_t data) { return (int8_t) (data >> 48); }
+inline int BoundOf(uint64_t data) { return (data >> 56) & 3; }
+inline int GenerationOf(uint64_t data) { return (data >> 58) & 63; }
+
+}  // namespace
+
+TranspositionTable::TranspositionTable() {
+  buckets_ = NULL;
+  num_buckets_ = 0;
+  generation_ = 0;
+  resize(TT_DEFAULT_MB);
+}
+
+TranspositionTable::~TranspositionTable() {
+  delete[] buckets_;
+}
+
+//------------------------------------------------------------------------------
+// Reallocates the table to (at most) the given size and clears it. Must not
+// be called while a search is running.
+//------------------------------------------------------------------------------
+void TranspositionTable::resize(size_t megabytes) {
+  size_t count = (megabytes << 20) / sizeof(Bucket);
+  if (count < 1) {
+    count = 1;
+  }
+  if (count != num_buckets_) {
+    delete[] buckets_;
+    buckets_ = new Bucket[count];
+    num_buckets_ = count;
+  }
+  clear();
+}
+
+void TranspositionTable::clear() {
+  for (size_t i = 0; i < num_buckets_; ++i) {
+    for (int j = 0; j < kBucketSize; ++j) {
+      buckets_[i].entries[j].check.store(0, std::memory_order_relaxed);
+      buckets_[i].entries[j].data.store(0, std::memory_order_relaxed);
+    }
+  }
+  generation_ = 0;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntryData *result) const {
+  const Bucket *bucket = bucketFor(key);
+  for (int i = 0; i < kBucketSize; ++i) {
+    uint64_t data = bucket->entries[i].data.load(std::memory_order_relaxed);
+    uint64_t check = bucket->entries[i].check.load(std::memory_order_relaxed);
+    if ((check ^ data) == key && BoundOf(data) != BOUND_NONE) {
+      result->move = MoveOf(data);
+      result->score = ScoreOf(data);
+      result->eval = EvalOf(data);
+      result->depth = DepthOf(data);
+      result->bound = BoundOf(data);
+      return true;
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Stores a result, replacing the same position if present, otherwise the
+// shallowest entry, preferring entries left over from earlier searches.
+//------------------------------------------------------------------------------
+void TranspositionTable::store(uint64_t key, Move move, int score, int eval,
+                               int depth, int bound) {
+  Bucket *bucket = bucketFor(key);
+  Entry *replace = &bucket->entries[0];
+  int worst = 1 << 30;
+  for (int i = 0; i < kBucketSize; ++i) {
+    Entry *entry = &bucket->entries[i];
+    uint64_t data = entry->data.load(std::memory_order_relaxed);
+    uint64_t check = entry->check.load(std::memory_order_relaxed);
+    if ((check ^ data) == key) {
+      // Keep a known best move rather than overwrite it with none, and keep
+      // deeper exact results from this search:
+      if (move == NO_MOVE) {
+        move = MoveOf(data);
+      }
+      if (bound != BOUND_EXACT && GenerationOf(data) == generation_ &&
+          DepthOf(data) > depth + 2) {
+        return;
+      }
+      replace = entry;
+      break;
+    }
+    int age = (generation_ - GenerationOf(data)) & 63;
+    int value = DepthOf(data) - 8 * age;
+    if (value < worst) {
+      worst = value;
+      replace = entry;
+    }
+  }
+  uint64_t data = Pack(move, score, eval, depth, bound, generation_);
+  replace->data.store(data, std::memory_order_relaxed);
+  replace->check.store(key ^ data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+  int used = 0;
+  size_t samples = num_buckets_ < 250 ? num_buckets_ : 250;
+  for (size_t i = 0; i < samples; ++i) {
+    for (int j = 0; j < kBucketSize; ++j) {
+      uint64_t data = buckets_[i].entries[j].data.load(
+          std::memory_order_relaxed);
+      used += BoundOf(data) != BOUND_NONE &&
+              GenerationOf(data) == generation_;
+    }
+  }
+  return samples ? (int) (used * 1000 / (samples * kBucketSize)) : 0;
+}
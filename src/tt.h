@@ -0,0 +1,72 @@
+/*******************************************************************************
+   Filename: tt.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the TranspositionTable class, a hash table of
+             search results shared by all search threads without locks.
+*******************************************************************************/
+
+#ifndef TT_H_
+#define TT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "position.h"
+
+#define TT_DEFAULT_MB 16
+
+enum Bound {
+  BOUND_NONE,
+  BOUND_UPPER,  // Score is at most the stored value (failed low).
+  BOUND_LOWER,  // Score is at least the stored value (failed high).
+  BOUND_EXACT
+};
+
+struct TTEntryData {
+  Move move;
+  int score;
+  int eval;
+  int depth;
+  int bound;
+};
+
+// Entries are stored as two 64-bit words: the packed data and the position
+// key XORed with that data. A reader that sees a torn write (one word from
+// each of two stores) gets a key mismatch and treats the slot as empty, so no
+// lock is needed.
+class TranspositionTable {
+ public:
+  TranspositionTable();
+  ~TranspositionTable();
+  void resize(size_t megabytes);
+  void clear();
+  void newSearch() { generation_ = (generation_ + 1) & 63; }
+  bool probe(uint64_t key, TTEntryData *data) const;
+  void store(uint64_t key, Move move, int score, int eval, int depth,
+             int bound);
+  int hashfull() const;  // Permille of sampled slots used this search.
+
+ private:
+  struct Entry {
+    std::atomic<uint64_t> check;  // key ^ data
+    std::atomic<uint64_t> data;
+  };
+  static const int kBucketSize = 4;  // Four entries fill one cache line.
+  struct alignas(64) Bucket {
+    Entry entries[kBucketSize];
+  };
+
+  Bucket *bucketFor(uint64_t key) const {
+    // Maps the key onto [0, num_buckets_) without a division:
+    return &buckets_[(size_t) (((unsigned __int128) key * num_buckets_) >>
+                               64)];
+  }
+
+  Bucket *buckets_;
+  size_t num_buckets_;
+  int generation_;
+};
+
+#endif  // TT_H_
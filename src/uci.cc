@@ -0,0 +1,351 @@
+/*******************************************************************************
+   Filename: uci.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: UCI server. A reader thread collects input lines into a queue
+             that the main loop works through; since "go" only starts the
+             search threads, the loop is always waiting on the queue during a
+             search and a "stop" reaches the engine as soon as it is read.
+*******************************************************************************/
+
+#include "uci.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "book.h"
+#include "nnue.h"
+#include "search.h"
+
+using namespace std;
+
+namespace {
+
+// The "OwnBook" and "BookFile" options. The book is opened when it is enabled
+// and moves are picked at random in proportion to their weights.
+struct BookSettings {
+  bool enabled;
+  string filename;
+  OpeningBook book;
+  mt19937 random;
+};
+
+// The "SyzygyPath" and "SyzygyProbeLimit" options.
+struct SyzygySettings {
+  Tablebases tablebases;
+  int probe_limit;
+};
+
+// Lines read from stdin, oldest first, handed from the reader thread to the
+// main loop.
+class InputQueue {
+ public:
+  InputQueue() : closed_(false) {}
+
+  void push(const string &line) {
+    lock_guard<mutex> lock(mutex_);
+    lines_.push_back(line);
+    ready_.notify_one();
+  }
+
+  void close() {
+    lock_guard<mutex> lock(mutex_);
+    closed_ = true;
+    ready_.notify_one();
+  }
+
+  // Blocks until a line is available. Returns false at the end of input.
+  bool pop(string *line) {
+    unique_lock<mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return closed_ || !lines_.empty(); });
+    if (lines_.empty()) {
+      return false;
+    }
+    *line = lines_.front();
+    lines_.pop_front();
+    return true;
+  }
+
+ private:
+  mutex mutex_;
+  condition_variable ready_;
+  deque<string> lines_;
+  bool closed_;
+};
+
+mutex g_output_mutex;  // The search threads report while the loop replies.
+
+void Send(const string &text) {
+  lock_guard<mutex> lock(g_output_mutex);
+  cout << text << endl;  // Flushes, as UCI requires.
+}
+
+// Holds its own reference to the queue: the thread is detached and may still
+// push a line after RunUci() has returned.
+void ReadInput(shared_ptr<InputQueue> queue) {
+  string line;
+  while (getline(cin, line)) {
+    queue->push(line);
+  }
+  queue->close();
+}
+
+string ScoreToString(int score) {
+  ostringstream out;
+  if (score >= VALUE_MATE_IN_MAX_PLY) {
+    out << "mate " << (VALUE_MATE - score + 1) / 2;
+  } else if (score <= -VALUE_MATE_IN_MAX_PLY) {
+    out << "mate -" << (VALUE_MATE + score) / 2;
+  } else {
+    out << "cp " << score;
+  }
+  return out.str();
+}
+
+void SendInfo(const SearchInfo &info) {
+  ostringstream out;
+  out << "info depth " << info.depth << " seldepth " << info.seldepth
+      << " score " << ScoreToString(info.score) << " nodes " << info.nodes
+      << " nps " << info.nodes * 1000 / max((int64_t) 1, info.time)
+      << " hashfull " << info.hashfull << " tbhits " << info.tbhits
+      << " time " << info.time << " pv";
+  for (size_t i = 0; i < info.pv.size(); ++i) {
+    out << " " << MoveToString(info.pv[i]);
+  }
+  Send(out.str());
+}
+
+void SendBestMove(Move best, Move ponder) {
+  string text = "bestmove " + (best == NO_MOVE ? "0000" : MoveToString(best));
+  if (best != NO_MOVE && ponder != NO_MOVE) {
+    text += " ponder " + MoveToString(ponder);
+  }
+  Send(text);
+}
+
+//------------------------------------------------------------------------------
+// Handles "position [startpos | fen <fen>] [moves <move> ...]". Leaves "pos"
+// unchanged if the FEN is invalid; stops at the first illegal move.
+//------------------------------------------------------------------------------
+void SetPosition(Position *pos, istringstream &in) {
+  string token, fen;
+  in >> token;
+  if (token == "startpos") {
+    fen = START_FEN;
+    in >> token;  // "moves", if any.
+  } else if (token == "fen") {
+    while (in >> token && token != "moves") {
+      fen += token + " ";
+    }
+  } else {
+    return;
+  }
+  Position next;
+  if (!next.setFen(fen)) {
+    Send("info string Error: invalid FEN: " + fen);
+    return;
+  }
+  while (in >> token) {
+    Move m = ParseMove(next, token);
+    if (m == NO_MOVE) {
+      Send("info string Error: illegal move: " + token);
+      break;
+    }
+    next.doMove(m);
+  }
+  *pos = next;
+}
+
+void OpenBook(BookSettings *settings) {
+  settings->book.close();
+  if (settings->enabled && !settings->book.open(settings->filename.c_str())) {
+    Send("info string Error: could not open book " + settings->filename);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Loads the "EvalFile" network, falling back on the classical evaluation when
+// there is none. "quiet" suppresses the reply, as at startup. The hash table
+// is cleared since its entries hold the old evaluator's scores.
+//------------------------------------------------------------------------------
+void LoadNetwork(Search *search, Network *network, const string &filename,
+                 bool quiet) {
+  search->setNetwork(NULL);
+  search->clearHash();
+  network->unload();
+  if (filename.empty() || filename == "<empty>") {
+    if (!quiet) {
+      Send("info string using the classical evaluation");
+    }
+  } else if (network->load(filename.c_str())) {
+    search->setNetwork(network);
+    if (!quiet) {
+      Send("info string NNUE evaluation using " + filename + " (" +
+           Network::simdName() + ")");
+    }
+  } else if (!quiet) {
+    Send("info string Error: could not load network " + filename +
+         "; using the classical evaluation");
+  }
+}
+
+//------------------------------------------------------------------------------
+// Handles "go". A book move, if there is one, is played at once unless the
+// search is to run until stopped.
+//------------------------------------------------------------------------------
+void Go(Search *search, BookSettings *settings, const Position &pos,
+        istringstream &in) {
+  SearchLimits limits;
+  string token;
+  while (in >> token) {
+    if (token == "depth") {
+      in >> limits.depth;
+    } else if (token == "movetime") {
+      in >> limits.movetime;
+    } else if (token == "wtime") {
+      in >> limits.time[WHITE];
+    } else if (token == "btime") {
+      in >> limits.time[BLACK];
+    } else if (token == "winc") {
+      in >> limits.increment[WHITE];
+    } else if (token == "binc") {
+      in >> limits.increment[BLACK];
+    } else if (token == "movestogo") {
+      in >> limits.movestogo;
+    } else if (token == "nodes") {
+      in >> limits.nodes;
+    } else if (token == "infinite") {
+      limits.infinite = true;
+    } else if (token == "ponder") {
+      limits.ponder = true;
+    }
+  }
+  if (settings->book.isOpen() && !limits.infinite && !limits.ponder) {
+    Move m = settings->book.pick(pos, settings->random());
+    if (m != NO_MOVE) {
+      Send("info string book move");
+      SendBestMove(m, NO_MOVE);
+      return;
+    }
+  }
+  search->start(pos, limits);
+}
+
+//------------------------------------------------------------------------------
+// Handles "setoption name <name> [value <value>]". Option names are not case
+// sensitive.
+//------------------------------------------------------------------------------
+void SetOption(Search *search, BookSettings *settings, SyzygySettings *syzygy,
+               Network *network, istringstream &in) {
+  string token, name, value;
+  in >> token;  // "name"
+  while (in >> token && token != "value") {
+    name += (name.empty() ? "" : " ") + token;
+  }
+  getline(in >> ws, value);  // May be a path containing spaces.
+  transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+  search->stop();
+  search->wait();
+  if (name == "threads") {
+    search->setThreads(min(MAX_THREADS, max(1, atoi(value.c_str()))));
+  } else if (name == "hash") {
+    search->setHashSize(min(MAX_HASH_MB, max(1, atoi(value.c_str()))));
+  } else if (name == "clear hash") {
+    search->clearHash();
+  } else if (name == "ownbook") {
+    settings->enabled = value == "true";
+    OpenBook(settings);
+  } else if (name == "bookfile") {
+    settings->filename = value;
+    OpenBook(settings);
+  } else if (name == "syzygypath") {
+    int found = syzygy->tablebases.init(value == "<empty>" ? "" : value);
+    Send("info string found " + to_string(found) + " tablebases");
+    search->setTablebases(&syzygy->tablebases, syzygy->probe_limit);
+  } else if (name == "syzygyprobelimit") {
+    syzygy->probe_limit = min(SYZYGY_MAX_PIECES, max(0, atoi(value.c_str())));
+    search->setTablebases(&syzygy->tablebases, syzygy->probe_limit);
+  } else if (name == "evalfile") {
+    LoadNetwork(search, network, value, false);
+  } else if (name != "ponder") {  // Pondering needs no setup.
+    Send("info string Error: unknown option: " + name);
+  }
+}
+
+}  // namespace
+
+int RunUci() {
+  Position pos;
+  Search search;
+  search.setInfoCallback(SendInfo);
+  search.setDoneCallback(SendBestMove);
+  BookSettings book;
+  book.enabled = false;
+  book.filename = BOOK_FILE;
+  book.random.seed(random_device()());
+  SyzygySettings syzygy;
+  syzygy.probe_limit = SYZYGY_DEFAULT_PROBE_LIMIT;
+  search.setTablebases(&syzygy.tablebases, syzygy.probe_limit);
+  Network network;
+  LoadNetwork(&search, &network, NNUE_FILE, true);
+
+  shared_ptr<InputQueue> queue = make_shared<InputQueue>();
+  thread reader(ReadInput, queue);
+  reader.detach();  // May be blocked in getline() when we quit.
+
+  string line;
+  while (queue->pop(&line)) {
+    istringstream in(line);
+    string command;
+    in >> command;
+    if (command == "uci") {
+      Send("id name " ENGINE_NAME);
+      Send("id author " ENGINE_AUTHOR);
+      Send("option name Threads type spin default 1 min 1 max " +
+           to_string(MAX_THREADS));
+      Send("option name Hash type spin default " + to_string(TT_DEFAULT_MB) +
+           " min 1 max " + to_string(MAX_HASH_MB));
+      Send("option name Clear Hash type button");
+      Send("option name Ponder type check default false");
+      Send("option name OwnBook type check default false");
+      Send("option name BookFile type string default " BOOK_FILE);
+      Send("option name SyzygyPath type string default <empty>");
+      Send("option name SyzygyProbeLimit type spin default " +
+           to_string(SYZYGY_DEFAULT_PROBE_LIMIT) + " min 0 max " +
+           to_string(SYZYGY_MAX_PIECES));
+      Send("option name EvalFile type string default " NNUE_FILE);
+      Send("uciok");
+    } else if (command == "isready") {
+      Send("readyok");
+    } else if (command == "ucinewgame") {
+      search.stop();
+      search.wait();
+      search.clearHash();
+    } else if (command == "setoption") {
+      SetOption(&search, &book, &syzygy, &network, in);
+    } else if (command == "position") {
+      SetPosition(&pos, in);
+    } else if (command == "go") {
+      Go(&search, &book, pos, in);
+    } else if (command == "stop") {
+      search.stop();
+    } else if (command == "ponderhit") {
+      search.ponderhit();
+    } else if (command == "quit") {
+      break;
+    }
+  }
+  search.stop();
+  search.wait();
+  return 0;
+}
@@ -0,0 +1,22 @@
+/*******************************************************************************
+   Filename: uci.h
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Header file for the UCI (Universal Chess Interface) server, which
+             lets tournament managers and GUIs run the engine over stdin and
+             stdout without opening a window.
+*******************************************************************************/
+
+#ifndef UCI_H_
+#define UCI_H_
+
+#define ENGINE_NAME   "Chess"
+#define ENGINE_AUTHOR "David C. Drake"
+#define MAX_THREADS   256
+#define MAX_HASH_MB   65536
+
+// Speaks UCI until "quit" or the end of input. Returns the exit status.
+int RunUci();
+
+#endif  // UCI_H_
@@ -0,0 +1,16 @@
+/*******************************************************************************
+   Filename: bench.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Standalone search benchmark, the same as "chess bench" (see
+             src/bench.h) but linked without OpenGL. The CMake build runs it
+             to collect profiles for profile-guided optimization.
+Usage:       bench [depth] [threads] [hash megabytes]
+*******************************************************************************/
+
+#include "bench.h"
+
+int main(int argc, char **argv) {
+  return BenchMain(argc, argv);
+}
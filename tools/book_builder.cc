@@ -0,0 +1,168 @@
+/*******************************************************************************
+   Filename: book_builder.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Builds an opening book from PGN collections, and lists the book
+             moves for a position. As in pgn_indexer, each input is memory-
+             mapped and parsed in chunks on all cores; every thread sorts its
+             own moves and the sorted runs are merged into the book.
+*******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "book.h"
+#include "mapped_file.h"
+#include "notation.h"
+#include "pgn.h"
+
+using namespace std;
+
+#define DEFAULT_MIN_GAMES 3
+
+namespace {
+
+struct Options {
+  int threads;
+  int plies;
+  int min_games;
+  string probe_fen;
+  vector<string> files;  // Output then inputs, or the book for --probe.
+};
+
+void Usage() {
+  cerr << "Usage: book_builder [options] OUTPUT.bin INPUT.pgn ...\n"
+          "       book_builder --probe FEN BOOK.bin\n"
+          "  --threads N    parsing threads (default: one per core)\n"
+          "  --plies N      book depth in plies (default: 20)\n"
+          "  --min-games N  keep moves played in at least N games "
+          "(default: 3)\n"
+          "  --probe FEN    list the book moves for FEN\n";
+  exit(2);
+}
+
+Options ParseOptions(int argc, char **argv) {
+  Options options;
+  options.threads = max(1u, thread::hardware_concurrency());
+  options.plies = BOOK_DEFAULT_PLIES;
+  options.min_games = DEFAULT_MIN_GAMES;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--threads" && has_value) {
+      options.threads = atoi(argv[++i]);
+    } else if (arg == "--plies" && has_value) {
+      options.plies = atoi(argv[++i]);
+    } else if (arg == "--min-games" && has_value) {
+      options.min_games = atoi(argv[++i]);
+    } else if (arg == "--probe" && has_value) {
+      options.probe_fen = argv[++i];
+    } else if (arg.compare(0, 2, "--") == 0) {
+      Usage();
+    } else {
+      options.files.push_back(arg);
+    }
+  }
+  bool probe = !options.probe_fen.empty();
+  if (options.threads < 1 || options.plies < 1 || options.min_games < 1 ||
+      (probe && options.files.size() != 1) ||
+      (!probe && options.files.size() < 2)) {
+    Usage();
+  }
+  return options;
+}
+
+void ParseChunk(const char *data, size_t begin, size_t end, int plies,
+                BookBuilder *part, size_t *skipped) {
+  part->setPlies(plies);
+  PgnReader reader(data + begin, end - begin);
+  PgnGame game;
+  while (reader.next(&game)) {
+    *skipped += !part->addGame(game);
+  }
+  part->sortEntries();
+}
+
+int Build(const Options &options) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  vector<BookBuilder> parts;
+  size_t total_bytes = 0, skipped = 0;
+  for (size_t f = 1; f < options.files.size(); ++f) {
+    const char *filename = options.files[f].c_str();
+    MappedFile file;
+    if (!file.open(filename, MappedFile::ACCESS_SEQUENTIAL)) {
+      cerr << "Error: could not read " << filename << endl;
+      return 1;
+    }
+    const char *data = (const char *) file.data();
+    total_bytes += file.size();
+
+    vector<size_t> bounds = SplitGames(data, file.size(), options.threads);
+    size_t first = parts.size();
+    parts.resize(first + bounds.size() - 1);
+    vector<size_t> counts(bounds.size() - 1, 0);
+    vector<thread> threads;
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+      threads.push_back(thread(ParseChunk, data, bounds[i], bounds[i + 1],
+                               options.plies, &parts[first + i],
+                               &counts[i]));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+      threads[i].join();
+      skipped += counts[i];
+    }
+  }
+
+  size_t entries = 0;
+  const char *output = options.files[0].c_str();
+  if (!WriteBook(output, parts, options.min_games, &entries)) {
+    cerr << "Error: could not write " << output << endl;
+    return 1;
+  }
+  double seconds = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+  printf("%zu book moves (%zu unreadable games skipped)\n", entries, skipped);
+  printf("%.1f MB in %.2f s\n", total_bytes / 1e6, seconds);
+  return 0;
+}
+
+int Probe(const Options &options) {
+  OpeningBook book;
+  if (!book.open(options.files[0].c_str())) {
+    cerr << "Error: could not open " << options.files[0] << endl;
+    return 1;
+  }
+  Position pos;
+  if (!pos.setFen(options.probe_fen)) {
+    cerr << "Error: invalid FEN " << options.probe_fen << endl;
+    return 1;
+  }
+  vector<BookMove> moves;
+  book.probe(pos, &moves);
+  int total = 0;
+  for (size_t i = 0; i < moves.size(); ++i) {
+    total += moves[i].weight;
+  }
+  for (size_t i = 0; i < moves.size(); ++i) {
+    printf("%-8s %5d %5.1f%%\n", MoveToSan(pos, moves[i].move).c_str(),
+           moves[i].weight, 100.0 * moves[i].weight / max(1, total));
+  }
+  if (moves.empty()) {
+    printf("not in book\n");
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options options = ParseOptions(argc, argv);
+  Position::initTables();
+  return options.probe_fen.empty() ? Build(options) : Probe(options);
+}
@@ -0,0 +1,925 @@
+/*******************************************************************************
+   Filename: match.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Plays a match between two UCI engines (typically two builds of
+             "chess --uci") on every core at once, refereeing the games with
+             the Position class. Each worker thread keeps its own pair of
+             engine processes alive for the whole match, so a game costs no
+             more than the moves themselves. Games are streamed to a PGN file
+             and the running score is summarized as an Elo difference and,
+             optionally, a sequential probability ratio test (SPRT).
+*******************************************************************************/
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "notation.h"
+#include "position.h"
+
+using namespace std;
+
+#define DEFAULT_ENGINE   "./chess --uci"
+#define DEFAULT_GAMES    100
+#define DEFAULT_TC       "10+0.1"  // Seconds.
+#define DEFAULT_MARGIN   50        // Milliseconds a clock may overrun.
+#define HANDSHAKE_TIME   10000     // Milliseconds to answer "uci"/"isready".
+#define STOP_GRACE_TIME  1000      // For depth/node limits and "movetime".
+#define MATE_SCORE       30000     // Engine mate scores map to +/- this.
+#define PGN_LINE_LENGTH  79
+
+namespace {
+
+int64_t Now() {
+  return chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct EngineConfig {
+  string name;
+  vector<string> argv;
+  vector<pair<string, string> > options;  // Sent with "setoption".
+};
+
+struct TimeControl {
+  int64_t base;       // Milliseconds per session; 0 means no clock.
+  int64_t increment;  // Milliseconds per move.
+  int moves;          // Moves per session; 0 means the whole game.
+};
+
+struct Options {
+  EngineConfig engines[2];
+  int games;
+  int concurrency;
+  string openings;
+  string pgn;
+  TimeControl tc;
+  int64_t margin;
+  int depth;
+  uint64_t nodes;
+  int64_t movetime;
+  int max_moves;          // Full moves before a draw is declared; 0: none.
+  int draw_move_number;   // Draw adjudication: from this move on,
+  int draw_moves;         // both sides report |score| <= draw_score
+  int draw_score;         // for this many moves in a row.
+  int resign_moves;       // Resign adjudication: a side reports a score
+  int resign_score;       // <= -resign_score for this many moves in a row.
+  bool sprt;
+  double elo0, elo1, alpha, beta;
+  int report_interval;
+};
+
+//------------------------------------------------------------------------------
+// A child process speaking UCI through a pair of pipes.
+//------------------------------------------------------------------------------
+class UciEngine {
+ public:
+  UciEngine() : pid_(-1), to_engine_(-1), from_engine_(-1) {}
+  ~UciEngine() { quit(); }
+
+  bool start(const EngineConfig &config);
+  void quit();
+  bool isRunning() const { return pid_ > 0; }
+  bool send(const string &line);
+
+  // Returns false if no full line arrives within "timeout" milliseconds
+  // (negative means wait forever) or the engine has exited.
+  bool readLine(string *line, int64_t timeout);
+
+  // Reads until a line starting with "token" arrives.
+  bool waitFor(const string &token, int64_t timeout);
+
+ private:
+  pid_t pid_;
+  int to_engine_;
+  int from_engine_;
+  string buffer_;
+};
+
+bool UciEngine::start(const EngineConfig &config) {
+  quit();
+  int in[2], out[2];
+  if (pipe2(in, O_CLOEXEC) != 0) {
+    return false;
+  }
+  if (pipe2(out, O_CLOEXEC) != 0) {
+    close(in[0]);
+    close(in[1]);
+    return false;
+  }
+  vector<char *> argv;
+  for (size_t i = 0; i < config.argv.size(); ++i) {
+    argv.push_back(const_cast<char *>(config.argv[i].c_str()));
+  }
+  argv.push_back(NULL);
+
+  pid_ = fork();
+  if (pid_ == 0) {
+    // Only async-signal-safe calls from here on; other threads may hold
+    // locks that were copied in a locked state.
+    dup2(in[0], STDIN_FILENO);
+    dup2(out[1], STDOUT_FILENO);
+    execvp(argv[0], &argv[0]);
+    _exit(127);
+  }
+  close(in[0]);
+  close(out[1]);
+  if (pid_ < 0) {
+    close(in[1]);
+    close(out[0]);
+    return false;
+  }
+  to_engine_ = in[1];
+  from_engine_ = out[0];
+  buffer_.clear();
+
+  if (!send("uci") || !waitFor("uciok", HANDSHAKE_TIME)) {
+    quit();
+    return false;
+  }
+  for (size_t i = 0; i < config.options.size(); ++i) {
+    send("setoption name " + config.options[i].first + " value " +
+         config.options[i].second);
+  }
+  return true;
+}
+
+void UciEngine::quit() {
+  if (pid_ <= 0) {
+    return;
+  }
+  send("quit");
+  close(to_engine_);
+  close(from_engine_);
+
+  // Give the engine a moment to exit on its own:
+  int64_t deadline = Now() + HANDSHAKE_TIME;
+  while (waitpid(pid_, NULL, WNOHANG) == 0) {
+    if (Now() > deadline) {
+      kill(pid_, SIGKILL);
+      waitpid(pid_, NULL, 0);
+      break;
+    }
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  pid_ = -1;
+  to_engine_ = from_engine_ = -1;
+}
+
+bool UciEngine::send(const string &line) {
+  if (pid_ <= 0) {
+    return false;
+  }
+  string text = line + "\n";
+  const char *data = text.data();
+  size_t left = text.size();
+  while (left > 0) {
+    ssize_t written = write(to_engine_, data, left);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    left -= written;
+  }
+  return true;
+}
+
+bool UciEngine::readLine(string *line, int64_t timeout) {
+  int64_t deadline = timeout < 0 ? 0 : Now() + timeout;
+  for (;;) {
+    size_t end = buffer_.find('\n');
+    if (end != string::npos) {
+      line->assign(buffer_, 0, end);
+      buffer_.erase(0, end + 1);
+      if (!line->empty() && (*line)[line->size() - 1] == '\r') {
+        line->erase(line->size() - 1);
+      }
+      return true;
+    }
+    if (pid_ <= 0) {
+      return false;
+    }
+    int wait = -1;
+    if (timeout >= 0) {
+      int64_t left = deadline - Now();
+      if (left <= 0) {
+        return false;
+      }
+      wait = (int) min(left, (int64_t) INT32_MAX);
+    }
+    pollfd fd = { from_engine_, POLLIN, 0 };
+    int ready = poll(&fd, 1, wait);
+    if (ready < 0 && errno != EINTR) {
+      return false;
+    }
+    if (ready > 0) {
+      char chunk[4096];
+      ssize_t count = read(from_engine_, chunk, sizeof(chunk));
+      if (count <= 0) {
+        return false;  // The engine exited.
+      }
+      buffer_.append(chunk, count);
+    }
+  }
+}
+
+bool UciEngine::waitFor(const string &token, int64_t timeout) {
+  int64_t deadline = Now() + timeout;
+  string line;
+  while (readLine(&line, max((int64_t) 0, deadline - Now()))) {
+    if (line.compare(0, token.size(), token) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// Refereeing.
+//------------------------------------------------------------------------------
+
+// True if neither side can possibly deliver mate: bare kings, or a single
+// minor piece, or only bishops all on squares of one color.
+bool IsInsufficientMaterial(const Position &pos) {
+  if (pos.piecesOfType(PAWN) | pos.piecesOfType(ROOK) |
+      pos.piecesOfType(QUEEN)) {
+    return false;
+  }
+  Bitboard minors = pos.piecesOfType(KNIGHT) | pos.piecesOfType(BISHOP);
+  if (!MoreThanOne(minors)) {
+    return true;
+  }
+  const Bitboard kDarkSquares = 0xAA55AA55AA55AA55ULL;
+  Bitboard bishops = pos.piecesOfType(BISHOP);
+  return !pos.piecesOfType(KNIGHT) &&
+         ((bishops & kDarkSquares) == 0 || (bishops & ~kDarkSquares) == 0);
+}
+
+// Reads the score from an "info" line, from the engine's point of view.
+bool ParseScore(const string &line, int *score) {
+  istringstream in(line);
+  string token;
+  while (in >> token) {
+    if (token == "score") {
+      string kind;
+      int value;
+      if (!(in >> kind >> value)) {
+        return false;
+      }
+      if (kind == "mate") {
+        *score = value > 0 ? MATE_SCORE : -MATE_SCORE;
+      } else {
+        *score = value;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+enum GameResult { WHITE_WINS, BLACK_WINS, DRAWN };
+
+struct Game {
+  int number;
+  int white;  // Index of the engine playing white.
+  string fen;
+  vector<string> moves;  // SAN.
+  GameResult result;
+  string reason;       // Shown as a comment at the end of the movetext.
+  string termination;  // PGN Termination tag.
+};
+
+//------------------------------------------------------------------------------
+// Plays one game between two running engines. "engines" is indexed by match
+// engine number. An engine that misbehaves loses and is stopped so that the
+// worker restarts it.
+//------------------------------------------------------------------------------
+void PlayGame(const Options &options, UciEngine engines[2], Game *game) {
+  Position pos;
+  pos.setFen(game->fen);
+  string position = "position fen " + game->fen + " moves";
+  for (int i = 0; i < 2; ++i) {
+    if (!engines[i].send("ucinewgame") || !engines[i].send("isready") ||
+        !engines[i].waitFor("readyok", HANDSHAKE_TIME)) {
+      int color = i == game->white ? WHITE : BLACK;
+      game->result = color == WHITE ? BLACK_WINS : WHITE_WINS;
+      game->reason = "Engine not responding";
+      game->termination = "abandoned";
+      engines[i].quit();
+      return;
+    }
+  }
+
+  const TimeControl &tc = options.tc;
+  int64_t clock[NUM_CHESS_PIECE_COLORS] = { tc.base, tc.base };
+  int moves_made[NUM_CHESS_PIECE_COLORS] = { 0, 0 };
+  int resign_count[NUM_CHESS_PIECE_COLORS] = { 0, 0 };
+  int draw_count = 0;
+  game->termination = "normal";
+
+  for (;;) {
+    MoveList legal;
+    GenerateLegalMoves(pos, &legal);
+    int side = pos.sideToMove();
+    GameResult loss = side == WHITE ? BLACK_WINS : WHITE_WINS;
+    if (legal.size == 0) {
+      game->result = pos.inCheck() ? loss : DRAWN;
+      game->reason = pos.inCheck() ? (side == WHITE ? "Black mates" :
+                                                      "White mates") :
+                                     "Stalemate";
+      return;
+    }
+    if (pos.isDraw(0)) {
+      game->result = DRAWN;
+      game->reason = pos.halfmoveClock() >= 100 ? "Fifty-move rule" :
+                                                  "Threefold repetition";
+      return;
+    }
+    if (IsInsufficientMaterial(pos)) {
+      game->result = DRAWN;
+      game->reason = "Insufficient material";
+      return;
+    }
+    if (options.max_moves &&
+        (int) game->moves.size() >= 2 * options.max_moves) {
+      game->result = DRAWN;
+      game->reason = "Maximum game length";
+      game->termination = "adjudication";
+      return;
+    }
+
+    int index = side == WHITE ? game->white : 1 - game->white;
+    UciEngine &engine = engines[index];
+    ostringstream go;
+    go << "go";
+    int64_t timeout = -1;
+    if (tc.base) {
+      go << " wtime " << clock[WHITE] << " btime " << clock[BLACK];
+      if (tc.increment) {
+        go << " winc " << tc.increment << " binc " << tc.increment;
+      }
+      if (tc.moves) {
+        go << " movestogo " << tc.moves - moves_made[side] % tc.moves;
+      }
+      timeout = clock[side] + options.margin;
+    }
+    if (options.movetime) {
+      go << " movetime " << options.movetime;
+      timeout = options.movetime + options.margin + STOP_GRACE_TIME;
+    }
+    if (options.depth) {
+      go << " depth " << options.depth;
+    }
+    if (options.nodes) {
+      go << " nodes " << options.nodes;
+    }
+
+    int64_t start = Now();
+    bool have_score = false;
+    int score = 0;
+    string line, best;
+    bool sent = engine.send(position) && engine.send(go.str());
+    while (sent && engine.readLine(&line, timeout < 0 ? -1 :
+                                   max((int64_t) 0,
+                                       start + timeout - Now()))) {
+      if (line.compare(0, 5, "info ") == 0) {
+        have_score |= ParseScore(line, &score);
+      } else if (line.compare(0, 9, "bestmove ") == 0) {
+        istringstream in(line.substr(9));
+        in >> best;
+        break;
+      }
+    }
+    int64_t elapsed = Now() - start;
+    if (best.empty()) {
+      bool timed_out = sent && timeout >= 0 && elapsed >= timeout;
+      game->result = loss;
+      game->reason = timed_out ? "Loss on time" : "Engine disconnected";
+      game->termination = timed_out ? "time forfeit" : "abandoned";
+      engine.quit();  // Still thinking (or dead); restart it.
+      return;
+    }
+    if (tc.base) {
+      clock[side] -= elapsed;
+      if (clock[side] < -options.margin) {
+        game->result = loss;
+        game->reason = "Loss on time";
+        game->termination = "time forfeit";
+        return;
+      }
+      clock[side] = max((int64_t) 0, clock[side]) + tc.increment;
+      if (tc.moves && ++moves_made[side] % tc.moves == 0) {
+        clock[side] += tc.base;
+      }
+    }
+
+    Move m = ParseMove(pos, best);
+    if (m == NO_MOVE) {
+      game->result = loss;
+      game->reason = "Illegal move: " + best;
+      game->termination = "rules infraction";
+      return;
+    }
+    game->moves.push_back(MoveToSan(pos, m));
+    pos.doMove(m);
+    position += " " + best;
+
+    if (have_score) {
+      if (options.resign_moves) {
+        resign_count[side] = score <= -options.resign_score ?
+                             resign_count[side] + 1 : 0;
+        if (resign_count[side] >= options.resign_moves) {
+          game->result = loss;
+          game->reason = side == WHITE ? "White resigns" : "Black resigns";
+          game->termination = "adjudication";
+          return;
+        }
+      }
+      if (options.draw_moves) {
+        draw_count = pos.fullmoveNumber() >= options.draw_move_number &&
+                     abs(score) <= options.draw_score ? draw_count + 1 : 0;
+        if (draw_count >= 2 * options.draw_moves) {
+          game->result = DRAWN;
+          game->reason = "Draw by adjudication";
+          game->termination = "adjudication";
+          return;
+        }
+      }
+    }
+  }
+}
+
+string TimeControlTag(const TimeControl &tc) {
+  if (!tc.base) {
+    return "-";
+  }
+  ostringstream tag;
+  if (tc.moves) {
+    tag << tc.moves << "/";
+  }
+  tag << tc.base / 1000.0;
+  if (tc.increment) {
+    tag << "+" << tc.increment / 1000.0;
+  }
+  return tag.str();
+}
+
+string GameToPgn(const Options &options, const Game &game) {
+  static const char *kResults[] = { "1-0", "0-1", "1/2-1/2" };
+  char date[16];
+  time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y.%m.%d", localtime(&now));
+
+  ostringstream pgn;
+  pgn << "[Event \"" << options.engines[0].name << " vs. "
+      << options.engines[1].name << "\"]\n"
+      << "[Site \"?\"]\n"
+      << "[Date \"" << date << "\"]\n"
+      << "[Round \"" << game.number << "\"]\n"
+      << "[White \"" << options.engines[game.white].name << "\"]\n"
+      << "[Black \"" << options.engines[1 - game.white].name << "\"]\n"
+      << "[Result \"" << kResults[game.result] << "\"]\n";
+  if (game.fen != START_FEN) {
+    pgn << "[SetUp \"1\"]\n[FEN \"" << game.fen << "\"]\n";
+  }
+  pgn << "[PlyCount \"" << game.moves.size() << "\"]\n"
+      << "[TimeControl \"" << TimeControlTag(options.tc) << "\"]\n"
+      << "[Termination \"" << game.termination << "\"]\n\n";
+
+  // Movetext, wrapped:
+  Position pos;
+  pos.setFen(game.fen);
+  int number = pos.fullmoveNumber();
+  bool white = pos.sideToMove() == WHITE;
+  vector<string> words;
+  for (size_t i = 0; i < game.moves.size(); ++i) {
+    if (white) {
+      words.push_back(to_string(number) + ". " + game.moves[i]);
+    } else if (i == 0) {
+      words.push_back(to_string(number) + "... " + game.moves[i]);
+    } else {
+      words.push_back(game.moves[i]);
+    }
+    number += !white;
+    white = !white;
+  }
+  words.push_back("{" + game.reason + "}");
+  words.push_back(kResults[game.result]);
+  size_t column = 0;
+  for (size_t i = 0; i < words.size(); ++i) {
+    if (column && column + 1 + words[i].size() > PGN_LINE_LENGTH) {
+      pgn << "\n";
+      column = 0;
+    } else if (column) {
+      pgn << " ";
+      ++column;
+    }
+    pgn << words[i];
+    column += words[i].size();
+  }
+  pgn << "\n\n";
+  return pgn.str();
+}
+
+//------------------------------------------------------------------------------
+// Statistics. Scores are the first engine's expected score per game.
+//------------------------------------------------------------------------------
+
+double EloToScore(double elo) {
+  return 1 / (1 + pow(10, -elo / 400));
+}
+
+double ScoreToElo(double score) {
+  score = min(max(score, 1e-6), 1 - 1e-6);
+  return -400 * log10(1 / score - 1);
+}
+
+// Log-likelihood ratio of elo1 against elo0, using the normal approximation
+// to the trinomial (win/draw/loss) distribution of game results.
+double Llr(int wins, int draws, int losses, double elo0, double elo1) {
+  int n = wins + draws + losses;
+  if (!wins || !losses) {
+    return 0;  // The variance estimate is meaningless until both occur.
+  }
+  double mean = (wins + draws / 2.0) / n;
+  double variance = (wins + draws / 4.0) / n - mean * mean;
+  double s0 = EloToScore(elo0), s1 = EloToScore(elo1);
+  return (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance / n);
+}
+
+//------------------------------------------------------------------------------
+// Hands out games to the worker threads and collects their results.
+//------------------------------------------------------------------------------
+class Match {
+ public:
+  Match(const Options &options, const vector<string> &openings)
+      : options_(options), openings_(openings), next_game_(0), done_(false),
+        failed_(false), wins_(0), draws_(0), losses_(0), finished_(0) {}
+
+  bool run();
+
+ private:
+  void worker();
+  void record(const Game &game);
+  void printSummary(bool final);
+
+  const Options &options_;
+  const vector<string> &openings_;
+  atomic<int> next_game_;
+  atomic<bool> done_;  // Stop handing out games (SPRT decided, or failure).
+  atomic<bool> failed_;
+  mutex results_mutex_;
+  ofstream pgn_;
+  int wins_, draws_, losses_;  // For engine 0.
+  int finished_;
+};
+
+bool Match::run() {
+  if (!options_.pgn.empty()) {
+    pgn_.open(options_.pgn.c_str(), ios::app);
+    if (!pgn_) {
+      cerr << "Error: could not write " << options_.pgn << endl;
+      return false;
+    }
+  }
+  vector<thread> workers;
+  for (int i = 0; i < options_.concurrency; ++i) {
+    workers.push_back(thread(&Match::worker, this));
+  }
+  for (size_t i = 0; i < workers.size(); ++i) {
+    workers[i].join();
+  }
+  printSummary(true);
+  return !failed_;
+}
+
+void Match::worker() {
+  UciEngine engines[2];
+  for (;;) {
+    int number = next_game_++;
+    if (number >= options_.games || done_) {
+      break;
+    }
+    for (int i = 0; i < 2; ++i) {
+      if (!engines[i].isRunning() && !engines[i].start(options_.engines[i])) {
+        cerr << "Error: could not start engine " << options_.engines[i].name
+             << endl;
+        failed_ = done_ = true;
+        return;
+      }
+    }
+
+    // Each opening is played twice, with colors reversed:
+    Game game;
+    game.number = number + 1;
+    game.white = number % 2;
+    game.fen = openings_[(number / 2) % openings_.size()];
+    PlayGame(options_, engines, &game);
+    record(game);
+  }
+}
+
+void Match::record(const Game &game) {
+  lock_guard<mutex> lock(results_mutex_);
+  if (pgn_.is_open()) {
+    pgn_ << GameToPgn(options_, game) << flush;
+  }
+  if (game.result == DRAWN) {
+    ++draws_;
+  } else if ((game.result == WHITE_WINS) == (game.white == 0)) {
+    ++wins_;
+  } else {
+    ++losses_;
+  }
+  ++finished_;
+
+  if (options_.sprt) {
+    double llr = Llr(wins_, draws_, losses_, options_.elo0, options_.elo1);
+    if (llr <= log(options_.beta / (1 - options_.alpha)) ||
+        llr >= log((1 - options_.beta) / options_.alpha)) {
+      done_ = true;
+    }
+  }
+  if (options_.report_interval && finished_ % options_.report_interval == 0) {
+    printSummary(false);
+  }
+}
+
+void Match::printSummary(bool final) {
+  int n = wins_ + draws_ + losses_;
+  if (n == 0) {
+    return;
+  }
+  double mean = (wins_ + draws_ / 2.0) / n;
+  printf("Score of %s vs. %s: %d - %d - %d [%.3f] %d\n",
+         options_.engines[0].name.c_str(), options_.engines[1].name.c_str(),
+         wins_, losses_, draws_, mean, n);
+  if (final || options_.sprt) {
+    double w = (double) wins_ / n, d = (double) draws_ / n;
+    double l = (double) losses_ / n;
+    double variance = w * (1 - mean) * (1 - mean) +
+                      d * (0.5 - mean) * (0.5 - mean) + l * mean * mean;
+    double margin = 1.959964 * sqrt(variance / n);
+    printf("Elo difference: %.1f +/- %.1f (95%%)\n", ScoreToElo(mean),
+           (ScoreToElo(mean + margin) - ScoreToElo(mean - margin)) / 2);
+  }
+  if (options_.sprt) {
+    double lower = log(options_.beta / (1 - options_.alpha));
+    double upper = log((1 - options_.beta) / options_.alpha);
+    double llr = Llr(wins_, draws_, losses_, options_.elo0, options_.elo1);
+    printf("SPRT: elo0 = %g, elo1 = %g, LLR = %.2f [%.2f, %.2f]%s\n",
+           options_.elo0, options_.elo1, llr, lower, upper,
+           llr >= upper ? " - H1 accepted" :
+           llr <= lower ? " - H0 accepted" : "");
+  }
+  fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+// Command line.
+//------------------------------------------------------------------------------
+
+void Usage() {
+  cerr << "Usage: match [options]\n"
+          "  --engine [name=NAME] [cmd=COMMAND] [option.NAME=VALUE ...]\n"
+          "                   give once per engine (default command: "
+          DEFAULT_ENGINE ")\n"
+          "  --games N        games to play (default: 100)\n"
+          "  --concurrency N  games at once (default: one per core)\n"
+          "  --openings FILE  start positions, one FEN or EPD per line; each\n"
+          "                   is played twice with colors reversed\n"
+          "  --pgn FILE       append finished games to FILE\n"
+          "  --tc [MOVES/]SECONDS[+INC]  time control (default: "
+          DEFAULT_TC ")\n"
+          "  --margin MS      allowed clock overrun (default: 50)\n"
+          "  --depth N, --nodes N, --movetime MS  fixed limits instead of a "
+          "clock\n"
+          "  --maxmoves N     declare a draw after N moves\n"
+          "  --draw MOVE N CP adjudicate a draw after move MOVE once both\n"
+          "                   sides report |score| <= CP for N moves\n"
+          "  --resign N CP    adjudicate a loss once a side reports a score\n"
+          "                   <= -CP for N moves\n"
+          "  --sprt ELO0 ELO1 [ALPHA BETA]  stop once the test decides\n"
+          "                   (default alpha and beta: 0.05)\n"
+          "  --report N       print the score every N games (default: 10)\n";
+  exit(2);
+}
+
+bool ParseTimeControl(const string &text, TimeControl *tc) {
+  tc->base = tc->increment = 0;
+  tc->moves = 0;
+  string rest = text;
+  size_t slash = rest.find('/');
+  if (slash != string::npos) {
+    tc->moves = atoi(rest.substr(0, slash).c_str());
+    rest = rest.substr(slash + 1);
+    if (tc->moves <= 0) {
+      return false;
+    }
+  }
+  size_t plus = rest.find('+');
+  tc->base = llround(atof(rest.substr(0, plus).c_str()) * 1000);
+  if (plus != string::npos) {
+    tc->increment = llround(atof(rest.substr(plus + 1).c_str()) * 1000);
+  }
+  return tc->base > 0 && tc->increment >= 0;
+}
+
+vector<string> SplitWords(const string &text) {
+  istringstream in(text);
+  vector<string> words;
+  string word;
+  while (in >> word) {
+    words.push_back(word);
+  }
+  return words;
+}
+
+Options ParseOptions(int argc, char **argv) {
+  Options options;
+  options.games = DEFAULT_GAMES;
+  options.concurrency = max(1u, thread::hardware_concurrency());
+  ParseTimeControl(DEFAULT_TC, &options.tc);
+  options.margin = DEFAULT_MARGIN;
+  options.depth = 0;
+  options.nodes = 0;
+  options.movetime = 0;
+  options.max_moves = 0;
+  options.draw_move_number = options.draw_moves = options.draw_score = 0;
+  options.resign_moves = options.resign_score = 0;
+  options.sprt = false;
+  options.elo0 = options.elo1 = 0;
+  options.alpha = options.beta = 0.05;
+  options.report_interval = 10;
+
+  int engine_count = 0;
+  bool fixed_limit = false, clock_given = false;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--engine" && engine_count < 2) {
+      EngineConfig &engine = options.engines[engine_count++];
+      while (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+        string setting = argv[++i];
+        size_t equals = setting.find('=');
+        if (equals == string::npos) {
+          Usage();
+        }
+        string key = setting.substr(0, equals);
+        string value = setting.substr(equals + 1);
+        if (key == "name") {
+          engine.name = value;
+        } else if (key == "cmd") {
+          engine.argv = SplitWords(value);
+        } else if (key.compare(0, 7, "option.") == 0) {
+          engine.options.push_back(make_pair(key.substr(7), value));
+        } else {
+          Usage();
+        }
+      }
+    } else if (arg == "--games" && has_value) {
+      options.games = atoi(argv[++i]);
+    } else if (arg == "--concurrency" && has_value) {
+      options.concurrency = atoi(argv[++i]);
+    } else if (arg == "--openings" && has_value) {
+      options.openings = argv[++i];
+    } else if (arg == "--pgn" && has_value) {
+      options.pgn = argv[++i];
+    } else if (arg == "--tc" && has_value) {
+      if (!ParseTimeControl(argv[++i], &options.tc)) {
+        Usage();
+      }
+      clock_given = true;
+    } else if (arg == "--margin" && has_value) {
+      options.margin = atoll(argv[++i]);
+    } else if (arg == "--depth" && has_value) {
+      options.depth = atoi(argv[++i]);
+      fixed_limit = true;
+    } else if (arg == "--nodes" && has_value) {
+      options.nodes = strtoull(argv[++i], NULL, 10);
+      fixed_limit = true;
+    } else if (arg == "--movetime" && has_value) {
+      options.movetime = atoll(argv[++i]);
+      fixed_limit = true;
+    } else if (arg == "--maxmoves" && has_value) {
+      options.max_moves = atoi(argv[++i]);
+    } else if (arg == "--draw" && i + 3 < argc) {
+      options.draw_move_number = atoi(argv[++i]);
+      options.draw_moves = atoi(argv[++i]);
+      options.draw_score = atoi(argv[++i]);
+    } else if (arg == "--resign" && i + 2 < argc) {
+      options.resign_moves = atoi(argv[++i]);
+      options.resign_score = atoi(argv[++i]);
+    } else if (arg == "--sprt" && i + 2 < argc) {
+      options.sprt = true;
+      options.elo0 = atof(argv[++i]);
+      options.elo1 = atof(argv[++i]);
+      if (i + 2 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+        options.alpha = atof(argv[++i]);
+        options.beta = atof(argv[++i]);
+      }
+    } else if (arg == "--report" && has_value) {
+      options.report_interval = atoi(argv[++i]);
+    } else {
+      Usage();
+    }
+  }
+  if (fixed_limit && !clock_given) {
+    options.tc.base = options.tc.increment = 0;  // No clock.
+    options.tc.moves = 0;
+  }
+  if (options.games < 1 || options.concurrency < 1 ||
+      (options.sprt && (options.elo1 <= options.elo0 ||
+                        options.alpha <= 0 || options.alpha >= 1 ||
+                        options.beta <= 0 || options.beta >= 1))) {
+    Usage();
+  }
+  for (int i = 0; i < 2; ++i) {
+    EngineConfig &engine = options.engines[i];
+    if (engine.argv.empty()) {
+      engine.argv = SplitWords(DEFAULT_ENGINE);
+    }
+    if (engine.name.empty()) {
+      engine.name = "engine" + to_string(i + 1);
+    }
+  }
+  return options;
+}
+
+// Reads one position per line as FEN, or as EPD (four fields followed by
+// operations). Blank lines and lines starting with '#' are skipped.
+bool LoadOpenings(const string &filename, vector<string> *openings) {
+  ifstream in(filename.c_str());
+  if (!in) {
+    cerr << "Error: could not read " << filename << endl;
+    return false;
+  }
+  string line;
+  for (int line_number = 1; getline(in, line); ++line_number) {
+    vector<string> fields = SplitWords(line);
+    if (fields.empty() || fields[0][0] == '#') {
+      continue;
+    }
+    string fen;
+    for (size_t i = 0; i < 4 && i < fields.size(); ++i) {
+      fen += fields[i] + " ";
+    }
+    const char *kDigits = "0123456789";
+    bool counters = fields.size() >= 6 &&
+                    fields[4].find_first_not_of(kDigits) == string::npos &&
+                    fields[5].find_first_not_of(kDigits) == string::npos;
+    fen += counters ? fields[4] + " " + fields[5] : "0 1";
+    Position pos;
+    if (!pos.setFen(fen)) {
+      cerr << "Error: " << filename << ":" << line_number
+           << ": invalid position: " << line << endl;
+      return false;
+    }
+    openings->push_back(pos.fen());
+  }
+  if (openings->empty()) {
+    cerr << "Error: no positions in " << filename << endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options options = ParseOptions(argc, argv);
+  Position::initTables();
+  signal(SIGPIPE, SIG_IGN);  // A crashed engine must not take us down.
+
+  vector<string> openings;
+  if (options.openings.empty()) {
+    openings.push_back(START_FEN);
+  } else if (!LoadOpenings(options.openings, &openings)) {
+    return 2;
+  }
+
+  Match match(options, openings);
+  return match.run() ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+/*******************************************************************************
+   Filename: mesh_compiler.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Offline converter that bakes the six ASCII .POL piece models
+             into one packed binary mesh file for the viewer to memory-map.
+
+      Usage: mesh_compiler [output file]   (default: models/pieces.mesh)
+*******************************************************************************/
+
+#include <cstdio>
+#include "mesh.h"
+
+int main(int argc, char **argv) {
+  const char *output = argc > 1 ? argv[1] : PACKED_MESH_FILE;
+  Mesh meshes[NUM_PIECE_MODELS];
+  size_t vertices = 0, triangles = 0;
+  for (int type = PAWN; type < NUM_CHESS_PIECE_TYPES; ++type) {
+    char filename[64];
+    PolFileName(type, filename, sizeof(filename));
+    if (!LoadPolMesh(filename, &meshes[type - PAWN])) {
+      fprintf(stderr, "Error: could not load %s\n", filename);
+      return 1;
+    }
+    vertices += meshes[type - PAWN].vertex_count;
+    triangles += meshes[type - PAWN].index_count / 3;
+  }
+  if (!WriteMeshFile(output, meshes)) {
+    fprintf(stderr, "Error: could not write %s\n", output);
+    return 1;
+  }
+  printf("%s: %zu vertices, %zu triangles\n", output, vertices, triangles);
+  return 0;
+}
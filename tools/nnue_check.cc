@@ -0,0 +1,205 @@
+/*******************************************************************************
+   Filename: nnue_check.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Checks the NNUE accumulator updates. Writes a network of random
+             weights, then walks random lines from positions rich in
+             castling, en passant and promotions, making and unmaking moves
+             and evaluating at random plies through one accumulator stack, as
+             the search does. Every evaluation is compared with one from a
+             cleared stack, which refreshes both sides from the board. Exits
+             non-zero on any mismatch, or if a kind of move never came up.
+Usage:       nnue_check [--walks N] [--seed N]
+*******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "nnue.h"
+
+using namespace std;
+
+namespace {
+
+#define DEFAULT_WALKS 200
+#define WALK_PLIES    400  // Moves made or unmade per walk.
+#define MAX_WALK_PLY  (NNUE_MAX_PLY - 1)
+
+const char *kStartFens[] = {
+  START_FEN,
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+  "4k3/1P4p1/8/3pP3/8/8/1p4P1/4K3 w - d6 0 1",
+};
+
+const int kNumStartFens = sizeof(kStartFens) / sizeof(kStartFens[0]);
+
+enum MoveKind { QUIET, CAPTURE_KIND, CASTLE_KIND, EN_PASSANT_KIND,
+                PROMOTION_KIND, NUM_MOVE_KINDS };
+
+const char *kMoveKindNames[NUM_MOVE_KINDS] = {
+  "quiet", "captures", "castles", "en passant", "promotions"
+};
+
+int KindOf(Move m) {
+  if (FlagOf(m) == EN_PASSANT) {
+    return EN_PASSANT_KIND;
+  } else if (IsPromotion(m)) {
+    return PROMOTION_KIND;
+  } else if (IsCastle(m)) {
+    return CASTLE_KIND;
+  }
+  return IsCapture(m) ? CAPTURE_KIND : QUIET;
+}
+
+// Appends "count" random values in [low, high] of type T, after padding
+// "data" to the next 64-byte boundary as the network file layout requires.
+template <typename T>
+void AddSection(vector<char> *data, size_t count, int low, int high,
+                mt19937 *random) {
+  data->resize((data->size() + 63) & ~(size_t) 63, 0);
+  uniform_int_distribution<int> value(low, high);
+  for (size_t i = 0; i < count; ++i) {
+    T x = (T) value(*random);
+    const char *bytes = (const char *) &x;
+    data->insert(data->end(), bytes, bytes + sizeof(x));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Writes a random network to a temporary file and loads it; the file is
+// removed at once, since the mapping keeps its contents. The ranges keep most
+// accumulator values and hidden sums inside the clipping range, so that a
+// wrong accumulator shows up in the evaluation.
+//------------------------------------------------------------------------------
+bool LoadRandomNetwork(Network *network, mt19937 *random) {
+  vector<char> data(64, 0);
+  memcpy(&data[0], "NNUE", 4);
+  const uint32_t kHeader[] = { NNUE_VERSION, NNUE_FEATURES, NNUE_HALF_DIMS,
+                               NNUE_HIDDEN1, NNUE_HIDDEN2 };
+  memcpy(&data[4], kHeader, sizeof(kHeader));
+  strcpy(&data[24], "nnue_check random");
+  AddSection<int16_t>(&data, NNUE_HALF_DIMS, 0, 96, random);
+  AddSection<int16_t>(&data, (size_t) NNUE_FEATURES * NNUE_HALF_DIMS, -8, 8,
+                      random);
+  AddSection<int32_t>(&data, NNUE_HIDDEN1, -64, 64, random);
+  AddSection<int8_t>(&data, NNUE_HIDDEN1 * 2 * NNUE_HALF_DIMS, -2, 2,
+                     random);
+  AddSection<int32_t>(&data, NNUE_HIDDEN2, -64, 64, random);
+  AddSection<int8_t>(&data, NNUE_HIDDEN2 * NNUE_HIDDEN1, -16, 16, random);
+  AddSection<int32_t>(&data, 1, -64, 64, random);
+  AddSection<int8_t>(&data, NNUE_HIDDEN2, -64, 64, random);
+
+  char filename[] = "/tmp/nnue_check_XXXXXX";
+  int fd = mkstemp(filename);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = write(fd, data.data(), data.size()) == (ssize_t) data.size();
+  ok = close(fd) == 0 && ok;
+  ok = ok && network->load(filename);
+  unlink(filename);
+  return ok;
+}
+
+// Picks a legal move, favoring the rare kinds so that every walk exercises
+// their updates.
+Move PickMove(const MoveList &moves, mt19937 *random) {
+  vector<Move> special;
+  for (const Move *m = moves.begin(); m != moves.end(); ++m) {
+    if (KindOf(*m) >= CASTLE_KIND) {
+      special.push_back(*m);
+    }
+  }
+  if (!special.empty() && (*random)() % 2 == 0) {
+    return special[(*random)() % special.size()];
+  }
+  return moves.moves[(*random)() % moves.size];
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int walks = DEFAULT_WALKS;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--walks") == 0 && i + 1 < argc) {
+      walks = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = (unsigned) strtoul(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--walks N] [--seed N]\n", argv[0]);
+      return 2;
+    }
+  }
+  Position::initTables();
+  mt19937 random(seed);
+  Network network;
+  if (!LoadRandomNetwork(&network, &random)) {
+    fprintf(stderr, "Error: could not write and load a random network\n");
+    return 1;
+  }
+
+  long evaluations = 0, mismatches = 0;
+  long kinds[NUM_MOVE_KINDS] = { 0 };
+  AccumulatorStack *stack = new AccumulatorStack;
+  AccumulatorStack *fresh = new AccumulatorStack;
+  for (int walk = 0; walk < walks; ++walk) {
+    Position pos;
+    pos.setFen(kStartFens[walk % kNumStartFens]);
+    stack->clear();
+    int ply = 0;
+    for (int step = 0; step < WALK_PLIES; ++step) {
+      MoveList moves;
+      GenerateLegalMoves(pos, &moves);
+      // Unmake a move now and then, and always at a dead end:
+      if (ply > 0 && (moves.size == 0 || ply == MAX_WALK_PLY ||
+                      random() % 4 == 0)) {
+        pos.undoMove();
+        --ply;
+      } else if (moves.size > 0) {
+        Move m = PickMove(moves, &random);
+        ++kinds[KindOf(m)];
+        pos.doMove(m);
+        ++ply;
+      } else {
+        break;
+      }
+      // Skipping plies makes later updates replay several moves at once:
+      if (random() % 2 == 0) {
+        continue;
+      }
+      fresh->clear();
+      int incremental = network.evaluate(pos, stack, ply);
+      int refreshed = network.evaluate(pos, fresh, 0);
+      ++evaluations;
+      if (incremental != refreshed) {
+        if (mismatches++ < 10) {
+          printf("MISMATCH %s (ply %d): incremental %d, refreshed %d\n",
+                 pos.fen().c_str(), ply, incremental, refreshed);
+        }
+      }
+    }
+  }
+  delete stack;
+  delete fresh;
+
+  bool covered = true;
+  printf("%ld evaluations, %ld mismatches; moves:", evaluations, mismatches);
+  for (int k = 0; k < NUM_MOVE_KINDS; ++k) {
+    printf(" %ld %s%s", kinds[k], kMoveKindNames[k],
+           k + 1 < NUM_MOVE_KINDS ? "," : "\n");
+    covered = covered && kinds[k] > 0;
+  }
+  if (!covered) {
+    printf("FAILED: some kinds of moves were never made\n");
+  }
+  return mismatches == 0 && covered ? 0 : 1;
+}
@@ -0,0 +1,334 @@
+/*******************************************************************************
+   Filename: perft.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Headless move generator regression check. Runs a suite of
+             standard positions, compares node counts and per-move-type
+             breakdowns against published values, and compares throughput
+             against a stored baseline. Also checks that setFen() refuses
+             illegal positions and bogus en passant squares. Exits non-zero
+             on any regression.
+*******************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "perft.h"
+
+using namespace std;
+
+#define MAX_REFERENCE_DEPTH 6
+#define UNKNOWN            -1
+
+// Published perft results; UNKNOWN entries are not checked.
+struct Reference {
+  int64_t nodes, captures, en_passants, castles, promotions, checks, mates;
+};
+
+struct TestPosition {
+  const char *name;
+  const char *fen;
+  int default_depth;
+  Reference results[MAX_REFERENCE_DEPTH];  // Index 0 is depth 1.
+};
+
+#define U UNKNOWN
+const TestPosition kSuite[] = {
+  { "startpos", START_FEN, 5, {
+    { 20, 0, 0, 0, 0, 0, 0 },
+    { 400, 0, 0, 0, 0, 0, 0 },
+    { 8902, 34, 0, 0, 0, 12, 0 },
+    { 197281, 1576, 0, 0, 0, 469, 8 },
+    { 4865609, 82719, 258, 0, 0, 27351, 347 },
+    { 119060324, 2812008, 5248, 0, 0, 809099, 10828 } } },
+  { "kiwipete",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    4, {
+    { 48, 8, 0, 2, 0, 0, 0 },
+    { 2039, 351, 1, 91, 0, 3, 0 },
+    { 97862, 17102, 45, 3162, 0, 993, 1 },
+    { 4085603, 757163, 1929, 128013, 15172, 25523, 43 },
+    { 193690690, 35043416, 73365, 4993637, 8392, 3309887, 30171 },
+    { U, U, U, U, U, U, U } } },
+  { "position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, {
+    { 14, 1, 0, 0, 0, 2, 0 },
+    { 191, 14, 0, 0, 0, 10, 0 },
+    { 2812, 209, 2, 0, 0, 267, 0 },
+    { 43238, 3348, 123, 0, 0, 1680, 17 },
+    { 674624, 52051, 1165, 0, 0, 52950, 0 },
+    { 11030083, 940350, 33325, 0, 7552, 452473, 2733 } } },
+  { "position4",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, {
+    { 6, 0, 0, 0, 0, 0, 0 },
+    { 264, 87, 0, 6, 48, 10, 0 },
+    { 9467, 1021, 4, 0, 120, 38, 22 },
+    { 422333, 131393, 0, 7795, 60032, 15492, 5 },
+    { 15833292, 2046173, 6512, 0, 329464, 200568, 50562 },
+    { U, U, U, U, U, U, U } } },
+  { "position5",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, {
+    { 44, U, U, U, U, U, U },
+    { 1486, U, U, U, U, U, U },
+    { 62379, U, U, U, U, U, U },
+    { 2103487, U, U, U, U, U, U },
+    { 89941194, U, U, U, U, U, U },
+    { U, U, U, U, U, U, U } } },
+  { "position6",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    4, {
+    { 46, U, U, U, U, U, U },
+    { 2079, U, U, U, U, U, U },
+    { 89890, U, U, U, U, U, U },
+    { 3894594, U, U, U, U, U, U },
+    { 164075551, U, U, U, U, U, U },
+    { U, U, U, U, U, U, U } } },
+};
+#undef U
+
+const int kSuiteSize = sizeof(kSuite) / sizeof(kSuite[0]);
+
+#define REJECTED -2  // FenCase::ep_square for FENs setFen() must refuse.
+
+// FENs that setFen() must refuse, or whose en passant field it must keep or
+// drop, since a bogus en passant square makes doMove() remove a missing pawn.
+struct FenCase {
+  const char *fen;
+  int ep_square;  // Expected epSquare(), or REJECTED.
+};
+
+const FenCase kFenCases[] = {
+  { "P3k3/8/8/8/8/8/8/4K3 w - - 0 1", REJECTED },  // Pawn on the last rank.
+  { "4k3/8/8/8/8/8/8/P3K3 w - - 0 1", REJECTED },  // And on the first.
+  { "4k2R/8/8/8/8/8/8/4K3 w - - 0 1", REJECTED },  // Black is in check.
+  { "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", SquareAt(5, 3) },
+  { "4k3/8/8/8/3Pp3/8/8/4K3 b - d3 0 1", SquareAt(2, 3) },
+  { "4k3/8/8/8/8/8/2P5/4K3 w - d3 0 1", NO_SQUARE },  // Wrong rank.
+  { "4k3/8/8/4P3/8/8/8/4K3 w - d6 0 1", NO_SQUARE },  // No pawn to take.
+  { "4k3/3p4/8/3pP3/8/8/8/4K3 w - d6 0 1", NO_SQUARE },  // Not just pushed.
+  { "4k3/8/8/3pP3/8/8/8/4K3 b - d6 0 1", NO_SQUARE },  // Wrong side.
+};
+
+const int kNumFenCases = sizeof(kFenCases) / sizeof(kFenCases[0]);
+
+struct Options {
+  int depth;               // 0 means each position's default depth.
+  string fen;              // Run only this position if set.
+  string baseline;
+  double tolerance;        // Percent.
+  int repeat;
+  bool save_baseline;
+};
+
+void Usage() {
+  cerr << "Usage: perft [options]\n"
+          "  --depth N        search every position to depth N\n"
+          "  --fen FEN        run one position instead of the built-in suite\n"
+          "  --baseline FILE  throughput baseline (default: perft.baseline)\n"
+          "  --tolerance PCT  allowed nodes/sec drop vs. the baseline "
+          "(default: 10)\n"
+          "  --repeat N       timed runs per position; the best is kept "
+          "(default: 3)\n"
+          "  --save-baseline  write the measured throughput to the baseline\n";
+  exit(2);
+}
+
+Options ParseOptions(int argc, char **argv) {
+  Options options = { 0, "", "perft.baseline", 10.0, 3, false };
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--depth" && has_value) {
+      options.depth = atoi(argv[++i]);
+    } else if (arg == "--fen" && has_value) {
+      options.fen = argv[++i];
+    } else if (arg == "--baseline" && has_value) {
+      options.baseline = argv[++i];
+    } else if (arg == "--tolerance" && has_value) {
+      options.tolerance = atof(argv[++i]);
+    } else if (arg == "--repeat" && has_value) {
+      options.repeat = atoi(argv[++i]);
+    } else if (arg == "--save-baseline") {
+      options.save_baseline = true;
+    } else {
+      Usage();
+    }
+  }
+  if (options.depth < 0 || options.repeat < 1) {
+    Usage();
+  }
+  return options;
+}
+
+// Baseline entries are keyed by "name/depth" and hold nodes per second.
+map<string, double> LoadBaseline(const string &filename) {
+  map<string, double> baseline;
+  ifstream in(filename.c_str());
+  string key;
+  double nps;
+  while (in >> key >> nps) {
+    baseline[key] = nps;
+  }
+  return baseline;
+}
+
+// Runs kFenCases. Returns false after printing each case that fails.
+bool CheckFens() {
+  bool ok = true;
+  for (int i = 0; i < kNumFenCases; ++i) {
+    const FenCase &test = kFenCases[i];
+    Position pos;
+    bool parsed = pos.setFen(test.fen);
+    if (parsed != (test.ep_square != REJECTED) ||
+        (parsed && pos.epSquare() != test.ep_square)) {
+      printf("    MISMATCH FEN %s: %s\n", test.fen,
+             !parsed ? "rejected" : test.ep_square == REJECTED ? "accepted" :
+             "wrong en passant square");
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool Check(const char *field, int64_t expected, uint64_t actual) {
+  if (expected == UNKNOWN || (uint64_t) expected == actual) {
+    return true;
+  }
+  printf("    MISMATCH %s: expected %lld, got %llu\n", field,
+         (long long) expected, (unsigned long long) actual);
+  return false;
+}
+
+int main(int argc, char **argv) {
+  Options options = ParseOptions(argc, argv);
+  Position::initTables();
+
+  vector<TestPosition> suite(kSuite, kSuite + kSuiteSize);
+  if (!options.fen.empty()) {
+    TestPosition custom = { "custom", options.fen.c_str(), 4, {} };
+    for (int i = 0; i < MAX_REFERENCE_DEPTH; ++i) {
+      custom.results[i].nodes = custom.results[i].captures =
+          custom.results[i].en_passants = custom.results[i].castles =
+          custom.results[i].promotions = custom.results[i].checks =
+          custom.results[i].mates = UNKNOWN;
+    }
+    suite.assign(1, custom);
+  }
+
+  map<string, double> baseline = LoadBaseline(options.baseline);
+  ofstream baseline_out;
+  if (options.save_baseline) {
+    baseline_out.open(options.baseline.c_str());
+    if (!baseline_out) {
+      cerr << "Error: could not write " << options.baseline << endl;
+      return 2;
+    }
+  }
+
+  bool fens_ok = CheckFens();
+  bool counts_ok = true;
+  double expected_seconds = 0, compared_seconds = 0;
+  uint64_t total_nodes = 0;
+  double total_seconds = 0;
+
+  printf("%-10s %5s %12s %10s %8s %9s %9s %9s %8s %10s\n", "position",
+         "depth", "nodes", "captures", "e.p.", "castles", "promos", "checks",
+         "mates", "Mnodes/s");
+  for (size_t i = 0; i < suite.size(); ++i) {
+    const TestPosition &test = suite[i];
+    int depth = options.depth ? options.depth : test.default_depth;
+    Position pos;
+    if (!pos.setFen(test.fen)) {
+      cerr << "Error: invalid FEN " << test.fen << endl;
+      return 2;
+    }
+
+    PerftStats stats;
+    PerftDetailed(pos, depth, &stats);
+
+    // Time the plain counter separately; the breakdown is much slower.
+    double best = 0;
+    uint64_t nodes = 0;
+    for (int run = 0; run < options.repeat; ++run) {
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      nodes = Perft(pos, depth);
+      double seconds = chrono::duration<double>(
+          chrono::steady_clock::now() - start).count();
+      if (run == 0 || seconds < best) {
+        best = seconds;
+      }
+    }
+    best = best > 1e-9 ? best : 1e-9;
+    double nps = nodes / best;
+    total_nodes += nodes;
+    total_seconds += best;
+
+    printf("%-10s %5d %12llu %10llu %8llu %9llu %9llu %9llu %8llu %10.2f\n",
+           test.name, depth, (unsigned long long) stats.nodes,
+           (unsigned long long) stats.captures,
+           (unsigned long long) stats.en_passants,
+           (unsigned long long) stats.castles,
+           (unsigned long long) stats.promotions,
+           (unsigned long long) stats.checks,
+           (unsigned long long) stats.mates, nps / 1e6);
+
+    if (nodes != stats.nodes) {
+      printf("    MISMATCH counters disagree: %llu vs. %llu nodes\n",
+             (unsigned long long) nodes, (unsigned long long) stats.nodes);
+      counts_ok = false;
+    }
+    if (depth >= 1 && depth <= MAX_REFERENCE_DEPTH) {
+      const Reference &ref = test.results[depth - 1];
+      counts_ok &= Check("nodes", ref.nodes, stats.nodes);
+      counts_ok &= Check("captures", ref.captures, stats.captures);
+      counts_ok &= Check("e.p.", ref.en_passants, stats.en_passants);
+      counts_ok &= Check("castles", ref.castles, stats.castles);
+      counts_ok &= Check("promotions", ref.promotions, stats.promotions);
+      counts_ok &= Check("checks", ref.checks, stats.checks);
+      counts_ok &= Check("mates", ref.mates, stats.mates);
+    }
+
+    string key = string(test.name) + "/" + to_string(depth);
+    if (baseline.count(key) && baseline[key] > 0) {
+      expected_seconds += nodes / baseline[key];
+      compared_seconds += best;
+    }
+    if (options.save_baseline) {
+      baseline_out << key << ' ' << nps << '\n';
+    }
+  }
+
+  printf("total: %llu nodes in %.3f s (%.2f Mnodes/s)\n",
+         (unsigned long long) total_nodes, total_seconds,
+         total_nodes / (total_seconds > 0 ? total_seconds : 1e-9) / 1e6);
+
+  bool speed_ok = true;
+  if (options.save_baseline) {
+    printf("baseline written to %s\n", options.baseline.c_str());
+  } else if (compared_seconds > 0) {
+    double change = 100.0 * (expected_seconds / compared_seconds - 1.0);
+    printf("throughput vs. baseline: %+.1f%% (tolerance -%.1f%%)\n", change,
+           options.tolerance);
+    speed_ok = change >= -options.tolerance;
+  } else {
+    printf("no matching baseline in %s; throughput not checked\n",
+           options.baseline.c_str());
+  }
+
+  if (!fens_ok) {
+    printf("FAILED: FEN parsing differs from the reference\n");
+  }
+  if (!counts_ok) {
+    printf("FAILED: node counts differ from the reference\n");
+  }
+  if (!speed_ok) {
+    printf("FAILED: throughput regression\n");
+  }
+  return fens_ok && counts_ok && speed_ok ? 0 : 1;
+}
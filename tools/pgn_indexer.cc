@@ -0,0 +1,235 @@
+/*******************************************************************************
+   Filename: pgn_indexer.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Converts PGN collections into a binary game database, and looks
+             up the games that reach a position. Each input file is memory-
+             mapped and split at game boundaries into one chunk per thread;
+             the threads parse their chunks into separate database parts.
+             A part that outgrows its share of the memory budget is sorted
+             and spilled to a run file beside the output, as is each part
+             once its chunk is done; the runs are merged from disk, in order,
+             when the database is written.
+*******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "game_db.h"
+#include "mapped_file.h"
+#include "pgn.h"
+
+using namespace std;
+
+#define DEFAULT_FIND_LIMIT 20
+#define DEFAULT_MEMORY_MB 1024
+
+namespace {
+
+struct Options {
+  int threads;
+  int index_plies;
+  size_t memory_mb;
+  string find_fen;
+  int limit;
+  vector<string> files;  // Output then inputs, or the database for --find.
+};
+
+struct ChunkResult {
+  GameDbBuilder part;
+  bool spill_failed;
+  size_t skipped;
+  size_t first_error;  // Offset of the first skipped game.
+};
+
+void Usage() {
+  cerr << "Usage: pgn_indexer [options] OUTPUT.db INPUT.pgn ...\n"
+          "       pgn_indexer --find FEN [--limit N] DATABASE.db\n"
+          "  --threads N      parsing threads (default: one per core)\n"
+          "  --index-plies N  index only the first N plies of each game\n"
+          "                   (default: every position)\n"
+          "  --memory MB      memory for games awaiting the merge, shared\n"
+          "                   by the threads (default: 1024)\n"
+          "  --find FEN       list the games that reach FEN\n"
+          "  --limit N        list at most N games (default: 20)\n";
+  exit(2);
+}
+
+Options ParseOptions(int argc, char **argv) {
+  Options options;
+  options.threads = max(1u, thread::hardware_concurrency());
+  options.index_plies = 0;
+  options.memory_mb = DEFAULT_MEMORY_MB;
+  options.limit = DEFAULT_FIND_LIMIT;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--threads" && has_value) {
+      options.threads = atoi(argv[++i]);
+    } else if (arg == "--index-plies" && has_value) {
+      options.index_plies = atoi(argv[++i]);
+    } else if (arg == "--memory" && has_value) {
+      options.memory_mb = (size_t) max(0, atoi(argv[++i]));
+    } else if (arg == "--find" && has_value) {
+      options.find_fen = argv[++i];
+    } else if (arg == "--limit" && has_value) {
+      options.limit = atoi(argv[++i]);
+    } else if (arg.compare(0, 2, "--") == 0) {
+      Usage();
+    } else {
+      options.files.push_back(arg);
+    }
+  }
+  bool find = !options.find_fen.empty();
+  if (options.threads < 1 || options.index_plies < 0 ||
+      options.memory_mb < 1 ||
+      (find && options.files.size() != 1) ||
+      (!find && options.files.size() < 2)) {
+    Usage();
+  }
+  return options;
+}
+
+void ParseChunk(const char *data, size_t begin, size_t end,
+                const Options &options, const string &temp_prefix,
+                ChunkResult *result) {
+  size_t budget = options.memory_mb * 1024 * 1024 / options.threads;
+  result->part.setIndexPlies(options.index_plies);
+  result->part.setTempPrefix(temp_prefix);
+  result->spill_failed = false;
+  result->skipped = 0;
+  result->first_error = 0;
+  PgnReader reader(data + begin, end - begin);
+  PgnGame game;
+  while (reader.next(&game)) {
+    if (!result->part.addGame(game)) {
+      if (result->skipped++ == 0) {
+        result->first_error = begin + game.offset;
+      }
+    } else if (result->part.memoryUsed() >= budget &&
+               !result->part.spill()) {
+      result->spill_failed = true;
+      return;
+    }
+  }
+  // Spill the rest too, so that parts of earlier files do not hold memory
+  // while later files are parsed:
+  result->spill_failed = !result->part.spill();
+}
+
+int Build(const Options &options) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  vector<GameDbBuilder> parts;
+  size_t total_bytes = 0, skipped = 0;
+  const char *output = options.files[0].c_str();
+  for (size_t f = 1; f < options.files.size(); ++f) {
+    const char *filename = options.files[f].c_str();
+    MappedFile file;
+    if (!file.open(filename, MappedFile::ACCESS_SEQUENTIAL)) {
+      cerr << "Error: could not read " << filename << endl;
+      return 1;
+    }
+    const char *data = (const char *) file.data();
+    size_t size = file.size();
+    total_bytes += size;
+
+    vector<size_t> bounds = SplitGames(data, size, options.threads);
+    vector<ChunkResult> results(bounds.size() - 1);
+    vector<thread> threads;
+    for (size_t i = 0; i < results.size(); ++i) {
+      string temp_prefix = string(output) + ".part" +
+                           to_string(parts.size() + i);
+      threads.push_back(thread(ParseChunk, data, bounds[i], bounds[i + 1],
+                               cref(options), temp_prefix, &results[i]));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+      threads[i].join();
+    }
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (results[i].spill_failed) {
+        cerr << "Error: could not write a temporary file beside " << output
+             << endl;
+        return 1;
+      }
+      if (results[i].skipped) {
+        cerr << "Note: " << filename << ": skipped " << results[i].skipped
+             << " unreadable game(s), the first at byte "
+             << results[i].first_error << endl;
+      }
+      skipped += results[i].skipped;
+      parts.push_back(move(results[i].part));
+    }
+  }
+
+  size_t games = 0, moves = 0, positions = 0;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    games += parts[i].gameCount();
+    moves += parts[i].moveCount();
+    positions += parts[i].indexCount();
+  }
+  if (games > UINT32_MAX) {
+    cerr << "Error: too many games for one database" << endl;
+    return 1;
+  }
+  if (!WriteGameDatabase(output, parts)) {
+    cerr << "Error: could not write " << output << endl;
+    return 1;
+  }
+  double seconds = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+  printf("%zu games (%zu skipped), %zu moves, %zu indexed positions\n",
+         games, skipped, moves, positions);
+  printf("%.1f MB in %.2f s (%.1f MB/s)\n", total_bytes / 1e6, seconds,
+         total_bytes / 1e6 / max(seconds, 1e-9));
+  return 0;
+}
+
+int Find(const Options &options) {
+  GameDatabase db;
+  if (!db.open(options.files[0].c_str())) {
+    cerr << "Error: could not open " << options.files[0]
+         << " (missing, damaged, or built by an incompatible version)"
+         << endl;
+    return 1;
+  }
+  Position pos;
+  if (!pos.setFen(options.find_fen)) {
+    cerr << "Error: invalid FEN " << options.find_fen << endl;
+    return 1;
+  }
+  vector<GameDbIndexEntry> matches;
+  db.findPosition(pos.key(), &matches);
+
+  static const char *kResults[] = { "*", "1-0", "0-1", "1/2-1/2" };
+  int results[4] = { 0, 0, 0, 0 };
+  for (size_t i = 0; i < matches.size(); ++i) {
+    uint32_t game = matches[i].game;
+    ++results[db.result(game)];
+    if ((int) i < options.limit) {
+      printf("game %u, ply %u: %s - %s %s (%s, %s)\n", game + 1,
+             matches[i].ply, db.tag(game, "White").c_str(),
+             db.tag(game, "Black").c_str(), kResults[db.result(game)],
+             db.tag(game, "Event").c_str(), db.tag(game, "Date").c_str());
+    }
+  }
+  printf("%zu games: +%d =%d -%d (white's view)\n", matches.size(),
+         results[RESULT_WHITE_WINS], results[RESULT_DRAW],
+         results[RESULT_BLACK_WINS]);
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options options = ParseOptions(argc, argv);
+  Position::initTables();
+  return options.find_fen.empty() ? Build(options) : Find(options);
+}
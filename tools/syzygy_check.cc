@@ -0,0 +1,87 @@
+/*******************************************************************************
+   Filename: syzygy_check.cc
+
+     Author: David C. Drake (https://davidcdrake.com)
+
+Description: Checks the Syzygy decoder against real tables: probes positions
+             whose results are known for certain (mates in one, immediate
+             promotions, stalemates, hanging queens, rook-pawn draws) and
+             exits non-zero on any wrong or failed probe. Needs the KQvK,
+             KRvK and KPvK .rtbw and .rtbz files.
+Usage:       syzygy_check PATH  (directories separated by ':')
+*******************************************************************************/
+
+#include <cstdio>
+#include "syzygy.h"
+
+namespace {
+
+#define ANY_DTZ 0  // Only the sign of the DTZ value is checked.
+
+struct Case {
+  const char *fen;
+  int wdl;
+  int dtz;  // Exact value in plies, or ANY_DTZ.
+};
+
+const Case kCases[] = {
+  // Mates in one zero the counter at once:
+  { "k7/8/K7/8/8/8/8/1Q6 w - - 0 1", WDL_WIN, 1 },
+  { "1q6/8/8/8/8/k7/8/K7 b - - 0 1", WDL_WIN, 1 },  // Colors reversed.
+  { "k7/8/1K6/8/8/8/8/7R w - - 0 1", WDL_WIN, 1 },
+  // So does a promotion:
+  { "8/4P3/8/8/8/k7/8/K7 w - - 0 1", WDL_WIN, 1 },
+  { "8/8/8/8/8/2k5/8/K6R b - - 0 1", WDL_LOSS, ANY_DTZ },
+  { "8/8/8/8/8/2K5/8/k6r w - - 0 1", WDL_LOSS, ANY_DTZ },
+  // The king takes the unprotected queen:
+  { "8/8/8/8/8/8/1kQ5/4K3 b - - 0 1", WDL_DRAW, 0 },
+  // Stalemate:
+  { "k7/2Q5/1K6/8/8/8/8/8 b - - 0 1", WDL_DRAW, 0 },
+  // The defending king holds the corner in front of a rook pawn:
+  { "k7/8/8/8/8/8/P7/K7 w - - 0 1", WDL_DRAW, 0 },
+};
+
+const int kNumCases = sizeof(kCases) / sizeof(kCases[0]);
+
+inline int Sign(int x) { return (x > 0) - (x < 0); }
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s PATH\n", argv[0]);
+    return 2;
+  }
+  Position::initTables();
+  Tablebases tablebases;
+  if (tablebases.init(argv[1]) == 0) {
+    fprintf(stderr, "Error: no tablebases found in %s\n", argv[1]);
+    return 1;
+  }
+  int failures = 0;
+  for (int i = 0; i < kNumCases; ++i) {
+    const Case &c = kCases[i];
+    Position pos;
+    if (!pos.setFen(c.fen)) {
+      fprintf(stderr, "Error: invalid FEN %s\n", c.fen);
+      return 1;
+    }
+    int wdl = 0, dtz = 0;
+    bool wdl_ok = tablebases.probeWdl(pos, &wdl);
+    bool dtz_ok = tablebases.probeDtz(pos, &dtz);
+    bool pass = wdl_ok && dtz_ok && wdl == c.wdl &&
+                Sign(dtz) == Sign(c.wdl) &&
+                (c.dtz == ANY_DTZ || dtz == c.dtz);
+    char expected[16];
+    snprintf(expected, sizeof(expected), c.dtz != ANY_DTZ ? "%d" :
+             c.wdl > 0 ? "> 0" : c.wdl < 0 ? "< 0" : "0", c.dtz);
+    printf("%-36s wdl %2d (expected %2d)  dtz %4d (expected %s)  %s\n",
+           c.fen, wdl, c.wdl, dtz, expected,
+           !wdl_ok || !dtz_ok ? "PROBE FAILED" : pass ? "ok" : "WRONG");
+    if (!pass) {
+      ++failures;
+    }
+  }
+  printf("%d of %d positions correct\n", kNumCases - failures, kNumCases);
+  return failures ? 1 : 0;
+}